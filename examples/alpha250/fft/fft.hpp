@@ -269,6 +269,7 @@ inline void  FFT::psd_acquisition_thread() {
         }
 
         {
+            KOHERON_TRACE_SCOPE("FFT::psd_acquisition");
             std::lock_guard<std::mutex> lock(mutex);
             psd_buffer_raw = psd_map.read_array<float, prm::fft_size/2, 0>();
 
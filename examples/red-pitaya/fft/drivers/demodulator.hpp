@@ -63,6 +63,8 @@ class Demodulator
     std::array<int32_t, fifo_buff_size> fifo_buffer;
 
     std::vector<int32_t> last_buffer_vect;
+    std::vector<int32_t> new_points;
+    std::vector<int32_t> published_points; ///< Copy published by the acquisition thread
     std::thread fifo_thread;
     void fifo_acquisition_thread();
 
@@ -82,14 +84,27 @@ inline void Demodulator::fifo_acquisition_thread()
     fifo_acquisition_started = true;
     while (fifo_acquisition_started) {
         {
+            KOHERON_TRACE_SCOPE("Demodulator::fifo_acquisition");
             std::lock_guard<std::mutex> lock(mutex);
             const uint32_t n_pts = get_fifo_length();
             ctx.log<INFO>("fifo_length: %d \n", n_pts);
+            new_points.resize(n_pts);
             for (size_t i = 0; i < n_pts; i++) {
-                fifo_buffer[fifo_buff_idx] = read_fifo();
+                new_points[i] = read_fifo();
+                fifo_buffer[fifo_buff_idx] = new_points[i];
                 fifo_buff_idx = (fifo_buff_idx + 1) % fifo_buff_size;
             }
+
+            published_points = new_points;
+        }
+
+        // Push the new points to the subscribed clients.
+        // Published without the lock: a blocking subscription
+        // doesn't hold the driver operations.
+        if (!published_points.empty()) {
+            ctx.publish<Demodulator, op_id::Demodulator::get_vector>(published_points);
         }
+
         std::this_thread::sleep_for(10ms);
     }
 }
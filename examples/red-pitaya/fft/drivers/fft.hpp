@@ -73,27 +73,32 @@ class FFT
     }
 
     // Read averaged spectrum data
+    /// @read_only
     const auto& read_psd_raw() {
         std::lock_guard<std::mutex> lock(mutex);
         return psd_buffer_raw;
     }
 
     // Return the PSD in W/Hz
+    /// @read_only
     const auto& read_psd() {
         std::lock_guard<std::mutex> lock(mutex);
         return psd_buffer;
     }
 
+    /// @read_only
     uint32_t get_number_averages() const {
         return prm::n_cycles;
     }
 
+    /// @read_only
     uint32_t get_fft_size() const {
         return prm::fft_size;
     }
 
     // Return the raw input value of each ADC channel
     // n_avg: number of averages
+    /// @read_only
     const std::array<int32_t, prm::n_adc> get_adc_raw_data(uint32_t n_avg) {
         if (n_avg <= 1) {
             return { ((static_cast<int32_t>(sts.read<reg::adc0>()) + 8192) % 16384) - 8192,
@@ -140,10 +145,12 @@ class FFT
         dds_freq[channel] = freq_hz;
     }
 
+    /// @read_only
     auto get_control_parameters() {
         return std::make_tuple(dds_freq[0], dds_freq[1], fs_adc, input_channel, W1, W2);
     }
 
+    /// @read_only
     const auto& get_window_index() const {
         return window_index;
     }
@@ -168,6 +175,10 @@ class FFT
 
     std::array<float, prm::fft_size/2> psd_buffer_raw;
     std::array<float, prm::fft_size/2> psd_buffer;
+
+    // Copies of the spectra published by the acquisition thread
+    std::array<float, prm::fft_size/2> published_psd_raw;
+    std::array<float, prm::fft_size/2> published_psd;
     std::thread psd_thread;
     std::mutex mutex;
     std::atomic<bool> psd_acquisition_started{false};
@@ -264,14 +275,24 @@ inline void  FFT::psd_acquisition_thread() {
         }
 
         {
+            KOHERON_TRACE_SCOPE("FFT::psd_acquisition");
             std::lock_guard<std::mutex> lock(mutex);
             psd_buffer_raw = psd_map.read_array<float, prm::fft_size/2, 0>();
 
             for (unsigned int i=0; i<prm::fft_size/2; i++) {
                 psd_buffer[i] = psd_buffer_raw[i] * freq_calibration[input_channel][i];
             }
+
+            published_psd_raw = psd_buffer_raw;
+            published_psd = psd_buffer;
         }
 
+        // Push the new spectra to the subscribed clients.
+        // Published without the lock: a blocking subscription
+        // doesn't hold the driver operations.
+        ctx.publish<FFT, op_id::FFT::read_psd_raw>(published_psd_raw);
+        ctx.publish<FFT, op_id::FFT::read_psd>(published_psd);
+
         acq_cycle_index = get_cycle_index();
     }
 }
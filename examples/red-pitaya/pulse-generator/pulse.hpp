@@ -25,8 +25,9 @@ constexpr uint32_t dac_size = mem::dac_range/sizeof(uint32_t);
 class Pulse
 {
   public:
-    Pulse(Context& ctx)
-    : ctl(ctx.mm.get<mem::control>())
+    Pulse(Context& ctx_)
+    : ctx(ctx_)
+    , ctl(ctx.mm.get<mem::control>())
     , sts(ctx.mm.get<mem::status>())
     , adc_fifo_map(ctx.mm.get<mem::adc_fifo>())
     , dac_map(ctx.mm.get<mem::dac>())
@@ -36,6 +37,7 @@ class Pulse
 
     // Trigger
 
+    /// @read_only
     auto get_status() {
         return std::make_tuple(
             pulse_width,
@@ -66,6 +68,7 @@ class Pulse
 
     // Adc FIFO
 
+    /// @read_only
     uint32_t get_fifo_occupancy() {
         return adc_fifo_map.read<Fifo_regs::rdfo>();
     }
@@ -78,6 +81,7 @@ class Pulse
         return adc_fifo_map.read<Fifo_regs::rdfd>();
     }
 
+    /// @read_only
     uint32_t get_fifo_length() {
         return (adc_fifo_map.read<Fifo_regs::rlr>() & 0x3FFFFF) >> 2;
     }
@@ -112,6 +116,7 @@ class Pulse
         return adc_data;
     }
 
+    /// @read_only
     const auto& get_fifo_buffer() {
         return fifo_buffer;
     }
@@ -119,6 +124,7 @@ class Pulse
     void start_fifo_acquisition();
 
   private:
+    Context& ctx;
     Memory<mem::control>& ctl;
     Memory<mem::status>& sts;
     Memory<mem::adc_fifo>& adc_fifo_map;
@@ -157,12 +163,20 @@ inline void Pulse::fifo_acquisition_thread()
     fifo_acquisition_started = true;
 
     while (fifo_acquisition_started) {
-        const uint32_t n_pts = get_fifo_length();
-
-        for (size_t i = 0; i < n_pts; i++) {
-            fifo_buffer[fifo_buff_idx] = read_fifo();
-            fifo_buff_idx = (fifo_buff_idx + 1) % fifo_buff_size;
+        {
+            KOHERON_TRACE_SCOPE("Pulse::fifo_acquisition");
+            const uint32_t n_pts = get_fifo_length();
+
+            for (size_t i = 0; i < n_pts; i++) {
+                fifo_buffer[fifo_buff_idx] = read_fifo();
+                fifo_buff_idx = (fifo_buff_idx + 1) % fifo_buff_size;
+            }
+
+            if (n_pts > 0) {
+                ctx.publish<Pulse, op_id::Pulse::get_fifo_buffer>(fifo_buffer);
+            }
         }
+
         std::this_thread::sleep_for(fifo_sleep_for);
     }
 }
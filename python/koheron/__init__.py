@@ -1,6 +1,7 @@
 from .version import __version__
 
 from .koheron import KoheronClient
+from .koheron import UdpStream
 from .koheron import command
 from .koheron import ConnectionError
 from .koheron import connect
@@ -1,6 +1,8 @@
 #!/usr/bin/env python
 # -*- coding: utf-8 -*-
 
+import os
+import mmap
 import socket
 import struct
 import numpy as np
@@ -8,9 +10,15 @@ import string
 import json
 import requests
 import time
+from collections import deque
 
 from .version import __version__
 
+try:
+    import lz4.block as lz4_block
+except ImportError:
+    lz4_block = None
+
 ConnectionError = requests.ConnectionError
 
 # --------------------------------------------
@@ -204,6 +212,132 @@ cpp_to_np_types = {
   'double': 'float64'
 }
 
+cpp_to_struct_fmt = {
+  'bool': '?',
+  'uint8_t': 'B', 'int8_t': 'b',
+  'uint16_t': 'H', 'int16_t': 'h',
+  'uint32_t': 'I', 'unsigned int': 'I',
+  'int32_t': 'i', 'int': 'i',
+  'uint64_t': 'Q', 'unsigned long': 'Q', 'int64_t': 'q', 'long': 'q',
+  'float': 'f',
+  'double': 'd'
+}
+
+def get_std_tuple_params(_type):
+    return [t.strip() for t in _type.split('<', 1)[1].rsplit('>', 1)[0].split(',')]
+
+# --------------------------------------------
+# Compression of the responses
+# --------------------------------------------
+
+COMPRESSION_LZ4 = 1
+COMPRESSION_SHUFFLE = 2
+
+# Value of the reserved header field of the compressed responses
+COMPRESSED_RESPONSE = 1
+
+# Value of the reserved header field of the stream frames
+STREAM_FRAME = 2
+
+# Backpressure policies of the stream subscriptions
+STREAM_DROP_OLDEST = 0
+STREAM_DROP_NEWEST = 1
+STREAM_BLOCK = 2
+
+# --------------------------------------------
+# Shared memory transport (Unix socket)
+# --------------------------------------------
+
+# Value of the reserved header field of the shared memory doorbells
+SHM_DOORBELL = 3
+
+# Size of the control page, followed by the request and response rings
+SHM_CONTROL_SIZE = 4096
+
+# Offsets of the released positions in the control page
+SHM_REQUEST_RELEASED = 0
+SHM_RESPONSE_RELEASED = 64
+
+# Minimum payload size going through the shared memory
+SHM_MIN_SIZE = 16384
+
+# --------------------------------------------
+# UDP streams
+# --------------------------------------------
+
+UDP_PORT = 36100
+
+# Value of the reserved header field of the UDP data datagrams
+UDP_DATAGRAM = 4
+
+# Commands of the UDP control datagrams
+UDP_SUBSCRIBE = 1
+UDP_UNSUBSCRIBE = 2
+
+# Control datagram: command, class_id, func_id, cookie, status
+UDP_CONTROL_FMT = '>IHHII'
+UDP_CONTROL_SIZE = struct.calcsize(UDP_CONTROL_FMT)
+
+# Status of the control answers (UDP_COOKIE: send the request again with the cookie of the answer)
+UDP_FAILED = 0
+UDP_OK = 1
+UDP_COOKIE = 2
+
+# Data datagram header: reserved, class_id, func_id, sequence, frame, fragment, n_fragments, timestamp
+UDP_HEADER_FMT = '>IHHIIHHQ'
+UDP_HEADER_SIZE = struct.calcsize(UDP_HEADER_FMT)
+
+# Subscription renewal period (the server removes it after 10 s)
+UDP_RENEWAL_PERIOD = 3.0
+
+def lz4_decompress(src, size):
+    '''Decompress a LZ4 block of size bytes once decompressed.'''
+    if lz4_block is not None:
+        return lz4_block.decompress(src, uncompressed_size=size)
+    dst = bytearray()
+    i = 0
+    while i < len(src):
+        token = src[i]
+        i += 1
+        length = token >> 4
+        if length == 15:
+            while True:
+                length += src[i]
+                i += 1
+                if src[i - 1] != 255:
+                    break
+        dst += src[i:i + length]
+        i += length
+        if i >= len(src):
+            break
+        offset = src[i] | (src[i + 1] << 8)
+        i += 2
+        length = token & 0x0f
+        if length == 15:
+            while True:
+                length += src[i]
+                i += 1
+                if src[i - 1] != 255:
+                    break
+        length += 4
+        start = len(dst) - offset
+        if offset >= length:
+            dst += dst[start:start + length]
+        else:
+            # The match overlaps its own output: repeat the last offset bytes
+            dst += (dst[start:] * (length // offset + 1))[:length]
+    assert len(dst) == size
+    return bytes(dst)
+
+def unshuffle(data, element_size):
+    '''Inverse of the server shuffle filter.'''
+    if element_size <= 1:
+        return data
+    n_elements = len(data) // element_size
+    n_shuffled = n_elements * element_size
+    arr = np.frombuffer(data, dtype='uint8', count=n_shuffled)
+    return arr.reshape(element_size, n_elements).T.tobytes() + data[n_shuffled:]
+
 # --------------------------------------------
 # KoheronClient
 # --------------------------------------------
@@ -226,6 +360,10 @@ class KoheronClient:
         self.port = port
         self.unixsock = unixsock
         self.is_connected = False
+        self.compression = 0
+        self.pending = b''
+        self.streams = {}
+        self.shm = None
 
         if host != '':
             try:
@@ -344,11 +482,60 @@ class KoheronClient:
 
     def send_command(self, device_id, cmd_id, cmd_args=[], *args):
         cmd = make_command(device_id, cmd_id, cmd_args, *args)
+        if self.shm is not None and len(cmd) - 8 >= SHM_MIN_SIZE:
+            cmd = self.shm_request(cmd, device_id, cmd_id) or cmd
         if self.sock.send(cmd) == 0:
             raise ConnectionError('send_command: Socket connection broken')
 
+    def enable_compression(self, shuffle=True):
+        '''Ask the server to compress the large responses.
+
+        Returns:
+            True if the server accepted
+        '''
+        flags = COMPRESSION_LZ4 | (COMPRESSION_SHUFFLE if shuffle else 0)
+        device_id, cmd_id, cmd_args = self.get_ids('KServer', 'set_compression')
+        self.send_command(device_id, cmd_id, cmd_args, flags)
+        self.compression = self.recv()
+        return self.compression != 0
+
+    def recv_response(self, n_bytes):
+        '''Receive the first n_bytes bytes of a response.
+
+        A compressed response is received and decompressed at once,
+        the following reads get its bytes.
+        '''
+        if (self.compression or self.streams or self.shm is not None) and not self.pending:
+            header = self.recv_socket(struct.calcsize('>IHH'))
+            reserved, class_id, func_id = struct.unpack('>IHH', header)
+            # Stream frames received before the response are queued
+            while reserved == STREAM_FRAME:
+                self.queue_frame(class_id, func_id)
+                header = self.recv_socket(struct.calcsize('>IHH'))
+                reserved, class_id, func_id = struct.unpack('>IHH', header)
+            if reserved == SHM_DOORBELL:
+                self.pending = self.shm_response()
+            elif reserved == COMPRESSED_RESPONSE:
+                size, compressed_size, element_size = struct.unpack('>III', self.recv_socket(12))
+                payload = lz4_decompress(self.recv_socket(compressed_size), size)
+                header = struct.pack('>IHH', 0, class_id, func_id)
+                self.pending = header + unshuffle(payload, element_size)
+            else:
+                self.pending = header
+        return self.recv_all(n_bytes)
+
     def recv_all(self, n_bytes):
         '''Receive exactly n_bytes bytes.'''
+        if self.pending:
+            data = self.pending[:n_bytes]
+            self.pending = self.pending[n_bytes:]
+            if len(data) < n_bytes:
+                data = bytes(data) + self.recv_socket(n_bytes - len(data))
+            return data
+        return self.recv_socket(n_bytes)
+
+    def recv_socket(self, n_bytes):
+        '''Receive exactly n_bytes bytes from the socket.'''
         data = []
         BUFF_SIZE = 65535
         n_rcv = 0
@@ -364,13 +551,13 @@ class KoheronClient:
         return b''.join(data)
 
     def recv_dynamic_payload(self):
-        reserved, class_id, func_id, length = struct.unpack('>IHHI', self.recv_all(struct.calcsize('>IHHI')))
+        reserved, class_id, func_id, length = struct.unpack('>IHHI', self.recv_response(struct.calcsize('>IHHI')))
         assert reserved == 0
         return self.recv_all(length)
 
     def recv(self, fmt='I'):
         fmt_ = '>IHH' + fmt
-        t = struct.unpack(fmt_, self.recv_all(struct.calcsize(fmt_)))[3:]
+        t = struct.unpack(fmt_, self.recv_response(struct.calcsize(fmt_)))[3:]
         if len(t) == 1:
             return t[0]
         else:
@@ -403,7 +590,7 @@ class KoheronClient:
     def recv_string(self, check_type=True):
         if check_type:
             self.check_ret_type(['const std::string', 'std::string', 'const char *', 'const char*'])
-        return self.recv_dynamic_payload().decode('utf8')
+        return str(self.recv_dynamic_payload(), 'utf8')
 
     def recv_json(self, check_type=True):
         if check_type:
@@ -433,6 +620,422 @@ class KoheronClient:
             self.check_ret_tuple()
         return tuple(self.recv(fmt))
 
+    def recv_ret_type(self, ret_type):
+        '''Receive a response given the return type of the command.'''
+        ret_type = ret_type.split('&')[0].strip()
+        if ret_type.startswith('const '):
+            ret_type = ret_type[len('const '):]
+        if ret_type == 'void':
+            return None
+        if ret_type in cpp_to_struct_fmt:
+            return self.recv(fmt=cpp_to_struct_fmt[ret_type])
+        if is_std_vector(ret_type):
+            dtype = cpp_to_np_types[get_std_vector_params(ret_type)['T']]
+            return self.recv_vector(dtype=dtype, check_type=False)
+        if is_std_array(ret_type):
+            params = get_std_array_params(ret_type)
+            return self.recv_array(int(params['N']), dtype=cpp_to_np_types[params['T']], check_type=False)
+        if is_std_tuple(ret_type):
+            fmt = ''.join(cpp_to_struct_fmt[t] for t in get_std_tuple_params(ret_type))
+            return self.recv_tuple(fmt, check_type=False)
+        if ret_type in ['std::string', 'char *', 'char*']:
+            return self.recv_string(check_type=False)
+        raise ValueError('Unsupported return type "' + ret_type + '"')
+
+    # -------------------------------------------------------
+    # Shared memory
+    # -------------------------------------------------------
+
+    def open_shared_memory(self):
+        '''Map a memory region shared with the server (Unix socket only).
+
+        The large request and response payloads then go through the
+        shared memory instead of being copied through the socket.
+
+        Returns:
+            True if the server accepted
+        '''
+        if self.unixsock == '' or self.shm is not None:
+            return False
+        device_id, cmd_id, cmd_args = self.get_ids('KServer', 'open_shared_memory')
+        self.send_command(device_id, cmd_id, cmd_args)
+        # The memfd is received with the response
+        n_bytes = struct.calcsize('>IHHI')
+        fd_size = struct.calcsize('i')
+        data, ancdata, _, _ = self.sock.recvmsg(n_bytes, socket.CMSG_SPACE(fd_size))
+        data += self.recv_socket(n_bytes - len(data))
+        ring_size = struct.unpack('>IHHI', data)[3]
+        fds = [struct.unpack('i', cmsg_data[:fd_size])[0] for level, cmsg_type, cmsg_data in ancdata
+               if level == socket.SOL_SOCKET and cmsg_type == socket.SCM_RIGHTS]
+        if not fds:
+            return False
+        try:
+            if ring_size > 0:
+                self.shm = mmap.mmap(fds[0], SHM_CONTROL_SIZE + 2 * ring_size)
+                self.shm_ring_size = ring_size
+                self.shm_request_head = 0
+        finally:
+            os.close(fds[0])
+        return self.shm is not None
+
+    def get_stats(self):
+        '''Latency statistics of the operations executed by the server.
+
+        Returns:
+            The report of the server, each operation named with its
+            driver and command ('driver_name' and 'name' keys).
+            Latencies are in ns, split in the time waiting for the driver lock,
+            executing and sending the response.
+        '''
+        device_id, cmd_id, cmd_args = self.get_ids('KServer', 'get_stats')
+        self.send_command(device_id, cmd_id, cmd_args)
+        stats = self.recv_json(check_type=False)
+        devices = {device['id']: device for device in self.commands}
+        for operation in stats['operations']:
+            device = devices.get(operation['driver'], {'class': '', 'functions': []})
+            operation['driver_name'] = device['class']
+            operation['name'] = next((cmd['name'] for cmd in device['functions'] if cmd['id'] == operation['op']), '')
+        return stats
+
+    def get_trace(self, seconds=10):
+        '''Trace events of the server activity in the last seconds.
+
+        Returns:
+            The Chrome trace-event JSON. Save it with json.dump
+            to open it in Perfetto (https://ui.perfetto.dev).
+        '''
+        device_id, cmd_id, cmd_args = self.get_ids('KServer', 'get_trace')
+        self.send_command(device_id, cmd_id, cmd_args, seconds)
+        return self.recv_json(check_type=False)
+
+    def shm_request(self, cmd, device_id, cmd_id):
+        '''Write the payload of a command in the request ring.
+
+        Returns:
+            The doorbell to send instead of the command, None if the ring is full
+        '''
+        size = len(cmd) - 8
+        ring_size = self.shm_ring_size
+        if size > ring_size:
+            return None
+        position = self.shm_request_head
+        offset = position % ring_size
+        # Payloads don't wrap around
+        if offset + size > ring_size:
+            position = (position + ring_size - offset) & 0xFFFFFFFF
+            offset = 0
+        end = (position + size) & 0xFFFFFFFF
+        released = struct.unpack_from('=I', self.shm, SHM_REQUEST_RELEASED)[0]
+        if (end - released) & 0xFFFFFFFF > ring_size:
+            return None
+        start = SHM_CONTROL_SIZE + offset
+        self.shm[start:start + size] = memoryview(cmd)[8:]
+        self.shm_request_head = end
+        return struct.pack('>IHHII', SHM_DOORBELL, device_id, cmd_id, position, size)
+
+    def shm_response(self):
+        '''Copy a response (header included) out of the response ring and release it.
+
+        Returns:
+            A view of the response, the following reads are not copied
+        '''
+        position, size = struct.unpack('>II', self.recv_socket(8))
+        start = SHM_CONTROL_SIZE + self.shm_ring_size + position % self.shm_ring_size
+        response = self.shm[start:start + size]
+        struct.pack_into('=I', self.shm, SHM_RESPONSE_RELEASED, (position + size) & 0xFFFFFFFF)
+        return memoryview(response)
+
+    # -------------------------------------------------------
+    # Server-push streams
+    # -------------------------------------------------------
+
+    def subscribe(self, device_name, command_name, policy=STREAM_DROP_OLDEST, queue_length=16):
+        '''Subscribe to the frames published by a driver operation.
+
+        The frames are pushed by the server as soon as the driver
+        publishes them, and received with recv_frame.
+
+        Args:
+            policy: What the server does when queue_length frames are waiting to be sent
+                    (STREAM_DROP_OLDEST, STREAM_DROP_NEWEST or STREAM_BLOCK)
+
+        Returns:
+            True if the server accepted
+        '''
+        device_id, cmd_id, _ = self.get_ids(device_name, command_name)
+        # Frames can arrive before the response
+        self.streams[(device_id, cmd_id)] = deque()
+        kserver_id, subscribe_id, cmd_args = self.get_ids('KServer', 'subscribe')
+        self.send_command(kserver_id, subscribe_id, cmd_args, device_id, cmd_id, policy, queue_length)
+        subscribed = self.recv(fmt='?')
+        if not subscribed:
+            del self.streams[(device_id, cmd_id)]
+        return subscribed
+
+    def unsubscribe(self, device_name, command_name):
+        '''Stop a subscription.
+
+        Returns:
+            The numbers of frames sent and dropped by the server
+        '''
+        device_id, cmd_id, _ = self.get_ids(device_name, command_name)
+        kserver_id, unsubscribe_id, cmd_args = self.get_ids('KServer', 'unsubscribe')
+        self.send_command(kserver_id, unsubscribe_id, cmd_args, device_id, cmd_id)
+        sent, dropped = self.recv(fmt='QQ')
+        self.streams.pop((device_id, cmd_id), None)
+        return sent, dropped
+
+    def queue_frame(self, device_id, cmd_id):
+        '''Receive the payload of a stream frame and queue it.'''
+        size = struct.unpack('>I', self.recv_socket(4))[0]
+        payload = self.recv_socket(size)
+        if (device_id, cmd_id) in self.streams:
+            self.streams[(device_id, cmd_id)].append(payload)
+
+    def recv_frame(self, device_name, command_name):
+        '''Receive the next frame of a subscribed stream.
+
+        The frame is decoded like the response of the operation.
+        '''
+        device_id, cmd_id, _ = self.get_ids(device_name, command_name)
+        queue = self.streams[(device_id, cmd_id)]
+        while not queue:
+            reserved, class_id, func_id = struct.unpack('>IHH', self.recv_socket(struct.calcsize('>IHH')))
+            if reserved != STREAM_FRAME:
+                raise ValueError('recv_frame: Unexpected response')
+            self.queue_frame(class_id, func_id)
+        return self.decode_frame(device_id, cmd_id, command_name, queue.popleft())
+
+    def decode_frame(self, device_id, cmd_id, command_name, payload):
+        '''Decode the payload of a frame like the response of the operation.'''
+        self.pending = struct.pack('>IHH', 0, device_id, cmd_id) + payload
+        return self.recv_ret_type(self.cmds_ret_types_list[device_id][command_name])
+
+    # -------------------------------------------------------
+    # Pipelining
+    # -------------------------------------------------------
+
+    def pipeline(self, calls, max_in_flight=16):
+        '''Send several commands at once and receive their responses.
+
+        The commands are executed in order by the server, which sends the
+        responses together: the calls cost a single round trip.
+
+        At most max_in_flight commands wait for their response: a command is
+        sent when a response is received. Otherwise, with all the commands
+        sent before reading, the server would block sending the responses
+        of a large pipeline while the client blocks sending the commands.
+
+        Args:
+            calls: A list of (device_name, command_name, arg1, arg2, ...) tuples
+            max_in_flight: Maximum number of commands sent and not yet answered
+
+        Returns:
+            The list of the responses (None for the commands returning void)
+        '''
+        commands = []
+        ret_types = []
+        for call in calls:
+            buff = bytearray()
+            ret_types += self.append_commands(buff, [call])
+            commands.append(buff)
+
+        def send(begin, end):
+            try:
+                self.sock.sendall(b''.join(commands[begin:end]))
+            except:
+                raise ConnectionError('pipeline: Socket connection broken')
+
+        n_sent = min(max(1, max_in_flight), len(commands))
+        send(0, n_sent)
+        responses = []
+        for ret_type in ret_types:
+            responses.append(self.recv_ret_type(ret_type))
+            if n_sent < len(commands):
+                send(n_sent, n_sent + 1)
+                n_sent += 1
+        return responses
+
+    def batch(self, calls):
+        '''Execute several commands with a single request.
+
+        The server executes the commands in order and sends back
+        all the responses in a single frame.
+
+        Args:
+            calls: A list of (device_name, command_name, arg1, arg2, ...) tuples
+
+        Returns:
+            The list of the responses (None for the commands returning void)
+
+        Raises:
+            RuntimeError: If a command failed (the other responses are received)
+        '''
+        device_id, cmd_id, cmd_args = self.get_ids('KServer', 'batch')
+        buff = make_command(device_id, cmd_id, cmd_args, len(calls))
+        ret_types = self.append_commands(buff, calls)
+        try:
+            self.sock.sendall(buff)
+        except:
+            raise ConnectionError('batch: Socket connection broken')
+        # The payload is the sequence of the commands entries:
+        # status, length of the response, response
+        payload = self.recv_dynamic_payload()
+        entry_header = struct.calcsize('>iI')
+        responses = []
+        failed = []
+        for call, ret_type in zip(calls, ret_types):
+            if len(payload) < entry_header:
+                raise ValueError('batch: Received {} responses for {} commands'.format(len(responses), len(calls)))
+            status, length = struct.unpack('>iI', payload[:entry_header])
+            response, payload = payload[entry_header:entry_header + length], payload[entry_header + length:]
+            if len(response) != length:
+                raise ValueError('batch: Truncated response to {}.{}'.format(call[0], call[1]))
+            if status < 0:
+                failed.append('{}.{}'.format(call[0], call[1]))
+                responses.append(None)
+                continue
+            # The response is decoded without reading the socket
+            sock, self.sock, self.pending = self.sock, None, response
+            try:
+                responses.append(self.recv_ret_type(ret_type))
+            except ConnectionError:
+                self.pending = b'-'
+            finally:
+                self.sock = sock
+            if self.pending:
+                self.pending = b''
+                raise ValueError('batch: Invalid response length for {}.{}'.format(call[0], call[1]))
+        if payload:
+            raise ValueError('batch: More responses than commands')
+        if failed:
+            raise RuntimeError('batch: Failed to execute ' + ', '.join(failed))
+        return responses
+
+    def append_commands(self, buff, calls):
+        '''Append the commands to buff and return their return types.'''
+        ret_types = []
+        for call in calls:
+            device_id, cmd_id, cmd_args = self.get_ids(call[0], call[1])
+            buff += make_command(device_id, cmd_id, cmd_args, *call[2:])
+            ret_types.append(self.cmds_ret_types_list[device_id][call[1]])
+        return ret_types
+
     def __del__(self):
+        if getattr(self, 'shm', None) is not None:
+            self.shm.close()
         if hasattr(self, 'sock'):
             self.sock.close()
+
+
+class UdpStream:
+    '''Receive the frames of an operation stream over UDP.
+
+    The datagrams lost on the network (or dropped by the server on congestion)
+    are counted from the gaps of the sequence numbers. The frames missing
+    a fragment are dropped.
+
+    Args:
+        client: A KoheronClient connected to the server (used for the operations ids and types)
+        port: UDP port of the server
+    '''
+    def __init__(self, client, device_name, command_name, port=UDP_PORT, timeout=1.0):
+        self.client = client
+        self.command_name = command_name
+        self.device_id, self.cmd_id, _ = client.get_ids(device_name, command_name)
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4194304)
+        self.sock.connect((client.host or '127.0.0.1', port))
+        self.sock.settimeout(timeout)
+        self.next_sequence = None
+        self.datagrams_received = 0
+        self.datagrams_lost = 0
+        self.frames_received = 0
+        self.frames_dropped = 0
+        self.fragments = {}
+        self.frame = None
+        self.cookie = 0
+        if not self.control(UDP_SUBSCRIBE):
+            raise ConnectionError('UdpStream: subscription refused')
+
+    def send_control(self, command):
+        self.sock.send(struct.pack(UDP_CONTROL_FMT, command, self.device_id, self.cmd_id, self.cookie, 0))
+        self.last_renewal = time.time()
+
+    def control_status(self, data, command):
+        '''Status of a control answer to command (None for other datagrams). Keeps its cookie.'''
+        if len(data) != UDP_CONTROL_SIZE:
+            return None
+        command_, class_id, func_id, cookie, status = struct.unpack(UDP_CONTROL_FMT, data)
+        if (command_, class_id, func_id) != (command, self.device_id, self.cmd_id):
+            return None
+        self.cookie = cookie
+        return status
+
+    def control(self, command):
+        '''Send a control datagram and wait for the server status.'''
+        attempts = 0
+        while attempts < 3:
+            self.send_control(command)
+            try:
+                while True:
+                    # Data datagrams can arrive before the status
+                    status = self.control_status(self.sock.recv(65536), command)
+                    if status == UDP_COOKIE:
+                        break # Send again with the cookie
+                    if status is not None:
+                        return status == UDP_OK
+            except socket.timeout:
+                attempts += 1
+        return False
+
+    def renew(self):
+        '''Renew the subscription (without waiting for the status).'''
+        self.send_control(UDP_SUBSCRIBE)
+
+    def recv_frame(self):
+        '''Receive the next complete frame.
+
+        Returns:
+            (timestamp, data): the publication time of the frame (ns since the epoch)
+            and the frame decoded like the response of the operation
+        '''
+        while True:
+            if time.time() - self.last_renewal > UDP_RENEWAL_PERIOD:
+                self.renew()
+            data = self.sock.recv(65536)
+            # The cookie changed (or the server restarted): renew with the new one
+            if self.control_status(data, UDP_SUBSCRIBE) == UDP_COOKIE:
+                self.renew()
+            if len(data) < UDP_HEADER_SIZE:
+                continue
+            (reserved, class_id, func_id, sequence, frame,
+             fragment, n_fragments, timestamp) = struct.unpack_from(UDP_HEADER_FMT, data)
+            if reserved != UDP_DATAGRAM or (class_id, func_id) != (self.device_id, self.cmd_id):
+                continue
+            self.account(sequence)
+            if frame != self.frame:
+                if self.fragments:
+                    self.frames_dropped += 1
+                self.frame = frame
+                self.fragments = {}
+            self.fragments[fragment] = data[UDP_HEADER_SIZE:]
+            if len(self.fragments) == n_fragments:
+                payload = b''.join(self.fragments[i] for i in range(n_fragments))
+                self.fragments = {}
+                self.frames_received += 1
+                return timestamp, self.client.decode_frame(self.device_id, self.cmd_id, self.command_name, payload)
+
+    def account(self, sequence):
+        '''Count the datagrams missing before this sequence number.'''
+        self.datagrams_received += 1
+        if self.next_sequence is not None:
+            gap = (sequence - self.next_sequence) & 0xFFFFFFFF
+            if gap >= 0x80000000:
+                return # Late (reordered) datagram
+            self.datagrams_lost += gap
+        self.next_sequence = (sequence + 1) & 0xFFFFFFFF
+
+    def close(self):
+        self.control(UDP_UNSUBSCRIBE)
+        self.sock.close()
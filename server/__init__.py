@@ -36,13 +36,31 @@ def get_drivers(drivers_list):
     drivers = [] # List of generated drivers
     obj_files = []  # Object file names
     driver_id = 2
+    op_offset = 0 # Index of the first operation of the driver in the dispatch table
     for path in drivers_list or []:
         assert(path.endswith('.hpp') or path.endswith('.h'))
         driver = get_driver(path, driver_id)
+        driver.op_offset = op_offset
         driver_id +=1
+        op_offset += len(driver.operations)
         drivers.append(driver)
+
+    # Ids of the drivers each driver gets from the context
+    ids = {driver.name: driver.id for driver in drivers}
+    for driver in drivers:
+        driver.dependencies = sorted(set(ids[name] for name in get_dependencies(driver.path)
+                                         if name in ids and ids[name] != driver.id))
     return drivers
 
+def get_dependencies(path):
+    ''' Names of the drivers obtained with ctx.get<Driver>() in the driver sources '''
+    names = []
+    for source in [path, os.path.splitext(path)[0] + '.cpp']:
+        if os.path.exists(source):
+            with open(source) as f:
+                names += re.findall(r'ctx\.get<\s*(\w+)\s*>', f.read())
+    return names
+
 class Driver:
     def __init__(self, path, base_dir='.'):
         dev = parse_header(os.path.join(base_dir, path))[0]
@@ -57,6 +75,8 @@ class Driver:
         self.includes = dev['includes']
         self.interface_name = 'interface_' + os.path.basename(self.includes[0]).split('.')[0]
         self.id = None
+        self.op_offset = 0
+        self.dependencies = []
         self.calls = None
 
 def get_json(drivers):
@@ -65,7 +85,18 @@ def get_json(drivers):
         'id': 1,
         'functions': [
             {'name': 'get_version', 'id': 0, 'args': [], 'ret_type': 'const char *'},
-            {'name': 'get_cmds', 'id': 1, 'args': [], 'ret_type': 'std::string'}
+            {'name': 'get_cmds', 'id': 1, 'args': [], 'ret_type': 'std::string'},
+            {'name': 'batch', 'id': 2, 'args': [{'name': 'n_commands', 'type': 'uint32_t'}], 'ret_type': 'std::vector<uint8_t>'},
+            {'name': 'get_memory_report', 'id': 3, 'args': [], 'ret_type': 'std::string'},
+            {'name': 'set_compression', 'id': 4, 'args': [{'name': 'flags', 'type': 'uint32_t'}], 'ret_type': 'uint32_t'},
+            {'name': 'subscribe', 'id': 5, 'args': [{'name': 'driver', 'type': 'uint16_t'}, {'name': 'operation', 'type': 'uint16_t'},
+                                                    {'name': 'policy', 'type': 'uint32_t'}, {'name': 'queue_length', 'type': 'uint32_t'}], 'ret_type': 'bool'},
+            {'name': 'unsubscribe', 'id': 6, 'args': [{'name': 'driver', 'type': 'uint16_t'}, {'name': 'operation', 'type': 'uint16_t'}],
+             'ret_type': 'std::tuple<uint64_t, uint64_t>'},
+            {'name': 'open_shared_memory', 'id': 7, 'args': [], 'ret_type': 'uint32_t'},
+            {'name': 'get_startup_report', 'id': 8, 'args': [], 'ret_type': 'std::string'},
+            {'name': 'get_stats', 'id': 9, 'args': [], 'ret_type': 'std::string'},
+            {'name': 'get_trace', 'id': 10, 'args': [{'name': 'seconds', 'type': 'uint32_t'}], 'ret_type': 'std::string'}
         ]
     }]
 
@@ -124,6 +155,8 @@ def parse_header(hppfile):
         drivers.append(parse_driver_header(cpp_header.classes[classname], hppfile))
     return drivers
 
+HANDOVER_HOOKS = ['handover_save', 'handover_restore']
+
 def parse_driver_header(_class, hppfile):
     driver = {}
     driver['name'] = _class['name']
@@ -137,8 +170,8 @@ def parse_driver_header(_class, hppfile):
     driver['operations'] = []
     op_id = 0
     for method in _class['methods']['public']:
-        # We eliminate constructor, destructor and templates
-        if (not (method['name'] in [s + _class['name'] for s in ['','~']])) and not method['template']:
+        # We eliminate constructor, destructor, templates and handover hooks (see drivers_manager.hpp)
+        if (not (method['name'] in [s + _class['name'] for s in ['','~']] + HANDOVER_HOOKS)) and not method['template']:
             driver['operations'].append(parse_header_operation(driver['name'], method))
             driver['operations'][-1]['id'] = op_id
             op_id += 1
@@ -150,6 +183,10 @@ def parse_header_operation(driver_name, method):
     operation['name'] = method['name']
     operation['ret_type'] = method['rtnType']
 
+    # Operations annotated '/// @read_only' run concurrently under a shared lock.
+    # They must not modify the driver state (members, hardware configuration...).
+    operation['read_only'] = '@read_only' in method.get('doxygen', '')
+
     check_type(operation['ret_type'], driver_name, operation['name'])
 
     if len(method['parameters']) > 0:
@@ -215,10 +252,17 @@ def cmd_calls(driver, driver_id):
         calls[op['tag']] = generate_call(driver, driver_id, op)
     return calls
 
+def args_name(operation):
+    ''' The arguments of the read-only operations are parsed in a local
+        variable, since several sessions can execute the operation at once '''
+    if operation.get('read_only'):
+        return 'args'
+    return 'args_' + operation['name']
+
 def generate_call(driver, driver_id, operation):
     def build_func_call(driver, operation):
         call = driver['objects'][0]['name'] + '.' + operation['name'] + '('
-        call += ', '.join('args_' + operation['name'] + '.' + arg['name'] for arg in operation.get('arguments', []))
+        call += ', '.join(args_name(operation) + '.' + arg['name'] for arg in operation.get('arguments', []))
         return call + ')'
 
     lines = []
@@ -226,7 +270,7 @@ def generate_call(driver, driver_id, operation):
         lines.append('    {};\n'.format(build_func_call(driver, operation)))
         lines.append('    return 0;\n')
     else:
-        lines.append('    return cmd.session->send<{}, {}>({});\n'.format(driver_id, operation['id'], build_func_call(driver, operation)))
+        lines.append('    return session.template send<{}, {}>({});\n'.format(driver_id, operation['id'], build_func_call(driver, operation)))
     return ''.join(lines)
 
 # -----------------------------------------------------------
@@ -241,13 +285,16 @@ def parser_generator(driver, operation):
     lines = []
     packs, has_vector = build_args_packs(lines, operation)
 
+    if operation.get('read_only'):
+        lines.append('Argument_' + operation['name'] + ' args;\n')
+
     if not has_vector:
         print_required_buff_size(lines, packs)
-        lines.append('    static_assert(req_buff_size <= cmd.payload.size(), "Buffer size too small");\n\n');
+        lines.append('    static_assert(req_buff_size <= CMD_PAYLOAD_BUFFER_LEN, "Buffer size too small");\n\n');
 
     for idx, pack in enumerate(packs):
         if pack['family'] == 'scalar':
-            lines.append('\n    auto args_tuple' + str(idx)  + ' = cmd.session->deserialize<')
+            lines.append('\n    auto args_tuple' + str(idx)  + ' = session.template deserialize<')
             print_type_list_pack(lines, pack)
             lines.append('>(cmd);\n')
             lines.append('    if (std::get<0>(args_tuple' + str(idx)  + ') < 0) {\n')
@@ -255,10 +302,10 @@ def parser_generator(driver, operation):
             lines.append('    }\n')
 
             for i, arg in enumerate(pack['args']):
-                lines.append('    args_' + operation['name'] + '.' + arg["name"] + ' = ' + 'std::get<' + str(i + 1) + '>(args_tuple' + str(idx) + ');\n');
+                lines.append('    ' + args_name(operation) + '.' + arg["name"] + ' = ' + 'std::get<' + str(i + 1) + '>(args_tuple' + str(idx) + ');\n');
 
         elif pack['family'] in ['vector', 'string', 'array']:
-            lines.append('    if (cmd.session->recv(args_' + operation['name'] + '.' + pack['args']['name'] + ', cmd) < 0) {\n')
+            lines.append('    if (session.recv(' + args_name(operation) + '.' + pack['args']['name'] + ', cmd) < 0) {\n')
             lines.append('        return -1;\n')
             lines.append('    }\n\n')
         else:
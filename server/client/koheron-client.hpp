@@ -4,10 +4,12 @@
 #define __KOHERON_CLIENT_HPP__
 
 #include <vector>
+#include <deque>
 #include <array>
 #include <tuple>
 #include <type_traits>
 #include <string>
+#include <algorithm>
 
 #include <cstdint>
 #include <cstdlib>
@@ -645,6 +647,96 @@ class DynamicSerializer {
     uint64_t scal_size = 0;
 };
 
+// ------------------------
+// Compression
+// ------------------------
+
+// Decompress a LZ4 block into dst of dst_size bytes.
+// Returns false if the block is invalid.
+inline bool lz4_decompress(const unsigned char *src, size_t src_size,
+                           unsigned char *dst, size_t dst_size)
+{
+    const unsigned char *ip = src;
+    const unsigned char *const ip_end = src + src_size;
+    unsigned char *op = dst;
+    unsigned char *const op_end = dst + dst_size;
+
+    auto read_length = [&](size_t length) -> size_t {
+        if (length == 15) {
+            unsigned char b;
+
+            do {
+                if (ip >= ip_end) {
+                    return SIZE_MAX;
+                }
+
+                b = *ip++;
+                length += b;
+            } while (b == 255);
+        }
+
+        return length;
+    };
+
+    while (ip < ip_end) {
+        const unsigned char token = *ip++;
+        const size_t literals_len = read_length(token >> 4);
+
+        if (literals_len > static_cast<size_t>(ip_end - ip) ||
+            literals_len > static_cast<size_t>(op_end - op)) {
+            return false;
+        }
+
+        std::memcpy(op, ip, literals_len);
+        ip += literals_len;
+        op += literals_len;
+
+        if (ip == ip_end) {
+            break;  // Last literals
+        }
+
+        if (ip_end - ip < 2) {
+            return false;
+        }
+
+        const size_t offset = ip[0] | (size_t(ip[1]) << 8);
+        ip += 2;
+        const size_t match_len = read_length(token & 0x0F);
+
+        if (match_len == SIZE_MAX || offset == 0 ||
+            offset > static_cast<size_t>(op - dst) ||
+            match_len + 4 > static_cast<size_t>(op_end - op)) {
+            return false;
+        }
+
+        // Byte by byte: the match can overlap its output
+        const unsigned char *match = op - offset;
+
+        for (size_t i = 0; i < match_len + 4; i++) {
+            *op++ = *match++;
+        }
+    }
+
+    return op == op_end;
+}
+
+// Inverse of the server shuffle filter
+inline void unshuffle(const unsigned char *src, size_t len, size_t element_size, unsigned char *dst)
+{
+    const size_t n_elements = len / element_size;
+
+    for (size_t j = 0; j < element_size; j++) {
+        const unsigned char *in = src + j * n_elements;
+
+        for (size_t i = 0; i < n_elements; i++) {
+            dst[i * element_size + j] = in[i];
+        }
+    }
+
+    const size_t n_shuffled = n_elements * element_size;
+    std::memcpy(dst + n_shuffled, src + n_shuffled, len - n_shuffled);
+}
+
 } // namespace serdes
 
 struct socket_error : std::system_error {
@@ -778,17 +870,49 @@ class KoheronClient
     void call(Args&&... args) {
         static_assert(std::is_same<arg_types_t<id>, std::tuple<std::decay_t<Args>...>>::value,
                       "Invalid argument type for call");
-        call<(id >> 16), id & 0xFFFF>(std::forward<Args>(args)...);
+        send_command<(id >> 16), id & 0xFFFF, !std::is_void<ret_type_t<id>>::value>(std::forward<Args>(args)...);
     }
 
     template<uint16_t class_id, uint16_t func_id, typename... Args>
     void call(Args&&... args) {
-        static_assert(class_id > 0, "class_id 0 is reserved");
+        send_command<class_id, func_id, true>(std::forward<Args>(args)...);
+    }
 
-        last_class_id = class_id;
-        last_func_id = func_id;
-        dynamic_serializer.build_command<class_id, func_id>(send_buffer, std::forward<Args>(args)...);
-        send();
+    // Pipelining
+    //
+    // The commands called between begin_pipeline() and flush() are sent at once.
+    // The server executes them in order and sends back all the responses together,
+    // which are then received in the same order with recv().
+    // Calling recv() flushes the pending commands.
+
+    void begin_pipeline() {
+        pipelining = true;
+    }
+
+    void flush() {
+        pipelining = false;
+
+        if (!pipeline_buffer.empty()) {
+            send(pipeline_buffer);
+            pipeline_buffer.clear();
+        }
+    }
+
+    // Compression
+    //
+    // The server compresses the large responses once enabled.
+    // They are decompressed on reception.
+
+    static constexpr uint32_t COMPRESSION_LZ4 = 1;
+    static constexpr uint32_t COMPRESSION_SHUFFLE = 2;
+
+    /// Returns true if the server accepted
+    bool enable_compression(bool shuffle = true) {
+        const uint32_t flags = COMPRESSION_LZ4 | (shuffle ? COMPRESSION_SHUFFLE : 0);
+        send_command<1, 4, true>(flags);
+        flush();
+        compression = command_deserializer<uint32_t>();
+        return compression != 0;
     }
 
     // API that allocates dynamic containers and gives back ownership to caller
@@ -803,6 +927,7 @@ class KoheronClient
                       (sizeof...(Tp) > 1 && std::is_same<ret_type_t<id>, Tup>::value),
                       "Invalid receive type");
 
+        flush();
         return command_deserializer<Tp...>();
     }
 
@@ -814,6 +939,7 @@ class KoheronClient
                       || (serdes::is_c_string_v<ret_type_t<id>>
                           && std::is_same<std::string, std::decay_t<Container>>::value),
                       "Invalid container for receive");
+        flush();
         command_deserializer(cont);
     }
 
@@ -824,37 +950,131 @@ class KoheronClient
     const char *host;
     int port;
 
-    uint16_t last_class_id = 0;
-    uint16_t last_func_id = 0;
+    // (class_id, func_id) of the commands waiting for a response
+    std::deque<std::pair<uint16_t, uint16_t>> expected_responses;
 
     std::vector<unsigned char> rcv_buffer;
     std::vector<unsigned char> send_buffer;
 
+    bool pipelining = false;
+    std::vector<unsigned char> pipeline_buffer;
+
+    uint32_t compression = 0;
+    std::vector<unsigned char> response;   // Decompressed response being read
+    size_t response_pos = 0;
+    std::vector<unsigned char> compressed;
+
     serdes::DynamicSerializer<1024> dynamic_serializer;
 
   private:
     static constexpr auto header_size = serdes::required_buffer_size<uint32_t, uint16_t, uint16_t>();
 
-    void send() {
-        int err = ::send(sockfd, reinterpret_cast<const char*>(send_buffer.data()), send_buffer.size(), 0);
-#ifdef _WIN32
-        if (err == SOCKET_ERROR) {
-            throw socket_error("Cannot send command to koheron-server\n");
+    template<uint16_t class_id, uint16_t func_id, bool has_response, typename... Args>
+    void send_command(Args&&... args) {
+        static_assert(class_id > 0, "class_id 0 is reserved");
+
+        // Without pipelining a single response can be pending
+        if (!pipelining) {
+            expected_responses.clear();
         }
-#else
-        if (err < 0) {
-            throw socket_error("Cannot send command to koheron-server\n");
+
+        if (has_response) {
+            expected_responses.emplace_back(class_id, func_id);
+        }
+
+        dynamic_serializer.build_command<class_id, func_id>(send_buffer, std::forward<Args>(args)...);
+
+        if (pipelining) {
+            pipeline_buffer.insert(pipeline_buffer.end(), send_buffer.begin(), send_buffer.end());
+        } else {
+            send(send_buffer);
         }
+    }
+
+    void send(const std::vector<unsigned char>& buffer) {
+        size_t bytes_send = 0;
+
+        while (bytes_send < buffer.size()) {
+            int err = ::send(sockfd, reinterpret_cast<const char*>(buffer.data() + bytes_send),
+                             buffer.size() - bytes_send, 0);
+#ifdef _WIN32
+            if (err == SOCKET_ERROR) {
+                throw socket_error("Cannot send command to koheron-server\n");
+            }
+#else
+            if (err < 0) {
+                throw socket_error("Cannot send command to koheron-server\n");
+            }
 #endif
+            bytes_send += err;
+        }
     }
 
     void recv_all(int n_bytes) {
         rcv_buffer.resize(n_bytes);
+        int bytes_read = 0;
+
+        // Bytes left in the decompressed response
+        if (response_pos < response.size()) {
+            bytes_read = std::min(n_bytes, static_cast<int>(response.size() - response_pos));
+            std::memcpy(rcv_buffer.data(), response.data() + response_pos, bytes_read);
+            response_pos += bytes_read;
+        }
+
+        recv_socket(rcv_buffer.data() + bytes_read, n_bytes - bytes_read);
+    }
+
+    // Receive the first n_bytes of a response.
+    // A compressed response is received and decompressed at once.
+    void recv_response(int n_bytes) {
+        static constexpr uint32_t COMPRESSED_RESPONSE = 1;
+
+        if (compression != 0 && response_pos == response.size()) {
+            std::array<unsigned char, header_size + 12> header;
+            recv_socket(header.data(), header_size);
+
+            if (std::get<0>(serdes::deserialize<0, uint32_t>(header.data())) == COMPRESSED_RESPONSE) {
+                recv_socket(header.data() + header_size, 12);
+                const auto sizes = serdes::deserialize<0, uint32_t, uint32_t, uint32_t>(header.data() + header_size);
+                const size_t size = std::get<0>(sizes);
+                const size_t element_size = std::get<2>(sizes);
+
+                compressed.resize(std::get<1>(sizes));
+                recv_socket(compressed.data(), static_cast<int>(compressed.size()));
+
+                // Header of the original response
+                response.resize(header_size + size);
+                std::memset(response.data(), 0, 4);
+                std::memcpy(response.data() + 4, header.data() + 4, header_size - 4);
+                unsigned char *payload = response.data() + header_size;
+
+                if (element_size > 1) {
+                    std::vector<unsigned char> shuffled(size);
+
+                    if (!serdes::lz4_decompress(compressed.data(), compressed.size(), shuffled.data(), size)) {
+                        throw socket_error("Invalid compressed response\n");
+                    }
+
+                    serdes::unshuffle(shuffled.data(), size, element_size, payload);
+                } else if (!serdes::lz4_decompress(compressed.data(), compressed.size(), payload, size)) {
+                    throw socket_error("Invalid compressed response\n");
+                }
+            } else {
+                response.assign(header.begin(), header.begin() + header_size);
+            }
+
+            response_pos = 0;
+        }
+
+        recv_all(n_bytes);
+    }
+
+    void recv_socket(unsigned char *buffer, int n_bytes) {
         int bytes_rcv = 0;
         int bytes_read = 0;
 
         while (bytes_read < n_bytes) {
-            bytes_rcv = ::recv(sockfd, reinterpret_cast<char*>(rcv_buffer.data() + bytes_read), n_bytes - bytes_read, 0);
+            bytes_rcv = ::recv(sockfd, reinterpret_cast<char*>(buffer + bytes_read), n_bytes - bytes_read, 0);
 
             if (bytes_rcv == 0)
                 // Technically not really an error.
@@ -878,16 +1098,21 @@ class KoheronClient
 
     void check_returned_header() {
         const auto t = serdes::deserialize<0, uint32_t, uint16_t, uint16_t>(rcv_buffer.data());
+        assert(!expected_responses.empty());
         assert(std::get<0>(t) == 0); // RESERVED
-        assert(std::get<1>(t) == last_class_id);
-        assert(std::get<2>(t) == last_func_id);
+        assert(std::get<1>(t) == expected_responses.front().first);
+        assert(std::get<2>(t) == expected_responses.front().second);
         _unused(t);
+
+        if (!expected_responses.empty()) {
+            expected_responses.pop_front();
+        }
     }
 
     template<typename Tp>
     std::enable_if_t<std::is_scalar<Tp>::value, Tp>
     command_deserializer() {
-        recv_all(serdes::required_buffer_size<uint32_t, uint16_t, uint16_t, Tp>());
+        recv_response(serdes::required_buffer_size<uint32_t, uint16_t, uint16_t, Tp>());
         check_returned_header();
         return std::get<0>(serdes::deserialize<0, Tp>(rcv_buffer.data() + header_size));
     }
@@ -900,7 +1125,7 @@ class KoheronClient
         using T = typename Tp::value_type;
         constexpr auto N = std::tuple_size<Tp>::value;
 
-        recv_all(header_size + serdes::size_of<T, N>);
+        recv_response(header_size + serdes::size_of<T, N>);
         check_returned_header();
         const auto p = reinterpret_cast<const Tp*>(rcv_buffer.data() + header_size);
         assert(p->data() == (const T*)(rcv_buffer.data() + header_size));
@@ -931,13 +1156,13 @@ class KoheronClient
     template<typename... Tp>
     std::enable_if_t< 1 < sizeof...(Tp), std::tuple<Tp...>>
     command_deserializer() {
-        recv_all(serdes::required_buffer_size<uint32_t, uint16_t, uint16_t, Tp...>());
+        recv_response(serdes::required_buffer_size<uint32_t, uint16_t, uint16_t, Tp...>());
         check_returned_header();
         return serdes::deserialize<0, Tp...>(rcv_buffer.data() + header_size);
     }
 
     void get_payload_dynamic() {
-        recv_all(serdes::required_buffer_size<uint32_t, uint16_t, uint16_t, uint32_t>());
+        recv_response(serdes::required_buffer_size<uint32_t, uint16_t, uint16_t, uint32_t>());
         check_returned_header();
         recv_all(std::get<0>(serdes::deserialize<0, uint32_t>(rcv_buffer.data() + header_size)));
     }
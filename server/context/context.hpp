@@ -22,18 +22,11 @@ class Context : public ContextBase
     , i2c(*this)
     , fclk(*this)
     , fpga(*this)
-    {
-        if (fpga.load_bitstream(instrument_name) < 0) {
-            log<PANIC>("Failed to load bitstream. Exiting server...\n");
-            exit(EXIT_FAILURE);
-        }
-
-        // We set all the Zynq clocks before starting the drivers
-        zynq_clocks::set_clocks(fclk);
-    }
+    {}
 
     int init() {
-        if (mm.open() < 0  ||
+        if (configure_fpga() < 0 ||
+            mm.open() < 0  ||
             spi.init() < 0 ||
             i2c.init() < 0)
             return -1;
@@ -46,6 +39,33 @@ class Context : public ContextBase
     I2cManager i2c;
     ZynqFclk fclk;
     FpgaManager fpga;
+
+  private:
+    // Called by init(), once the context can log
+    int configure_fpga() {
+        if constexpr (koheron::config::simulated) {
+            log<INFO>("Simulated memory maps, the FPGA is not configured\n");
+            return 0;
+        }
+
+        // Skipped if the same bitstream and clocks are already loaded
+        const auto fpga_state = fpga.get_state(instrument_name, zynq_clocks::settings);
+
+        if (fpga.is_state_loaded(fpga_state)) {
+            log<INFO>("Bitstream and clocks already configured\n");
+            return 0;
+        }
+
+        if (fpga.load_bitstream(instrument_name) < 0) {
+            log<PANIC>("Failed to load bitstream. Exiting server...\n");
+            return -1;
+        }
+
+        // We set all the Zynq clocks before starting the drivers
+        zynq_clocks::set_clocks(fclk);
+        fpga.save_state(fpga_state);
+        return 0;
+    }
 };
 
 #endif // __CONTEXT_HPP__
@@ -7,6 +7,8 @@
 #include <unistd.h>
 
 #include <array>
+#include <cstdio>
+#include <cstring>
 #include <string>
 #include <vector>
 
@@ -18,24 +20,112 @@ class FpgaManager {
     : ctx(ctx_)
     {}
 
+    // Hash of the bitstream content and of the clocks settings
+    // (0 if the bitstream cannot be read)
+    uint64_t get_state(const char* name, const char* clocks_settings) {
+        FILE *fbitstream = open_bitstream(name);
+
+        if (fbitstream == nullptr) {
+            return 0;
+        }
+
+        std::vector<char> buffer(bitstream_chunk_size);
+        uint64_t hash = fnv1a(fnv_offset_basis, clocks_settings, strlen(clocks_settings));
+        size_t n;
+
+        while ((n = fread(buffer.data(), 1, buffer.size(), fbitstream)) > 0) {
+            hash = fnv1a(hash, buffer.data(), n);
+        }
+
+        fclose(fbitstream);
+        return hash == 0 ? 1 : hash;
+    }
+
+    // True if the configuration recorded in the state file is
+    // the given one and the FPGA is still programmed
+    bool is_state_loaded(uint64_t state) {
+        if (! koheron::config::skip_unchanged_fpga_config || state == 0) {
+            return false;
+        }
+
+        FILE *fstate = fopen(koheron::config::fpga_state_file, "r");
+
+        if (fstate == nullptr) {
+            return false;
+        }
+
+        unsigned long long loaded_state = 0;
+        const bool match = fscanf(fstate, "%llx", &loaded_state) == 1 && loaded_state == state;
+        fclose(fstate);
+        return match && read_prog_done() == 1;
+    }
+
+    // Record the configuration loaded
+    void save_state(uint64_t state) {
+        if (! koheron::config::skip_unchanged_fpga_config || state == 0) {
+            return;
+        }
+
+        // Written then renamed: the state file is never partially written
+        const auto tmp_filename = std::string(koheron::config::fpga_state_file) + ".tmp";
+        FILE *fstate = fopen(tmp_filename.c_str(), "w");
+
+        if (fstate == nullptr) {
+            ctx.log<WARNING>("FpgaManager: Cannot write state file %s\n", tmp_filename.c_str());
+            return;
+        }
+
+        const bool ok = fprintf(fstate, "%016llx\n", static_cast<unsigned long long>(state)) > 0;
+
+        if (fclose(fstate) != 0 || ! ok || rename(tmp_filename.c_str(), koheron::config::fpga_state_file) < 0) {
+            ctx.log<WARNING>("FpgaManager: Cannot write state file %s\n", koheron::config::fpga_state_file);
+            remove(tmp_filename.c_str());
+        }
+    }
+
     int load_bitstream(const char* name) {
+        // The recorded state is invalid until the new configuration is loaded
+        remove(koheron::config::fpga_state_file);
+
         FILE *xdevcfg = fopen("/dev/xdevcfg", "w");
 
         if (xdevcfg != nullptr) {
-            std::vector<char> bitstream_data{};
-            
-            if (read_bitstream_data(name, bitstream_data) < 0) {
+            ctx.log<INFO>("FpgaManager: Loading bitstream %s%s.bit...\n", live_instrument_dirname.c_str(), name);
+            FILE *fbitstream = open_bitstream(name);
+
+            if (fbitstream == nullptr) {
+                ctx.log<PANIC>("FpgaManager: Cannot open bitstream file\n");
                 fclose(xdevcfg);
                 return -1;
             }
 
-            if (fwrite(bitstream_data.data(), bitstream_data.size(), 1, xdevcfg) != 1) {
-                ctx.log<PANIC>("FpgaManager: Failed to write bitstream to xdevcfg\n");
+            // Streamed through a bounded buffer
+            std::vector<char> buffer(bitstream_chunk_size);
+            size_t n;
+
+            while ((n = fread(buffer.data(), 1, buffer.size(), fbitstream)) > 0) {
+                if (fwrite(buffer.data(), 1, n, xdevcfg) != n) {
+                    ctx.log<PANIC>("FpgaManager: Failed to write bitstream to xdevcfg\n");
+                    fclose(fbitstream);
+                    fclose(xdevcfg);
+                    return -1;
+                }
+            }
+
+            if (ferror(fbitstream)) {
+                ctx.log<PANIC>("FpgaManager: Cannot read bitstream data\n");
+                fclose(fbitstream);
                 fclose(xdevcfg);
                 return -1;
             }
 
-            fclose(xdevcfg);
+            fclose(fbitstream);
+
+            if (fclose(xdevcfg) != 0) {
+                ctx.log<PANIC>("FpgaManager: Failed to write bitstream to xdevcfg\n");
+                return -1;
+            }
+
             return check_bitstream_loaded();
         } else {
             // TODO Ubuntu 18.04 call fpga_manager driver
@@ -48,60 +138,59 @@ class FpgaManager {
   private:
     ContextBase& ctx;
 
+    static constexpr size_t bitstream_chunk_size = 65536;
+
+    // 64 bits FNV-1a hash
+    static constexpr uint64_t fnv_offset_basis = 14695981039346656037ULL;
+    static constexpr uint64_t fnv_prime = 1099511628211ULL;
+
+    static uint64_t fnv1a(uint64_t hash, const char* data, size_t len) {
+        for (size_t i = 0; i < len; i++) {
+            hash = (hash ^ static_cast<unsigned char>(data[i])) * fnv_prime;
+        }
+
+        return hash;
+    }
+
     const std::string live_instrument_dirname = "/tmp/live-instrument/";
     const std::string xdev = "/sys/bus/platform/drivers/xdevcfg/f8007000.devcfg/prog_done";
     // const std::string fman = "/sys/class/fpga_manager/fpga0/firmware";
     // const std::string ffull = "/configfs/device-tree/overlays/full/";
 
-    int read_bitstream_data(const char* name, std::vector<char>& bitstream_data) {
-        // https://stackoverflow.com/questions/22059189/read-a-file-as-byte-array
-
+    FILE* open_bitstream(const char* name) {
         const auto bistream_filename = live_instrument_dirname + name + ".bit";
-        ctx.log<INFO>("FpgaManager: Loading bitstream %s...\n", bistream_filename.c_str());
-        FILE *fbitstream = fopen(bistream_filename.c_str(), "rb");
+        return fopen(bistream_filename.c_str(), "rb");
+    }
 
-        if (fbitstream == nullptr) {
-            ctx.log<PANIC>("FpgaManager: Cannot open bitstream file\n");
+    // Returns 1 if the FPGA is programmed, 0 if not, -1 on failure
+    int read_prog_done() {
+        FILE *fprog_done = fopen(xdev.c_str(), "r");
+
+        if (fprog_done == nullptr) {
             return -1;
         }
 
-        fseek(fbitstream, 0, SEEK_END);
-        bitstream_data.resize(ftell(fbitstream));
-        rewind(fbitstream);
+        std::array<char, 1> buff{};
+        const auto n = read(fileno(fprog_done), buff.data(), 1);
+        fclose(fprog_done);
 
-        if (fread(bitstream_data.data(), bitstream_data.size(), 1, fbitstream) != 1) {
-            ctx.log<PANIC>("FpgaManager: Cannot read bitstream data\n");
-            fclose(fbitstream);
+        if (n != 1) {
             return -1;
         }
-        
-        fclose(fbitstream);
-        return 0;
+
+        return buff[0] == '1' ? 1 : 0;
     }
 
     int check_bitstream_loaded() {
-        FILE *fprog_done = fopen("/sys/bus/platform/drivers/xdevcfg/f8007000.devcfg/prog_done", "r");
-
-        if (fprog_done == nullptr) {
-            ctx.log<PANIC>("FpgaManager: Failed to open prog_done\n");
+        switch (read_prog_done()) {
+          case 1:
+            ctx.log<INFO>("FpgaManager: Bitstream successfully loaded\n");
+            return 0;
+          case 0:
+            ctx.log<PANIC>("FpgaManager: Failed to load bitstream\n");
             return -1;
-        }
-
-        std::array<char, 1> buff{};
-
-        if (read(fileno(fprog_done), buff.data(), 1) == 1) {
-            if (buff[0] == '1') {
-                ctx.log<INFO>("FpgaManager: Bitstream successfully loaded\n");
-                fclose(fprog_done);
-                return 0;
-            } else {
-                ctx.log<PANIC>("FpgaManager: Failed to load bitstream\n");
-                fclose(fprog_done);
-                return -1;
-            }
-        } else {
+          default:
             ctx.log<PANIC>("FpgaManager: Failed to read prog_done\n");
-            fclose(fprog_done);
             return -1;
         }
     }
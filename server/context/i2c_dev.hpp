@@ -166,6 +166,7 @@ class I2cManager
             return *empty_i2cdev;
         }
 
+        std::lock_guard<std::mutex> lock(mutex);
         i2c_drivers[devname]->init();
         return *i2c_drivers[devname];
     }
@@ -174,6 +175,7 @@ class I2cManager
     ContextBase& ctx;
     std::unordered_map<std::string, std::unique_ptr<I2cDev>> i2c_drivers;
     std::unique_ptr<I2cDev> empty_i2cdev;
+    std::mutex mutex; // Drivers are started concurrently
 };
 
 #endif // __DRIVERS_LIB_I2C_DEV_HPP__
@@ -11,10 +11,44 @@
 extern "C" {
     #include <fcntl.h>
     #include <sys/mman.h>
+    #include <sys/syscall.h>
 }
 
+#include <config.hpp>
+
 #include "memory_map.hpp"
 
+// Size of the simulated physical memory: up to the end of the last memory map
+constexpr uint64_t simulated_memory_size() {
+    uint64_t size = 0;
+
+    for (MemID id = 0; id < mem::count; id++) {
+        const uint64_t end = (mem::get_base_addr(id) & ~uint64_t(mem::get_total_size(id) - 1))
+                             + mem::get_total_size(id);
+        size = end > size ? end : size;
+    }
+
+    return size;
+}
+
+// Host build: anonymous shared memory stands for /dev/mem.
+// The file is sparse, only the pages of the memory maps are allocated.
+inline int open_simulated_memory()
+{
+#ifdef SYS_memfd_create
+    const int fd = static_cast<int>(syscall(SYS_memfd_create, "koheron-memory", 0));
+
+    if (fd >= 0 && ftruncate(fd, static_cast<off_t>(simulated_memory_size())) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+#else
+    return -1;
+#endif
+}
+
 // http://stackoverflow.com/questions/39041236/tuple-of-sequence
 template<size_t N, class = std::make_index_sequence<N>> class MemoryManagerImpl;
 
@@ -58,11 +92,20 @@ class MemoryManagerImpl<N, std::index_sequence<ids...>>
 template<size_t N, MemID... ids>
 int MemoryManagerImpl<N, std::index_sequence<ids...>>::open()
 {
-    fd = ::open("/dev/mem", O_RDWR | O_SYNC);
-
-     if (fd == -1) {
-        fprintf(stderr, "Can't open /dev/mem\n");
-        return -1;
+    if constexpr (koheron::config::simulated) {
+        fd = open_simulated_memory();
+
+        if (fd == -1) {
+            fprintf(stderr, "Can't create the simulated memory\n");
+            return -1;
+        }
+    } else {
+        fd = ::open("/dev/mem", O_RDWR | O_SYNC);
+
+        if (fd == -1) {
+            fprintf(stderr, "Can't open /dev/mem\n");
+            return -1;
+        }
     }
 
     open_maps<N>();
@@ -99,7 +99,7 @@ int SpiDev::recv(uint8_t *buffer, size_t n_bytes)
         return -1;
 
     int bytes_rcv = 0;
-    int64_t bytes_read = 0;
+    size_t bytes_read = 0;
 
     while (bytes_read < n_bytes) {
         bytes_rcv = read(fd, buffer + bytes_read, n_bytes - bytes_read);
@@ -181,6 +181,7 @@ SpiDev& SpiManager::get(const std::string& devname,
         return empty_spidev;
     }
 
+    std::lock_guard<std::mutex> lock(mutex);
     spi_drivers[devname]->init(mode, speed, word_length);
     return *spi_drivers[devname];
 }
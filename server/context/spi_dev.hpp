@@ -19,6 +19,7 @@
 #include <unordered_map>
 #include <string>
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <array>
 
@@ -99,6 +100,7 @@ class SpiManager
     ContextBase& ctx;
     std::unordered_map<std::string, std::unique_ptr<SpiDev>> spi_drivers;
     SpiDev empty_spidev;
+    std::mutex mutex; // Drivers are started concurrently
 };
 
 #endif // __DRIVERS_LIB_SPI_DEV_HPP__
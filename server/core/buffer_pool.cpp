@@ -0,0 +1,87 @@
+/// Implementation of buffer_pool.hpp
+///
+/// (c) Koheron
+
+#include "buffer_pool.hpp"
+
+#include <algorithm>
+
+namespace koheron {
+
+BufferPool::~BufferPool()
+{
+    for (auto& free_list : free_lists) {
+        for (auto ptr : free_list) {
+            delete[] ptr;
+        }
+    }
+}
+
+size_t BufferPool::class_of(size_t size)
+{
+    size_t c = 0;
+
+    while (c < number_of_classes && class_size(c) < size) {
+        c++;
+    }
+
+    return c;
+}
+
+PoolBuffer BufferPool::acquire(size_t size)
+{
+    const size_t c = class_of(size);
+    const size_t capacity = c < number_of_classes ? class_size(c) : size;
+
+    PoolBuffer buffer;
+    buffer.pool = this;
+    buffer.capacity = capacity;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.number_of_acquires++;
+        stats.bytes_in_use += capacity;
+        stats.peak_bytes_in_use = std::max(stats.peak_bytes_in_use, stats.bytes_in_use);
+        stats.buffers_in_use[std::min(c, stats.buffers_in_use.size() - 1)]++;
+
+        if (c < number_of_classes && !free_lists[c].empty()) {
+            buffer.ptr = free_lists[c].back();
+            free_lists[c].pop_back();
+            stats.bytes_cached -= capacity;
+            return buffer;
+        }
+
+        stats.number_of_allocations++;
+    }
+
+    buffer.ptr = new char[capacity];
+    return buffer;
+}
+
+void BufferPool::release(char *ptr, size_t capacity)
+{
+    const size_t c = class_of(capacity);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.bytes_in_use -= capacity;
+        stats.buffers_in_use[std::min(c, stats.buffers_in_use.size() - 1)]--;
+
+        if (c < number_of_classes &&
+            stats.bytes_cached + capacity <= config::buffer_pool_max_cached_bytes) {
+            free_lists[c].push_back(ptr);
+            stats.bytes_cached += capacity;
+            return;
+        }
+    }
+
+    delete[] ptr;
+}
+
+BufferPool::Stats BufferPool::get_stats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+} // namespace koheron
@@ -0,0 +1,144 @@
+/// Shared pool of byte buffers
+///
+/// The sessions borrow their receive buffers from a pool shared by
+/// all the sessions, for the actual size of the messages.
+/// Sizes are rounded up to a power of two (the size class).
+/// Released buffers are kept in per-class free lists for reuse,
+/// up to config::buffer_pool_max_cached_bytes. Buffers larger than the
+/// largest class are allocated and freed on demand.
+///
+/// (c) Koheron
+
+#ifndef __KOHERON_BUFFER_POOL_HPP__
+#define __KOHERON_BUFFER_POOL_HPP__
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <vector>
+#include <mutex>
+#include <utility>
+
+#include "config.hpp"
+
+namespace koheron {
+
+class BufferPool;
+
+/// Number of size classes from config::buffer_pool_min_size to config::buffer_pool_max_size
+constexpr size_t buffer_pool_classes()
+{
+    size_t n = 1;
+
+    while ((size_t(config::buffer_pool_min_size) << (n - 1)) < config::buffer_pool_max_size) {
+        n++;
+    }
+
+    return n;
+}
+
+static_assert(buffer_pool_classes() < 32, "Too many buffer size classes");
+
+/// Buffer borrowed from the pool. Returned to the pool on destruction.
+class PoolBuffer
+{
+  public:
+    PoolBuffer() = default;
+    ~PoolBuffer() {release();}
+
+    PoolBuffer(const PoolBuffer&) = delete;
+    PoolBuffer& operator=(const PoolBuffer&) = delete;
+
+    PoolBuffer(PoolBuffer&& other) noexcept {*this = std::move(other);}
+
+    PoolBuffer& operator=(PoolBuffer&& other) noexcept {
+        if (this != &other) {
+            release();
+            pool = other.pool;
+            ptr = other.ptr;
+            capacity = other.capacity;
+            other.pool = nullptr;
+            other.ptr = nullptr;
+            other.capacity = 0;
+        }
+
+        return *this;
+    }
+
+    char* data() {return ptr;}
+    const char* data() const {return ptr;}
+
+    /// Capacity of the buffer (size class)
+    size_t size() const {return capacity;}
+
+    bool empty() const {return ptr == nullptr;}
+
+    /// Give the buffer back to the pool
+    void release();
+
+  private:
+    BufferPool *pool = nullptr;
+    char *ptr = nullptr;
+    size_t capacity = 0;
+
+friend class BufferPool;
+};
+
+class BufferPool
+{
+  public:
+    BufferPool() = default;
+    ~BufferPool();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    /// Borrow a buffer of at least size bytes
+    PoolBuffer acquire(size_t size);
+
+    struct Stats
+    {
+        size_t bytes_in_use = 0;       ///< Bytes borrowed by the sessions
+        size_t peak_bytes_in_use = 0;
+        size_t bytes_cached = 0;       ///< Bytes in the free lists
+        uint64_t number_of_acquires = 0;
+        uint64_t number_of_allocations = 0; ///< Acquires not served from the free lists
+        /// Number of buffers in use per size class.
+        /// The entry after the last class counts the larger buffers.
+        std::array<size_t, 32> buffers_in_use{};
+    };
+
+    Stats get_stats();
+
+    /// Size of the class c
+    static size_t class_size(size_t c) {return size_t(config::buffer_pool_min_size) << c;}
+
+    static constexpr size_t number_of_classes = buffer_pool_classes();
+
+  private:
+    /// Size class of a buffer of size bytes.
+    /// Returns number_of_classes if the buffer is larger than the largest class.
+    static size_t class_of(size_t size);
+
+    void release(char *ptr, size_t capacity);
+
+    std::mutex mutex;
+    std::array<std::vector<char*>, number_of_classes> free_lists;
+    Stats stats;
+
+friend class PoolBuffer;
+};
+
+inline void PoolBuffer::release()
+{
+    if (ptr != nullptr) {
+        pool->release(ptr, capacity);
+        pool = nullptr;
+        ptr = nullptr;
+        capacity = 0;
+    }
+}
+
+} // namespace koheron
+
+#endif // __KOHERON_BUFFER_POOL_HPP__
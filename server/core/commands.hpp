@@ -31,8 +31,6 @@ struct Buffer
     char* data()   {return _data.data();}
     char* begin()  {return &(_data.data())[position];}
 
-    // These functions are used by Websocket
-
     template<typename... Tp>
     std::tuple<Tp...> deserialize() {
         static_assert(required_buffer_size<Tp...>() <= len, "Buffer size too small");
@@ -42,6 +40,39 @@ struct Buffer
         return tup;
     }
 
+  private:
+    std::array<char, len> _data;
+    size_t position; // Current position in the buffer
+};
+
+/// Command payload
+///
+/// Refers to the message received by the session (WebSocket),
+/// which stays valid until the command is executed.
+/// TCP sessions read the arguments directly from the socket.
+class CommandPayload
+{
+  public:
+    void set(char *data_, size_t len_) {
+        _data = data_;
+        len = len_;
+        position = 0;
+    }
+
+    size_t size() const {return len;}
+
+    /// Number of bytes not yet deserialized
+    size_t remaining() const {return len - position;}
+
+    char* begin()  {return _data + position;}
+
+    template<typename... Tp>
+    std::tuple<Tp...> deserialize() {
+        const auto tup = koheron::deserialize<0, Tp...>(begin());
+        position += required_buffer_size<Tp...>();
+        return tup;
+    }
+
     template<typename T, size_t N>
     const std::array<T, N>& extract_array() {
         // http://stackoverflow.com/questions/11205186/treat-c-cstyle-array-as-stdarray
@@ -72,8 +103,9 @@ struct Buffer
     }
 
   private:
-    std::array<char, len> _data;
-    size_t position; // Current position in the buffer
+    char *_data = nullptr;
+    size_t len = 0;
+    size_t position = 0; // Current position in the buffer
 };
 
 class SessionAbstract;
@@ -95,7 +127,7 @@ struct Command
     int32_t operation = -1; // Operation ID
 
     Buffer<HEADER_SIZE> header; // Raw data header
-    Buffer<CMD_PAYLOAD_BUFFER_LEN> payload;
+    CommandPayload payload;
 };
 
 } // namespace koheron
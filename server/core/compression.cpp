@@ -0,0 +1,220 @@
+/// Implementation of compression.hpp
+///
+/// (c) Koheron
+
+#include "compression.hpp"
+#include "serializer_deserializer.hpp"
+
+#include <cstring>
+
+namespace koheron {
+
+// ------------------------------------------
+// LZ4 block format
+// ------------------------------------------
+//
+// Sequences of [token | literals length | literals | offset | match length].
+// The last 5 bytes are always literals, and the last match
+// starts at least 12 bytes before the end of the block.
+
+namespace {
+
+constexpr size_t min_match = 4;
+constexpr size_t last_literals = 5;
+constexpr size_t match_find_limit = 12;
+constexpr size_t max_distance = 65535;
+
+inline uint32_t read32(const unsigned char *p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint32_t lz4_hash(uint32_t sequence) {
+    return (sequence * 2654435761U) >> (32 - lz4_hash_log);
+}
+
+inline unsigned char* write_length(unsigned char *op, size_t len) {
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+
+    *op++ = static_cast<unsigned char>(len);
+    return op;
+}
+
+inline unsigned char* write_sequence(unsigned char *op, const unsigned char *literals,
+                                     size_t literals_len, size_t offset, size_t match_len) {
+    unsigned char *token = op++;
+    *token = static_cast<unsigned char>(std::min(literals_len, size_t(15)) << 4);
+
+    if (literals_len >= 15) {
+        op = write_length(op, literals_len - 15);
+    }
+
+    std::memcpy(op, literals, literals_len);
+    op += literals_len;
+
+    *op++ = static_cast<unsigned char>(offset & 0xFF);
+    *op++ = static_cast<unsigned char>(offset >> 8);
+
+    *token |= static_cast<unsigned char>(std::min(match_len, size_t(15)));
+
+    if (match_len >= 15) {
+        op = write_length(op, match_len - 15);
+    }
+
+    return op;
+}
+
+} // namespace
+
+size_t lz4_compress(const unsigned char *src, size_t len, unsigned char *dst, uint32_t *hash_table)
+{
+    const unsigned char *ip = src;
+    const unsigned char *anchor = src;
+    const unsigned char *const end = src + len;
+    unsigned char *op = dst;
+
+    if (len > match_find_limit) {
+        const unsigned char *const match_start_limit = end - match_find_limit;
+        const unsigned char *const match_end_limit = end - last_literals;
+
+        std::fill(hash_table, hash_table + lz4_hash_table_size, 0);
+
+        // Skip faster through the incompressible data
+        unsigned int n_misses = 0;
+
+        while (ip < match_start_limit) {
+            const uint32_t sequence = read32(ip);
+            const uint32_t h = lz4_hash(sequence);
+            const unsigned char *ref = src + hash_table[h];
+            hash_table[h] = static_cast<uint32_t>(ip - src);
+
+            if (ref >= ip || static_cast<size_t>(ip - ref) > max_distance || read32(ref) != sequence) {
+                ip += 1 + (n_misses++ >> 6);
+                continue;
+            }
+
+            n_misses = 0;
+
+            const unsigned char *match_end = ip + min_match;
+            const unsigned char *ref_end = ref + min_match;
+
+            while (match_end < match_end_limit && *match_end == *ref_end) {
+                match_end++;
+                ref_end++;
+            }
+
+            op = write_sequence(op, anchor, static_cast<size_t>(ip - anchor),
+                                static_cast<size_t>(ip - ref),
+                                static_cast<size_t>(match_end - ip) - min_match);
+            ip = match_end;
+            anchor = ip;
+        }
+    }
+
+    // Last literals
+    const size_t literals_len = static_cast<size_t>(end - anchor);
+    *op++ = static_cast<unsigned char>(std::min(literals_len, size_t(15)) << 4);
+
+    if (literals_len >= 15) {
+        op = write_length(op, literals_len - 15);
+    }
+
+    std::memcpy(op, anchor, literals_len);
+    op += literals_len;
+
+    return static_cast<size_t>(op - dst);
+}
+
+void shuffle(const unsigned char *src, size_t len, size_t element_size, unsigned char *dst)
+{
+    const size_t n_elements = len / element_size;
+
+    for (size_t j = 0; j < element_size; j++) {
+        unsigned char *out = dst + j * n_elements;
+
+        for (size_t i = 0; i < n_elements; i++) {
+            out[i] = src[i * element_size + j];
+        }
+    }
+
+    // The trailing bytes are not shuffled
+    const size_t n_shuffled = n_elements * element_size;
+    std::memcpy(dst + n_shuffled, src + n_shuffled, len - n_shuffled);
+}
+
+// ------------------------------------------
+// Compressor
+// ------------------------------------------
+
+bool Compressor::compress(IovecBuffer& message, uint32_t flags, size_t element_size,
+                          IovecBuffer& compressed)
+{
+    constexpr size_t header_size = 8;
+    const size_t size = message.size();
+
+    if (!(flags & COMPRESSION_LZ4) || size <= header_size) {
+        return false;
+    }
+
+    // The compressor needs a contiguous input
+    input = pool.acquire(size);
+    size_t offset = 0;
+
+    for (const auto& iov : message.iovecs()) {
+        std::memcpy(input.data() + offset, iov.iov_base, iov.iov_len);
+        offset += iov.iov_len;
+    }
+
+    const size_t payload_size = size - header_size;
+    const unsigned char *payload = reinterpret_cast<unsigned char*>(input.data()) + header_size;
+
+    if (!(flags & COMPRESSION_SHUFFLE) || element_size < 2) {
+        element_size = 1;
+    } else {
+        shuffled = pool.acquire(payload_size);
+        shuffle(payload, payload_size, element_size, reinterpret_cast<unsigned char*>(shuffled.data()));
+        payload = reinterpret_cast<unsigned char*>(shuffled.data());
+    }
+
+    output = pool.acquire(lz4_compress_bound(payload_size));
+    hash_table = pool.acquire(lz4_hash_table_size * sizeof(uint32_t));
+
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wcast-align"
+    const size_t compressed_size = lz4_compress(payload, payload_size,
+                                                reinterpret_cast<unsigned char*>(output.data()),
+                                                reinterpret_cast<uint32_t*>(hash_table.data()));
+    #pragma GCC diagnostic pop
+
+    if (compressed_size + 12 >= payload_size) {
+        release();
+        return false;
+    }
+
+    // Header: the class and function ids are kept
+    std::array<unsigned char, 20> header;
+    std::memcpy(header.data(), input.data(), header_size);
+    koheron::append<uint32_t>(header.data(), COMPRESSED_RESPONSE);
+    koheron::append<uint32_t>(header.data() + 8, static_cast<uint32_t>(payload_size));
+    koheron::append<uint32_t>(header.data() + 12, static_cast<uint32_t>(compressed_size));
+    koheron::append<uint32_t>(header.data() + 16, static_cast<uint32_t>(element_size));
+
+    compressed.clear();
+    compressed.append(header.data(), header.size());
+    compressed.reference(reinterpret_cast<unsigned char*>(output.data()), compressed_size);
+    return true;
+}
+
+void Compressor::release()
+{
+    input.release();
+    shuffled.release();
+    output.release();
+    hash_table.release();
+}
+
+} // namespace koheron
@@ -0,0 +1,112 @@
+/// Compression of the responses
+///
+/// Sessions compress the large responses once the client has
+/// negotiated it (KServer set_compression operation).
+///
+/// The payload (after the 8 bytes header) is compressed in the LZ4 block
+/// format. With the shuffle filter, the bytes of the container elements
+/// are first grouped by significance (all the first bytes, then all the
+/// second bytes...), which makes smooth spectra or ADC samples in wider
+/// words much more compressible.
+///
+/// Compressed response:
+/// |    RESERVED = 1   | class_id | func_id | payload size | compressed size | element size | data
+/// |  0 |  1 |  2 |  3 |  4 |  5  |  6 |  7 |  8 ... 11    |   12 ... 15     |  16 ... 19   | 20...
+///
+/// The element size is 1 when the payload is not shuffled.
+///
+/// (c) Koheron
+
+#ifndef __KOHERON_COMPRESSION_HPP__
+#define __KOHERON_COMPRESSION_HPP__
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <array>
+#include <type_traits>
+#include <algorithm>
+#include <initializer_list>
+
+#include "iovec.hpp"
+#include "buffer_pool.hpp"
+
+namespace koheron {
+
+/// Flags negotiated with set_compression
+enum CompressionFlags : uint32_t {
+    COMPRESSION_LZ4 = 1,
+    COMPRESSION_SHUFFLE = 2
+};
+
+/// Value of the reserved header field for a compressed response
+constexpr uint32_t COMPRESSED_RESPONSE = 1;
+
+// Element size of the containers, used by the shuffle filter
+
+template<typename T>
+struct element_size : std::integral_constant<size_t, 1> {};
+
+template<typename T, typename Alloc>
+struct element_size<std::vector<T, Alloc>> : std::integral_constant<size_t, sizeof(T)> {};
+
+template<typename T, size_t N>
+struct element_size<std::array<T, N>> : std::integral_constant<size_t, sizeof(T)> {};
+
+/// Largest element size of the containers in a response
+template<typename... Args>
+constexpr size_t shuffle_element_size() {
+    size_t size = 1;
+    (void)std::initializer_list<int>{(size = std::max(size, element_size<std::decay_t<Args>>::value), 0)...};
+    return size;
+}
+
+/// Largest compressed size of n bytes in the LZ4 block format
+constexpr size_t lz4_compress_bound(size_t n) {
+    return n + n / 255 + 16;
+}
+
+/// Compress src into dst in the LZ4 block format.
+/// dst must hold lz4_compress_bound(len) bytes.
+/// hash_table must hold lz4_hash_table_size entries.
+/// Returns the compressed size.
+size_t lz4_compress(const unsigned char *src, size_t len, unsigned char *dst, uint32_t *hash_table);
+
+constexpr unsigned int lz4_hash_log = 14;
+constexpr size_t lz4_hash_table_size = size_t(1) << lz4_hash_log;
+
+/// Group the bytes of the elements by significance
+void shuffle(const unsigned char *src, size_t len, size_t element_size, unsigned char *dst);
+
+class Compressor
+{
+  public:
+    explicit Compressor(BufferPool& pool_)
+    : pool(pool_)
+    {}
+
+    /// Build the compressed response of message into compressed.
+    /// Returns false if compressing doesn't reduce the message size.
+    bool compress(IovecBuffer& message, uint32_t flags, size_t element_size,
+                  IovecBuffer& compressed);
+
+    /// Give the work buffers back to the pool,
+    /// once the compressed response is sent.
+    void release();
+
+    /// Bytes of the work buffers held
+    size_t memory_size() const {
+        return input.size() + shuffled.size() + output.size() + hash_table.size();
+    }
+
+  private:
+    BufferPool& pool;
+    PoolBuffer input;
+    PoolBuffer shuffled;
+    PoolBuffer output;
+    PoolBuffer hash_table;
+};
+
+} // namespace koheron
+
+#endif // __KOHERON_COMPRESSION_HPP__
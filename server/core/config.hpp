@@ -6,8 +6,23 @@
 
 #include <cstdint>
 
+/// Host build (make host_server, see server.mk): the memory maps are
+/// backed by anonymous shared memory, the FPGA is not configured and
+/// the server files are written in /tmp.
+#ifdef KOHERON_SIMULATED
+#define KOHERON_RUN_PATH "/tmp/"
+#else
+#define KOHERON_RUN_PATH "/var/run/"
+#endif
+
 namespace koheron {
     namespace config {
+#ifdef KOHERON_SIMULATED
+        constexpr bool simulated = true;
+#else
+        constexpr bool simulated = false;
+#endif
+
         namespace log {
             /// Display messages emitted and received
             constexpr bool verbose = false;
@@ -17,6 +32,13 @@ namespace koheron {
 
             /// Send messages to syslog
             constexpr bool syslog = true;
+
+            /// Format and write the messages on a background thread.
+            /// Each logging thread has a ring of ring_records messages,
+            /// drained every drain_period_ms. Not used with verbose.
+            constexpr bool async = true;
+            constexpr uint32_t ring_records = 64;
+            constexpr int drain_period_ms = 20;
         }
 
         /// Maximum length of the Unix socket file path
@@ -29,6 +51,197 @@ namespace koheron {
         constexpr bool notify_systemd = true;
         constexpr char sd_notify_socket[unix_socket_path_len] = "/run/systemd/notify";
 
+        /// Don't reload the bitstream and reconfigure the clocks
+        /// when the same configuration is already loaded.
+        ///
+        /// A hash of the bitstream and of the clocks settings is recorded
+        /// in fpga_state_file, which must be cleared on reboot.
+        constexpr bool skip_unchanged_fpga_config = true;
+        constexpr char fpga_state_file[] = KOHERON_RUN_PATH "koheron-server.fpga";
+
+        /// Record the latency histograms of the operations (KServer get_stats)
+        constexpr bool operation_stats = true;
+
+        namespace trace {
+            /// Record the trace events of the server activity (see trace.hpp)
+            constexpr bool enabled = true;
+
+            /// Number of events kept per thread
+            constexpr uint32_t ring_events = 2048;
+
+            /// Number of exited threads whose events are kept
+            constexpr uint32_t exited_rings = 16;
+
+            /// On SIGUSR1, the events of the last dump_seconds are written in dump_path
+            constexpr char dump_path[] = "/tmp/koheron-trace.json";
+            constexpr uint32_t dump_seconds = 10;
+        }
+
+        /// Number of threads starting the drivers with the server.
+        ///
+        /// Each driver is started once the drivers it depends on
+        /// (ctx.get<Driver>() in its sources) are started. The drivers
+        /// mostly wait on the peripherals, so there can be more threads
+        /// than cores. Set to 0 to start the drivers on first use.
+        constexpr unsigned int driver_init_threads = 4;
+
+        /// Maximum number of open sessions (all listeners).
+        /// The memory of the sessions is allocated with the server.
+        constexpr unsigned int max_sessions = 512;
+
+        /// Sessions scheduling model
+        enum class SessionModel {
+            THREAD_PER_SESSION, ///< Each session runs on a pool worker with blocking sockets
+            REACTOR             ///< Non-blocking sessions multiplexed on epoll event loops
+        };
+
+        /// Built with -DKOHERON_REACTOR for the reactor model (see make host_tests_reactor)
+#ifdef KOHERON_REACTOR
+        constexpr SessionModel session_model = SessionModel::REACTOR;
+#else
+        constexpr SessionModel session_model = SessionModel::THREAD_PER_SESSION;
+#endif
+
+        /// Sessions worker pool (THREAD_PER_SESSION model)
+        ///
+        /// The pool is shared by all the listeners. It is started with
+        /// max(session_pool_min_workers, session_pool_workers_per_core * number of cores)
+        /// threads, each running one session at a time. It grows when no
+        /// worker is free, up to the sum of the *_worker_connections, so that
+        /// every connection accepted by a listener is served.
+        constexpr unsigned int session_pool_workers_per_core = 8;
+        constexpr unsigned int session_pool_min_workers = 8;
+
+        /// Maximum number of accepted connections waiting for a free worker.
+        /// Connections are rejected when the admission queue is full.
+        constexpr unsigned int session_admission_queue_len = 32;
+
+        /// A connection waiting longer than this for a worker is closed
+        constexpr int session_admission_timeout_ms = 2000;
+
+        /// Number of event-loop threads in reactor mode
+        constexpr unsigned int reactor_threads = 2;
+
+        /// Maximum time a stream frame waits for the pending responses
+        /// of a session to be written in reactor mode. The delivery
+        /// thread waits, the event loops never block on a socket.
+        constexpr int reactor_io_timeout_ms = 5000;
+
+        /// Maximum size of a command in reactor mode. A partially received
+        /// command is buffered until complete: the receive buffer grows up
+        /// to this size as the bytes arrive.
+        constexpr unsigned int reactor_max_command_size = 16777216;
+
+        /// Use io_uring for TCP and Unix sessions I/O when available.
+        /// Sessions fall back to read/write if the kernel doesn't support it.
+        /// Only used with the THREAD_PER_SESSION model.
+        ///
+        /// Opt-in, built with -DKOHERON_IO_URING (see make host_tests_io_uring):
+        /// make transport_benchmark shows no gain over read/write on loopback
+        /// for 64 kB and larger responses.
+#ifdef KOHERON_IO_URING
+        constexpr bool io_uring_transport = true;
+#else
+        constexpr bool io_uring_transport = false;
+#endif
+
+        /// Submission queue depth of the per-session io_uring
+        constexpr unsigned int io_uring_queue_depth = 8;
+
+        /// Number and size of the receive buffers provided to the kernel
+        constexpr unsigned int io_uring_recv_buffers = 8;
+        constexpr unsigned int io_uring_recv_buffer_size = 16384;
+
+        /// Maximum received bytes waiting to be read by an io_uring session.
+        /// Beyond, the receive buffers are given back to the kernel only as
+        /// the session reads: the kernel stops receiving (ENOBUFS) and TCP
+        /// flow control slows the client down.
+        constexpr unsigned int io_uring_max_staging_size = 262144;
+
+        /// Size of the registered send buffer.
+        /// Responses fitting in it are coalesced until the next read.
+        constexpr unsigned int io_uring_send_buffer_size = 65536;
+
+        /// Size of the per-session receive buffer (TCP, Unix and WebSocket
+        /// sessions without io_uring). Each read fetches all the pipelined
+        /// commands available, up to this size.
+        constexpr unsigned int recv_buffer_size = 16384;
+
+        /// Shared buffer pool
+        ///
+        /// Buffer sizes are rounded up to a power of two between
+        /// buffer_pool_min_size and buffer_pool_max_size (larger buffers
+        /// are not pooled). At most buffer_pool_max_cached_bytes of
+        /// released buffers are kept for reuse.
+        constexpr unsigned int buffer_pool_min_size = 4096;
+        constexpr unsigned int buffer_pool_max_size = 1048576;
+        constexpr unsigned int buffer_pool_max_cached_bytes = 4194304;
+
+        /// Maximum size of the coalesced responses (TCP and Unix sessions).
+        ///
+        /// Clients can pipeline commands. The responses to the commands
+        /// received back to back are sent together when the session gets idle,
+        /// or earlier if they exceed this size.
+        /// With io_uring, the send buffer size sets the same limit.
+        constexpr unsigned int send_coalesce_size = 65536;
+
+        /// Allow the clients to enable the compression of the responses
+        constexpr bool compression = true;
+
+        /// Minimum response size compressed
+        constexpr unsigned int compression_min_size = 65536;
+
+        /// Maximum length of the server-push subscriptions queues (number of frames)
+        constexpr unsigned int stream_max_queue_length = 1024;
+
+        /// Maximum time a publisher waits for room in the queue of
+        /// a subscription with the BLOCK policy. The frame is dropped after.
+        constexpr int stream_block_timeout_ms = 1000;
+
+        /// Shared memory transport (Unix socket sessions)
+        ///
+        /// Local clients can map a memory region shared with their session
+        /// (KServer open_shared_memory operation). The payloads larger than
+        /// shm_min_size then go through two rings (requests and responses)
+        /// of shm_ring_size bytes, the socket only carries their position.
+        constexpr bool shared_memory = true;
+
+        /// Size of each ring (power of two)
+        constexpr unsigned int shm_ring_size = 8388608;
+
+        /// Minimum payload size going through the shared memory
+        constexpr unsigned int shm_min_size = 16384;
+
+        /// Send large TCP responses with MSG_ZEROCOPY.
+        /// The session waits for the kernel to release the source buffer
+        /// before returning, so the driver can overwrite it afterwards.
+        /// The pinning and notification costs only pay off for large payloads
+        /// on a real network link (on loopback the kernel copies anyway).
+        constexpr bool tcp_zerocopy = false;
+
+        /// Minimum response size sent with MSG_ZEROCOPY
+        constexpr unsigned int tcp_zerocopy_min_size = 262144;
+
+        /// Maximum time waiting for the zero-copy completion notifications:
+        /// tcp_zerocopy_timeout_ms, plus the time to send the payload at
+        /// tcp_zerocopy_min_rate bytes per second (the notifications come
+        /// once the peer acknowledged the whole payload).
+        constexpr int tcp_zerocopy_timeout_ms = 5000;
+        constexpr unsigned int tcp_zerocopy_min_rate = 1048576;
+
+        /// WebSocket messages larger than this size are sent as several
+        /// fragments (0 to send each message as a single frame).
+        constexpr unsigned int websocket_fragment_size = 1048576;
+
+        /// Maximum size of a received WebSocket message (after reassembly of the fragments).
+        /// The buffer grows with the bytes received, not with the declared frame size.
+        constexpr unsigned int websocket_max_message_size = 16777216;
+
+        /// Idle WebSocket clients are pinged after this time, and disconnected
+        /// if they don't answer within the same time (0 to disable).
+        /// Only used with the THREAD_PER_SESSION model.
+        constexpr int websocket_ping_interval_ms = 30000;
+
         /// Enable/Disable the Nagle algorithm in the TCP buffer
         constexpr bool tcp_nodelay = true;
 
@@ -42,10 +255,53 @@ namespace koheron {
         /// Websocket max parallel connections
         constexpr int websocket_worker_connections = 100;
 
+        /// UDP streaming port (0 to disable)
+        ///
+        /// UDP clients subscribe to the operation streams
+        /// with control datagrams sent to this port.
+        /// Disabled by default: build with -DKOHERON_UDP_PORT=36100 to enable it
+        /// (make CONFIG=... SERVER_FLAGS=-DKOHERON_UDP_PORT=36100 server).
+#ifdef KOHERON_UDP_PORT
+        constexpr unsigned int udp_port = KOHERON_UDP_PORT;
+#else
+        constexpr unsigned int udp_port = 0;
+#endif
+
+        /// Maximum size of the UDP datagrams (header included).
+        /// 1472 bytes fit in an Ethernet frame (1500 bytes MTU).
+        constexpr unsigned int udp_datagram_size = 1472;
+
+        /// Length of the UDP subscriptions queues (number of frames).
+        /// The oldest frames are dropped, which bounds the lag on congestion.
+        constexpr unsigned int udp_queue_length = 2;
+
+        /// UDP subscriptions are removed if not renewed within this time
+        constexpr int udp_subscription_timeout_ms = 10000;
+
+        /// Lifetime of the cookies of the UDP control datagrams (see udp_channel.hpp)
+        constexpr unsigned int udp_cookie_lifetime_ms = 60000;
+
+        /// Maximum number of UDP subscriptions
+        constexpr unsigned int udp_max_subscriptions = 64;
+
         /// Unix socket file path
-        constexpr char unix_socket_path[unix_socket_path_len] = "/var/run/koheron-server.sock";
+        constexpr char unix_socket_path[unix_socket_path_len] = KOHERON_RUN_PATH "koheron-server.sock";
         /// Unix socket max parallel connections
         constexpr int unix_socket_worker_connections = 100;
+
+        /// Zero-downtime restart (see handover.hpp)
+        ///
+        /// A server started while another one is running takes over its
+        /// listening sockets through this Unix socket. The previous server
+        /// then exits once its sessions are closed, or after the drain timeout.
+        constexpr bool handover = true;
+        constexpr char handover_socket_path[unix_socket_path_len] = KOHERON_RUN_PATH "koheron-server.handover";
+        constexpr int handover_drain_timeout_ms = 10000;
+
+        /// Maximum time for the new server to start its drivers. The running
+        /// server rejects the driver operations meanwhile, and resumes them
+        /// if the new server doesn't take over.
+        constexpr int handover_init_timeout_ms = 30000;
     }
 } // namespace koheron
 
@@ -5,7 +5,9 @@
 
 #include <server_definitions.hpp>
 #include <syslog.hpp>
+#include <streams.hpp>
 #include <drivers_table.hpp>
+#include <trace.hpp>
 
 namespace koheron {
     class DriverManager;
@@ -15,8 +17,9 @@ namespace koheron {
 class ContextBase
 {
   private:
-    koheron::DriverManager *driver_manager;
-    koheron::SysLog *syslog;
+    koheron::DriverManager *driver_manager = nullptr;
+    koheron::SysLog *syslog = nullptr;
+    koheron::StreamManager *stream_manager = nullptr;
 
     void set_driver_manager(koheron::DriverManager *driver_manager_) {
         driver_manager = driver_manager_;
@@ -26,15 +29,38 @@ class ContextBase
         syslog = syslog_;
     }
 
+    void set_stream_manager(koheron::StreamManager *stream_manager_) {
+        stream_manager = stream_manager_;
+    }
+
   public:
     template<class Driver>
     Driver& get() const;
 
     template<int severity, typename... Args>
     void log(const char *msg, Args&&... args) {
+        // The syslog is attached by the DriverManager after the Context is built
+        if (syslog == nullptr) {
+            koheron::fprintf(stderr, msg, std::forward<Args>(args)...);
+            return;
+        }
+
         syslog->print<severity>(msg, std::forward<Args>(args)...);
     }
 
+    /// Push a frame to the clients subscribed to the stream of operation op
+    /// (an op_id constant). The frame is serialized as the response to the operation.
+    /// Does nothing if there is no subscriber.
+    template<class Driver, uint16_t op, typename... Args>
+    void publish(Args&&... args) {
+        constexpr uint32_t stream = koheron::stream_id(driver_id_of<Driver>, op);
+
+        if (stream_manager->has_subscribers(stream)) {
+            stream_manager->publish(stream,
+                koheron::make_stream_frame<driver_id_of<Driver>, op>(std::forward<Args>(args)...));
+        }
+    }
+
   protected:
     virtual int init() { return 0; }
 
@@ -6,8 +6,12 @@
 #define __DRIVER_HPP__
 
 #include <cstring>
+#include <mutex>
+#include <shared_mutex>
 
 #include "server_definitions.hpp"
+#include "operation_stats.hpp"
+#include "trace.hpp"
 #include <drivers_table.hpp>
 
 namespace koheron {
@@ -30,6 +34,45 @@ friend class DriverManager;
 template<driver_id type>
 class Driver : public DriverAbstract {};
 
+/// Entry of the operations dispatch table (see interface_drivers.hpp)
+using OperationEntry = int (*)(DriverAbstract*, Command&);
+
+/// Execute an operation of a driver.
+/// The read-only operations share the lock of the driver,
+/// the others have exclusive access.
+/// The wait for the lock is only timed if the lock is contended.
+template<class DriverType, int (DriverType::*operation)(Command&), bool read_only>
+int execute_operation(DriverAbstract *driver_abs, Command& cmd)
+{
+    auto& driver = *static_cast<DriverType*>(driver_abs);
+
+    if constexpr (read_only) {
+        std::shared_lock<std::shared_mutex> lock(driver.mutex, std::try_to_lock);
+
+        if (!lock.owns_lock()) {
+            const auto start = stats_clock_ns();
+            lock.lock();
+            const auto end = stats_clock_ns();
+            operation_timing.locked(end - start);
+            trace::record("lock", start, end);
+        }
+
+        return (driver.*operation)(cmd);
+    } else {
+        std::unique_lock<std::shared_mutex> lock(driver.mutex, std::try_to_lock);
+
+        if (!lock.owns_lock()) {
+            const auto start = stats_clock_ns();
+            lock.lock();
+            const auto end = stats_clock_ns();
+            operation_timing.locked(end - start);
+            trace::record("lock", start, end);
+        }
+
+        return (driver.*operation)(cmd);
+    }
+}
+
 } // namespace koheron
 
 #endif // __DRIVER_HPP__
@@ -8,6 +8,12 @@
 #include "meta_utils.hpp"
 #include <interface_drivers.hpp>
 
+#include <condition_variable>
+#include <cstring>
+#include <shared_mutex>
+#include <type_traits>
+#include <vector>
+
 namespace koheron {
 
 //----------------------------------------------------------------------------
@@ -46,15 +52,24 @@ DriverManager::DriverManager(Server *server_)
 {
     ctx.set_driver_manager(this);
     ctx.set_syslog(&server->syslog);
-    is_started.fill(false);
+    ctx.set_stream_manager(&server->stream_manager);
+
+    for (auto& started : is_started) {
+        started.store(false);
+    }
+}
+
+static uint64_t to_us(std::chrono::steady_clock::duration duration)
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
 }
 
 template<std::size_t driver>
 void DriverManager::alloc_driver()
 {
-    std::lock_guard<std::recursive_mutex> lock(mutex);
+    std::lock_guard<std::recursive_mutex> lock(std::get<driver - 2>(mutexes));
 
-    if (std::get<driver - 2>(is_started)) {
+    if (std::get<driver - 2>(is_started).load()) {
         return;
     }
 
@@ -62,6 +77,8 @@ void DriverManager::alloc_driver()
         "Driver Manager: Starting driver [%u] %s...\n",
         driver, std::get<driver>(drivers_names).data());
 
+    const auto start_time = clock::now();
+
     if (driver_container.alloc<driver>() < 0) {
         server->syslog.print<PANIC>(
             "Failed to allocate driver [%u] %s. Exiting server...\n",
@@ -73,7 +90,17 @@ void DriverManager::alloc_driver()
 
     std::get<driver - 2>(device_list)
         = std::make_unique<Driver<driver>>(server, driver_container.get<driver>());
-    std::get<driver - 2>(is_started) = true;
+
+    // Includes the time to start the dependencies not started yet
+    auto& driver_startup = std::get<driver - 2>(startup);
+    driver_startup.start_us = to_us(start_time - init_time);
+    driver_startup.duration_us = to_us(clock::now() - start_time);
+
+    server->syslog.print<INFO>(
+        "Driver Manager: Driver [%u] %s started in %.1f ms\n",
+        driver, std::get<driver>(drivers_names).data(), 1E-3 * double(driver_startup.duration_us));
+
+    std::get<driver - 2>(is_started).store(true, std::memory_order_release);
 }
 
 template<driver_id dev0, driver_id... drivers>
@@ -102,48 +129,327 @@ void DriverManager::start(driver_id driver, std::index_sequence<drivers...>)
     start_impl<drivers...>(driver);
 }
 
+// The threads take the drivers whose dependencies are all started.
+// Once a driver is started, the drivers depending on it are released.
+int DriverManager::start_drivers()
+{
+    constexpr std::size_t drivers_num = device_num - 2;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::vector<driver_id> ready;
+    std::array<std::size_t, drivers_num> remaining{}; // Number of dependencies not started
+    std::size_t running = 0;
+
+    for (const auto& dependency : drivers_dependencies) {
+        remaining[dependency.first - 2]++;
+    }
+
+    for (driver_id driver = 2; driver < device_num; driver++) {
+        if (remaining[driver - 2] == 0) {
+            ready.push_back(driver);
+        }
+    }
+
+    auto worker = [&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        while (true) {
+            cond.wait(lock, [&] { return !ready.empty() || running == 0; });
+
+            // Nothing left to start once no driver is running
+            if (ready.empty() || server->exit_all.load()) {
+                break;
+            }
+
+            const auto driver = ready.back();
+            ready.pop_back();
+            running++;
+            lock.unlock();
+
+            start(driver, make_index_sequence_in_range<2, device_num>());
+
+            lock.lock();
+            running--;
+
+            for (const auto& dependency : drivers_dependencies) {
+                if (dependency.second == driver && --remaining[dependency.first - 2] == 0) {
+                    ready.push_back(dependency.first);
+                }
+            }
+
+            cond.notify_all();
+        }
+    };
+
+    const auto threads_num = std::min<std::size_t>(config::driver_init_threads, drivers_num);
+    std::vector<std::thread> threads;
+
+    for (std::size_t i = 0; i < threads_num; i++) {
+        threads.emplace_back(worker);
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // Drivers never released (circular dependency): started one by one
+    // to report the cycle.
+    for (driver_id driver = 2; driver < device_num && !server->exit_all.load(); driver++) {
+        if (!is_started[driver - 2].load()) {
+            start(driver, make_index_sequence_in_range<2, device_num>());
+        }
+    }
+
+    if (server->exit_all.load()) {
+        return -1;
+    }
+
+    startup_duration_us = to_us(clock::now() - init_time);
+
+    server->syslog.print<INFO>(
+        "Driver Manager: %zu drivers started in %.1f ms (%zu threads)\n",
+        drivers_num, 1E-3 * double(startup_duration_us), threads_num);
+
+    return 0;
+}
+
 int DriverManager::init()
 {
+    init_time = clock::now();
+
     if (ctx.init() < 0) {
         server->syslog.print<CRITICAL>("Context initialization failed\n");
         return -1;
     }
 
+    if (config::driver_init_threads > 0 && start_drivers() < 0) {
+        server->syslog.print<CRITICAL>("Drivers initialization failed\n");
+        return -1;
+    }
+
     get<driver_id_of<Common>>().init();
     return 0;
 }
 
-template<driver_id dev0, driver_id... drivers>
-std::enable_if_t<0 == sizeof...(drivers) && 2 <= dev0, int>
-DriverManager::execute_driver_implementation(DriverAbstract *dev_abs, Command& cmd)
+//----------------------------------------------------------------------------
+// Handover
+//----------------------------------------------------------------------------
+
+template<class T, class = void>
+struct has_handover_state : std::false_type {};
+
+template<class T>
+struct has_handover_state<T, std::void_t<
+    decltype(std::declval<T&>().handover_save(std::declval<std::vector<unsigned char>&>())),
+    decltype(std::declval<T&>().handover_restore(std::declval<const std::vector<unsigned char>&>()))>>
+: std::true_type {};
+
+template<driver_id driver>
+uint32_t DriverManager::save_driver_state(std::vector<unsigned char>& bytes)
 {
-    static_assert(dev0 < device_num, "");
-    static_assert(dev0 >= 2, "");
-    return static_cast<Driver<dev0>*>(dev_abs)->execute(cmd);
+    if constexpr (has_handover_state<device_t<driver>>::value) {
+        if (!is_driver_started(driver)) {
+            return 0;
+        }
+
+        std::vector<unsigned char> state;
+
+        {
+            // No operation running on the driver
+            auto& interface = static_cast<Driver<driver>&>(*std::get<driver - 2>(device_list));
+            std::lock_guard<std::shared_mutex> lock(interface.mutex);
+            driver_container.get<driver>().handover_save(state);
+        }
+
+        const auto& name = std::get<driver>(drivers_names);
+        const auto name_len = static_cast<uint16_t>(name.size());
+        const auto state_size = static_cast<uint32_t>(state.size());
+        const auto offset = bytes.size();
+
+        bytes.resize(offset + sizeof(name_len) + name_len + sizeof(state_size) + state_size);
+        unsigned char *ptr = bytes.data() + offset;
+        std::memcpy(ptr, &name_len, sizeof(name_len));
+        std::memcpy(ptr + sizeof(name_len), name.data(), name_len);
+        std::memcpy(ptr + sizeof(name_len) + name_len, &state_size, sizeof(state_size));
+        std::memcpy(ptr + sizeof(name_len) + name_len + sizeof(state_size), state.data(), state_size);
+        return 1;
+    } else {
+        (void)bytes;
+        return 0;
+    }
 }
 
-template<driver_id dev0, driver_id... drivers>
-std::enable_if_t<0 < sizeof...(drivers) && 2 <= dev0, int>
-DriverManager::execute_driver_implementation(DriverAbstract *dev_abs, Command& cmd)
+template<driver_id... drivers>
+uint32_t DriverManager::save_drivers_state(std::vector<unsigned char>& bytes, std::index_sequence<drivers...>)
 {
-    static_assert(dev0 < device_num, "");
-    static_assert(dev0 >= 2, "");
+    return (0 + ... + save_driver_state<drivers>(bytes));
+}
 
-    return dev_abs->type == dev0 ? static_cast<Driver<dev0>*>(dev_abs)->execute(cmd)
-                                 : execute_driver_implementation<drivers...>(dev_abs, cmd);
+uint32_t DriverManager::save_handover_state(std::vector<unsigned char>& bytes)
+{
+    return save_drivers_state(bytes, make_index_sequence_in_range<2, device_num>());
+}
+
+template<driver_id driver>
+void DriverManager::restore_driver_state(const std::string& name, const std::vector<unsigned char>& state)
+{
+    if constexpr (has_handover_state<device_t<driver>>::value) {
+        if (name != std::get<driver>(drivers_names).data()) {
+            return;
+        }
+
+        auto& instance = get<driver>();
+        auto& interface = static_cast<Driver<driver>&>(*std::get<driver - 2>(device_list));
+        std::lock_guard<std::shared_mutex> lock(interface.mutex);
+        instance.handover_restore(state);
+
+        server->syslog.print<INFO>("Driver Manager: State of driver %s restored (%zu bytes)\n",
+                                   name.c_str(), state.size());
+    } else {
+        (void)name;
+        (void)state;
+    }
 }
 
 template<driver_id... drivers>
-int DriverManager::execute_driver(DriverAbstract *dev_abs, Command& cmd,
-                               std::index_sequence<drivers...>)
+void DriverManager::restore_drivers_state(const std::string& name, const std::vector<unsigned char>& state,
+                                          std::index_sequence<drivers...>)
+{
+    (restore_driver_state<drivers>(name, state), ...);
+}
+
+void DriverManager::restore_handover_state(const std::vector<unsigned char>& bytes, uint32_t n_states)
+{
+    size_t offset = 0;
+
+    for (uint32_t i = 0; i < n_states; i++) {
+        uint16_t name_len;
+        uint32_t state_size;
+
+        if (offset + sizeof(name_len) > bytes.size()) {
+            break;
+        }
+
+        std::memcpy(&name_len, bytes.data() + offset, sizeof(name_len));
+        offset += sizeof(name_len);
+
+        if (offset + name_len + sizeof(state_size) > bytes.size()) {
+            break;
+        }
+
+        const std::string name(reinterpret_cast<const char *>(bytes.data() + offset), name_len);
+        offset += name_len;
+        std::memcpy(&state_size, bytes.data() + offset, sizeof(state_size));
+        offset += sizeof(state_size);
+
+        if (offset + state_size > bytes.size()) {
+            break;
+        }
+
+        const std::vector<unsigned char> state(bytes.begin() + static_cast<std::ptrdiff_t>(offset),
+                                               bytes.begin() + static_cast<std::ptrdiff_t>(offset + state_size));
+        offset += state_size;
+        restore_drivers_state(name, state, make_index_sequence_in_range<2, device_num>());
+    }
+
+    if (offset != bytes.size()) {
+        server->syslog.print<ERROR>("Driver Manager: Invalid handover state\n");
+    }
+}
+
+int DriverManager::quiesce(int timeout_ms)
+{
+    quiesced.store(true);
+    const auto deadline = clock::now() + std::chrono::milliseconds(timeout_ms);
+
+    while (running_operations.load() > 0) {
+        if (clock::now() > deadline) {
+            return -1;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    server->syslog.print<INFO>("Driver Manager: Driver operations stopped\n");
+    return 0;
+}
+
+void DriverManager::resume()
+{
+    quiesced.store(false);
+    server->syslog.print<INFO>("Driver Manager: Driver operations resumed\n");
+}
+
+// Names of the Server operations (trace events)
+static constexpr std::array<const char*, Server::server_op_num> server_operations_names = {
+    "KServer::get_version",
+    "KServer::get_cmds",
+    "KServer::batch",
+    "KServer::get_memory_report",
+    "KServer::set_compression",
+    "KServer::subscribe",
+    "KServer::unsubscribe",
+    "KServer::open_shared_memory",
+    "KServer::get_startup_report",
+    "KServer::get_stats",
+    "KServer::get_trace"
+};
+
+size_t DriverManager::operation_stats_index(driver_id driver, int32_t op)
 {
-    static_assert(sizeof...(drivers) == device_num - 2, "");
-    return execute_driver_implementation<drivers...>(dev_abs, cmd);
+    if (op < 0) {
+        return operations_num + Server::server_op_num;
+    }
+
+    if (driver == 1 && op < Server::server_op_num) {
+        return operations_num + static_cast<size_t>(op);
+    }
+
+    if (driver >= 2 && driver < device_num && op < drivers_op_num[driver]) {
+        return op_offsets[driver] + static_cast<size_t>(op);
+    }
+
+    return operations_num + Server::server_op_num;
 }
 
 int DriverManager::execute(Command& cmd)
 {
-    assert(cmd.driver < device_num);
+    if constexpr (!config::operation_stats && !config::trace::enabled) {
+        return execute_command(cmd);
+    }
+
+    const auto outer = operation_timing.begin();
+    const auto start = stats_clock_ns();
+    const int ret = execute_command(cmd);
+    const auto end = stats_clock_ns();
+    const auto index = operation_stats_index(cmd.driver, cmd.operation);
+
+    // Aborted on a partially received command, it is executed again
+    const bool incomplete = cmd.session != nullptr && cmd.session->input_incomplete;
+
+    if (index < operations_num + Server::server_op_num && !incomplete) {
+        if constexpr (config::operation_stats) {
+            server->operation_stats.record(index, cmd.session != nullptr ? cmd.session->type : NONE,
+                                           end - start);
+        }
+
+        const char *name = index < operations_num ? operations_names[index]
+                                                  : server_operations_names[index - operations_num];
+        trace::record(name, start, end, static_cast<uint32_t>(cmd.session_id));
+    }
+
+    operation_timing.end(outer);
+    return ret;
+}
+
+int DriverManager::execute_command(Command& cmd)
+{
+    // The ids come from the client: they index the dispatch tables
+    // only once checked (also in release builds).
+    if (cmd.driver >= device_num) {
+        return -1;
+    }
 
     if (cmd.driver == 0) {
         return 0;
@@ -153,12 +459,42 @@ int DriverManager::execute(Command& cmd)
         return server->execute(cmd);
     }
 
+    if (cmd.operation < 0 || cmd.operation >= drivers_op_num[cmd.driver]) {
+        return -1;
+    }
+
+    if constexpr (config::handover) {
+        // Counted before checking the flag, so that quiesce() waits for it
+        running_operations.fetch_add(1);
+
+        if (quiesced.load()) {
+            running_operations.fetch_sub(1);
+            return -1;
+        }
+
+        const int ret = execute_driver_operation(cmd);
+        running_operations.fetch_sub(1);
+        return ret;
+    }
+
+    return execute_driver_operation(cmd);
+}
+
+int DriverManager::execute_driver_operation(Command& cmd)
+{
     if (!is_started[cmd.driver - 2]) {
         start(cmd.driver, make_index_sequence_in_range<2, device_num>());
     }
 
-    return execute_driver(device_list[cmd.driver - 2].get(), cmd,
-                       make_index_sequence_in_range<2, device_num>());
+    // Single indirect call (the Unix sessions are TCP sessions)
+    const auto index = op_offsets[cmd.driver] + static_cast<std::size_t>(cmd.operation);
+    DriverAbstract *driver = device_list[cmd.driver - 2].get();
+
+    if (cmd.session->type == WEBSOCK) {
+        return dispatch_table<WEBSOCK>[index](driver, cmd);
+    }
+
+    return dispatch_table<TCP>[index](driver, cmd);
 }
 
 } // namespace koheron
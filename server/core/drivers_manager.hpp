@@ -8,10 +8,14 @@
 #include "config.hpp"
 
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <cassert>
 #include <thread>
 #include <mutex>
+#include <string>
+#include <vector>
 #include "driver.hpp"
 #include <drivers.hpp>
 #include <drivers_table.hpp>
@@ -50,6 +54,13 @@ class DriverContainer
 class Server;
 struct Command;
 
+/// Startup of a driver (times in us since the start of DriverManager::init)
+struct DriverStartup
+{
+    uint64_t start_us = 0;
+    uint64_t duration_us = 0;
+};
+
 class DriverManager
 {
   public:
@@ -58,26 +69,97 @@ class DriverManager
     int init();
     int execute(Command &cmd);
 
+    /// Index of the statistics of an operation (see operation_stats.hpp):
+    /// the operations of the drivers, then the ones of KServer.
+    /// Returns the number of operations if the operation doesn't exist.
+    static size_t operation_stats_index(driver_id driver, int32_t op);
+
     template<driver_id driver>
     auto& get() {
-        if (! std::get<driver - 2>(is_started)) {
+        if (! std::get<driver - 2>(is_started).load(std::memory_order_acquire)) {
             alloc_driver<driver>();
         }
         return driver_container.get<driver>();
     }
 
+    bool is_driver_started(driver_id driver) const {
+        return is_started[driver - 2].load(std::memory_order_acquire);
+    }
+
+    /// Only valid if the driver is started
+    const DriverStartup& get_driver_startup(driver_id driver) const {
+        return startup[driver - 2];
+    }
+
+    /// Time to start all the drivers (0 if started on first use)
+    uint64_t get_startup_duration_us() const {
+        return startup_duration_us;
+    }
+
+    /// State of the drivers handed over to the next server (see handover.hpp)
+    ///
+    /// A driver implementing
+    ///     void handover_save(std::vector<unsigned char>& state);
+    ///     void handover_restore(const std::vector<unsigned char>& state);
+    /// passes its state to the driver of the same name in the next server.
+    /// The entries are | name length (u16) | name | state size (u32) | state |
+    /// Returns the number of states saved.
+    uint32_t save_handover_state(std::vector<unsigned char>& bytes);
+    void restore_handover_state(const std::vector<unsigned char>& bytes, uint32_t n_states);
+
+    /// Stop the driver operations while the next server starts (see handover.hpp)
+    ///
+    /// Waits for the operations running on the drivers. The following
+    /// ones fail until resume(). Returns -1 if operations are still
+    /// running after timeout_ms.
+    int quiesce(int timeout_ms);
+    void resume();
+
   private:
+    using clock = std::chrono::steady_clock;
+
+    int execute_command(Command& cmd);
+    int execute_driver_operation(Command& cmd);
+
+    std::atomic<bool> quiesced{false};
+    std::atomic<uint32_t> running_operations{0};
+
     // Store drivers (except Server) as unique_ptr
     std::array<std::unique_ptr<DriverAbstract>, device_num - 2> device_list;
     Server *server;
     DriverContainer driver_container;
-    std::array<bool, device_num - 2> is_started;
-    std::recursive_mutex mutex;
+    std::array<std::atomic<bool>, device_num - 2> is_started;
+
+    // One lock per driver, so that independent drivers start concurrently.
+    // Recursive for the DriverContainer to detect circular dependencies.
+    std::array<std::recursive_mutex, device_num - 2> mutexes;
 
     Context ctx;
 
+    clock::time_point init_time;
+    std::array<DriverStartup, device_num - 2> startup;
+    uint64_t startup_duration_us = 0;
+
     template<std::size_t driver> void alloc_driver();
 
+    // Start all the drivers along the dependency graph
+    int start_drivers();
+
+    // Handover
+
+    template<driver_id driver>
+    uint32_t save_driver_state(std::vector<unsigned char>& bytes);
+
+    template<driver_id... drivers>
+    uint32_t save_drivers_state(std::vector<unsigned char>& bytes, std::index_sequence<drivers...>);
+
+    template<driver_id driver>
+    void restore_driver_state(const std::string& name, const std::vector<unsigned char>& state);
+
+    template<driver_id... drivers>
+    void restore_drivers_state(const std::string& name, const std::vector<unsigned char>& state,
+                               std::index_sequence<drivers...>);
+
     // Start
 
     template<driver_id... drivers>
@@ -90,19 +172,6 @@ class DriverManager
     template<driver_id dev0, driver_id... drivers>
     std::enable_if_t<0 < sizeof...(drivers) && 2 <= dev0, void>
     start_impl(driver_id driver);
-
-    // Execute
-
-    template<driver_id... drivers>
-    int execute_driver(DriverAbstract *dev_abs, Command& cmd, std::index_sequence<drivers...>);
-
-    template<driver_id dev0, driver_id... drivers>
-    std::enable_if_t<0 == sizeof...(drivers) && 2 <= dev0, int>
-    execute_driver_implementation(DriverAbstract *dev_abs, Command& cmd);
-
-    template<driver_id dev0, driver_id... drivers>
-    std::enable_if_t<0 < sizeof...(drivers) && 2 <= dev0, int>
-    execute_driver_implementation(DriverAbstract *dev_abs, Command& cmd);
 };
 
 } // namespace koheron
@@ -0,0 +1,404 @@
+/// Implementation of handover.hpp
+///
+/// (c) Koheron
+
+#include "handover.hpp"
+#include "server.hpp"
+
+#include <cstring>
+#include <cerrno>
+
+extern "C" {
+  #include <unistd.h>
+  #include <poll.h>
+  #include <sys/socket.h>
+  #include <sys/time.h>
+  #include <sys/uio.h>
+  #include <sys/un.h>
+}
+
+namespace koheron {
+
+constexpr size_t handover_header_size = 16;
+
+// Period of the exit_comm check of the handover thread
+constexpr int handover_poll_ms = 200;
+
+// Maximum time waiting for the other server at each step
+constexpr int handover_io_timeout_ms = 5000;
+
+static int handover_socket_address(struct sockaddr_un& addr)
+{
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if (strlen(config::handover_socket_path) >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+
+    strcpy(addr.sun_path, config::handover_socket_path);
+    return 0;
+}
+
+static void set_io_timeout(int fd, int timeout_ms = handover_io_timeout_ms)
+{
+    struct timeval tv{};
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+static int read_exact(int fd, unsigned char *buffer, size_t len)
+{
+    size_t bytes_read = 0;
+
+    while (bytes_read < len) {
+        const auto n = read(fd, buffer + bytes_read, len - bytes_read);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (n <= 0) {
+            return -1;
+        }
+
+        bytes_read += static_cast<size_t>(n);
+    }
+
+    return 0;
+}
+
+static int write_u32(int fd, uint32_t value)
+{
+    return write(fd, &value, sizeof(value)) == sizeof(value) ? 0 : -1;
+}
+
+static int read_u32(int fd, uint32_t& value)
+{
+    return read_exact(fd, reinterpret_cast<unsigned char *>(&value), sizeof(value));
+}
+
+//----------------------------------------------------------------------------
+// New server
+//----------------------------------------------------------------------------
+
+int Handover::receive()
+{
+    struct sockaddr_un addr;
+
+    if (handover_socket_address(addr) < 0) {
+        server->syslog.print<ERROR>("Handover: invalid socket path\n");
+        return -1;
+    }
+
+    const int comm_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if (comm_fd < 0) {
+        server->syslog.print<ERROR>("Handover: can't open socket\n");
+        return -1;
+    }
+
+    if (connect(comm_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) {
+        close(comm_fd);
+        return 0; // No server running
+    }
+
+    server->syslog.print<INFO>("Handover: taking over the running server ...\n");
+    set_io_timeout(comm_fd);
+
+    std::array<unsigned char, handover_header_size> header;
+    std::array<int, handover_sockets_num> received_fds;
+
+    union {
+        char buf[CMSG_SPACE(sizeof(received_fds))];
+        struct cmsghdr align;
+    } control;
+
+    std::memset(&control, 0, sizeof(control));
+
+    struct iovec iov;
+    iov.iov_base = header.data();
+    iov.iov_len = header.size();
+
+    struct msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    // The descriptors come with the header
+    if (write_u32(comm_fd, HANDOVER_REQUEST) < 0 ||
+        recvmsg(comm_fd, &msg, MSG_CMSG_CLOEXEC) != static_cast<ssize_t>(header.size())) {
+        server->syslog.print<ERROR>("Handover: no answer from the running server\n");
+        close(comm_fd);
+        return -1;
+    }
+
+    size_t n_fds = 0;
+
+    for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            n_fds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            std::memcpy(received_fds.data(), CMSG_DATA(cmsg), n_fds * sizeof(int));
+        }
+    }
+
+    uint32_t magic, mask, state_size;
+    std::memcpy(&magic, header.data(), 4);
+    std::memcpy(&mask, header.data() + 4, 4);
+    std::memcpy(&n_states, header.data() + 8, 4);
+    std::memcpy(&state_size, header.data() + 12, 4);
+
+    size_t n_expected = 0;
+
+    for (size_t i = 0; i < handover_sockets_num; i++) {
+        if (mask & (1U << i)) {
+            fds[i] = n_expected < n_fds ? received_fds[n_expected] : -1;
+            n_expected++;
+        }
+    }
+
+    state.resize(state_size);
+
+    if (magic != HANDOVER_MAGIC || n_fds != n_expected ||
+        read_exact(comm_fd, state.data(), state.size()) < 0) {
+        server->syslog.print<ERROR>("Handover: invalid answer from the running server\n");
+
+        for (size_t i = 0; i < n_fds; i++) {
+            close(received_fds[i]);
+        }
+
+        fds.fill(-1);
+        state.clear();
+        n_states = 0;
+        close(comm_fd);
+        return -1;
+    }
+
+    // The running server waits for the acknowledgement with its drivers stopped.
+    // If this server exits before, it resumes them.
+    previous_fd = comm_fd;
+    server->syslog.print<INFO>("Handover: %zu sockets and %u driver states received\n", n_fds, n_states);
+    return 1;
+}
+
+void Handover::acknowledge()
+{
+    if (previous_fd < 0) {
+        return;
+    }
+
+    server->driver_manager.restore_handover_state(state, n_states);
+    state.clear();
+
+    // From now on the running server stops accepting the connections
+    if (write_u32(previous_fd, HANDOVER_ACK) < 0) {
+        server->syslog.print<WARNING>("Handover: acknowledgement not sent\n");
+    }
+
+    close(previous_fd);
+    previous_fd = -1;
+}
+
+//----------------------------------------------------------------------------
+// Running server
+//----------------------------------------------------------------------------
+
+int Handover::init()
+{
+    struct sockaddr_un addr;
+
+    if (handover_socket_address(addr) < 0) {
+        server->syslog.print<ERROR>("Handover: invalid socket path\n");
+        return -1;
+    }
+
+    handover_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if (handover_fd < 0) {
+        server->syslog.print<ERROR>("Handover: can't open socket\n");
+        return -1;
+    }
+
+    // Replaces the socket of the previous server
+    unlink(addr.sun_path);
+
+    if (bind(handover_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0 ||
+        listen(handover_fd, 1) < 0) {
+        server->syslog.print<ERROR>("Handover: socket binding error\n");
+        close(handover_fd);
+        handover_fd = -1;
+        return -1;
+    }
+
+    return 0;
+}
+
+int Handover::start_worker()
+{
+    if (handover_fd >= 0) {
+        handover_thread = std::thread{&Handover::handover_loop, this};
+    }
+
+    return 0;
+}
+
+void Handover::shutdown()
+{
+    if (previous_fd >= 0) {
+        close(previous_fd);
+        previous_fd = -1;
+    }
+
+    if (handover_fd < 0) {
+        return;
+    }
+
+    // The handover thread exits on exit_comm
+    if (handover_thread.joinable()) {
+        handover_thread.join();
+    }
+
+    close(handover_fd);
+    handover_fd = -1;
+
+    // Once handed over, the socket path belongs to the next server
+    if (!done.load()) {
+        unlink(config::handover_socket_path);
+    }
+}
+
+void Handover::handover_loop()
+{
+    while (!server->exit_comm.load() && !done.load()) {
+        struct pollfd pfd{};
+        pfd.fd = handover_fd;
+        pfd.events = POLLIN;
+
+        if (poll(&pfd, 1, handover_poll_ms) <= 0) {
+            continue;
+        }
+
+        const int comm_fd = accept4(handover_fd, nullptr, nullptr, SOCK_CLOEXEC);
+
+        if (comm_fd < 0) {
+            continue;
+        }
+
+        // Only a server run by the same user takes over
+        struct ucred cred{};
+        socklen_t len = sizeof(cred);
+
+        if (getsockopt(comm_fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0 ||
+            (cred.uid != geteuid() && cred.uid != 0)) {
+            server->syslog.print<WARNING>("Handover: request from another user rejected\n");
+            close(comm_fd);
+            continue;
+        }
+
+        set_io_timeout(comm_fd);
+
+        if (send(comm_fd) == 0) {
+            done.store(true);
+        }
+
+        close(comm_fd);
+    }
+}
+
+int Handover::send(int comm_fd)
+{
+    uint32_t request, ack;
+
+    if (read_u32(comm_fd, request) < 0 || request != HANDOVER_REQUEST) {
+        server->syslog.print<WARNING>("Handover: invalid request\n");
+        return -1;
+    }
+
+    std::array<int, handover_sockets_num> sockets_fds = {
+        server->tcp_listener.listen_fd,
+        server->websock_listener.listen_fd,
+        server->unix_listener.listen_fd,
+        server->udp_channel.get_fd()
+    };
+
+    std::array<int, handover_sockets_num> sent_fds;
+    uint32_t mask = 0;
+    size_t n_fds = 0;
+
+    for (size_t i = 0; i < handover_sockets_num; i++) {
+        if (sockets_fds[i] >= 0) {
+            mask |= 1U << i;
+            sent_fds[n_fds++] = sockets_fds[i];
+        }
+    }
+
+    // A single server drives the hardware: the operations are rejected
+    // from now on, and the saved state is final.
+    if (server->driver_manager.quiesce(handover_io_timeout_ms) < 0) {
+        server->syslog.print<ERROR>("Handover: driver operations still running\n");
+        server->driver_manager.resume();
+        return -1;
+    }
+
+    std::vector<unsigned char> drivers_state;
+    const uint32_t n_drivers_states = server->driver_manager.save_handover_state(drivers_state);
+    const auto state_size = static_cast<uint32_t>(drivers_state.size());
+
+    std::array<unsigned char, handover_header_size> header;
+    std::memcpy(header.data(), &HANDOVER_MAGIC, 4);
+    std::memcpy(header.data() + 4, &mask, 4);
+    std::memcpy(header.data() + 8, &n_drivers_states, 4);
+    std::memcpy(header.data() + 12, &state_size, 4);
+
+    union {
+        char buf[CMSG_SPACE(sizeof(sent_fds))];
+        struct cmsghdr align;
+    } control;
+
+    std::memset(&control, 0, sizeof(control));
+
+    struct iovec iov[2];
+    iov[0].iov_base = header.data();
+    iov[0].iov_len = header.size();
+    iov[1].iov_base = drivers_state.data();
+    iov[1].iov_len = drivers_state.size();
+
+    struct msghdr msg{};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 1;
+
+    if (n_fds > 0) {
+        msg.msg_control = control.buf;
+        msg.msg_controllen = CMSG_SPACE(n_fds * sizeof(int));
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(n_fds * sizeof(int));
+        std::memcpy(CMSG_DATA(cmsg), sent_fds.data(), n_fds * sizeof(int));
+    }
+
+    if (sendmsg(comm_fd, &msg, MSG_NOSIGNAL) != static_cast<ssize_t>(header.size()) ||
+        (drivers_state.size() > 0 && writev_all(comm_fd, &iov[1], 1) <= 0)) {
+        server->syslog.print<ERROR>("Handover: failed to send the sockets\n");
+        server->driver_manager.resume();
+        return -1;
+    }
+
+    // The new server starts its drivers before taking over.
+    // Keep serving if it fails.
+    set_io_timeout(comm_fd, config::handover_init_timeout_ms);
+
+    if (read_u32(comm_fd, ack) < 0 || ack != HANDOVER_ACK) {
+        server->syslog.print<ERROR>("Handover: no acknowledgement from the new server\n");
+        server->driver_manager.resume();
+        return -1;
+    }
+
+    server->syslog.print<INFO>("Handover: sockets handed over to the new server\n");
+    return 0;
+}
+
+} // namespace koheron
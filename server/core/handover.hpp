@@ -0,0 +1,105 @@
+/// Zero-downtime restart
+///
+/// A server started while another one is running takes over its
+/// listening sockets through the Unix socket config::handover_socket_path,
+/// so that no connection is refused during the restart.
+///
+/// 1. The new server connects and sends HANDOVER_REQUEST.
+/// 2. The running server waits for the operations running on its drivers,
+///    and rejects the next ones (see DriverManager::quiesce), so that a
+///    single server drives the hardware.
+///    It answers with the header below. The listening
+///    sockets (TCP, WebSocket, Unix, UDP, in this order, only the ones
+///    set in the mask) are attached to it (SCM_RIGHTS).
+///    | HANDOVER_MAGIC | sockets mask | number of states | state size |
+///    |   0 ... 3      |   4 ... 7    |     8 ... 11     |  12 ... 15 |
+/// 3. The state of the drivers follows (see DriverManager::save_handover_state).
+/// 4. The new server starts its drivers (and configures the FPGA), restores
+///    the states, then answers HANDOVER_ACK and starts accepting the connections.
+/// 5. The running server stops accepting connections, closes its copy
+///    of the sockets without shutting them down, and exits once its sessions
+///    are closed (or after config::handover_drain_timeout_ms).
+///
+/// The running server resumes its drivers and keeps serving if the new one
+/// fails before step 4 (or doesn't answer within config::handover_init_timeout_ms).
+///
+/// (c) Koheron
+
+#ifndef __KOHERON_HANDOVER_HPP__
+#define __KOHERON_HANDOVER_HPP__
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace koheron {
+
+class Server;
+
+constexpr uint32_t HANDOVER_REQUEST = 0x4b484e31; // "KHN1"
+constexpr uint32_t HANDOVER_MAGIC = 0x4b484e32;
+constexpr uint32_t HANDOVER_ACK = 0x4b484e33;
+
+/// Sockets handed over
+enum HandoverSocket {
+    HANDOVER_TCP,
+    HANDOVER_WEBSOCK,
+    HANDOVER_UNIX,
+    HANDOVER_UDP,
+    handover_sockets_num
+};
+
+class Handover
+{
+  public:
+    Handover(Server *server_)
+    : server(server_)
+    {
+        fds.fill(-1);
+    }
+
+    /// Take over the sockets and the drivers state of the running server
+    /// (steps 1 to 3). Its drivers are stopped until acknowledge().
+    /// Returns 1 if handed over, 0 if no server is running, -1 on failure.
+    int receive();
+
+    /// Restore the drivers state and let the running server exit (step 4).
+    /// Called once the drivers are started.
+    void acknowledge();
+
+    /// Socket handed over by the previous server (-1 if none)
+    int get_fd(HandoverSocket socket) const {
+        return fds[socket];
+    }
+
+    /// Open the socket waiting for the next server
+    int init();
+
+    int start_worker();
+
+    /// True once the sockets are handed over to the next server
+    bool is_done() const {
+        return done.load();
+    }
+
+    void shutdown();
+
+  private:
+    Server *server;
+    int handover_fd = -1;
+    int previous_fd = -1; // Connection to the running server until acknowledge()
+    std::vector<unsigned char> state;
+    uint32_t n_states = 0;
+    std::thread handover_thread;
+    std::atomic<bool> done{false};
+    std::array<int, handover_sockets_num> fds;
+
+    void handover_loop();
+    int send(int comm_fd);
+};
+
+} // namespace koheron
+
+#endif // __KOHERON_HANDOVER_HPP__
@@ -0,0 +1,123 @@
+/// Scatter-gather buffers
+///
+/// (c) Koheron
+
+#ifndef __KOHERON_IOVEC_HPP__
+#define __KOHERON_IOVEC_HPP__
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+extern "C" {
+  #include <sys/uio.h>
+}
+
+namespace koheron {
+
+/// Serialized message as a list of memory segments
+///
+/// Headers, scalar packs and small payloads are copied into an inline buffer.
+/// Larger payloads are referenced in place, so the referenced data
+/// must stay alive until the buffer has been sent.
+class IovecBuffer
+{
+  public:
+    /// Payloads smaller than this are copied rather than referenced
+    static constexpr size_t min_reference_size = 1024;
+
+    void clear() {
+        data.clear();
+        segments.clear();
+        n_bytes = 0;
+    }
+
+    /// Copy bytes into the inline buffer
+    void append(const unsigned char *bytes, size_t len) {
+        if (len == 0) {
+            return;
+        }
+
+        if (segments.empty() || segments.back().ptr != nullptr) {
+            segments.push_back({nullptr, data.size(), 0});
+        }
+
+        data.insert(data.end(), bytes, bytes + len);
+        segments.back().len += len;
+        n_bytes += len;
+    }
+
+    /// Reference bytes in place (copied if small)
+    void reference(const unsigned char *bytes, size_t len) {
+        if (len < min_reference_size) {
+            append(bytes, len);
+            return;
+        }
+
+        segments.push_back({bytes, 0, len});
+        n_bytes += len;
+    }
+
+    /// Total number of bytes
+    size_t size() const {return n_bytes;}
+
+    /// Bytes allocated for the inline data and the segments
+    size_t memory_size() const {
+        return data.capacity() + segments.capacity() * sizeof(Segment)
+               + iov.capacity() * sizeof(struct iovec);
+    }
+
+    /// Append all the bytes to a contiguous buffer
+    void copy_to(std::vector<unsigned char>& bytes) const {
+        for (const auto& seg : segments) {
+            const unsigned char *base = seg.ptr == nullptr ? data.data() + seg.offset : seg.ptr;
+            bytes.insert(bytes.end(), base, base + seg.len);
+        }
+    }
+
+    /// The iovec list. Valid until the buffer is modified.
+    std::vector<struct iovec>& iovecs() {
+        iov.resize(segments.size());
+
+        for (size_t i = 0; i < segments.size(); i++) {
+            const auto& seg = segments[i];
+            const unsigned char *base = seg.ptr == nullptr ? data.data() + seg.offset : seg.ptr;
+            iov[i].iov_base = const_cast<unsigned char*>(base);
+            iov[i].iov_len = seg.len;
+        }
+
+        return iov;
+    }
+
+  private:
+    struct Segment
+    {
+        const unsigned char *ptr; ///< Referenced data (nullptr for inline data)
+        size_t offset;            ///< Offset in the inline buffer
+        size_t len;
+    };
+
+    std::vector<unsigned char> data;
+    std::vector<Segment> segments;
+    std::vector<struct iovec> iov;
+    size_t n_bytes = 0;
+};
+
+/// Skip n_bytes already sent at the beginning of an iovec list
+inline void advance_iovecs(struct iovec *&iov, size_t& iovcnt, size_t n_bytes)
+{
+    while (iovcnt > 0 && n_bytes >= iov->iov_len) {
+        n_bytes -= iov->iov_len;
+        iov++;
+        iovcnt--;
+    }
+
+    if (iovcnt > 0) {
+        iov->iov_base = static_cast<unsigned char*>(iov->iov_base) + n_bytes;
+        iov->iov_len -= n_bytes;
+    }
+}
+
+} // namespace koheron
+
+#endif // __KOHERON_IOVEC_HPP__
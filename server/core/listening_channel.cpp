@@ -129,7 +129,7 @@ int ListeningChannel<TCP>::init()
 template<>
 void ListeningChannel<TCP>::shutdown()
 {
-    if (config::tcp_worker_connections > 0) {
+    if (config::tcp_worker_connections > 0 && listen_fd >= 0) {
         server->syslog.print<INFO>("Closing TCP listener ...\n");
 
         if (::shutdown(listen_fd, SHUT_RDWR) < 0)
@@ -169,7 +169,7 @@ int ListeningChannel<WEBSOCK>::init()
 template<>
 void ListeningChannel<WEBSOCK>::shutdown()
 {
-    if (config::websocket_worker_connections > 0) {
+    if (config::websocket_worker_connections > 0 && listen_fd >= 0) {
         server->syslog.print<INFO>("Closing WebSocket listener ...\n");
 
         if (::shutdown(listen_fd, SHUT_RDWR) < 0)
@@ -235,7 +235,7 @@ int ListeningChannel<UNIX>::init()
 template<>
 void ListeningChannel<UNIX>::shutdown()
 {
-    if (config::unix_socket_worker_connections > 0) {
+    if (config::unix_socket_worker_connections > 0 && listen_fd >= 0) {
         server->syslog.print<INFO>("Closing Unix listener ...\n");
 
         if (::shutdown(listen_fd, SHUT_RDWR) < 0)
@@ -0,0 +1,138 @@
+/// Implementation of operation_stats.hpp
+///
+/// (c) Koheron
+
+#include "operation_stats.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace koheron {
+
+void LatencySummary::add(const LatencyHistogram& histogram)
+{
+    for (size_t i = 0; i < latency_buckets; i++) {
+        const auto n = histogram.counts[i].get();
+        counts[i] += n;
+        count += n;
+    }
+
+    sum_ns += histogram.sum_ns.get();
+}
+
+uint64_t LatencySummary::percentile(double q) const
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    const auto rank = std::max(uint64_t(1), static_cast<uint64_t>(std::ceil(q * static_cast<double>(count))));
+    uint64_t n = 0;
+
+    for (size_t i = 0; i < latency_buckets; i++) {
+        n += counts[i];
+
+        if (n >= rank) {
+            return latency_bucket_max(i);
+        }
+    }
+
+    return max();
+}
+
+uint64_t LatencySummary::max() const
+{
+    for (size_t i = latency_buckets; i > 0; i--) {
+        if (counts[i - 1] > 0) {
+            return latency_bucket_max(i - 1);
+        }
+    }
+
+    return 0;
+}
+
+// Counters of the thread, registered on its first request
+struct ThreadOperationStats
+{
+    const OperationStats *owner = nullptr;
+    std::shared_ptr<OperationStats::ThreadStats> stats;
+};
+
+static thread_local ThreadOperationStats thread_operation_stats;
+
+OperationStats::ThreadStats& OperationStats::thread_stats()
+{
+    auto& local = thread_operation_stats;
+
+    if (local.owner != this) {
+        local.stats = std::make_shared<ThreadStats>(n_operations);
+        local.owner = this;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        threads.push_back(local.stats);
+    }
+
+    return *local.stats;
+}
+
+void OperationStats::record(size_t operation, int socket_type, uint64_t duration_ns)
+{
+    auto& stats = thread_stats();
+    auto counters = stats.operations[operation].load(std::memory_order_acquire);
+
+    if (counters == nullptr) {
+        counters = new OperationCounters();
+        stats.operations[operation].store(counters, std::memory_order_release);
+    }
+
+    const auto& timing = operation_timing;
+    const auto waited_ns = timing.lock_ns + timing.send_ns;
+
+    counters->requests.add(1);
+    counters->bytes_received.add(timing.bytes_received);
+    counters->bytes_sent.add(timing.bytes_sent);
+    counters->lock.record(timing.lock_ns);
+    counters->exec.record(duration_ns > waited_ns ? duration_ns - waited_ns : 0);
+    counters->send.record(timing.send_ns);
+
+    if (socket_type >= 0 && socket_type < socket_type_num) {
+        stats.requests[static_cast<size_t>(socket_type)].add(1);
+    }
+}
+
+OperationSummary OperationStats::get_summary(size_t operation)
+{
+    OperationSummary summary;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto& stats : threads) {
+        const auto counters = stats->operations[operation].load(std::memory_order_acquire);
+
+        if (counters == nullptr) {
+            continue;
+        }
+
+        summary.requests += counters->requests.get();
+        summary.bytes_received += counters->bytes_received.get();
+        summary.bytes_sent += counters->bytes_sent.get();
+        summary.lock.add(counters->lock);
+        summary.exec.add(counters->exec);
+        summary.send.add(counters->send);
+    }
+
+    return summary;
+}
+
+uint64_t OperationStats::get_requests(int socket_type)
+{
+    uint64_t requests = 0;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto& stats : threads) {
+        requests += stats->requests[static_cast<size_t>(socket_type)].get();
+    }
+
+    return requests;
+}
+
+} // namespace koheron
@@ -0,0 +1,232 @@
+/// Per-operation latency statistics
+///
+/// Each operation (driver, op) has three latency histograms:
+/// - lock: waiting for the lock of the driver,
+/// - exec: executing the operation (arguments reception and driver call),
+/// - send: serializing and sending the response,
+/// and counts the requests and the bytes received and sent.
+///
+/// The histograms are HDR-style: each power of two is divided in
+/// latency_sub_buckets buckets, so the relative error of the
+/// percentiles is below 1 / latency_sub_buckets.
+///
+/// Each thread records in its own counters (no lock, no atomic
+/// read-modify-write). The counters are summed when the statistics are read.
+///
+/// (c) Koheron
+
+#ifndef __KOHERON_OPERATION_STATS_HPP__
+#define __KOHERON_OPERATION_STATS_HPP__
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "config.hpp"
+#include "server_definitions.hpp"
+
+namespace koheron {
+
+constexpr uint32_t latency_sub_bucket_bits = 3;
+constexpr uint32_t latency_sub_buckets = 1U << latency_sub_bucket_bits;
+
+/// Latencies above 2^latency_max_exponent ns (about 69 s) are counted in the last bucket
+constexpr uint32_t latency_max_exponent = 36;
+constexpr size_t latency_buckets = (latency_max_exponent - latency_sub_bucket_bits + 1) * latency_sub_buckets;
+
+inline uint64_t stats_clock_ns()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+inline size_t latency_bucket(uint64_t ns)
+{
+    if (ns < latency_sub_buckets) {
+        return ns;
+    }
+
+    const uint32_t exponent = 63 - static_cast<uint32_t>(__builtin_clzll(ns));
+
+    if (exponent >= latency_max_exponent) {
+        return latency_buckets - 1;
+    }
+
+    const uint32_t shift = exponent - latency_sub_bucket_bits;
+    return (shift + 1) * latency_sub_buckets + ((ns >> shift) - latency_sub_buckets);
+}
+
+/// Largest latency counted in a bucket
+inline uint64_t latency_bucket_max(size_t bucket)
+{
+    if (bucket < latency_sub_buckets) {
+        return bucket;
+    }
+
+    const uint64_t shift = bucket / latency_sub_buckets - 1;
+    const uint64_t lower = (latency_sub_buckets + bucket % latency_sub_buckets) << shift;
+    return lower + (uint64_t(1) << shift) - 1;
+}
+
+/// Counter written by a single thread, read by any
+struct StatsCounter
+{
+    std::atomic<uint64_t> value{0};
+
+    void add(uint64_t n) {
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    uint64_t get() const {
+        return value.load(std::memory_order_relaxed);
+    }
+};
+
+struct LatencyHistogram
+{
+    std::array<StatsCounter, latency_buckets> counts;
+    StatsCounter sum_ns;
+
+    void record(uint64_t ns) {
+        counts[latency_bucket(ns)].add(1);
+        sum_ns.add(ns);
+    }
+};
+
+/// Counters of an operation on one thread
+struct OperationCounters
+{
+    StatsCounter requests;
+    StatsCounter bytes_received;
+    StatsCounter bytes_sent;
+    LatencyHistogram lock;
+    LatencyHistogram exec;
+    LatencyHistogram send;
+};
+
+/// Sum of the latencies of an operation on all the threads
+struct LatencySummary
+{
+    std::array<uint64_t, latency_buckets> counts{};
+    uint64_t count = 0;
+    uint64_t sum_ns = 0;
+
+    void add(const LatencyHistogram& histogram);
+
+    /// Latency below which a fraction q of the requests are (upper bound)
+    uint64_t percentile(double q) const;
+    uint64_t max() const;
+    uint64_t mean() const {return count > 0 ? sum_ns / count : 0;}
+};
+
+struct OperationSummary
+{
+    uint64_t requests = 0;
+    uint64_t bytes_received = 0;
+    uint64_t bytes_sent = 0;
+    LatencySummary lock;
+    LatencySummary exec;
+    LatencySummary send;
+};
+
+/// Timing of the operation executed by the thread
+struct OperationTiming
+{
+    uint64_t lock_ns = 0;
+    uint64_t send_ns = 0;
+    uint64_t bytes_received = 0;
+    uint64_t bytes_sent = 0;
+
+    /// Start timing an operation.
+    /// Returns the timing of the enclosing operation (batch), if any.
+    /// The bytes of the command received until now belong to the new operation.
+    OperationTiming begin() {
+        auto outer = *this;
+        outer.bytes_received = 0;
+        lock_ns = 0;
+        send_ns = 0;
+        bytes_sent = 0;
+        return outer;
+    }
+
+    void end(const OperationTiming& outer) {
+        *this = outer;
+    }
+
+    void locked(uint64_t duration_ns) {
+        if constexpr (config::operation_stats) {
+            lock_ns += duration_ns;
+        }
+    }
+
+    void sent(uint64_t duration_ns, int64_t bytes) {
+        if constexpr (config::operation_stats) {
+            send_ns += duration_ns;
+            bytes_sent += bytes > 0 ? static_cast<uint64_t>(bytes) : 0;
+        }
+    }
+
+    void received(int64_t bytes) {
+        if constexpr (config::operation_stats) {
+            bytes_received += bytes > 0 ? static_cast<uint64_t>(bytes) : 0;
+        }
+    }
+};
+
+inline thread_local OperationTiming operation_timing;
+
+class OperationStats
+{
+  public:
+    explicit OperationStats(size_t n_operations_)
+    : n_operations(n_operations_)
+    {}
+
+    /// Record the operation executed by the calling thread
+    void record(size_t operation, int socket_type, uint64_t duration_ns);
+
+    OperationSummary get_summary(size_t operation);
+
+    /// Number of requests received by the sessions of a type
+    uint64_t get_requests(int socket_type);
+
+    size_t size() const {return n_operations;}
+
+    /// Counters of one thread
+    struct ThreadStats
+    {
+        explicit ThreadStats(size_t n_operations)
+        : operations(new std::atomic<OperationCounters*>[n_operations]())
+        , size(n_operations)
+        {}
+
+        ~ThreadStats() {
+            for (size_t i = 0; i < size; i++) {
+                delete operations[i].load();
+            }
+        }
+
+        // Allocated on the first request
+        std::unique_ptr<std::atomic<OperationCounters*>[]> operations;
+        size_t size;
+        std::array<StatsCounter, socket_type_num> requests;
+    };
+
+  private:
+    const size_t n_operations;
+
+    // The counters of the exited threads are kept
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadStats>> threads;
+
+    ThreadStats& thread_stats();
+};
+
+} // namespace koheron
+
+#endif // __KOHERON_OPERATION_STATS_HPP__
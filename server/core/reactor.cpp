@@ -0,0 +1,507 @@
+/// Implementation of reactor.hpp
+///
+/// (c) Koheron
+
+#include "reactor.hpp"
+#include "server.hpp"
+#include "session.hpp"
+#include "shm_transport.hpp"
+
+#include <climits>
+#include <chrono>
+
+extern "C" {
+  #include <fcntl.h>
+  #include <sys/epoll.h>
+  #include <sys/eventfd.h>
+  #include <sys/socket.h>
+  #include <unistd.h>
+}
+
+namespace koheron {
+
+int wait_socket(int fd, short events)
+{
+    struct pollfd pfd{};
+    pfd.fd = fd;
+    pfd.events = events;
+
+    while (true) {
+        const int n = poll(&pfd, 1, config::reactor_io_timeout_ms);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (n <= 0) {
+            return -1;
+        }
+
+        if (pfd.revents & (POLLERR | POLLNVAL)) {
+            return -1;
+        }
+
+        return 0;
+    }
+}
+
+int set_non_blocking(int fd)
+{
+    const int flags = fcntl(fd, F_GETFL, 0);
+
+    if (flags < 0) {
+        return -1;
+    }
+
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+int64_t writev_all(int fd, struct iovec *iov, size_t iovcnt)
+{
+    int64_t bytes_send = 0;
+
+    while (iovcnt > 0) {
+        struct msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = std::min(iovcnt, static_cast<size_t>(IOV_MAX));
+
+        const auto n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+
+        if (n == 0) {
+            return 0;
+        }
+
+        if (n < 0) {
+            if (would_block(errno) && wait_socket(fd, POLLOUT) == 0) {
+                continue;
+            }
+
+            return -1;
+        }
+
+        bytes_send += n;
+        advance_iovecs(iov, iovcnt, static_cast<size_t>(n));
+    }
+
+    return bytes_send;
+}
+
+PendingOutput::~PendingOutput()
+{
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+int64_t PendingOutput::send(struct iovec *iov, size_t iovcnt, int fd_)
+{
+    if (closed) {
+        return -1;
+    }
+
+    int64_t bytes = 0;
+
+    for (size_t i = 0; i < iovcnt; i++) {
+        bytes += static_cast<int64_t>(iov[i].iov_len);
+    }
+
+    // Written after the bytes already queued
+    if (empty()) {
+        while (iovcnt > 0) {
+            int64_t n;
+
+            if (fd_ >= 0) {
+                n = sendmsg_with_fd(comm_fd, iov, iovcnt, fd_, MSG_DONTWAIT);
+            } else {
+                struct msghdr msg{};
+                msg.msg_iov = iov;
+                msg.msg_iovlen = std::min(iovcnt, static_cast<size_t>(IOV_MAX));
+                n = sendmsg(comm_fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+            }
+
+            if (n < 0) {
+                if (would_block(errno)) {
+                    break;
+                }
+
+                return -1;
+            }
+
+            fd_ = -1;
+            advance_iovecs(iov, iovcnt, static_cast<size_t>(n));
+        }
+    }
+
+    if (iovcnt > 0 && queue(iov, iovcnt, fd_) < 0) {
+        return -1;
+    }
+
+    return bytes;
+}
+
+int PendingOutput::queue(const struct iovec *iov, size_t iovcnt, int fd_)
+{
+    const bool was_empty = empty();
+
+    if (fd_ >= 0) {
+        // A single descriptor is passed at a time (shared memory)
+        if (fd >= 0) {
+            return -1;
+        }
+
+        fd = dup(fd_);
+
+        if (fd < 0) {
+            return -1;
+        }
+
+        fd_offset = data.size();
+    }
+
+    for (size_t i = 0; i < iovcnt; i++) {
+        const auto base = static_cast<const unsigned char*>(iov[i].iov_base);
+        data.insert(data.end(), base, base + iov[i].iov_len);
+    }
+
+    if (was_empty) {
+        return watch(EPOLLOUT | EPOLLRDHUP);
+    }
+
+    return 0;
+}
+
+int PendingOutput::drain()
+{
+    while (!empty()) {
+        int64_t n;
+
+        if (fd >= 0 && head == fd_offset) {
+            struct iovec iov;
+            iov.iov_base = data.data() + head;
+            iov.iov_len = size();
+            n = sendmsg_with_fd(comm_fd, &iov, 1, fd, MSG_DONTWAIT);
+
+            if (n > 0) {
+                ::close(fd);
+                fd = -1;
+            }
+        } else {
+            const size_t end = fd >= 0 ? fd_offset : data.size();
+            n = ::send(comm_fd, data.data() + head, end - head, MSG_NOSIGNAL | MSG_DONTWAIT);
+        }
+
+        if (n < 0) {
+            if (would_block(errno)) {
+                return 0;
+            }
+
+            close();
+            return -1;
+        }
+
+        head += static_cast<size_t>(n);
+    }
+
+    // The queue only grows when the client doesn't keep up
+    data.clear();
+    data.shrink_to_fit();
+    head = 0;
+    drained.notify_all();
+    return watch(EPOLLIN | EPOLLRDHUP) < 0 ? -1 : 1;
+}
+
+int PendingOutput::wait_drained(std::unique_lock<std::mutex>& lock)
+{
+    const auto timeout = std::chrono::milliseconds(config::reactor_io_timeout_ms);
+
+    if (!drained.wait_for(lock, timeout, [this] {return empty() || closed;})) {
+        return -1;
+    }
+
+    return closed ? -1 : 0;
+}
+
+void PendingOutput::close()
+{
+    closed = true;
+    drained.notify_all();
+}
+
+int PendingOutput::watch(uint32_t events)
+{
+    struct epoll_event ev{};
+    ev.events = events;
+    ev.data.u64 = event_data;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_MOD, comm_fd, &ev);
+}
+
+// The session ID and the socket file descriptor are
+// both stored in the 64 bits epoll user data.
+
+static uint64_t pack_event_data(SessionID sid, int comm_fd)
+{
+    return (static_cast<uint64_t>(static_cast<uint32_t>(comm_fd)) << 32)
+           + static_cast<uint32_t>(sid);
+}
+
+static SessionID event_session_id(uint64_t data)
+{
+    return static_cast<SessionID>(data & 0xFFFFFFFF);
+}
+
+static int event_comm_fd(uint64_t data)
+{
+    return static_cast<int>(data >> 32);
+}
+
+Reactor::Reactor(Server *server_)
+: server(server_)
+{}
+
+Reactor::~Reactor()
+{
+    stop();
+}
+
+int Reactor::start()
+{
+    const auto n_loops = std::max(1U, config::reactor_threads);
+
+    for (unsigned int i = 0; i < n_loops; i++) {
+        auto loop = std::make_unique<EventLoop>();
+        loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+        if (loop->epoll_fd < 0) {
+            server->syslog.print<PANIC>("Reactor: Cannot create epoll instance\n");
+            return -1;
+        }
+
+        loop->wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        if (loop->wakeup_fd < 0) {
+            server->syslog.print<PANIC>("Reactor: Cannot create wake up event\n");
+            close(loop->epoll_fd);
+            return -1;
+        }
+
+        struct epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = pack_event_data(-1, loop->wakeup_fd);
+
+        if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->wakeup_fd, &ev) < 0) {
+            server->syslog.print<PANIC>("Reactor: Cannot register wake up event\n");
+            close(loop->wakeup_fd);
+            close(loop->epoll_fd);
+            return -1;
+        }
+
+        loops.push_back(std::move(loop));
+    }
+
+    running = true;
+
+    for (auto& loop : loops) {
+        loop->thread = std::thread{&Reactor::run_loop, this, loop.get()};
+    }
+
+    server->syslog.print<INFO>("Reactor: %u event loops started\n", loops.size());
+    return 0;
+}
+
+void Reactor::stop()
+{
+    if (!running.exchange(false)) {
+        return;
+    }
+
+    const uint64_t one = 1;
+
+    for (auto& loop : loops) {
+        if (write(loop->wakeup_fd, &one, sizeof(one)) < 0) {
+            server->syslog.print<WARNING>("Reactor: Cannot wake up event loop\n");
+        }
+    }
+
+    for (auto& loop : loops) {
+        if (loop->thread.joinable()) {
+            loop->thread.join();
+        }
+
+        close(loop->wakeup_fd);
+        close(loop->epoll_fd);
+    }
+
+    loops.clear();
+}
+
+int Reactor::add_session(SessionID sid, int comm_fd)
+{
+    if (!running) {
+        return -1;
+    }
+
+    if (set_non_blocking(comm_fd) < 0) {
+        server->syslog.print<ERROR>("Reactor: Cannot set session %u socket non-blocking\n", sid);
+        return -1;
+    }
+
+    auto& loop = loops[next_loop++ % loops.size()];
+
+    struct epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.u64 = pack_event_data(sid, comm_fd);
+
+    // Before the first event
+    attach_session(sid, loop->epoll_fd, ev.data.u64);
+
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, comm_fd, &ev) < 0) {
+        server->syslog.print<ERROR>("Reactor: Cannot register session %u\n", sid);
+        return -1;
+    }
+
+    return 0;
+}
+
+void Reactor::run_loop(EventLoop *loop)
+{
+    constexpr int max_events = 32;
+    std::array<struct epoll_event, max_events> events;
+
+    while (running) {
+        const int n_events = epoll_wait(loop->epoll_fd, events.data(), max_events, -1);
+
+        if (n_events < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            server->syslog.print<CRITICAL>("Reactor: epoll_wait failed\n");
+            break;
+        }
+
+        for (int i = 0; i < n_events; i++) {
+            const auto data = events[i].data.u64;
+            const int comm_fd = event_comm_fd(data);
+
+            if (comm_fd == loop->wakeup_fd) {
+                continue;
+            }
+
+            const SessionID sid = event_session_id(data);
+
+            // The socket is writable: the queued responses are written,
+            // then the commands received in the meantime are executed.
+            if (events[i].events & EPOLLOUT) {
+                const int err = process_output(sid);
+
+                if (err < 0 || (err > 0 && process_session(sid) < 0)) {
+                    close_session(loop, sid, comm_fd);
+                }
+
+                continue;
+            }
+
+            // Pending data are processed before handling a hang up
+            // so that the last commands sent by a client are executed.
+            if (events[i].events & EPOLLIN) {
+                if (process_session(sid) < 0) {
+                    close_session(loop, sid, comm_fd);
+                    continue;
+                }
+            } else if (events[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+                close_session(loop, sid, comm_fd);
+            }
+        }
+    }
+}
+
+void Reactor::attach_session(SessionID sid, int epoll_fd, uint64_t event_data)
+{
+    auto& session = server->session_manager.get_session(sid);
+
+    switch (session.type) {
+      case TCP:
+        static_cast<Session<TCP>*>(&session)->attach_output(epoll_fd, event_data);
+        break;
+      case UNIX:
+        static_cast<Session<UNIX>*>(&session)->attach_output(epoll_fd, event_data);
+        break;
+      case WEBSOCK:
+        static_cast<Session<WEBSOCK>*>(&session)->attach_output(epoll_fd, event_data);
+        break;
+      default:
+        break;
+    }
+}
+
+int Reactor::process_session(SessionID sid)
+{
+    auto& session = server->session_manager.get_session(sid);
+
+    switch (session.type) {
+      case TCP:
+        return static_cast<Session<TCP>*>(&session)->process_event();
+      case UNIX:
+        return static_cast<Session<UNIX>*>(&session)->process_event();
+      case WEBSOCK:
+        return static_cast<Session<WEBSOCK>*>(&session)->process_event();
+      default:
+        return -1;
+    }
+}
+
+int Reactor::process_output(SessionID sid)
+{
+    auto& session = server->session_manager.get_session(sid);
+
+    switch (session.type) {
+      case TCP:
+        return static_cast<Session<TCP>*>(&session)->process_output();
+      case UNIX:
+        return static_cast<Session<UNIX>*>(&session)->process_output();
+      case WEBSOCK:
+        return static_cast<Session<WEBSOCK>*>(&session)->process_output();
+      default:
+        return -1;
+    }
+}
+
+void Reactor::close_session(EventLoop *loop, SessionID sid, int comm_fd)
+{
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, comm_fd, nullptr) < 0) {
+        server->syslog.print<WARNING>("Reactor: Cannot unregister session %u\n", sid);
+    }
+
+    auto& session = server->session_manager.get_session(sid);
+
+    // The delivery threads waiting for the socket to drain give up
+    switch (session.type) {
+      case TCP:
+        static_cast<Session<TCP>*>(&session)->close_output();
+        break;
+      case UNIX:
+        static_cast<Session<UNIX>*>(&session)->close_output();
+        break;
+      case WEBSOCK:
+        static_cast<Session<WEBSOCK>*>(&session)->close_output();
+        break;
+      default:
+        break;
+    }
+
+    switch (session.type) {
+      case TCP:
+        reactor_session_exit(sid, &server->tcp_listener);
+        break;
+      case UNIX:
+        reactor_session_exit(sid, &server->unix_listener);
+        break;
+      case WEBSOCK:
+        reactor_session_exit(sid, &server->websock_listener);
+        break;
+      default:
+        server->session_manager.delete_session(sid);
+    }
+}
+
+} // namespace koheron
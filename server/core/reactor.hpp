@@ -0,0 +1,161 @@
+/// Event-driven sessions scheduler
+///
+/// In reactor mode (see config::session_model) the sessions
+/// are not run on a dedicated thread. Their sockets are set
+/// non-blocking and multiplexed on a fixed number of epoll
+/// event loops. Each session is attached to a single loop,
+/// which reads and executes its commands when data are available.
+///
+/// The event loops never wait on a socket: a partially received
+/// command is parsed again once the rest is received, and the
+/// responses the socket doesn't accept are queued until it is
+/// writable (see PendingOutput).
+///
+/// (c) Koheron
+
+#ifndef __KOHERON_REACTOR_HPP__
+#define __KOHERON_REACTOR_HPP__
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <cerrno>
+#include <cstdint>
+
+extern "C" {
+  #include <poll.h>
+}
+
+#include "server_definitions.hpp"
+#include "config.hpp"
+#include "iovec.hpp"
+
+namespace koheron {
+
+class Server;
+
+/// Wait until the socket is ready for the requested poll events.
+///
+/// Used by the blocking writes when a write returns EAGAIN
+/// in the middle of a message (not by the reactor sessions).
+/// Returns 0 when ready, -1 on error or time out.
+int wait_socket(int fd, short events);
+
+/// Set a socket in non-blocking mode
+int set_non_blocking(int fd);
+
+/// Send a list of buffers with sendmsg, looping on partial writes.
+/// The iovec list is modified.
+/// Returns the number of bytes sent, 0 if the connection is closed, -1 on error.
+int64_t writev_all(int fd, struct iovec *iov, size_t iovcnt);
+
+/// True if a failed read or write on a non-blocking socket must be retried
+inline bool would_block(int err) {
+    return err == EAGAIN || err == EINTR; // EWOULDBLOCK == EAGAIN on Linux
+}
+
+/// Output of a reactor session
+///
+/// The sends never block: the bytes the socket doesn't accept are
+/// queued, and the event loop waits for the socket to be writable
+/// (EPOLLOUT instead of EPOLLIN) before writing them. The commands
+/// received in the meantime are executed once the queue is drained.
+///
+/// Not thread safe: the caller serializes the sends of the session.
+class PendingOutput
+{
+  public:
+    PendingOutput() = default;
+
+    ~PendingOutput();
+
+    /// Set when the session is attached to an event loop
+    void attach(int epoll_fd_, int comm_fd_, uint64_t event_data_) {
+        epoll_fd = epoll_fd_;
+        comm_fd = comm_fd_;
+        event_data = event_data_;
+    }
+
+    bool empty() const {return head == data.size();}
+
+    /// Number of bytes queued
+    size_t size() const {return data.size() - head;}
+
+    /// Bytes of the queue
+    size_t memory_size() const {return data.capacity();}
+
+    /// Send without blocking, the bytes not written are queued.
+    /// A file descriptor fd >= 0 is passed with the first byte (SCM_RIGHTS).
+    /// The iovec list is modified.
+    /// Returns the number of bytes sent or queued, -1 on error.
+    int64_t send(struct iovec *iov, size_t iovcnt, int fd_ = -1);
+
+    /// Write the queued bytes (the socket is writable).
+    /// Returns 1 once the queue is drained, 0 if bytes remain, -1 on error.
+    int drain();
+
+    /// Wait until the queue is drained (called by the delivery threads).
+    /// lock holds the mutex serializing the sends.
+    /// Returns -1 on time out (see config::reactor_io_timeout_ms) or once closed.
+    int wait_drained(std::unique_lock<std::mutex>& lock);
+
+    /// Wake up the waiting threads, the session is closed
+    void close();
+
+  private:
+    int epoll_fd = -1;
+    int comm_fd = -1;
+    uint64_t event_data = 0;
+
+    std::vector<unsigned char> data;
+    size_t head = 0;       ///< Next byte to write
+    int fd = -1;           ///< Descriptor passed with the byte at fd_offset
+    size_t fd_offset = 0;
+    bool closed = false;
+    std::condition_variable drained;
+
+    int queue(const struct iovec *iov, size_t iovcnt, int fd_);
+    int watch(uint32_t events);
+};
+
+class Reactor
+{
+  public:
+    explicit Reactor(Server *server_);
+
+    ~Reactor();
+
+    int start();
+    void stop();
+
+    /// Attach a session to an event loop
+    int add_session(SessionID sid, int comm_fd);
+
+    bool is_running() const {return running;}
+
+  private:
+    struct EventLoop
+    {
+        int epoll_fd = -1;
+        int wakeup_fd = -1;
+        std::thread thread;
+    };
+
+    Server *server;
+    std::vector<std::unique_ptr<EventLoop>> loops;
+    std::atomic<unsigned int> next_loop{0};
+    std::atomic<bool> running{false};
+
+    void run_loop(EventLoop *loop);
+    void attach_session(SessionID sid, int epoll_fd, uint64_t event_data);
+    int process_session(SessionID sid);
+    int process_output(SessionID sid);
+    void close_session(EventLoop *loop, SessionID sid, int comm_fd);
+};
+
+} // namespace koheron
+
+#endif // __KOHERON_REACTOR_HPP__
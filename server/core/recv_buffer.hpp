@@ -0,0 +1,184 @@
+/// Buffered socket reader
+///
+/// Each read from the socket fetches as many bytes as available
+/// (up to the buffer capacity), so that a single system call can
+/// receive several pipelined commands. The headers, scalar packs and
+/// small payloads are then copied straight out of the buffer.
+/// Reads larger than the buffer bypass it.
+///
+/// The buffer is borrowed from the shared buffer pool on the first read.
+///
+/// In reactor mode, the parsing of a command can be resumed: the bytes
+/// read after mark() stay in the buffer, and rewind() reads them again
+/// once the rest of a partially received command is available.
+///
+/// (c) Koheron
+
+#ifndef __KOHERON_RECV_BUFFER_HPP__
+#define __KOHERON_RECV_BUFFER_HPP__
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <cerrno>
+
+#include "buffer_pool.hpp"
+
+extern "C" {
+  #include <sys/socket.h>
+}
+
+namespace koheron {
+
+class RecvBuffer
+{
+  public:
+    RecvBuffer(BufferPool& pool_, size_t capacity_)
+    : pool(pool_)
+    , capacity(capacity_)
+    {}
+
+    void set_fd(int comm_fd) {fd = comm_fd;}
+
+    /// Number of received bytes not yet consumed
+    size_t available() const {return tail - head;}
+
+    /// Give the buffer back to the pool if it holds no data
+    void release_if_empty() {
+        if (available() == 0) {
+            buffer.release();
+            head = 0;
+            tail = 0;
+            mark_pos = 0;
+            marked = false;
+        }
+    }
+
+    void mark() {
+        mark_pos = head;
+        marked = true;
+    }
+
+    void unmark() {marked = false;}
+
+    void rewind() {head = mark_pos;}
+
+    /// Number of bytes consumed since the mark
+    size_t marked_size() const {return head - mark_pos;}
+
+    /// Received bytes not yet consumed (available() bytes)
+    const char* peek() const {return buffer.data() + head;}
+
+    void consume(size_t n) {head += std::min(n, available());}
+
+    /// Bytes of the buffer held
+    size_t memory_size() const {return buffer.size();}
+
+    /// Same return values than recv(2): at most len bytes are read,
+    /// 0 if the connection is closed, -1 on error (errno is set).
+    int64_t read(char *dst, size_t len, int flags = 0) {
+        if (available() == 0) {
+            if (len >= capacity) {
+                return ::recv(fd, dst, len, flags);
+            }
+
+            const auto n = fill(flags);
+
+            if (n <= 0) {
+                return n;
+            }
+        }
+
+        const auto n = std::min(len, available());
+        std::memcpy(dst, buffer.data() + head, n);
+        head += n;
+        return static_cast<int64_t>(n);
+    }
+
+    /// Read ahead the bytes available on the socket.
+    /// Same return values than recv(2).
+    int64_t fill(int flags = 0) {
+        prepare();
+
+        if (tail == buffer.size()) {
+            return static_cast<int64_t>(available());
+        }
+
+        const auto n = ::recv(fd, buffer.data() + tail, buffer.size() - tail, flags);
+
+        if (n > 0) {
+            tail += static_cast<size_t>(n);
+        }
+
+        return n;
+    }
+
+    /// Receive without blocking until n bytes are available. The buffer
+    /// grows up to max_capacity to hold a command larger than its capacity.
+    /// Returns the number of bytes available, 0 if the connection is closed,
+    /// -1 on error (errno is EAGAIN if less than n bytes were received,
+    /// EMSGSIZE if n bytes don't fit in max_capacity).
+    int64_t fill_nonblocking(size_t n, size_t max_capacity) {
+        while (available() < n) {
+            prepare();
+
+            if (tail == buffer.size()) {
+                const size_t used = tail - start();
+
+                if (buffer.size() >= max_capacity || n + used - available() > max_capacity) {
+                    errno = EMSGSIZE;
+                    return -1;
+                }
+
+                // Grow geometrically as the bytes arrive
+                auto larger = pool.acquire(std::min(2 * buffer.size(), max_capacity));
+                std::memcpy(larger.data(), buffer.data(), tail);
+                buffer = std::move(larger);
+            }
+
+            const auto n_rcv = ::recv(fd, buffer.data() + tail, buffer.size() - tail, MSG_DONTWAIT);
+
+            if (n_rcv <= 0) {
+                return n_rcv;
+            }
+
+            tail += static_cast<size_t>(n_rcv);
+        }
+
+        return static_cast<int64_t>(available());
+    }
+
+  private:
+    BufferPool& pool;
+    int fd = -1;
+    size_t capacity;
+    PoolBuffer buffer;
+    size_t head = 0;           ///< Next byte to consume
+    size_t tail = 0;           ///< End of the received bytes
+    size_t mark_pos = 0;       ///< Start of the command being parsed
+    bool marked = false;
+
+    /// First byte to keep in the buffer
+    size_t start() const {return marked ? mark_pos : head;}
+
+    /// Borrow the buffer and move the bytes to keep
+    /// (part of a command) to the front
+    void prepare() {
+        if (buffer.empty()) {
+            buffer = pool.acquire(capacity);
+        }
+
+        const size_t offset = start();
+
+        if (offset > 0) {
+            std::memmove(buffer.data(), buffer.data() + offset, tail - offset);
+            tail -= offset;
+            head -= offset;
+            mark_pos -= std::min(mark_pos, offset);
+        }
+    }
+};
+
+} // namespace koheron
+
+#endif // __KOHERON_RECV_BUFFER_HPP__
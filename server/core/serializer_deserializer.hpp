@@ -12,6 +12,8 @@
 #include <string>
 #include <complex>
 
+#include "iovec.hpp"
+
 namespace koheron {
 
 // http://stackoverflow.com/questions/17789928/whats-a-proper-way-of-type-punning-a-float-to-an-int-and-vice-versa
@@ -446,6 +448,27 @@ class DynamicSerializer {
     static_assert(!is_c_string_v<std::string>, "");
 
   private:
+    // Output buffers.
+    //
+    // A std::vector receives a copy of the whole message.
+    // An IovecBuffer references the container payloads in place.
+
+    static void append_bytes(std::vector<unsigned char>& buffer, const unsigned char *bytes, size_t len) {
+        buffer.insert(buffer.end(), bytes, bytes + len);
+    }
+
+    static void reference_bytes(std::vector<unsigned char>& buffer, const unsigned char *bytes, size_t len) {
+        append_bytes(buffer, bytes, len);
+    }
+
+    static void append_bytes(IovecBuffer& buffer, const unsigned char *bytes, size_t len) {
+        buffer.append(bytes, len);
+    }
+
+    static void reference_bytes(IovecBuffer& buffer, const unsigned char *bytes, size_t len) {
+        buffer.reference(bytes, len);
+    }
+
     // Scalars
 
     template<typename T>
@@ -454,55 +477,61 @@ class DynamicSerializer {
         scal_size += size_of<T>;
     }
 
-    void dump_scalar_pack(std::vector<unsigned char>& buffer) {
+    template<typename Buffer>
+    void dump_scalar_pack(Buffer& buffer) {
         if (scal_size > 0) {
-            buffer.reserve(buffer.size() + scal_size);
-            buffer.insert(buffer.end(), scal_data.data(), scal_data.data() + scal_size);
+            append_bytes(buffer, scal_data.data(), scal_size);
             scal_size = 0;
         }
     }
 
-    template<typename Tp0, typename... Tp>
+    template<typename Buffer, typename Tp0, typename... Tp>
     inline std::enable_if_t<0 == sizeof...(Tp) && (is_scalar_v<Tp0> || is_std_complex_v<Tp0>), void>
-    command_serializer(std::vector<unsigned char>&, Tp0&& t, Tp&&...) {
+    command_serializer(Buffer&, Tp0&& t, Tp&&...) {
         append(std::forward<Tp0>(t));
     }
 
-    template <typename Tp0, typename... Tp>
+    template <typename Buffer, typename Tp0, typename... Tp>
     inline std::enable_if_t<0 < sizeof...(Tp) && (is_scalar_v<Tp0> || is_std_complex_v<Tp0>), void>
-    command_serializer(std::vector<unsigned char>& buffer, Tp0&& t, Tp&&... args) {
+    command_serializer(Buffer& buffer, Tp0&& t, Tp&&... args) {
         append(std::forward<Tp0>(t));
         command_serializer(buffer, std::forward<Tp>(args)...);
     }
 
     // Dynamic containers (vector, string)
 
-    template<typename Container>
-    void dump_container_to_buffer(std::vector<unsigned char>& buffer,
-                                  const Container& container) {
+    template<typename Buffer, typename Container>
+    void dump_container_to_buffer(Buffer& buffer, const Container& container,
+                                  bool is_temporary = false) {
         static_assert(is_container_v<Container>, "");
 
         using T = typename Container::value_type;
         const uint32_t n_bytes = container.size() * sizeof(T);
-        buffer.resize(buffer.size() + size_of<uint32_t>);
-        koheron::append(buffer.data() + buffer.size() - size_of<uint32_t>, n_bytes);
+        std::array<unsigned char, size_of<uint32_t>> length;
+        koheron::append(length.data(), n_bytes);
+        append_bytes(buffer, length.data(), length.size());
 
         if (n_bytes > 0) {
             const auto bytes = reinterpret_cast<const unsigned char*>(container.data());
-            buffer.insert(buffer.end(), bytes, bytes + n_bytes);
+
+            if (is_temporary) {
+                append_bytes(buffer, bytes, n_bytes);
+            } else {
+                reference_bytes(buffer, bytes, n_bytes);
+            }
         }
     }
 
-    template<typename Tp0, typename... Tp>
+    template<typename Buffer, typename Tp0, typename... Tp>
     std::enable_if_t<0 == sizeof...(Tp) && is_container_v<std::remove_reference_t<Tp0>>, void>
-    command_serializer(std::vector<unsigned char>& buffer, Tp0&& t, Tp&&... args) {
+    command_serializer(Buffer& buffer, Tp0&& t, Tp&&... args) {
         dump_scalar_pack(buffer);
         dump_container_to_buffer(buffer, std::forward<Tp0>(t));
     }
 
-    template <typename Tp0, typename... Tp>
+    template <typename Buffer, typename Tp0, typename... Tp>
     std::enable_if_t<0 < sizeof...(Tp) && is_container_v<std::remove_reference_t<Tp0>>, void>
-    command_serializer(std::vector<unsigned char>& buffer, Tp0&& t, Tp&&... args) {
+    command_serializer(Buffer& buffer, Tp0&& t, Tp&&... args) {
         dump_scalar_pack(buffer);
         dump_container_to_buffer(buffer, std::forward<Tp0>(t));
         command_serializer(buffer, std::forward<Tp>(args)...);
@@ -510,28 +539,27 @@ class DynamicSerializer {
 
     // std::array
 
-    template<typename Array>
-    void dump_array_to_buffer(std::vector<unsigned char>& buffer,
-                                  const Array& arr) {
+    template<typename Buffer, typename Array>
+    void dump_array_to_buffer(Buffer& buffer, const Array& arr) {
         using T = typename Array::value_type;
         constexpr auto n_bytes = std::tuple_size<Array>::value * sizeof(T);
 
         if (n_bytes > 0) {
             const auto bytes = reinterpret_cast<const unsigned char*>(arr.data());
-            buffer.insert(buffer.end(), bytes, bytes + n_bytes);
+            reference_bytes(buffer, bytes, n_bytes);
         }
     }
 
-    template<typename Tp0, typename... Tp>
+    template<typename Buffer, typename Tp0, typename... Tp>
     std::enable_if_t<0 == sizeof...(Tp) && is_std_array_v<std::decay_t<Tp0>>, void>
-    command_serializer(std::vector<unsigned char>& buffer, Tp0&& t, Tp&&... args) {
+    command_serializer(Buffer& buffer, Tp0&& t, Tp&&... args) {
         dump_scalar_pack(buffer);
         dump_array_to_buffer(buffer, std::forward<Tp0>(t));
     }
 
-    template <typename Tp0, typename... Tp>
+    template <typename Buffer, typename Tp0, typename... Tp>
     std::enable_if_t<0 < sizeof...(Tp) && is_std_array_v<std::decay_t<Tp0>>, void>
-    command_serializer(std::vector<unsigned char>& buffer, Tp0&& t, Tp&&... args) {
+    command_serializer(Buffer& buffer, Tp0&& t, Tp&&... args) {
         dump_scalar_pack(buffer);
         dump_array_to_buffer(buffer, std::forward<Tp0>(t));
         command_serializer(buffer, std::forward<Tp>(args)...);
@@ -539,58 +567,61 @@ class DynamicSerializer {
 
     // C strings
 
-    template<typename Tp0, typename... Tp>
+    template<typename Buffer, typename Tp0, typename... Tp>
     std::enable_if_t<0 == sizeof...(Tp) && is_c_string_v<Tp0>, void>
-    command_serializer(std::vector<unsigned char>& buffer, Tp0&& t, Tp&&... args) {
+    command_serializer(Buffer& buffer, Tp0&& t, Tp&&... args) {
         dump_scalar_pack(buffer);
-        dump_container_to_buffer(buffer, std::string(std::forward<Tp0>(t)));
+        dump_container_to_buffer(buffer, std::string(std::forward<Tp0>(t)), true);
     }
 
-    template <typename Tp0, typename... Tp>
+    template <typename Buffer, typename Tp0, typename... Tp>
     std::enable_if_t<0 < sizeof...(Tp) && is_c_string_v<Tp0>, void>
-    command_serializer(std::vector<unsigned char>& buffer, Tp0&& t, Tp&&... args) {
+    command_serializer(Buffer& buffer, Tp0&& t, Tp&&... args) {
         dump_scalar_pack(buffer);
-        dump_container_to_buffer(buffer, std::string(std::forward<Tp0>(t)));
+        dump_container_to_buffer(buffer, std::string(std::forward<Tp0>(t)), true);
         command_serializer(buffer, std::forward<Tp>(args)...);
     }
 
     // Tuples are unpacked before serialization
 
-    template<uint16_t class_id, uint16_t func_id,
+    template<uint16_t class_id, uint16_t func_id, typename Buffer,
              std::size_t... I, typename... Args>
-    void call_command_serializer(std::vector<unsigned char>& buffer,
+    void call_command_serializer(Buffer& buffer,
                                  std::index_sequence<I...>,
-                                 std::tuple<Args...> tup_args) {
+                                 const std::tuple<Args...>& tup_args) {
         build_command<class_id, func_id>(buffer, std::get<I>(tup_args)...);
     }
 
   public:
-    template<uint16_t class_id, uint16_t func_id, typename Tp0, typename... Args>
+    // The buffer is either a std::vector<unsigned char> or an IovecBuffer.
+    // With an IovecBuffer, the arguments must outlive the sending of the buffer.
+
+    template<uint16_t class_id, uint16_t func_id, typename Buffer, typename Tp0, typename... Args>
     std::enable_if_t<0 <= sizeof...(Args) &&
                      !is_std_tuple_v<
-                         typename std::remove_reference<Tp0>::type
+                         std::decay_t<Tp0>
                      >, void>
-    build_command(std::vector<unsigned char>& buffer, Tp0&& arg0, Args&&... args) {
+    build_command(Buffer& buffer, Tp0&& arg0, Args&&... args) {
         const auto& header = serialize(0U, class_id, func_id);
-        buffer.resize(koheron::required_buffer_size<uint32_t, uint16_t, uint16_t>());
-        std::move(header.begin(), header.end(), buffer.begin());
+        buffer.clear();
+        append_bytes(buffer, header.data(), header.size());
         scal_size = 0;
         command_serializer(buffer, std::forward<Tp0>(arg0),
                            std::forward<Args>(args)...);
         dump_scalar_pack(buffer);
     }
 
-    template<uint16_t class_id, uint16_t func_id, typename... Args>
+    template<uint16_t class_id, uint16_t func_id, typename Buffer, typename... Args>
     std::enable_if_t< 0 == sizeof...(Args), void >
-    build_command(std::vector<unsigned char>& buffer, Args&&... args) {
+    build_command(Buffer& buffer, Args&&...) {
         const auto& header = serialize(0U, class_id, func_id);
-        buffer.resize(koheron::required_buffer_size<uint32_t, uint16_t, uint16_t>());
-        std::move(header.begin(), header.end(), buffer.begin());
+        buffer.clear();
+        append_bytes(buffer, header.data(), header.size());
     }
 
-    template<uint16_t class_id, uint16_t func_id, typename... Args>
-    void build_command(std::vector<unsigned char>& buffer,
-                       std::tuple<Args...> tup_args) {
+    template<uint16_t class_id, uint16_t func_id, typename Buffer, typename... Args>
+    void build_command(Buffer& buffer,
+                       const std::tuple<Args...>& tup_args) {
         call_command_serializer<class_id, func_id>(buffer,
                 std::index_sequence_for<Args...>{}, tup_args);
     }
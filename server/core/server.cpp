@@ -17,43 +17,80 @@ extern "C" {
 
 namespace koheron {
 
+// Listening socket handed over by the previous server, or a new one
+template<int socket_type>
+static int init_listener(ListeningChannel<socket_type>& listener, int handed_over_fd)
+{
+    return handed_over_fd >= 0 ? listener.init(handed_over_fd) : listener.init();
+}
+
 Server::Server()
 : signal_handler()
 , tcp_listener(this)
 , websock_listener(this)
 , unix_listener(this)
+, udp_channel(this)
+, handover(this)
+, stream_manager()
+, operation_stats(operations_num + server_op_num)
 , driver_manager(this)
 , syslog()
-, session_manager(driver_manager, syslog)
+, buffer_pool()
+, session_manager(driver_manager, syslog, buffer_pool, stream_manager)
+, reactor(this)
+, session_pool(this)
 {
+    exit_comm.store(false);
+    exit_all.store(false);
+
     if (signal_handler.init(this) < 0) {
         exit(EXIT_FAILURE);
     }
 
+    // Zero-downtime restart: take over the sockets of the running server.
+    // Its drivers are stopped before ours start.
+    if (config::handover && handover.receive() < 0) {
+        syslog.print<WARNING>("Handover failed, opening new sockets\n");
+    }
+
+    // The running server resumes its drivers if we exit here
     if (driver_manager.init() < 0) {
         exit(EXIT_FAILURE);
     }
 
-    exit_comm.store(false);
-    exit_all.store(false);
+    handover.acknowledge();
 
     if (config::tcp_worker_connections > 0) {
-        if (tcp_listener.init() < 0) {
+        if (init_listener(tcp_listener, handover.get_fd(HANDOVER_TCP)) < 0) {
             exit(EXIT_FAILURE);
         }
     }
 
     if (config::websocket_worker_connections > 0) {
-        if (websock_listener.init() < 0) {
+        if (init_listener(websock_listener, handover.get_fd(HANDOVER_WEBSOCK)) < 0) {
             exit(EXIT_FAILURE);
         }
     }
 
     if (config::unix_socket_worker_connections > 0) {
-        if (unix_listener.init() < 0) {
+        if (init_listener(unix_listener, handover.get_fd(HANDOVER_UNIX)) < 0) {
             exit(EXIT_FAILURE);
         }
     }
+
+    if (config::udp_port > 0) {
+        const int udp_fd = handover.get_fd(HANDOVER_UDP);
+
+        // The server runs without UDP streaming
+        if ((udp_fd >= 0 ? udp_channel.init(udp_fd) : udp_channel.init()) < 0) {
+            syslog.print<WARNING>("UDP streaming disabled\n");
+        }
+    }
+
+    // The server still runs if the next one can't take over
+    if (config::handover && handover.init() < 0) {
+        syslog.print<WARNING>("Zero-downtime restart not available\n");
+    }
 }
 
 // This cannot be done in the destructor
@@ -67,6 +104,21 @@ void Server::close_listeners()
     websock_listener.shutdown();
     unix_listener.shutdown();
     join_listeners_workers();
+    udp_channel.shutdown();
+    handover.shutdown();
+}
+
+// The sockets are used by the next server:
+// they are closed but not shut down.
+void Server::release_listeners()
+{
+    exit_comm.store(true);
+    tcp_listener.release();
+    websock_listener.release();
+    unix_listener.release();
+
+    // The UDP subscribers subscribe again to the next server
+    udp_channel.shutdown();
 }
 
 int Server::start_listeners_workers()
@@ -80,6 +132,12 @@ int Server::start_listeners_workers()
     if (unix_listener.start_worker() < 0) {
         return -1;
     }
+    if (udp_channel.start_worker() < 0) {
+        return -1;
+    }
+    if (handover.start_worker() < 0) {
+        return -1;
+    }
     return 0;
 }
 
@@ -165,10 +223,24 @@ int Server::run()
 {
     bool ready_notified = false;
 
+    if (config::session_model == config::SessionModel::REACTOR) {
+        if (reactor.start() < 0) {
+            return -1;
+        }
+    } else {
+        if (session_pool.start() < 0) {
+            return -1;
+        }
+    }
+
     if (start_listeners_workers() < 0) {
         return -1;
     }
 
+    // The server threads are started
+    signal_handler.unblock_trace_signal();
+    syslog.start_buffering();
+
     while (true) {
         if (!ready_notified && is_ready()) {
             syslog.print<INFO>("Koheron server ready\n");
@@ -178,8 +250,34 @@ int Server::run()
             ready_notified = true;
         }
 
-        if (signal_handler.interrupt() || exit_all) {
+        if (signal_handler.trace_requested()) {
+            if (trace::dump_to_file(config::trace::dump_path, config::trace::dump_seconds) < 0) {
+                syslog.print<ERROR>("Cannot write the trace in %s\n", config::trace::dump_path);
+            } else {
+                syslog.print<INFO>("Trace written in %s\n", config::trace::dump_path);
+            }
+        }
+
+        // The next server accepts the connections from now on
+        if (handover.is_done()) {
+            release_listeners();
+            syslog.print<INFO>("Draining sessions ...\n");
+
+            const auto deadline = std::chrono::steady_clock::now()
+                                + std::chrono::milliseconds(config::handover_drain_timeout_ms);
+
+            while (session_manager.get_number_of_sessions() > 0 && !signal_handler.interrupt()
+                   && std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            }
+        }
+
+        if (signal_handler.interrupt() || exit_all || handover.is_done()) {
             syslog.print<INFO>("Interrupt received, killing Koheron server ...\n");
+            reactor.stop();
+            session_pool.stop();
+            session_manager.shutdown_all();
+            session_pool.join();
             session_manager.delete_all();
             close_listeners();
             syslog.close();
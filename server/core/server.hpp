@@ -20,7 +20,20 @@
 #include "drivers_manager.hpp"
 #include "syslog.hpp"
 #include "signal_handler.hpp"
+#include "buffer_pool.hpp"
+#include "streams.hpp"
+#include "udp_channel.hpp"
+#include "handover.hpp"
+#include "operation_stats.hpp"
+#include "trace.hpp"
 #include "session_manager.hpp"
+#include "reactor.hpp"
+#include "session_pool.hpp"
+
+extern "C" {
+  #include <poll.h>
+  #include <unistd.h>
+}
 
 namespace koheron {
 
@@ -34,7 +47,13 @@ struct ListenerStats
 {
     int number_of_opened_sessions = 0; ///< Number of currently opened sessions
     int total_sessions_num = 0;  ///< Total number of sessions
-    int total_number_of_requests = 0;  ///< Total number of requests
+    uint64_t total_number_of_requests = 0;  ///< Total number of requests (updated by get_stats)
+    int number_of_queued_sessions = 0; ///< Connections waiting for a worker
+
+    // Sessions worker pool (shared by all the listeners)
+    int pool_workers = 0;       ///< Number of workers
+    int pool_busy_workers = 0;  ///< Number of workers running a session
+    int pool_queue_depth = 0;   ///< Number of connections in the admission queue
 };
 
 /// Implementation in listening_channel.cpp
@@ -53,6 +72,18 @@ class ListeningChannel
     int init();
     void shutdown();
 
+    /// Use a listening socket handed over by the previous server
+    int init(int handed_over_fd) {
+        number_of_threads = 0;
+        listen_fd = handed_over_fd;
+        return listen_fd;
+    }
+
+    /// Stop accepting connections without shutting down the
+    /// socket, which is used by the next server (see handover.hpp).
+    /// The listening thread exits on exit_comm.
+    void release();
+
     /// True if the maximum of threads set by the config is reached
     bool is_max_threads();
 
@@ -80,11 +111,22 @@ class ListeningChannel
 template<int socket_type>
 void ListeningChannel<socket_type>::join_worker()
 {
-    if (listen_fd >= 0) {
+    if (comm_thread.joinable()) {
         comm_thread.join();
     }
 }
 
+template<int socket_type>
+void ListeningChannel<socket_type>::release()
+{
+    join_worker();
+
+    if (listen_fd >= 0) {
+        close(listen_fd);
+        listen_fd = -1;
+    }
+}
+
  ////////////////////////////////////////////////////////////////////////////
 /////// Server
 
@@ -102,6 +144,15 @@ class Server
     enum Operation {
         GET_VERSION = 0,            ///< Send th version of the server
         GET_CMDS = 1,               ///< Send the commands numbers
+        BATCH = 2,                  ///< Execute a list of commands and send all the responses at once
+        GET_MEMORY_REPORT = 3,      ///< Send the buffers memory usage (JSON)
+        SET_COMPRESSION = 4,        ///< Negotiate the compression of the responses
+        SUBSCRIBE = 5,              ///< Push the frames of an operation stream to the session
+        UNSUBSCRIBE = 6,            ///< Stop pushing the frames of an operation stream
+        OPEN_SHARED_MEMORY = 7,     ///< Map a memory region shared with a local client
+        GET_STARTUP_REPORT = 8,     ///< Send the startup time of the drivers (JSON)
+        GET_STATS = 9,              ///< Send the latency statistics of the operations (JSON)
+        GET_TRACE = 10,             ///< Send the trace events of the last seconds (Chrome trace-event JSON)
         server_op_num
     };
 
@@ -114,14 +165,25 @@ class Server
     ListeningChannel<TCP> tcp_listener;
     ListeningChannel<WEBSOCK> websock_listener;
     ListeningChannel<UNIX> unix_listener;
+    UdpChannel udp_channel;
+
+    Handover handover;
 
     /// True when all listeners are ready
     bool is_ready();
 
     // Managers
+
+    // Constructed before the drivers: their
+    // acquisition threads publish as soon as they start.
+    StreamManager stream_manager;
+    OperationStats operation_stats;
     DriverManager driver_manager;
     SysLog syslog;
+    BufferPool buffer_pool;
     SessionManager session_manager;
+    Reactor reactor;
+    SessionPool session_pool;
 
     std::mutex ks_mutex;
 
@@ -134,6 +196,7 @@ class Server
     void detach_listeners_workers();
     void join_listeners_workers();
     void close_listeners();
+    void release_listeners();
     void notify_systemd_ready();
 
 template<int socket_type> friend class ListeningChannel;
@@ -148,6 +211,13 @@ void session_thread_call(int comm_fd, ListeningChannel<socket_type> *listener)
 
     SessionID sid = listener->server->session_manager. template create_session<socket_type>(comm_fd);
 
+    if (sid < 0) {
+        close(comm_fd);
+        listener->number_of_threads--;
+        listener->stats.number_of_opened_sessions--;
+        return;
+    }
+
     auto session = static_cast<Session<socket_type>*>(&listener->server->session_manager.get_session(sid));
 
     if (session->run() < 0) {
@@ -159,29 +229,88 @@ void session_thread_call(int comm_fd, ListeningChannel<socket_type> *listener)
     listener->stats.number_of_opened_sessions--;
 }
 
+// In reactor mode the session is attached to an event loop
+// instead of running on its own thread.
+
+template<int socket_type>
+void reactor_session_exit(SessionID sid, ListeningChannel<socket_type> *listener)
+{
+    listener->server->session_manager.delete_session(sid);
+    listener->number_of_threads--;
+    listener->stats.number_of_opened_sessions--;
+}
+
+template<int socket_type>
+void reactor_session_call(int comm_fd, ListeningChannel<socket_type> *listener)
+{
+    listener->number_of_threads++;
+    listener->stats.number_of_opened_sessions++;
+    listener->stats.total_sessions_num++;
+
+    SessionID sid = listener->server->session_manager. template create_session<socket_type>(comm_fd);
+
+    if (sid < 0) {
+        close(comm_fd);
+        listener->number_of_threads--;
+        listener->stats.number_of_opened_sessions--;
+        return;
+    }
+
+    if (listener->server->reactor.add_session(sid, comm_fd) < 0) {
+        listener->server->syslog. template print<ERROR>("Cannot start session %u\n", sid);
+        reactor_session_exit(sid, listener);
+    }
+}
+
 template<int socket_type>
 void comm_thread_call(ListeningChannel<socket_type> *listener)
 {
     listener->is_ready = true;
 
     while (!listener->server->exit_comm.load()) {
+        struct pollfd pfd{};
+        pfd.fd = listener->listen_fd;
+        pfd.events = POLLIN;
+
+        // Check exit_comm periodically: a listener released
+        // to the next server is not shut down.
+        if (poll(&pfd, 1, listener_poll_ms) == 0) {
+            if (config::session_model == config::SessionModel::THREAD_PER_SESSION) {
+                listener->server->session_pool.expire();
+            }
+            continue;
+        }
+
         int comm_fd = listener->open_communication();
 
         if (listener->server->exit_comm.load())
             break;
 
         if (comm_fd < 0) {
+            // Accepted by the other server during a handover
+            if (would_block(errno)) {
+                continue;
+            }
+
             listener->server->syslog. template print<CRITICAL>("Connection to client rejected [socket_type = %u]\n", socket_type);
             continue;
         }
 
         if (listener->is_max_threads()) {
             listener->server->syslog. template print<WARNING>("Maximum number of workers exceeded\n");
+            close(comm_fd);
+            continue;
+        }
+
+        if (config::session_model == config::SessionModel::REACTOR) {
+            reactor_session_call<socket_type>(comm_fd, listener);
             continue;
         }
 
-        std::thread session_thread(session_thread_call<socket_type>, comm_fd, listener);
-        session_thread.detach();
+        if (listener->server->session_pool.admit(comm_fd, socket_type) < 0) {
+            listener->server->syslog. template print<WARNING>("Session admission queue full\n");
+            close(comm_fd);
+        }
     }
 
     listener->server->syslog. template print<INFO>("%s listener closed.\n", listen_channel_desc[socket_type].c_str());
@@ -195,6 +324,13 @@ inline int ListeningChannel<socket_type>::start_worker()
             server->syslog.print<PANIC>("Listen %s error\n", listen_channel_desc[socket_type].c_str());
             return -1;
         }
+
+        // The socket can be shared with another server (see handover.hpp):
+        // a connection signaled by poll may be accepted by the other one.
+        if (set_non_blocking(listen_fd) < 0) {
+            server->syslog.print<PANIC>("Cannot set %s listener non-blocking\n", listen_channel_desc[socket_type].c_str());
+            return -1;
+        }
         comm_thread = std::thread{comm_thread_call<socket_type>, this};
     }
 
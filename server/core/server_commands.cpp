@@ -5,6 +5,7 @@
 #include "server.hpp"
 #include "session.hpp"
 #include <ctime>
+#include <string>
 #include <drivers_json.hpp>
 
 namespace koheron {
@@ -24,10 +25,293 @@ template<> int Server::execute_operation<Server::GET_CMDS>(Command& cmd)
     return session_manager.get_session(cmd.session_id).send<1, Server::GET_CMDS>(build_drivers_json());
 }
 
+// Execute the n_commands commands following the request.
+// The response payload is the sequence of the commands entries:
+// status (0 or -1 if failed), length of the response, response.
+template<> int Server::execute_operation<Server::BATCH>(Command& cmd)
+{
+    auto& session = session_manager.get_session(cmd.session_id);
+    uint32_t n_commands = 0;
+
+    // A batch interrupted by a partially received command (reactor mode)
+    // is resumed without reading its header again
+    if (session.batch_remaining == 0) {
+        const auto args = session.deserialize<uint32_t>(cmd);
+
+        if (std::get<0>(args) < 0) {
+            return -1;
+        }
+
+        n_commands = std::get<1>(args);
+    }
+
+    if (session.execute_batch(n_commands) < 0) {
+        return -1;
+    }
+
+    return session.send<1, Server::BATCH>(session.batch_responses);
+}
+
+// Send the memory used by the buffers of the sessions.
+// session_bytes is the memory owned by the requesting session.
+template<> int Server::execute_operation<Server::GET_MEMORY_REPORT>(Command& cmd)
+{
+    auto& session = session_manager.get_session(cmd.session_id);
+    const auto stats = buffer_pool.get_stats();
+
+    std::string buffers_in_use;
+
+    for (size_t c = 0; c <= BufferPool::number_of_classes; c++) {
+        if (stats.buffers_in_use[c] == 0) {
+            continue;
+        }
+
+        if (!buffers_in_use.empty()) {
+            buffers_in_use += ",";
+        }
+
+        // The entry after the last class counts the unpooled buffers
+        const auto size = c < BufferPool::number_of_classes ? BufferPool::class_size(c) : 0;
+        buffers_in_use += "\"" + std::to_string(size) + "\":" + std::to_string(stats.buffers_in_use[c]);
+    }
+
+    const std::string report =
+        "{\"number_of_sessions\":" + std::to_string(session_manager.get_number_of_sessions()) +
+        ",\"bytes_in_use\":" + std::to_string(stats.bytes_in_use) +
+        ",\"peak_bytes_in_use\":" + std::to_string(stats.peak_bytes_in_use) +
+        ",\"bytes_cached\":" + std::to_string(stats.bytes_cached) +
+        ",\"number_of_acquires\":" + std::to_string(stats.number_of_acquires) +
+        ",\"number_of_allocations\":" + std::to_string(stats.number_of_allocations) +
+        ",\"buffers_in_use\":{" + buffers_in_use + "}" +
+        ",\"sizeof_tcp_session\":" + std::to_string(sizeof(Session<TCP>)) +
+        ",\"sizeof_websocket_session\":" + std::to_string(sizeof(Session<WEBSOCK>)) +
+        ",\"sizeof_command\":" + std::to_string(sizeof(Command)) +
+        ",\"session_bytes\":" + std::to_string(session.memory_size()) +
+        ",\"number_of_subscriptions\":" + std::to_string(stream_manager.get_number_of_subscriptions()) +
+        ",\"log_records_dropped\":" + std::to_string(syslog.get_number_of_dropped()) + "}";
+
+    return session.send<1, Server::GET_MEMORY_REPORT>(report);
+}
+
+// The client sends the requested CompressionFlags.
+// The server answers with the flags it accepts, applied to the following responses.
+template<> int Server::execute_operation<Server::SET_COMPRESSION>(Command& cmd)
+{
+    auto& session = session_manager.get_session(cmd.session_id);
+    const auto args = session.deserialize<uint32_t>(cmd);
+
+    if (std::get<0>(args) < 0) {
+        return -1;
+    }
+
+    constexpr uint32_t supported = COMPRESSION_LZ4 | COMPRESSION_SHUFFLE;
+    uint32_t flags = config::compression ? (std::get<1>(args) & supported) : 0;
+
+    // Shuffling alone is meaningless
+    if (!(flags & COMPRESSION_LZ4)) {
+        flags = 0;
+    }
+
+    // The response itself is not compressed
+    session.compression = 0;
+    const int err = session.send<1, Server::SET_COMPRESSION>(flags);
+    session.compression = flags;
+    return err;
+}
+
+// Push the frames published on the stream of an operation to the session.
+// The client chooses the backpressure policy and the length of the queue.
+// Returns true if the session is subscribed.
+template<> int Server::execute_operation<Server::SUBSCRIBE>(Command& cmd)
+{
+    auto& session = session_manager.get_session(cmd.session_id);
+    const auto args = session.deserialize<uint16_t, uint16_t, uint32_t, uint32_t>(cmd);
+
+    if (std::get<0>(args) < 0) {
+        return -1;
+    }
+
+    const auto driver = std::get<1>(args);
+    const auto operation = std::get<2>(args);
+    const auto policy = std::get<3>(args);
+    const auto queue_length = std::get<4>(args);
+    bool subscribed = false;
+
+    if (driver < 2 || driver >= device_num) {
+        syslog.print<ERROR>("Server::subscribe invalid driver %u\n", driver);
+    } else if (operation >= drivers_op_num[driver]) {
+        syslog.print<ERROR>("Server::subscribe invalid operation %u of driver %u\n", operation, driver);
+    } else if (policy >= stream_policy_num) {
+        syslog.print<ERROR>("Server::subscribe invalid policy %u\n", policy);
+    } else if (queue_length == 0 || queue_length > config::stream_max_queue_length) {
+        syslog.print<ERROR>("Server::subscribe invalid queue length %u\n", queue_length);
+    } else if (session.start_streaming() < 0) {
+        return -1;
+    } else {
+        // The frames can be sent before the response
+        subscribed = stream_manager.subscribe(session, cmd.session_id, stream_id(driver, operation),
+                                              static_cast<StreamPolicy>(policy), queue_length) == 0;
+    }
+
+    return session.send<1, Server::SUBSCRIBE>(subscribed);
+}
+
+// No frame of the stream is sent after the response.
+// Returns the number of frames sent and dropped.
+template<> int Server::execute_operation<Server::UNSUBSCRIBE>(Command& cmd)
+{
+    auto& session = session_manager.get_session(cmd.session_id);
+    const auto args = session.deserialize<uint16_t, uint16_t>(cmd);
+
+    if (std::get<0>(args) < 0) {
+        return -1;
+    }
+
+    uint64_t frames_sent = 0;
+    uint64_t frames_dropped = 0;
+
+    if (stream_manager.unsubscribe(cmd.session_id, stream_id(std::get<1>(args), std::get<2>(args)),
+                                   frames_sent, frames_dropped) < 0) {
+        syslog.print<WARNING>("Server::unsubscribe session %u not subscribed\n", cmd.session_id);
+    }
+
+    return session.send<1, Server::UNSUBSCRIBE>(frames_sent, frames_dropped);
+}
+
+// Unix socket sessions only.
+// The memfd of the region is passed with the response (SCM_RIGHTS).
+// Returns the size of the rings (0 if not available).
+template<> int Server::execute_operation<Server::OPEN_SHARED_MEMORY>(Command& cmd)
+{
+    auto& session = session_manager.get_session(cmd.session_id);
+    const uint32_t ring_size = session.open_shared_memory();
+
+    if (ring_size == 0) {
+        syslog.print<WARNING>("Server::open_shared_memory not available for session %u\n", cmd.session_id);
+    }
+
+    return session.send<1, Server::OPEN_SHARED_MEMORY>(ring_size);
+}
+
+// Send the startup time of the drivers.
+// The drivers not started yet are not listed.
+template<> int Server::execute_operation<Server::GET_STARTUP_REPORT>(Command& cmd)
+{
+    std::string drivers;
+
+    for (driver_id driver = 2; driver < device_num; driver++) {
+        if (!driver_manager.is_driver_started(driver)) {
+            continue;
+        }
+
+        if (!drivers.empty()) {
+            drivers += ",";
+        }
+
+        const auto& startup = driver_manager.get_driver_startup(driver);
+        drivers += "{\"id\":" + std::to_string(driver) +
+                   ",\"name\":\"" + drivers_names[driver].data() + "\"" +
+                   ",\"start_us\":" + std::to_string(startup.start_us) +
+                   ",\"duration_us\":" + std::to_string(startup.duration_us) + "}";
+    }
+
+    const std::string report =
+        "{\"threads\":" + std::to_string(config::driver_init_threads) +
+        ",\"duration_us\":" + std::to_string(driver_manager.get_startup_duration_us()) +
+        ",\"drivers\":[" + drivers + "]}";
+
+    return session_manager.get_session(cmd.session_id).send<1, Server::GET_STARTUP_REPORT>(report);
+}
+
+static std::string latency_json(const LatencySummary& latency)
+{
+    return "{\"mean\":" + std::to_string(latency.mean()) +
+           ",\"p50\":" + std::to_string(latency.percentile(0.5)) +
+           ",\"p90\":" + std::to_string(latency.percentile(0.9)) +
+           ",\"p99\":" + std::to_string(latency.percentile(0.99)) +
+           ",\"p999\":" + std::to_string(latency.percentile(0.999)) +
+           ",\"max\":" + std::to_string(latency.max()) + "}";
+}
+
+// Send the latency statistics of the operations executed since the server started.
+// The latencies are in ns, the percentiles are upper bounds (see operation_stats.hpp).
+// The operations never executed are not listed.
+template<> int Server::execute_operation<Server::GET_STATS>(Command& cmd)
+{
+    std::string operations;
+
+    const auto add_operation = [&](driver_id driver, int32_t op) {
+        const auto summary = operation_stats.get_summary(DriverManager::operation_stats_index(driver, op));
+
+        if (summary.requests == 0) {
+            return;
+        }
+
+        if (!operations.empty()) {
+            operations += ",";
+        }
+
+        operations += "{\"driver\":" + std::to_string(driver) +
+                      ",\"op\":" + std::to_string(op) +
+                      ",\"requests\":" + std::to_string(summary.requests) +
+                      ",\"bytes_received\":" + std::to_string(summary.bytes_received) +
+                      ",\"bytes_sent\":" + std::to_string(summary.bytes_sent) +
+                      ",\"lock_ns\":" + latency_json(summary.lock) +
+                      ",\"exec_ns\":" + latency_json(summary.exec) +
+                      ",\"send_ns\":" + latency_json(summary.send) + "}";
+    };
+
+    for (int32_t op = 0; op < server_op_num; op++) {
+        add_operation(1, op);
+    }
+
+    for (driver_id driver = 2; driver < device_num; driver++) {
+        for (int32_t op = 0; op < drivers_op_num[driver]; op++) {
+            add_operation(driver, op);
+        }
+    }
+
+    tcp_listener.stats.total_number_of_requests = operation_stats.get_requests(TCP);
+    websock_listener.stats.total_number_of_requests = operation_stats.get_requests(WEBSOCK);
+    unix_listener.stats.total_number_of_requests = operation_stats.get_requests(UNIX);
+
+    const std::string report =
+        "{\"requests\":{\"tcp\":" + std::to_string(tcp_listener.stats.total_number_of_requests) +
+        ",\"websocket\":" + std::to_string(websock_listener.stats.total_number_of_requests) +
+        ",\"unix\":" + std::to_string(unix_listener.stats.total_number_of_requests) + "}" +
+        ",\"operations\":[" + operations + "]}";
+
+    return session_manager.get_session(cmd.session_id).send<1, Server::GET_STATS>(report);
+}
+
+// Send the trace events of the last seconds (Chrome trace-event JSON)
+template<> int Server::execute_operation<Server::GET_TRACE>(Command& cmd)
+{
+    auto& session = session_manager.get_session(cmd.session_id);
+    const auto args = session.deserialize<uint32_t>(cmd);
+
+    if (std::get<0>(args) < 0) {
+        return -1;
+    }
+
+    return session.send<1, Server::GET_TRACE>(trace::dump(std::get<1>(args)));
+}
+
 ////////////////////////////////////////////////
 
 int Server::execute(Command& cmd)
 {
+    // Not locked: the sub-commands may call Server operations
+    if (cmd.operation == Server::BATCH) {
+        return execute_operation<Server::BATCH>(cmd);
+    }
+
+    // Not locked: a large dump (or a slow client) would hold up the
+    // other Server operations. The trace rings have their own lock.
+    if (cmd.operation == Server::GET_TRACE) {
+        return execute_operation<Server::GET_TRACE>(cmd);
+    }
+
     std::lock_guard<std::mutex> lock(this->ks_mutex);
 
     switch (cmd.operation) {
@@ -35,6 +319,20 @@ int Server::execute(Command& cmd)
         return execute_operation<Server::GET_VERSION>(cmd);
       case Server::GET_CMDS:
         return execute_operation<Server::GET_CMDS>(cmd);
+      case Server::GET_MEMORY_REPORT:
+        return execute_operation<Server::GET_MEMORY_REPORT>(cmd);
+      case Server::SET_COMPRESSION:
+        return execute_operation<Server::SET_COMPRESSION>(cmd);
+      case Server::SUBSCRIBE:
+        return execute_operation<Server::SUBSCRIBE>(cmd);
+      case Server::UNSUBSCRIBE:
+        return execute_operation<Server::UNSUBSCRIBE>(cmd);
+      case Server::OPEN_SHARED_MEMORY:
+        return execute_operation<Server::OPEN_SHARED_MEMORY>(cmd);
+      case Server::GET_STARTUP_REPORT:
+        return execute_operation<Server::GET_STARTUP_REPORT>(cmd);
+      case Server::GET_STATS:
+        return execute_operation<Server::GET_STATS>(cmd);
       case Server::server_op_num:
       default:
         syslog.print<ERROR>("Server::execute unknown operation\n");
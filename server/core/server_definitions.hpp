@@ -18,6 +18,9 @@ namespace koheron {
 /// Pending connections queue size
 constexpr int NUMBER_OF_PENDING_CONNECTIONS = 10;
 
+/// Period of the exit check of the listening threads
+constexpr int listener_poll_ms = 200;
+
 // ------------------------------------------
 // Buffer sizes
 // ------------------------------------------
@@ -25,7 +28,7 @@ constexpr int NUMBER_OF_PENDING_CONNECTIONS = 10;
 /// Number of samples
 constexpr int KOHERON_SIG_LEN = 16384;
 
-/// Command payload buffer length
+/// Maximum command payload length (WebSocket messages)
 constexpr int64_t CMD_PAYLOAD_BUFFER_LEN = 16384 * 16;
 
 /// Read string length
@@ -34,15 +37,6 @@ constexpr int KOHERON_READ_STR_LEN = 16384;
 /// Send string length
 constexpr int KOHERON_SEND_STR_LEN = 16384;
 
-/// Receive data buffer length
-constexpr int KOHERON_RECV_DATA_BUFF_LEN = 16384 * 16;
-
-/// Websocket receive buffer size
-constexpr int WEBSOCK_READ_STR_LEN = KOHERON_RECV_DATA_BUFF_LEN;
-
-/// Websocket send buffer size (bytes)
-constexpr int WEBSOCK_SEND_BUF_LEN = 16384 * 16;
-
 // ------------------------------------------
 // Debugging
 // ------------------------------------------
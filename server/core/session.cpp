@@ -8,12 +8,42 @@ namespace koheron {
 // TCP
 // -----------------------------------------------
 
-template<> int Session<TCP>::init_socket() {return 0;}
-template<> int Session<TCP>::exit_socket() {return 0;}
+template<>
+int Session<TCP>::init_socket()
+{
+    reader.set_fd(comm_fd);
+
+    if (config::io_uring_transport &&
+        config::session_model == config::SessionModel::THREAD_PER_SESSION) {
+        if (uring.open(comm_fd) < 0) {
+            syslog.print<DEBUG>("TCPSocket: io_uring not available, using read/write\n");
+        }
+    }
+
+    // The zero-copy completions are waited for on the session socket
+    if (config::tcp_zerocopy && config::session_model == config::SessionModel::THREAD_PER_SESSION
+        && zerocopy.open(comm_fd) < 0) {
+        syslog.print<DEBUG>("TCPSocket: MSG_ZEROCOPY not available\n");
+    }
+
+    return 0;
+}
+
+template<>
+int Session<TCP>::exit_socket()
+{
+    uring.close();
+    return 0;
+}
 
 template<>
 int Session<TCP>::read_command(Command& cmd)
 {
+    // Release the rest of the previous payload read from the shared memory
+    if (shm.in_request()) {
+        shm.end_request();
+    }
+
     // Read and decode header
     // |      RESERVED     | dev_id  |  op_id  |             payload_size              |   payload
     // |  0 |  1 |  2 |  3 |  4 |  5 |  6 |  7 |  8 |  9 | 10 | 11 | 12 | 13 | 14 | 15 | 16 | 17 | ...
@@ -24,7 +54,10 @@ int Session<TCP>::read_command(Command& cmd)
     }
 
     if (header_bytes < 0) {
-        syslog.print<ERROR>("TCPSocket: Cannot read header\n");
+        if (!input_incomplete) {
+            syslog.print<ERROR>("TCPSocket: Cannot read header\n");
+        }
+
         return header_bytes;
     }
 
@@ -34,6 +67,22 @@ int Session<TCP>::read_command(Command& cmd)
     cmd.driver = static_cast<driver_id>(std::get<0>(header_tuple));
     cmd.operation = std::get<1>(header_tuple);
 
+    // The payload is in the shared memory
+    if (shm.is_open() && std::get<0>(koheron::deserialize<0, uint32_t>(cmd.header.data())) == SHM_DOORBELL) {
+        Buffer<2 * sizeof(uint32_t)> doorbell;
+
+        if (rcv_n_bytes(doorbell.data(), doorbell.size()) <= 0) {
+            return -1;
+        }
+
+        const auto location = doorbell.deserialize<uint32_t, uint32_t>();
+
+        if (shm.begin_request(std::get<0>(location), std::get<1>(location)) < 0) {
+            syslog.print<ERROR>("UnixSocket: Invalid shared memory payload\n");
+            return -1;
+        }
+    }
+
     syslog.print<DEBUG>("TCPSocket: Receive command for driver %u, operation %u\n",
         cmd.driver, cmd.operation);
 
@@ -44,11 +93,76 @@ int Session<TCP>::read_command(Command& cmd)
 template<>
 int64_t Session<TCP>::rcv_n_bytes(char *buffer, int64_t n_bytes)
 {
+    if (shm.in_request()) {
+        const auto bytes_read = shm.read(buffer, n_bytes);
+
+        if (bytes_read < 0) {
+            syslog.print<ERROR>("UnixSocket: Shared memory payload too short\n");
+        }
+
+        return bytes_read;
+    }
+
+    if (uring.is_open()) {
+        const auto bytes_read = uring.recv(buffer, n_bytes);
+
+        if (bytes_read == 0) {
+            syslog.print<INFO>("TCPSocket: Connection closed by client\n");
+        } else if (bytes_read < 0) {
+            syslog.print<ERROR>("TCPSocket: Can't receive data\n");
+        } else {
+            syslog.print<DEBUG>("[R@%u] [%u bytes]\n", id, bytes_read);
+            operation_timing.received(bytes_read);
+        }
+
+        return bytes_read;
+    }
+
+    // Reactor mode: the command is parsed from the receive buffer. If it is
+    // only partially received, its parsing is aborted (input_incomplete)
+    // and resumed from its start once input_needed bytes are available.
+    if (config::session_model == config::SessionModel::REACTOR) {
+        const auto len = static_cast<size_t>(n_bytes);
+
+        if (reader.available() < len) {
+            const auto n = reader.fill_nonblocking(len, config::reactor_max_command_size);
+
+            if (n == 0) {
+                syslog.print<INFO>("TCPSocket: Connection closed by client\n");
+                return 0;
+            }
+
+            if (n < 0) {
+                if (would_block(errno)) {
+                    input_incomplete = true;
+                    input_needed = reader.marked_size() + len;
+                    return -1;
+                }
+
+                if (errno == EMSGSIZE) {
+                    syslog.print<ERROR>("TCPSocket: Command larger than %u bytes\n", config::reactor_max_command_size);
+                } else {
+                    syslog.print<ERROR>("TCPSocket: Can't receive data\n");
+                }
+
+                return -1;
+            }
+        }
+
+        std::memcpy(buffer, reader.peek(), len);
+        reader.consume(len);
+        syslog.print<DEBUG>("[R@%u] [%u bytes]\n", id, n_bytes);
+        operation_timing.received(n_bytes);
+        return n_bytes;
+    }
+
     int64_t bytes_rcv = 0;
     int64_t bytes_read = 0;
 
     while (bytes_read < n_bytes) {
-        bytes_rcv = read(comm_fd, buffer + bytes_read, n_bytes - bytes_read);
+        // Don't block while responses are waiting to be sent
+        const int flags = coalesced_responses.empty() ? 0 : MSG_DONTWAIT;
+        bytes_rcv = reader.read(buffer + bytes_read, static_cast<size_t>(n_bytes - bytes_read), flags);
 
         if (bytes_rcv == 0) {
             syslog.print<INFO>("TCPSocket: Connection closed by client\n");
@@ -56,6 +170,17 @@ int64_t Session<TCP>::rcv_n_bytes(char *buffer, int64_t n_bytes)
         }
 
         if (bytes_rcv < 0) {
+            if (would_block(errno)) {
+                // No more pipelined command: the session is idle
+                if (!coalesced_responses.empty()) {
+                    if (flush() < 0) {
+                        return -1;
+                    }
+
+                    continue;
+                }
+            }
+
             syslog.print<ERROR>("TCPSocket: Can't receive data\n");
             return -1;
         }
@@ -65,9 +190,119 @@ int64_t Session<TCP>::rcv_n_bytes(char *buffer, int64_t n_bytes)
 
     assert(bytes_read == n_bytes);
     syslog.print<DEBUG>("[R@%u] [%u bytes]\n", id, bytes_read);
+    operation_timing.received(bytes_read);
     return bytes_read;
 }
 
+template<>
+int Session<TCP>::flush()
+{
+    if (coalesced_responses.empty()) {
+        return 0;
+    }
+
+    struct iovec iov;
+    iov.iov_base = coalesced_responses.data();
+    iov.iov_len = coalesced_responses.size();
+    const auto n_bytes_send = send_iovecs(&iov, 1);
+    coalesced_responses.clear();
+
+    if (n_bytes_send <= 0) {
+        syslog.print<ERROR>("TCPSocket::flush: Can't write to client\n");
+        return -1;
+    }
+
+    syslog.print<DEBUG>("[S] [%u bytes]\n", n_bytes_send);
+    return 0;
+}
+
+template<>
+int Session<TCP>::start_streaming()
+{
+    std::lock_guard<std::mutex> lock(send_mutex);
+    streaming = true;
+
+    if ((uring.is_open() && uring.flush() < 0) || flush() < 0) {
+        syslog.print<ERROR>("TCPSocket: Can't send the pending responses\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+template<>
+int Session<TCP>::push(const std::vector<unsigned char>& frame)
+{
+    struct iovec iov;
+    iov.iov_base = const_cast<unsigned char*>(frame.data());
+    iov.iov_len = frame.size();
+
+    std::unique_lock<std::mutex> lock(send_mutex);
+
+    // Reactor mode: the frames wait for the previous ones to be written
+    if (config::session_model == config::SessionModel::REACTOR && output.wait_drained(lock) < 0) {
+        return -1;
+    }
+
+    const auto n_bytes_send = send_iovecs(&iov, 1);
+
+    if (n_bytes_send > 0) {
+        syslog.print<DEBUG>("[S@%u] [%u bytes frame]\n", id, n_bytes_send);
+    }
+
+    return static_cast<int>(n_bytes_send);
+}
+
+template<>
+uint32_t Session<TCP>::open_shared_memory()
+{
+    if (!config::shared_memory || type != UNIX) {
+        return 0;
+    }
+
+    if (shm.is_open()) {
+        syslog.print<WARNING>("UnixSocket: Shared memory already open\n");
+        return 0;
+    }
+
+    shm_fd = shm.open();
+
+    if (shm_fd < 0) {
+        syslog.print<ERROR>("UnixSocket: Can't create the shared memory\n");
+        return 0;
+    }
+
+    return SharedMemoryTransport::ring_size;
+}
+
+template<>
+int Session<TCP>::receive_input()
+{
+    // A partially received command is not parsed again before the rest is received
+    const size_t needed = std::max<size_t>(input_needed, 1);
+
+    if (reader.available() < needed) {
+        const auto n = reader.fill_nonblocking(needed, config::reactor_max_command_size);
+
+        if (n == 0) {
+            syslog.print<INFO>("TCPSocket: Connection closed by client\n");
+            return -1;
+        }
+
+        if (n < 0) {
+            if (would_block(errno)) {
+                return 0;
+            }
+
+            syslog.print<ERROR>("TCPSocket: Can't receive data\n");
+            return -1;
+        }
+    }
+
+    input_needed = 0;
+    return 1;
+}
+
 // -----------------------------------------------
 // WebSocket
 // -----------------------------------------------
@@ -76,12 +311,18 @@ template<>
 int Session<WEBSOCK>::init_socket()
 {
     websock.set_id(comm_fd);
+    const int err = websock.authenticate();
 
-    if (websock.authenticate() < 0) {
+    if (err < 0) {
         syslog.print<CRITICAL>("Cannot connect websocket to client\n");
         return -1;
     }
 
+    // Rest of the handshake not yet received (reactor mode)
+    if (err == WebSocket::INCOMPLETE) {
+        input_incomplete = true;
+    }
+
     return 0;
 }
 
@@ -102,11 +343,19 @@ int Session<WEBSOCK>::read_command(Command& cmd)
         return 0;
     }
 
+    // Rest of the message not yet received (reactor mode)
+    if (!websock.has_message()) {
+        input_incomplete = true;
+        return -1;
+    }
+
     if (websock.payload_size() < Command::HEADER_SIZE) {
         syslog.print<ERROR>("WebSocket: Command too small\n");
         return -1;
     }
 
+    operation_timing.received(websock.payload_size());
+
     const auto header_tuple = cmd.header.deserialize<uint16_t, uint16_t>();
     cmd.session_id = id;
     cmd.session = this;
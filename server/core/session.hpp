@@ -11,6 +11,7 @@
 #include <unistd.h>
 #include <type_traits>
 #include <cassert>
+#include <mutex>
 
 #include "commands.hpp"
 #include "serializer_deserializer.hpp"
@@ -19,6 +20,14 @@
 #include "session_abstract.hpp"
 #include "drivers_manager.hpp"
 #include "websocket.hpp"
+#include "reactor.hpp"
+#include "uring.hpp"
+#include "zerocopy.hpp"
+#include "recv_buffer.hpp"
+#include "compression.hpp"
+#include "shm_transport.hpp"
+#include "operation_stats.hpp"
+#include "trace.hpp"
 
 namespace koheron {
 
@@ -33,12 +42,57 @@ template<int socket_type>
 class Session : public SessionAbstract
 {
   public:
-    Session(int comm_fd, SessionID id_, SysLog& syslog_, DriverManager& drv_manager_);
+    Session(int comm_fd, SessionID id_, SysLog& syslog_, DriverManager& drv_manager_,
+            BufferPool& buffer_pool_);
 
     int run();
 
+    /// Handle a readable socket in reactor mode.
+    ///
+    /// The first event completes the session initialization, the
+    /// following ones execute the commands received. The execution
+    /// stops at a partially received command, or while responses
+    /// wait for the socket to be writable.
+    /// Returns -1 when the session must be closed.
+    int process_event();
+
+    // Pending output in reactor mode (see PendingOutput)
+
+    /// Called before the first event
+    void attach_output(int epoll_fd, uint64_t event_data);
+
+    /// Write the pending output (the socket is writable).
+    /// Returns 1 once written, 0 if bytes remain, -1 on error.
+    int process_output();
+
+    void close_output();
+
     SessionID get_id() const {return id;}
 
+    /// Read and execute the n_commands following commands (or the rest of
+    /// an interrupted batch, see batch_remaining). Their responses are
+    /// appended to batch_responses instead of being sent.
+    int execute_batch(uint32_t n_commands);
+
+    // Server-push streams
+
+    /// Prepare the session for the stream frames, sent by the
+    /// subscriptions delivery threads. The pending responses are sent,
+    /// and the next ones are not coalesced anymore.
+    int start_streaming();
+
+    /// Send a stream frame (called by the delivery threads)
+    int push(const std::vector<unsigned char>& frame);
+
+    /// Map a memory region shared with the client (Unix sessions).
+    /// The memfd is passed with the next response.
+    /// Returns the size of the rings, 0 if not available.
+    uint32_t open_shared_memory();
+
+    /// Bytes owned by the session: the object and its buffers,
+    /// io_uring rings and shared memory region
+    size_t memory_size();
+
     // Receive - Send
 
     // TODO Move in Session<TCP> specialization
@@ -47,6 +101,11 @@ class Session : public SessionAbstract
     template<typename... Tp> std::tuple<int, Tp...> deserialize(Command& cmd, std::false_type);
     template<typename... Tp> std::tuple<int, Tp...> deserialize(Command& cmd, std::true_type);
 
+    template<typename... Tp>
+    std::tuple<int, Tp...> deserialize(Command& cmd) {
+        return deserialize<Tp...>(cmd, std::integral_constant<bool, 0 < sizeof...(Tp)>());
+    }
+
     // The command is passed in argument since for the WebSocket the vector data
     // are stored into it. This implies that the whole vector is already stored on
     // the stack which might not be a good thing.
@@ -63,8 +122,43 @@ class Session : public SessionAbstract
 
     template<uint16_t class_id, uint16_t func_id, typename... Args>
     int send(Args&&... args) {
+        if constexpr (!config::operation_stats && !config::trace::enabled) {
+            return send_response<class_id, func_id>(std::forward<Args>(args)...);
+        }
+
+        const auto start = stats_clock_ns();
+        const int bytes_send = send_response<class_id, func_id>(std::forward<Args>(args)...);
+        const auto end = stats_clock_ns();
+        operation_timing.sent(end - start, bytes_send);
+        trace::record("send", start, end);
+        return bytes_send;
+    }
+
+  private:
+    template<uint16_t class_id, uint16_t func_id, typename... Args>
+    int send_response(Args&&... args) {
+        // The container payloads are referenced in place by send_buffer:
+        // they are sent before the arguments go out of scope.
         dynamic_serializer.build_command<class_id, func_id>(send_buffer, std::forward<Args>(args)...);
-        const auto bytes_send = write(send_buffer.data(), send_buffer.size());
+
+        if (in_batch) {
+            send_buffer.copy_to(batch_responses);
+            return static_cast<int>(send_buffer.size());
+        }
+
+        int bytes_send;
+
+        if (shm.is_open() && send_buffer.size() >= config::shm_min_size &&
+            shm.write_response(send_buffer, shm_doorbell)) {
+            // Only the position of the payload goes through the socket
+            bytes_send = write(shm_doorbell);
+        } else if (compression != 0 && send_buffer.size() >= config::compression_min_size &&
+            compressor.compress(send_buffer, compression, shuffle_element_size<Args...>(), compressed_buffer)) {
+            bytes_send = write(compressed_buffer);
+            compressor.release();
+        } else {
+            bytes_send = write(send_buffer);
+        }
 
         if (bytes_send == 0) {
             status = CLOSED;
@@ -73,28 +167,77 @@ class Session : public SessionAbstract
         return bytes_send;
     }
 
-  private:
     int comm_fd;  ///< Socket file descriptor
     SessionID id;
     SysLog& syslog;
     DriverManager& driver_manager;
 
-    struct EmptyBuffer {};
+    struct EmptyReader {
+        EmptyReader(BufferPool&, size_t) {}
+        void release_if_empty() {}
+    };
+
+    std::conditional_t<socket_type == TCP || socket_type == UNIX,
+                       RecvBuffer, EmptyReader> reader;
+
+    struct EmptyUring {};
     std::conditional_t<socket_type == TCP || socket_type == UNIX,
-                       Buffer<KOHERON_RECV_DATA_BUFF_LEN>, EmptyBuffer> recv_data_buff;
+                       UringTransport, EmptyUring> uring;
+
+    struct EmptyZeroCopy {};
+    std::conditional_t<socket_type == TCP || socket_type == UNIX,
+                       ZeroCopySender, EmptyZeroCopy> zerocopy;
+
+    struct EmptyOutput {};
+    std::conditional_t<socket_type == TCP || socket_type == UNIX,
+                       PendingOutput, EmptyOutput> output;
 
     struct EmptyWebsock {
-        EmptyWebsock(SysLog&) {}
+        EmptyWebsock(SysLog&, BufferPool&) {}
+        void release_buffers() {}
     };
 
     std::conditional_t<socket_type == WEBSOCK, WebSocket, EmptyWebsock> websock;
 
-    std::vector<unsigned char> send_buffer;
+    struct EmptySharedMemory {
+        bool is_open() const {return false;}
+        bool write_response(IovecBuffer&, IovecBuffer&) {return false;}
+    };
+
+    std::conditional_t<socket_type == TCP || socket_type == UNIX,
+                       SharedMemoryTransport, EmptySharedMemory> shm;
+    IovecBuffer shm_doorbell;
+    int shm_fd = -1; ///< memfd to pass with the next response
+
+    IovecBuffer send_buffer;
     DynamicSerializer<1024> dynamic_serializer;
 
+    Compressor compressor;
+    IovecBuffer compressed_buffer;
+
+    /// Responses to pipelined commands, sent when the session gets idle.
+    /// (TCP and Unix sessions without io_uring, which coalesces by itself)
+    std::vector<unsigned char> coalesced_responses;
+
+    bool in_batch = false;
+
+    // Command interrupted by a partially received command of its batch (reactor mode)
+    driver_id batch_driver = 0;
+    int32_t batch_operation = 0;
+
+    /// Bytes needed to parse again a partially received command (reactor mode)
+    size_t input_needed = 0;
+
+    /// Set once subscribed to a stream. The responses and the
+    /// stream frames are then written under send_mutex.
+    bool streaming = false;
+    std::mutex send_mutex;
+
     enum {CLOSED, OPENED};
     int status;
 
+    bool is_initialized = false; ///< Used in reactor mode
+
   private:
     int init_socket();
     int exit_socket();
@@ -116,27 +259,50 @@ class Session : public SessionAbstract
         const auto err = rcv_n_bytes(buff.data(), sizeof(uint32_t));
 
         if (err < 0) {
-            syslog.print<ERROR>("Cannot read pack length\n");
+            if (!input_incomplete) {
+                syslog.print<ERROR>("Cannot read pack length\n");
+            }
+
             return -1;
         }
 
         return std::get<0>(buff.deserialize<uint32_t>());
     }
 
-    template<class T> int write(const T *data, unsigned int len);
+    int write(IovecBuffer& buffer);
+
+    /// Blocking write, or queued without blocking in reactor mode.
+    /// fd >= 0 is passed with the first byte.
+    int64_t send_iovecs(struct iovec *iov, size_t iovcnt, int fd = -1);
+
+    /// Send the coalesced responses
+    int flush();
+
+    // Resumable parsing (reactor mode)
+
+    /// Receive without blocking. Returns 1 if the next command
+    /// can be parsed, 0 if more bytes are needed, -1 on error.
+    int receive_input();
+
+    void mark_input();
+    void rewind_input();
+    bool output_pending();
 
 friend class SessionManager;
 };
 
 template<int socket_type>
-Session<socket_type>::Session(int comm_fd_, SessionID id_, SysLog& syslog_, DriverManager& drv_manager_)
+Session<socket_type>::Session(int comm_fd_, SessionID id_, SysLog& syslog_, DriverManager& drv_manager_,
+                              BufferPool& buffer_pool_)
 : SessionAbstract(socket_type)
 , comm_fd(comm_fd_)
 , id(id_)
 , syslog(syslog_)
 , driver_manager(drv_manager_)
-, websock(syslog)
-, send_buffer(0)
+, reader(buffer_pool_, config::recv_buffer_size)
+, websock(syslog, buffer_pool_)
+, send_buffer()
+, compressor(buffer_pool_)
 , status(OPENED)
 {}
 
@@ -173,6 +339,168 @@ int Session<socket_type>::run()
     return 0;
 }
 
+template<int socket_type>
+int Session<socket_type>::process_event()
+{
+    if (exit_signal) {
+        return -1;
+    }
+
+    input_incomplete = false;
+
+    if (!is_initialized) {
+        if (init_session() < 0) {
+            return -1;
+        }
+
+        // Rest of the WebSocket handshake not yet received
+        if (input_incomplete) {
+            return 0;
+        }
+
+        is_initialized = true;
+    }
+
+    // Execute the pipelined commands, the responses are coalesced
+    // and sent once no more command is received. A partially received
+    // command is parsed again from its start once the rest is received.
+    while (!output_pending()) {
+        const int ready = receive_input();
+
+        if (ready < 0) {
+            return -1;
+        }
+
+        if (ready == 0) {
+            break;
+        }
+
+        input_incomplete = false;
+        mark_input();
+        Command cmd;
+
+        if (batch_remaining > 0) {
+            cmd.session_id = id;
+            cmd.session = this;
+            cmd.driver = batch_driver;
+            cmd.operation = batch_operation;
+        } else if (read_command(cmd) <= 0) {
+            if (input_incomplete) {
+                rewind_input();
+                break;
+            }
+
+            return -1;
+        }
+
+        const int err = driver_manager.execute(cmd);
+
+        if (input_incomplete) {
+            batch_driver = cmd.driver;
+            batch_operation = cmd.operation;
+            rewind_input();
+            break;
+        }
+
+        if (err < 0) {
+            syslog.print<ERROR>("Failed to execute command [driver = %i, operation = %i]\n", cmd.driver, cmd.operation);
+        }
+
+        if (status == CLOSED) {
+            exit_session();
+            return -1;
+        }
+    }
+
+    if (flush() < 0) {
+        exit_session();
+        return -1;
+    }
+
+    // Idle sessions give their buffers back to the pool
+    reader.release_if_empty();
+    websock.release_buffers();
+    return 0;
+}
+
+template<int socket_type>
+int Session<socket_type>::execute_batch(uint32_t n_commands)
+{
+    if (in_batch) {
+        syslog.print<ERROR>("Nested batch is not allowed\n");
+        return -1;
+    }
+
+    if (batch_remaining == 0) {
+        batch_remaining = n_commands;
+        batch_responses.clear();
+    }
+
+    in_batch = true;
+    int err = 0;
+
+    while (batch_remaining > 0) {
+        // An interrupted batch is resumed from this command
+        mark_input();
+        Command cmd;
+
+        if (read_command(cmd) <= 0) {
+            if (!input_incomplete) {
+                status = CLOSED;
+                batch_remaining = 0;
+            }
+
+            err = -1;
+            break;
+        }
+
+        // Each entry is the status of the command, the length of its
+        // response, then the response (dropped if the command failed)
+        const size_t entry = batch_responses.size();
+        batch_responses.resize(entry + batch_entry_header_size);
+
+        const int cmd_err = driver_manager.execute(cmd);
+
+        if (input_incomplete) {
+            batch_responses.resize(entry);
+            err = -1;
+            break;
+        }
+
+        if (cmd_err < 0) {
+            syslog.print<ERROR>("Failed to execute batch command [driver = %i, operation = %i]\n", cmd.driver, cmd.operation);
+            batch_responses.resize(entry + batch_entry_header_size);
+        }
+
+        const auto length = batch_responses.size() - entry - batch_entry_header_size;
+        append<int32_t>(&batch_responses[entry], cmd_err < 0 ? -1 : 0);
+        append<uint32_t>(&batch_responses[entry + sizeof(int32_t)], static_cast<uint32_t>(length));
+        batch_remaining--;
+    }
+
+    in_batch = false;
+    return err;
+}
+
+template<int socket_type>
+size_t Session<socket_type>::memory_size()
+{
+    std::lock_guard<std::mutex> lock(send_mutex);
+
+    size_t size = sizeof(*this) + send_buffer.memory_size()
+                + compressor.memory_size() + compressed_buffer.memory_size()
+                + coalesced_responses.capacity() + batch_responses.capacity();
+
+    if constexpr (socket_type == TCP || socket_type == UNIX) {
+        size += reader.memory_size() + uring.memory_size() + output.memory_size()
+              + shm.memory_size() + shm_doorbell.memory_size();
+    } else {
+        size += websock.memory_size();
+    }
+
+    return size;
+}
+
 // -----------------------------------------------
 // TCP
 // -----------------------------------------------
@@ -180,10 +508,79 @@ int Session<socket_type>::run()
 template<>
 int64_t Session<TCP>::rcv_n_bytes(char *buffer, int64_t n_bytes);
 
+template<>
+int Session<TCP>::start_streaming();
+
+template<>
+int Session<TCP>::push(const std::vector<unsigned char>& frame);
+
+template<>
+uint32_t Session<TCP>::open_shared_memory();
+
+template<>
+int Session<TCP>::flush();
+
+template<>
+int Session<TCP>::receive_input();
+
+template<>
+inline void Session<TCP>::attach_output(int epoll_fd, uint64_t event_data)
+{
+    output.attach(epoll_fd, comm_fd, event_data);
+}
+
+template<>
+inline int Session<TCP>::process_output()
+{
+    std::lock_guard<std::mutex> lock(send_mutex);
+    return output.drain();
+}
+
+template<>
+inline void Session<TCP>::close_output()
+{
+    std::lock_guard<std::mutex> lock(send_mutex);
+    output.close();
+}
+
+template<>
+inline bool Session<TCP>::output_pending()
+{
+    std::lock_guard<std::mutex> lock(send_mutex);
+    return !output.empty();
+}
+
+template<>
+inline void Session<TCP>::mark_input()
+{
+    reader.mark();
+}
+
+template<>
+inline void Session<TCP>::rewind_input()
+{
+    reader.rewind();
+}
+
+template<>
+inline int64_t Session<TCP>::send_iovecs(struct iovec *iov, size_t iovcnt, int fd)
+{
+    if (config::session_model == config::SessionModel::REACTOR) {
+        return output.send(iov, iovcnt, fd);
+    }
+
+    if (fd >= 0) {
+        return send_with_fd(comm_fd, iov, iovcnt, fd);
+    }
+
+    return writev_all(comm_fd, iov, iovcnt);
+}
+
 template<>
 template<typename T, size_t N>
 inline int Session<TCP>::recv(std::array<T, N>& arr, Command&)
 {
+    KOHERON_TRACE_SCOPE("recv");
     return rcv_n_bytes(reinterpret_cast<char*>(arr.data()), size_of<T, N>);
 }
 
@@ -191,12 +588,15 @@ template<>
 template<typename T>
 inline int Session<TCP>::recv(std::vector<T>& vec, Command&)
 {
-    const auto length = get_pack_length() / sizeof(T);
+    KOHERON_TRACE_SCOPE("recv");
+    const int64_t pack_length = get_pack_length();
 
-    if (length < 0) {
+    // Divided once checked (a negative length is not a size)
+    if (pack_length < 0) {
         return -1;
     }
 
+    const auto length = static_cast<size_t>(pack_length) / sizeof(T);
     vec.resize(length);
     const auto err = rcv_n_bytes(reinterpret_cast<char *>(vec.data()), length * sizeof(T));
 
@@ -211,13 +611,14 @@ template<>
 template<>
 inline int Session<TCP>::recv(std::string& str, Command&)
 {
-    const auto length = get_pack_length();
+    KOHERON_TRACE_SCOPE("recv");
+    const int64_t length = get_pack_length();
 
     if (length < 0) {
         return -1;
     }
 
-    str.resize(length);
+    str.resize(static_cast<size_t>(length));
     const auto err = rcv_n_bytes(str.data(), length);
 
     if (err >= 0) {
@@ -238,6 +639,7 @@ template<>
 template<typename... Tp>
 inline std::tuple<int, Tp...> Session<TCP>::deserialize(Command&, std::true_type)
 {
+    KOHERON_TRACE_SCOPE("recv");
     constexpr auto pack_len = required_buffer_size<Tp...>();
     Buffer<pack_len> buff;
     const int err = rcv_n_bytes(buff.data(), pack_len);
@@ -245,11 +647,62 @@ inline std::tuple<int, Tp...> Session<TCP>::deserialize(Command&, std::true_type
 }
 
 template<>
-template<class T>
-inline int Session<TCP>::write(const T *data, unsigned int len)
+inline int Session<TCP>::write(IovecBuffer& buffer)
 {
-    const auto bytes_send = sizeof(T) * len;
-    const int n_bytes_send = ::write(comm_fd, static_cast<const unsigned char*>(data), bytes_send);
+    auto& iovecs = buffer.iovecs();
+    const auto bytes_send = buffer.size();
+    int64_t n_bytes_send;
+
+    // Stream frames are written concurrently
+    std::unique_lock<std::mutex> lock(send_mutex, std::defer_lock);
+
+    if (streaming) {
+        lock.lock();
+    }
+
+    if (shm_fd >= 0) {
+        // The coalesced responses must be sent first
+        if ((uring.is_open() && uring.flush() < 0) || flush() < 0) {
+            syslog.print<ERROR>("TCPSocket::write: Can't write to client\n");
+            return -1;
+        }
+
+        n_bytes_send = send_iovecs(iovecs.data(), iovecs.size(), shm_fd);
+        ::close(shm_fd);
+        shm_fd = -1;
+    } else if (zerocopy.is_enabled() && bytes_send >= config::tcp_zerocopy_min_size) {
+        // The coalesced responses must be sent first
+        if ((uring.is_open() && uring.flush() < 0) || flush() < 0) {
+            syslog.print<ERROR>("TCPSocket::write: Can't write to client\n");
+            return -1;
+        }
+
+        n_bytes_send = zerocopy.send(iovecs.data(), iovecs.size());
+    } else if (uring.is_open()) {
+        n_bytes_send = uring.send(iovecs.data(), iovecs.size());
+
+        // Nothing must be left in flight once the lock is released
+        if (streaming && n_bytes_send > 0 && uring.flush() < 0) {
+            n_bytes_send = -1;
+        }
+    } else if (!streaming && coalesced_responses.size() + bytes_send <= config::send_coalesce_size) {
+        buffer.copy_to(coalesced_responses);
+        n_bytes_send = static_cast<int64_t>(bytes_send);
+    } else {
+        // Send the coalesced responses with this one
+        const auto n_coalesced = coalesced_responses.size();
+
+        if (n_coalesced > 0) {
+            iovecs.insert(iovecs.begin(), {coalesced_responses.data(), n_coalesced});
+        }
+
+        n_bytes_send = send_iovecs(iovecs.data(), iovecs.size());
+        coalesced_responses.clear();
+
+        if (n_bytes_send > 0) {
+            n_bytes_send -= static_cast<int64_t>(n_coalesced);
+        }
+    }
 
     if (n_bytes_send == 0) {
        syslog.print<ERROR>("TCPSocket::write: Connection closed by client\n");
@@ -261,11 +714,6 @@ inline int Session<TCP>::write(const T *data, unsigned int len)
        return -1;
     }
 
-    if (n_bytes_send != static_cast<int>(bytes_send)) {
-        syslog.print<ERROR>("TCPSocket::write: Some bytes have not been sent\n");
-        return -1;
-    }
-
     syslog.print<DEBUG>("[S] [%u bytes]\n", bytes_send);
     return static_cast<int>(bytes_send);
 }
@@ -279,8 +727,12 @@ template<>
 class Session<UNIX> : public Session<TCP>
 {
   public:
-    Session<UNIX>(int comm_fd_, SessionID id_, SysLog& syslog_, DriverManager& drv_manager_)
-    : Session<TCP>(comm_fd_, id_, syslog_, drv_manager_) {}
+    Session<UNIX>(int comm_fd_, SessionID id_, SysLog& syslog_, DriverManager& drv_manager_,
+                  BufferPool& buffer_pool_)
+    : Session<TCP>(comm_fd_, id_, syslog_, drv_manager_, buffer_pool_)
+    {
+        type = UNIX;
+    }
 };
 
 // -----------------------------------------------
@@ -291,6 +743,11 @@ template<>
 template<typename T, size_t N>
 inline int Session<WEBSOCK>::recv(std::array<T, N>& arr, Command& cmd)
 {
+    if (size_of<T, N> > cmd.payload.remaining()) {
+        syslog.print<ERROR>("WebSocket: Payload size overflow during array reception\n");
+        return -1;
+    }
+
     arr = cmd.payload.extract_array<T, N>();
     return 0;
 }
@@ -299,9 +756,14 @@ template<>
 template<typename T>
 inline int Session<WEBSOCK>::recv(std::vector<T>& vec, Command& cmd)
 {
+    if (sizeof(uint32_t) > cmd.payload.remaining()) {
+        syslog.print<ERROR>("WebSocket: Payload size overflow during buffer reception\n");
+        return -1;
+    }
+
     const auto length = std::get<0>(cmd.payload.deserialize<uint32_t>());
 
-    if (length > CMD_PAYLOAD_BUFFER_LEN) {
+    if (length > cmd.payload.remaining()) {
         syslog.print<ERROR>("WebSocket: Payload size overflow during buffer reception\n");
         return -1;
     }
@@ -314,9 +776,14 @@ template<>
 template<>
 inline int Session<WEBSOCK>::recv(std::string& str, Command& cmd)
 {
+    if (sizeof(uint32_t) > cmd.payload.remaining()) {
+        syslog.print<ERROR>("WebSocket::rcv_vector: Payload size overflow\n");
+        return -1;
+    }
+
     const auto length = std::get<0>(cmd.payload.deserialize<uint32_t>());
 
-    if (length > CMD_PAYLOAD_BUFFER_LEN) {
+    if (length > cmd.payload.remaining()) {
         syslog.print<ERROR>("WebSocket::rcv_vector: Payload size overflow\n");
         return -1;
     }
@@ -336,14 +803,83 @@ template<>
 template<typename... Tp>
 inline std::tuple<int, Tp...> Session<WEBSOCK>::deserialize(Command& cmd, std::true_type)
 {
+    if (required_buffer_size<Tp...>() > cmd.payload.remaining()) {
+        syslog.print<ERROR>("WebSocket: Payload size overflow during arguments reception\n");
+        return std::tuple<int, Tp...>(-1, Tp()...);
+    }
+
     return std::tuple_cat(std::make_tuple(0), cmd.payload.deserialize<Tp...>());
 }
 
 template<>
-template<class T>
-inline int Session<WEBSOCK>::write(const T *data, unsigned int len)
+inline int Session<WEBSOCK>::write(IovecBuffer& buffer)
+{
+    return websock.send(buffer);
+}
+
+template<>
+inline int Session<WEBSOCK>::flush()
+{
+    return 0;
+}
+
+template<>
+inline int Session<WEBSOCK>::receive_input()
 {
-    return websock.send(data, len);
+    return 1; // The WebSocket resumes the reception by itself
+}
+
+template<>
+inline void Session<WEBSOCK>::mark_input() {}
+
+template<>
+inline void Session<WEBSOCK>::rewind_input() {}
+
+template<>
+inline void Session<WEBSOCK>::attach_output(int epoll_fd, uint64_t event_data)
+{
+    websock.attach_output(epoll_fd, comm_fd, event_data);
+}
+
+template<>
+inline int Session<WEBSOCK>::process_output()
+{
+    return websock.drain_output();
+}
+
+template<>
+inline void Session<WEBSOCK>::close_output()
+{
+    websock.close_output();
+}
+
+template<>
+inline bool Session<WEBSOCK>::output_pending()
+{
+    return websock.output_pending();
+}
+
+// The WebSocket serializes the sends by itself
+
+template<>
+inline int Session<WEBSOCK>::start_streaming()
+{
+    streaming = true;
+    return 0;
+}
+
+template<>
+inline uint32_t Session<WEBSOCK>::open_shared_memory()
+{
+    return 0;
+}
+
+template<>
+inline int Session<WEBSOCK>::push(const std::vector<unsigned char>& frame)
+{
+    IovecBuffer buffer;
+    buffer.reference(frame.data(), frame.size());
+    return websock.send(buffer, true);
 }
 
 
@@ -384,6 +920,76 @@ inline int SessionAbstract::recv(Tp& container, Command& cmd)
     }
 }
 
+inline int SessionAbstract::execute_batch(uint32_t n_commands)
+{
+    switch (this->type) {
+        case TCP:
+            return static_cast<Session<TCP>*>(this)->execute_batch(n_commands);
+        case UNIX:
+            return static_cast<Session<UNIX>*>(this)->execute_batch(n_commands);
+        case WEBSOCK:
+            return static_cast<Session<WEBSOCK>*>(this)->execute_batch(n_commands);
+        default:
+            return -1;
+    }
+}
+
+inline int SessionAbstract::start_streaming()
+{
+    switch (this->type) {
+        case TCP:
+            return static_cast<Session<TCP>*>(this)->start_streaming();
+        case UNIX:
+            return static_cast<Session<UNIX>*>(this)->start_streaming();
+        case WEBSOCK:
+            return static_cast<Session<WEBSOCK>*>(this)->start_streaming();
+        default:
+            return -1;
+    }
+}
+
+inline uint32_t SessionAbstract::open_shared_memory()
+{
+    switch (this->type) {
+        case TCP:
+            return static_cast<Session<TCP>*>(this)->open_shared_memory();
+        case UNIX:
+            return static_cast<Session<UNIX>*>(this)->open_shared_memory();
+        case WEBSOCK:
+            return static_cast<Session<WEBSOCK>*>(this)->open_shared_memory();
+        default:
+            return 0;
+    }
+}
+
+inline size_t SessionAbstract::memory_size()
+{
+    switch (this->type) {
+        case TCP:
+            return static_cast<Session<TCP>*>(this)->memory_size();
+        case UNIX:
+            return static_cast<Session<UNIX>*>(this)->memory_size();
+        case WEBSOCK:
+            return static_cast<Session<WEBSOCK>*>(this)->memory_size();
+        default:
+            return 0;
+    }
+}
+
+inline int SessionAbstract::push(const std::vector<unsigned char>& frame)
+{
+    switch (this->type) {
+        case TCP:
+            return static_cast<Session<TCP>*>(this)->push(frame);
+        case UNIX:
+            return static_cast<Session<UNIX>*>(this)->push(frame);
+        case WEBSOCK:
+            return static_cast<Session<WEBSOCK>*>(this)->push(frame);
+        default:
+            return -1;
+    }
+}
+
 template<uint16_t class_id, uint16_t func_id, typename... Args>
 inline int SessionAbstract::send(Args&&... args)
 {
@@ -399,14 +1005,6 @@ inline int SessionAbstract::send(Args&&... args)
     }
 }
 
-// Cast abstract session unique_ptr
-template<int socket_type>
-Session<socket_type>*
-cast_to_session(const std::unique_ptr<SessionAbstract>& sess_abstract)
-{
-    return static_cast<Session<socket_type>*>(sess_abstract.get());
-}
-
 } // namespace koheron
 
 #endif // __KOHERON_SESSION_HPP__
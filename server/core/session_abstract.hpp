@@ -6,6 +6,7 @@
 #include "commands.hpp"
 
 #include <atomic>
+#include <vector>
 
 namespace koheron {
 
@@ -20,9 +21,32 @@ class SessionAbstract
     template<typename... Tp> std::tuple<int, Tp...> deserialize(Command& cmd);
     template<typename Tp> int recv(Tp& container, Command& cmd);
     template<uint16_t class_id, uint16_t func_id, typename... Args> int send(Args&&... args);
+    int execute_batch(uint32_t n_commands);
+    int start_streaming();
+    int push(const std::vector<unsigned char>& frame);
+    uint32_t open_shared_memory();
+    size_t memory_size();
 
     int type;
 
+    /// Compression of the responses negotiated with the client (CompressionFlags)
+    uint32_t compression = 0;
+
+    /// Set when the command being parsed is only partially received
+    /// (reactor mode). Its execution is aborted, and it is parsed
+    /// again from its start once the rest is received.
+    bool input_incomplete = false;
+
+    /// Commands of the batch not yet executed (see Server::BATCH).
+    /// In reactor mode, a batch interrupted by a partially received
+    /// command is resumed from that command.
+    uint32_t batch_remaining = 0;
+    std::vector<unsigned char> batch_responses;
+
+    /// Each batch entry starts with the status (int32) of the
+    /// command and the length (uint32) of its response
+    static constexpr size_t batch_entry_header_size = 8;
+
     std::atomic<bool> exit_signal{false};
 
     void exit_comm() {
@@ -6,115 +6,123 @@
 #include "server.hpp"
 #include "session.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <sys/socket.h>
-#include <thread>
-#include <mutex>
 
 namespace koheron {
 
-SessionManager::SessionManager(DriverManager& drv_manager_, SysLog& syslog_)
+constexpr size_t session_size = std::max({sizeof(Session<TCP>), sizeof(Session<UNIX>), sizeof(Session<WEBSOCK>)});
+constexpr size_t session_align = std::max({alignof(Session<TCP>), alignof(Session<UNIX>), alignof(Session<WEBSOCK>)});
+
+SessionManager::SessionManager(DriverManager& drv_manager_, SysLog& syslog_,
+                               BufferPool& buffer_pool_, StreamManager& stream_manager_)
 : driver_manager(drv_manager_),
   syslog(syslog_),
-  session_pool(),
-  reusable_ids(0)
+  buffer_pool(buffer_pool_),
+  stream_manager(stream_manager_),
+  sessions(config::max_sessions, session_size, session_align)
 {}
 
 SessionManager::~SessionManager() {delete_all();}
 
-int SessionManager::number_of_sessions = 0;
-
-bool SessionManager::is_reusable_id(SessionID id)
+template<int socket_type>
+SessionID SessionManager::create_session(int comm_fd)
 {
-    for (auto& reusable_id : reusable_ids)
-        if (reusable_id == id)
-            return true;
-
-    return false;
-}
+    const SessionID id = sessions.allocate();
 
-bool SessionManager::is_id_in_session_ids(SessionID id)
-{
-    auto curr_ids = get_session_ids();
-
-    for (auto& curr_id : curr_ids)
-        if (curr_id == id)
-            return true;
+    if (id < 0) {
+        syslog.print<ERROR>("Maximum number of sessions reached (%u)\n", config::max_sessions);
+        return -1;
+    }
 
-    return false;
+    auto session = new (sessions.get_storage(id)) Session<socket_type>(comm_fd, id, syslog, driver_manager, buffer_pool);
+    sessions.publish(id, session);
+    return id;
 }
 
+template SessionID SessionManager::create_session<TCP>(int comm_fd);
+template SessionID SessionManager::create_session<UNIX>(int comm_fd);
+template SessionID SessionManager::create_session<WEBSOCK>(int comm_fd);
+
 std::vector<SessionID> SessionManager::get_session_ids()
 {
     std::vector<SessionID> res(0);
 
-    for (auto& session : session_pool) {
-        assert(!is_reusable_id(session.first));
-        res.push_back(session.first);
-    }
+    sessions.for_each([&](SessionID id, SessionAbstract&) {
+        res.push_back(id);
+    });
 
     return res;
 }
 
-void SessionManager::delete_session(SessionID id)
+int SessionManager::get_session_fd(SessionAbstract& session)
 {
-    std::lock_guard<std::mutex> lock(mutex);
+    switch (session.type) {
+      case TCP:
+        return static_cast<Session<TCP>&>(session).comm_fd;
+      case UNIX:
+        return static_cast<Session<UNIX>&>(session).comm_fd;
+      case WEBSOCK:
+        return static_cast<Session<WEBSOCK>&>(session).comm_fd;
+      default:
+        assert(false);
+        return -1;
+    }
+}
 
-    int session_fd = 0;
+void SessionManager::delete_session(SessionID id)
+{
+    // Once retired, shutdown_all() doesn't access the session anymore
+    auto session = sessions.retire(id);
 
-    if (!is_id_in_session_ids(id)) {
+    if (session == nullptr) {
         syslog.print<INFO>("Not allocated session ID: %u\n", id);
         return;
     }
 
-    if (session_pool[id] != nullptr) {
-        switch (session_pool[id]->type) {
-          case TCP:
-            session_fd = cast_to_session<TCP>(session_pool[id])->comm_fd;
-            break;
-          case UNIX:
-            session_fd = cast_to_session<UNIX>(session_pool[id])->comm_fd;
-            break;
-          case WEBSOCK:
-            session_fd = cast_to_session<WEBSOCK>(session_pool[id])->comm_fd;
-            break;
-          default: assert(false);
-        }
+    const int session_fd = get_session_fd(*session);
 
-        if (shutdown(session_fd, SHUT_RDWR) < 0) {
-            syslog.print<WARNING>("Cannot shutdown socket for session ID: %u\n", id);
-        }
-        close(session_fd);
+    if (shutdown(session_fd, SHUT_RDWR) < 0) {
+        syslog.print<WARNING>("Cannot shutdown socket for session ID: %u\n", id);
     }
 
-    session_pool.erase(id);
-    reusable_ids.push_back(id);
-    number_of_sessions--;
+    // The delivery threads write to the socket until they are stopped
+    stream_manager.unsubscribe_all(id);
+    close(session_fd);
+
+    session->~SessionAbstract();
+    sessions.release(id);
 }
 
 void SessionManager::delete_all()
 {
     syslog.print<INFO>("Closing all active sessions ...\n");
-    assert(number_of_sessions == session_pool.size());
 
-    if (!session_pool.empty()) {
-        auto ids = get_session_ids();
-
-        for (auto& id : ids) {
-            syslog.print<INFO>("Delete session %u\n", id);
-            delete_session(id);
-        }
+    for (auto& id : get_session_ids()) {
+        syslog.print<INFO>("Delete session %u\n", id);
+        delete_session(id);
     }
 
-    assert(number_of_sessions == 0);
+    assert(sessions.size() == 0);
 }
 
 void SessionManager::exit_comm()
 {
-    for (auto& session : session_pool) {
-        session.second->exit_comm();
-    }
+    sessions.for_each([](SessionID, SessionAbstract& session) {
+        session.exit_comm();
+    });
 }
 
-} // namespace koheron
+void SessionManager::shutdown_all()
+{
+    sessions.for_each([&](SessionID id, SessionAbstract& session) {
+        session.exit_comm();
 
+        if (shutdown(get_session_fd(session), SHUT_RDWR) < 0) {
+            syslog.print<WARNING>("Cannot shutdown socket for session ID: %u\n", id);
+        }
+    });
+}
+
+} // namespace koheron
@@ -1,20 +1,24 @@
 /// Sessions manager
 ///
+/// The sessions live in a slab of config::max_sessions slots (see slab.hpp).
+/// Opening and closing a session doesn't lock the other sessions,
+/// and the IDs of closed sessions are not reused before the slot
+/// generation wraps around.
+///
 /// (c) Koheron
 
 #ifndef __SESSION_MANAGER_HPP__
 #define __SESSION_MANAGER_HPP__
 
-#include <map>
 #include <vector>
-#include <stack>
-#include <memory>
-#include <mutex>
 
 #include "server_definitions.hpp"
 #include "config.hpp"
 #include "session_abstract.hpp"
 #include "syslog.hpp"
+#include "buffer_pool.hpp"
+#include "streams.hpp"
+#include "slab.hpp"
 
 
 namespace koheron {
@@ -26,63 +30,42 @@ class DriverManager;
 class SessionManager
 {
   public:
-    SessionManager(DriverManager& drv_manager_, SysLog& syslog_);
+    SessionManager(DriverManager& drv_manager_, SysLog& syslog_, BufferPool& buffer_pool_,
+                   StreamManager& stream_manager_);
 
     ~SessionManager();
 
-    static int number_of_sessions;
-
-    size_t get_number_of_sessions() const {return session_pool.size();}
+    size_t get_number_of_sessions() const {return sessions.size();}
 
+    /// Returns the ID of the new session, or -1 if config::max_sessions are open
     template<int socket_type>
     SessionID create_session(int comm_fd);
 
     std::vector<SessionID> get_session_ids();
 
-    SessionAbstract& get_session(SessionID id) const {return *session_pool.at(id);}
+    /// Lock-free. The session must be open (e.g. looked up by its own thread).
+    SessionAbstract& get_session(SessionID id) const {return *sessions.get(id);}
 
     void delete_session(SessionID id);
     void delete_all();
     void exit_comm();
 
+    /// Shutdown the sockets of all the sessions without deleting them.
+    /// Lets the sessions running on the worker pool terminate by themselves.
+    void shutdown_all();
+
     DriverManager& driver_manager;
     SysLog& syslog;
+    BufferPool& buffer_pool;
+    StreamManager& stream_manager;
 
   private:
-    // Sessions pool
-    std::map<SessionID, std::unique_ptr<SessionAbstract>> session_pool;
-    std::vector<SessionID> reusable_ids;
+    // Sessions are constructed in the slab slots
+    Slab<SessionAbstract> sessions;
 
-    bool is_reusable_id(SessionID id);
-    bool is_id_in_session_ids(SessionID id);
-
-    std::mutex mutex;
+    int get_session_fd(SessionAbstract& session);
 };
 
-template<int socket_type>
-SessionID SessionManager::create_session(int comm_fd)
-{
-    std::lock_guard<std::mutex> lock(mutex);
-
-    SessionID new_id;
-
-    // Choose a reusable ID if available else
-    // create a new ID equal to the session number
-    if (reusable_ids.empty()) {
-        new_id = number_of_sessions;
-    } else {
-        new_id = reusable_ids.back();
-        reusable_ids.pop_back();
-    }
-
-    auto session = std::make_unique<Session<socket_type>>(comm_fd, new_id, syslog, driver_manager);
-
-    session_pool.insert(std::pair<SessionID, std::unique_ptr<SessionAbstract>>(new_id,
-                static_cast<std::unique_ptr<SessionAbstract>>(std::move(session))));
-    number_of_sessions++;
-    return new_id;
-}
-
 } // namespace koheron
 
 #endif //__SESSION_MANAGER_HPP__
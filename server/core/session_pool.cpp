@@ -0,0 +1,218 @@
+/// Implementation of session_pool.hpp
+///
+/// (c) Koheron
+
+#include "session_pool.hpp"
+#include "server.hpp"
+#include "session.hpp"
+
+#include <algorithm>
+
+extern "C" {
+  #include <unistd.h>
+}
+
+namespace koheron {
+
+SessionPool::SessionPool(Server *server_)
+: server(server_)
+{}
+
+int SessionPool::start()
+{
+    const auto max_connections = [](int n) { return static_cast<unsigned int>(std::max(n, 0)); };
+
+    const unsigned int n_cores = std::max(1U, std::thread::hardware_concurrency());
+    max_pool_size = max_connections(config::tcp_worker_connections)
+                  + max_connections(config::websocket_worker_connections)
+                  + max_connections(config::unix_socket_worker_connections);
+    const unsigned int n_workers = std::min(max_pool_size,
+                                            std::max(config::session_pool_min_workers,
+                                                     config::session_pool_workers_per_core * n_cores));
+
+    int err = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (unsigned int i = 0; i < n_workers && err == 0; i++) {
+            if (start_worker() < 0) {
+                server->syslog.print<PANIC>("SessionPool: Cannot start worker %u\n", i);
+                err = -1;
+            }
+        }
+
+        update_stats();
+    }
+
+    if (err < 0) {
+        stop();
+        join();
+        return -1;
+    }
+
+    server->syslog.print<INFO>("SessionPool: %u workers started (up to %u)\n", pool_size, max_pool_size);
+    return 0;
+}
+
+// Called with the mutex locked
+int SessionPool::start_worker()
+{
+    try {
+        workers.emplace_back(&SessionPool::worker_loop, this);
+    } catch (const std::system_error&) {
+        return -1;
+    }
+
+    pool_size = static_cast<unsigned int>(workers.size());
+    return 0;
+}
+
+void SessionPool::stop()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+
+    for (auto& admission : queue) {
+        close(admission.comm_fd);
+    }
+
+    queue.clear();
+    update_stats();
+    cond.notify_all();
+}
+
+// Called once stopped: admit() doesn't start workers anymore
+void SessionPool::join()
+{
+    for (auto& worker : workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    workers.clear();
+}
+
+int SessionPool::admit(int comm_fd, int socket_type)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    expire_admissions();
+
+    if (stopping || queue.size() >= config::session_admission_queue_len) {
+        return -1;
+    }
+
+    queue.push_back({comm_fd, socket_type, std::chrono::steady_clock::now()});
+
+    // No idle worker for this connection
+    if (queue.size() > pool_size - busy_workers && pool_size < max_pool_size) {
+        if (start_worker() < 0) {
+            server->syslog.print<WARNING>("SessionPool: Cannot start worker %u\n", pool_size);
+        }
+    }
+
+    update_stats();
+    cond.notify_one();
+    return 0;
+}
+
+void SessionPool::expire()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    expire_admissions();
+}
+
+// Called with the mutex locked
+void SessionPool::expire_admissions()
+{
+    const auto deadline = std::chrono::steady_clock::now()
+                        - std::chrono::milliseconds(config::session_admission_timeout_ms);
+    bool expired = false;
+
+    while (!queue.empty() && queue.front().time < deadline) {
+        server->syslog.print<WARNING>("SessionPool: No worker available, connection closed\n");
+        close(queue.front().comm_fd);
+        queue.pop_front();
+        expired = true;
+    }
+
+    if (expired) {
+        update_stats();
+    }
+}
+
+void SessionPool::worker_loop()
+{
+    while (true) {
+        Admission admission;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [this] { return stopping || !queue.empty(); });
+
+            if (stopping) {
+                return;
+            }
+
+            expire_admissions();
+
+            if (queue.empty()) {
+                continue;
+            }
+
+            admission = queue.front();
+            queue.pop_front();
+            busy_workers++;
+            update_stats();
+        }
+
+        run_session(admission);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busy_workers--;
+            update_stats();
+        }
+    }
+}
+
+void SessionPool::run_session(const Admission& admission)
+{
+    switch (admission.socket_type) {
+      case TCP:
+        session_thread_call<TCP>(admission.comm_fd, &server->tcp_listener);
+        break;
+      case UNIX:
+        session_thread_call<UNIX>(admission.comm_fd, &server->unix_listener);
+        break;
+      case WEBSOCK:
+        session_thread_call<WEBSOCK>(admission.comm_fd, &server->websock_listener);
+        break;
+      default:
+        close(admission.comm_fd);
+    }
+}
+
+// Called with the mutex locked
+void SessionPool::update_stats()
+{
+    const auto n_queued = [&](int socket_type) {
+        return static_cast<int>(std::count_if(queue.begin(), queue.end(),
+                    [=](const Admission& admission) { return admission.socket_type == socket_type; }));
+    };
+
+    const auto update = [&](auto& stats, int socket_type) {
+        stats.number_of_queued_sessions = n_queued(socket_type);
+        stats.pool_workers = static_cast<int>(pool_size);
+        stats.pool_busy_workers = static_cast<int>(busy_workers);
+        stats.pool_queue_depth = static_cast<int>(queue.size());
+    };
+
+    update(server->tcp_listener.stats, TCP);
+    update(server->websock_listener.stats, WEBSOCK);
+    update(server->unix_listener.stats, UNIX);
+}
+
+} // namespace koheron
@@ -0,0 +1,79 @@
+/// Sessions worker pool
+///
+/// The worker threads are spawned when the server starts, so
+/// that accepting a connection doesn't create a thread.
+/// Each worker runs one session at a time. When all the workers are
+/// busy, the pool grows up to the number of connections allowed by the
+/// listeners. The connections wait for a worker in a bounded admission
+/// queue, and are closed after config::session_admission_timeout_ms.
+///
+/// (c) Koheron
+
+#ifndef __KOHERON_SESSION_POOL_HPP__
+#define __KOHERON_SESSION_POOL_HPP__
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "server_definitions.hpp"
+#include "config.hpp"
+
+namespace koheron {
+
+class Server;
+
+class SessionPool
+{
+  public:
+    explicit SessionPool(Server *server_);
+
+    int start();
+
+    /// Stop admitting connections and close the queued ones
+    void stop();
+
+    /// Wait for the workers to terminate
+    void join();
+
+    /// Queue an accepted connection.
+    /// Returns -1 if the admission queue is full.
+    int admit(int comm_fd, int socket_type);
+
+    /// Close the connections waiting for too long
+    void expire();
+
+    unsigned int number_of_workers() const {return pool_size;}
+
+  private:
+    struct Admission
+    {
+        int comm_fd;
+        int socket_type;
+        std::chrono::steady_clock::time_point time;
+    };
+
+    Server *server;
+    unsigned int pool_size = 0;
+    unsigned int max_pool_size = 0;
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<Admission> queue;
+    unsigned int busy_workers = 0;
+    bool stopping = false;
+
+    int start_worker();
+    void worker_loop();
+    void expire_admissions();
+    void run_session(const Admission& admission);
+    void update_stats();
+};
+
+} // namespace koheron
+
+#endif // __KOHERON_SESSION_POOL_HPP__
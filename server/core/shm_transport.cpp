@@ -0,0 +1,205 @@
+/// Implementation of shm_transport.hpp
+///
+/// (c) Koheron
+
+#include "shm_transport.hpp"
+#include "serializer_deserializer.hpp"
+#include "reactor.hpp"
+
+#include <array>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+
+extern "C" {
+  #include <unistd.h>
+  #include <fcntl.h>
+  #include <poll.h>
+  #include <sys/mman.h>
+  #include <sys/socket.h>
+  #include <sys/syscall.h>
+}
+
+#ifndef MFD_CLOEXEC
+# define MFD_CLOEXEC 0x0001U
+# define MFD_ALLOW_SEALING 0x0002U
+#endif
+
+namespace koheron {
+
+int SharedMemoryTransport::open()
+{
+#ifdef SYS_memfd_create
+    const int fd = static_cast<int>(syscall(SYS_memfd_create, "koheron-shm", MFD_CLOEXEC | MFD_ALLOW_SEALING));
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (ftruncate(fd, region_size) < 0) {
+        ::close(fd);
+        return -1;
+    }
+
+#ifdef F_ADD_SEALS
+    // The client can't shrink the region under the server mapping
+    fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+#endif
+
+    void *addr = mmap(nullptr, region_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (addr == MAP_FAILED) {
+        ::close(fd);
+        return -1;
+    }
+
+    base = static_cast<unsigned char*>(addr);
+    request_data = nullptr;
+    response_head = 0;
+    return fd;
+#else
+    return -1; // No memfd
+#endif
+}
+
+void SharedMemoryTransport::close()
+{
+    if (base != nullptr) {
+        munmap(base, region_size);
+        base = nullptr;
+        request_data = nullptr;
+    }
+}
+
+int SharedMemoryTransport::begin_request(uint32_t position, uint32_t size)
+{
+    const uint32_t offset = position & (ring_size - 1);
+
+    if (size > ring_size - offset) {
+        return -1;
+    }
+
+    request_data = request_ring() + offset;
+    request_size = size;
+    request_read = 0;
+    request_end = position + size;
+    return 0;
+}
+
+int64_t SharedMemoryTransport::read(char *buffer, int64_t n_bytes)
+{
+    if (n_bytes < 0 || static_cast<uint64_t>(n_bytes) > request_size - request_read) {
+        return -1;
+    }
+
+    std::memcpy(buffer, request_data + request_read, static_cast<size_t>(n_bytes));
+    request_read += n_bytes;
+
+    // Released as soon as consumed, so that the client can reuse the room
+    if (request_read == request_size) {
+        end_request();
+    }
+
+    return n_bytes;
+}
+
+void SharedMemoryTransport::end_request()
+{
+    if (request_data != nullptr) {
+        __atomic_store_n(released(0), request_end, __ATOMIC_RELEASE);
+        request_data = nullptr;
+    }
+}
+
+bool SharedMemoryTransport::write_response(IovecBuffer& message, IovecBuffer& doorbell)
+{
+    if (message.size() > ring_size) {
+        return false;
+    }
+
+    const uint32_t size = message.size();
+    uint32_t position = response_head;
+    uint32_t offset = position & (ring_size - 1);
+
+    // Payloads don't wrap around
+    if (offset + size > ring_size) {
+        position += ring_size - offset;
+        offset = 0;
+    }
+
+    const uint32_t end = position + size;
+    const uint32_t released_position = __atomic_load_n(released(64), __ATOMIC_ACQUIRE);
+
+    if (end - released_position > ring_size) {
+        return false;
+    }
+
+    unsigned char *dst = response_ring() + offset;
+
+    for (const auto& iov : message.iovecs()) {
+        std::memcpy(dst, iov.iov_base, iov.iov_len);
+        dst += iov.iov_len;
+    }
+
+    // The doorbell has the class and function ids of the response
+    constexpr size_t header_size = 8;
+    std::array<unsigned char, 16> bytes;
+    std::memcpy(bytes.data(), response_ring() + offset, header_size);
+    koheron::append<uint32_t>(bytes.data(), SHM_DOORBELL);
+    koheron::append<uint32_t>(bytes.data() + 8, position);
+    koheron::append<uint32_t>(bytes.data() + 12, size);
+
+    doorbell.clear();
+    doorbell.append(bytes.data(), bytes.size());
+    response_head = end;
+    return true;
+}
+
+int64_t sendmsg_with_fd(int comm_fd, struct iovec *iov, size_t iovcnt, int fd, int flags)
+{
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+
+    std::memset(&control, 0, sizeof(control));
+
+    struct msghdr msg{};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = std::min(iovcnt, static_cast<size_t>(IOV_MAX));
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    struct cmsghdr *cmsg = &control.align;
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+    return sendmsg(comm_fd, &msg, flags | MSG_NOSIGNAL);
+}
+
+int64_t send_with_fd(int comm_fd, struct iovec *iov, size_t iovcnt, int fd)
+{
+    // The descriptor is received with the first bytes
+    int64_t n;
+
+    do {
+        n = sendmsg_with_fd(comm_fd, iov, iovcnt, fd);
+    } while (n < 0 && would_block(errno) && wait_socket(comm_fd, POLLOUT) == 0);
+
+    if (n <= 0) {
+        return n;
+    }
+
+    advance_iovecs(iov, iovcnt, static_cast<size_t>(n));
+
+    if (iovcnt == 0) {
+        return n;
+    }
+
+    const auto rest = writev_all(comm_fd, iov, iovcnt);
+    return rest <= 0 ? rest : n + rest;
+}
+
+} // namespace koheron
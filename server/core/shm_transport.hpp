@@ -0,0 +1,125 @@
+/// Shared memory transport
+///
+/// Local clients connected on the Unix socket can map a memory region
+/// shared with their session (KServer open_shared_memory operation).
+/// The session creates a memfd and passes it with the response (SCM_RIGHTS).
+/// The large requests payloads and responses are then written in the region,
+/// and the socket only carries a doorbell with their position and size.
+///
+/// Region:
+/// | control (4 kB) | request ring (shm_ring_size) | response ring (shm_ring_size) |
+///
+/// The control page holds the released position of each ring (u32, native byte order):
+/// - offset 0: request ring, written by the server once the payload is read
+/// - offset 64: response ring, written by the client once the payload is read
+///
+/// Positions count the bytes written in a ring modulo 2^32, the payload
+/// offset in the ring is position % shm_ring_size. A payload never wraps
+/// around: if it doesn't fit before the end of the ring, it starts at the
+/// beginning, and the skipped bytes are released with it.
+/// The writer checks that (position + size) - released <= shm_ring_size,
+/// and sends the payload through the socket if the ring is full.
+///
+/// Request doorbell (the payload is read from the request ring):
+/// |  RESERVED = 3     | dev_id  |  op_id  |     position      |       size        |
+/// |  0 |  1 |  2 |  3 |  4 |  5 |  6 |  7 |  8 |  9 | 10 | 11 | 12 | 13 | 14 | 15 |
+///
+/// Response doorbell (the whole response, header included, is in the response ring):
+/// |  RESERVED = 3     | class_id | func_id |     position      |       size        |
+/// |  0 |  1 |  2 |  3 |  4 |  5  |  6 |  7 |  8 |  9 | 10 | 11 | 12 | 13 | 14 | 15 |
+///
+/// The client releases a response by writing position + size
+/// at the response released position.
+///
+/// (c) Koheron
+
+#ifndef __KOHERON_SHM_TRANSPORT_HPP__
+#define __KOHERON_SHM_TRANSPORT_HPP__
+
+#include <cstdint>
+#include <cstddef>
+
+#include "iovec.hpp"
+#include "config.hpp"
+
+namespace koheron {
+
+/// Value of the reserved header field of the shared memory doorbells
+constexpr uint32_t SHM_DOORBELL = 3;
+
+class SharedMemoryTransport
+{
+  public:
+    static constexpr size_t control_size = 4096;
+    static constexpr size_t ring_size = config::shm_ring_size;
+    static constexpr size_t region_size = control_size + 2 * ring_size;
+
+    static_assert((ring_size & (ring_size - 1)) == 0, "shm_ring_size must be a power of two");
+
+    ~SharedMemoryTransport() {close();}
+
+    /// Create and map the shared region.
+    /// Returns the memfd to pass to the client (to be closed once sent), or -1.
+    int open();
+
+    void close();
+
+    bool is_open() const {return base != nullptr;}
+
+    /// Bytes of the mapped region
+    size_t memory_size() const {return is_open() ? region_size : 0;}
+
+    // Requests
+
+    /// Start reading a request payload from the request ring.
+    /// Returns -1 if the payload is not inside the ring.
+    int begin_request(uint32_t position, uint32_t size);
+
+    /// True while the payload of the current command is read from the ring
+    bool in_request() const {return request_data != nullptr;}
+
+    /// Copy the next n_bytes of the request payload.
+    /// Returns -1 if the payload is shorter.
+    int64_t read(char *buffer, int64_t n_bytes);
+
+    /// Release the request payload to the client
+    void end_request();
+
+    // Responses
+
+    /// Copy the message into the response ring, and build its doorbell.
+    /// Returns false if the ring is full.
+    bool write_response(IovecBuffer& message, IovecBuffer& doorbell);
+
+  private:
+    unsigned char *base = nullptr;
+
+    const unsigned char *request_data = nullptr;
+    uint32_t request_size = 0;
+    uint32_t request_read = 0;
+    uint32_t request_end = 0;     ///< Position released with the current request
+
+    uint32_t response_head = 0;   ///< Position of the next response
+
+    uint32_t *released(size_t offset) {
+        #pragma GCC diagnostic push
+        #pragma GCC diagnostic ignored "-Wcast-align"
+        return reinterpret_cast<uint32_t*>(base + offset);
+        #pragma GCC diagnostic pop
+    }
+
+    unsigned char *request_ring() {return base + control_size;}
+    unsigned char *response_ring() {return base + control_size + ring_size;}
+};
+
+/// Single sendmsg of a list of buffers with a file descriptor attached (SCM_RIGHTS).
+/// Same return values than sendmsg(2).
+int64_t sendmsg_with_fd(int comm_fd, struct iovec *iov, size_t iovcnt, int fd, int flags = 0);
+
+/// Send a list of buffers with a file descriptor attached (SCM_RIGHTS).
+/// Returns the number of bytes sent, 0 if the connection is closed, -1 on error.
+int64_t send_with_fd(int comm_fd, struct iovec *iov, size_t iovcnt, int fd);
+
+} // namespace koheron
+
+#endif // __KOHERON_SHM_TRANSPORT_HPP__
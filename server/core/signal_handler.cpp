@@ -24,7 +24,8 @@ int SignalHandler::init(Server *server_)
 
     if (set_interrupt_signals() < 0 ||
         set_ignore_signals()   < 0 ||
-        set_crash_signals()    < 0)
+        set_crash_signals()    < 0 ||
+        set_trace_signal()     < 0)
         return -1;
 
     return 0;
@@ -60,6 +61,62 @@ int SignalHandler::set_interrupt_signals()
     return 0;
 }
 
+// Trace dump signal
+//
+// SIGUSR1 would interrupt the blocking calls of the sessions:
+// it is blocked in the server threads and received by the main thread.
+
+int volatile SignalHandler::s_trace_requested = 0;
+
+static void trace_signal_handler(int)
+{
+    SignalHandler::s_trace_requested = 1;
+}
+
+static sigset_t trace_signal_set()
+{
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    return set;
+}
+
+int SignalHandler::set_trace_signal()
+{
+    struct sigaction sig_trace_handler{};
+
+    sig_trace_handler.sa_handler = trace_signal_handler;
+    sigemptyset(&sig_trace_handler.sa_mask);
+    sig_trace_handler.sa_flags = SA_RESTART;
+
+    if (sigaction(SIGUSR1, &sig_trace_handler, nullptr) < 0) {
+        server->syslog.print<CRITICAL>("Cannot set SIGUSR1 handler\n");
+        return -1;
+    }
+
+    // Inherited by the threads started from now on
+    const auto set = trace_signal_set();
+
+    if (pthread_sigmask(SIG_BLOCK, &set, nullptr) != 0) {
+        server->syslog.print<CRITICAL>("Cannot block SIGUSR1\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+int SignalHandler::unblock_trace_signal()
+{
+    const auto set = trace_signal_set();
+
+    if (pthread_sigmask(SIG_UNBLOCK, &set, nullptr) != 0) {
+        server->syslog.print<ERROR>("Cannot unblock SIGUSR1\n");
+        return -1;
+    }
+
+    return 0;
+}
+
 // Ignored signals
 
 int SignalHandler::set_ignore_signals()
@@ -124,6 +181,8 @@ static void crash_signal_handler(int sig)
         sig_name = "(Unidentify signal)";
     }
 
+    // The server exits before the log rings are drained
+    SignalHandler::server->syslog.write_immediately();
     SignalHandler::server->syslog.print<PANIC>(
                               "CRASH: signal %d %s\n", sig, sig_name);
 
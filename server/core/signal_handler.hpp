@@ -16,13 +16,29 @@ class SignalHandler
 
     bool interrupt() const {return s_interrupted != 0;}
 
+    /// True once after SIGUSR1 (trace dump request)
+    bool trace_requested() {
+        if (s_trace_requested == 0) {
+            return false;
+        }
+
+        s_trace_requested = 0;
+        return true;
+    }
+
+    /// Receive SIGUSR1 on the calling thread.
+    /// It is blocked in the threads started after init.
+    int unblock_trace_signal();
+
     static int volatile s_interrupted;
+    static int volatile s_trace_requested;
     static Server *server;
 
   private:
     int set_interrupt_signals();
     int set_ignore_signals();
     int set_crash_signals();
+    int set_trace_signal();
 };
 
 } // namespace koheron
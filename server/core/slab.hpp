@@ -0,0 +1,208 @@
+/// Fixed-capacity slab of objects with generation-tagged IDs
+///
+/// The objects are constructed in place in the slots of a single
+/// allocation. An ID packs the slot index (low bits) and the generation
+/// of the slot, which is incremented each time the slot is released,
+/// so that a stale ID never designates the next object of the slot.
+/// IDs are non-negative ints, -1 stands for no object.
+///
+/// The free slots are kept in a lock-free stack. Lookups don't lock:
+/// - get() is for the owner of the object, which is the only one releasing it.
+/// - for_each() pins each slot it visits. retire() unpublishes the slot,
+///   then waits for the visitors pinning it before returning the object.
+///
+/// (c) Koheron
+
+#ifndef __KOHERON_SLAB_HPP__
+#define __KOHERON_SLAB_HPP__
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <thread>
+
+namespace koheron {
+
+template<typename Base>
+class Slab
+{
+  public:
+    Slab(size_t capacity_, size_t object_size, size_t object_align)
+    : capacity(capacity_ > 0 ? capacity_ : 1)
+    , index_bits(bit_width(capacity - 1))
+    , generation_mask((1U << (31 - index_bits)) - 1)
+    , align(object_align)
+    , stride((object_size + object_align - 1) / object_align * object_align)
+    , slots(std::make_unique<Slot[]>(capacity))
+    , storage(::operator new(capacity * stride, std::align_val_t(align)))
+    {
+        // All the slots are free
+        for (size_t i = 0; i < capacity; i++) {
+            slots[i].next.store(i + 1 < capacity ? uint32_t(i + 2) : 0);
+        }
+
+        free_head.store(1);
+    }
+
+    ~Slab() {
+        ::operator delete(storage, std::align_val_t(align));
+    }
+
+    Slab(const Slab&) = delete;
+    Slab& operator=(const Slab&) = delete;
+
+    size_t get_capacity() const {return capacity;}
+    size_t size() const {return count.load();}
+    size_t memory_size() const {return capacity * (stride + sizeof(Slot));}
+
+    /// Reserve a free slot. Returns the ID of the next object, or -1 if the slab is full.
+    int allocate() {
+        uint64_t head = free_head.load(std::memory_order_acquire);
+        uint32_t index;
+
+        do {
+            if (uint32_t(head) == 0) {
+                return -1;
+            }
+
+            index = uint32_t(head) - 1;
+
+            // The tag in the high bits prevents ABA
+            const uint64_t next = ((head >> 32) + 1) << 32 | slots[index].next.load();
+
+            if (free_head.compare_exchange_weak(head, next, std::memory_order_acq_rel,
+                                                std::memory_order_acquire)) {
+                break;
+            }
+        } while (true);
+
+        return int(slots[index].generation << index_bits | index);
+    }
+
+    /// Memory for the object of a reserved ID
+    void* get_storage(int id) const {
+        return static_cast<unsigned char*>(storage) + slot_index(id) * stride;
+    }
+
+    /// Make the object constructed in the storage of a reserved ID visible
+    void publish(int id, Base *object) {
+        auto& slot = slots[slot_index(id)];
+        slot.object = object;
+        count++;
+        slot.id.store(id, std::memory_order_release);
+    }
+
+    /// Object of an ID (nullptr if not published)
+    Base* get(int id) const {
+        if (id < 0 || slot_index(id) >= capacity) {
+            return nullptr;
+        }
+
+        const auto& slot = slots[slot_index(id)];
+        return slot.id.load(std::memory_order_acquire) == id ? slot.object : nullptr;
+    }
+
+    /// Call f(id, object) on each published object
+    template<typename F>
+    void for_each(F&& f) {
+        for (size_t i = 0; i < capacity; i++) {
+            auto& slot = slots[i];
+
+            if (slot.id.load(std::memory_order_relaxed) < 0) {
+                continue;
+            }
+
+            slot.readers++;
+            const int id = slot.id.load();
+
+            if (id >= 0) {
+                f(id, *slot.object);
+            }
+
+            slot.readers--;
+        }
+    }
+
+    /// Unpublish an object.
+    /// Returns the object once for_each() doesn't visit it anymore,
+    /// nullptr if the ID is not published. The caller destroys the
+    /// object then releases the ID.
+    Base* retire(int id) {
+        if (id < 0 || slot_index(id) >= capacity) {
+            return nullptr;
+        }
+
+        auto& slot = slots[slot_index(id)];
+        int expected = id;
+
+        if (!slot.id.compare_exchange_strong(expected, -1)) {
+            return nullptr;
+        }
+
+        while (slot.readers.load() > 0) {
+            std::this_thread::yield();
+        }
+
+        count--;
+        return slot.object;
+    }
+
+    /// Return the slot of a retired ID to the free slots
+    void release(int id) {
+        const uint32_t index = slot_index(id);
+        auto& slot = slots[index];
+        slot.object = nullptr;
+        slot.generation = (slot.generation + 1) & generation_mask;
+
+        uint64_t head = free_head.load(std::memory_order_relaxed);
+        uint64_t next;
+
+        do {
+            slot.next.store(uint32_t(head));
+            next = ((head >> 32) + 1) << 32 | (index + 1);
+        } while (!free_head.compare_exchange_weak(head, next, std::memory_order_release,
+                                                  std::memory_order_relaxed));
+    }
+
+  private:
+    struct alignas(64) Slot {
+        std::atomic<int> id{-1};            // Published ID, -1 if none
+        std::atomic<uint32_t> readers{0};   // Visitors pinning the slot
+        std::atomic<uint32_t> next{0};      // Next free slot (index + 1, 0 for none)
+        uint32_t generation = 0;
+        Base *object = nullptr;
+    };
+
+    static uint32_t bit_width(size_t value) {
+        uint32_t width = 1;
+
+        while ((value >> width) != 0) {
+            width++;
+        }
+
+        return width;
+    }
+
+    uint32_t slot_index(int id) const {
+        return uint32_t(id) & ((1U << index_bits) - 1);
+    }
+
+    const size_t capacity;
+    const uint32_t index_bits;
+    const uint32_t generation_mask;
+    const size_t align;
+    const size_t stride;
+
+    std::unique_ptr<Slot[]> slots;
+    void *storage;
+
+    // Free slots stack: | tag (32 bits) | index + 1 (32 bits) |
+    std::atomic<uint64_t> free_head{0};
+    std::atomic<size_t> count{0};
+};
+
+} // namespace koheron
+
+#endif // __KOHERON_SLAB_HPP__
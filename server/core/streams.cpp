@@ -0,0 +1,259 @@
+/// Implementation of streams.hpp
+///
+/// (c) Koheron
+
+#include "streams.hpp"
+#include "session.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace koheron {
+
+// Frames pushed to a session
+class SessionSink : public StreamSink
+{
+  public:
+    explicit SessionSink(SessionAbstract& session_)
+    : session(session_)
+    {}
+
+    int deliver(const StreamFrame& frame) override {
+        return session.push(frame->bytes);
+    }
+
+  private:
+    SessionAbstract& session;
+};
+
+//----------------------------------------------------------------------------
+// Subscription
+//----------------------------------------------------------------------------
+
+void Subscription::start()
+{
+    thread = std::thread{&Subscription::delivery_thread, this};
+}
+
+void Subscription::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        queue.clear();
+    }
+
+    not_empty.notify_all();
+    not_full.notify_all();
+
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void Subscription::push(const StreamFrame& frame)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if (closed) {
+        return;
+    }
+
+    if (queue.size() >= queue_length) {
+        switch (policy) {
+          case DROP_OLDEST:
+            queue.pop_front();
+            frames_dropped++;
+            break;
+          case DROP_NEWEST:
+            frames_dropped++;
+            return;
+          case BLOCK:
+            if (!not_full.wait_for(lock, std::chrono::milliseconds(config::stream_block_timeout_ms),
+                                   [&] {return closed || queue.size() < queue_length;})) {
+                frames_dropped++;
+                return;
+            }
+
+            if (closed) {
+                return;
+            }
+
+            break;
+          case stream_policy_num:
+          default:
+            return;
+        }
+    }
+
+    queue.push_back(frame);
+    lock.unlock();
+    not_empty.notify_one();
+}
+
+void Subscription::delivery_thread()
+{
+    while (true) {
+        StreamFrame frame;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            not_empty.wait(lock, [&] {return closed || !queue.empty();});
+
+            if (closed) {
+                return;
+            }
+
+            frame = std::move(queue.front());
+            queue.pop_front();
+        }
+
+        not_full.notify_one();
+
+        if (sink->deliver(frame) <= 0) {
+            // The session is closing: the publishers must not wait anymore
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                closed = true;
+                queue.clear();
+            }
+
+            not_full.notify_all();
+            return;
+        }
+
+        frames_sent++;
+    }
+}
+
+//----------------------------------------------------------------------------
+// Stream manager
+//----------------------------------------------------------------------------
+
+int StreamManager::subscribe(SessionAbstract& session, SessionID sid, uint32_t stream,
+                             StreamPolicy policy, size_t queue_length)
+{
+    return subscribe(static_cast<SubscriberID>(sid), stream, policy, queue_length,
+                     std::make_unique<SessionSink>(session));
+}
+
+int StreamManager::subscribe(SubscriberID id, uint32_t stream, StreamPolicy policy,
+                             size_t queue_length, std::unique_ptr<StreamSink> sink)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& subscribers = streams[stream];
+
+    for (const auto& subscriber : subscribers) {
+        if (subscriber.id == id) {
+            return -1;
+        }
+    }
+
+    auto subscription = std::make_shared<Subscription>(std::move(sink), policy, queue_length);
+    subscription->start();
+    subscribers.push_back({id, std::move(subscription)});
+    number_of_subscriptions++;
+    return 0;
+}
+
+int StreamManager::unsubscribe(SubscriberID id, uint32_t stream, uint64_t& frames_sent, uint64_t& frames_dropped)
+{
+    std::shared_ptr<Subscription> subscription;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = streams.find(stream);
+
+        if (it == streams.end()) {
+            return -1;
+        }
+
+        auto& subscribers = it->second;
+        auto subscriber = std::find_if(subscribers.begin(), subscribers.end(),
+                                       [&](const Subscriber& s) {return s.id == id;});
+
+        if (subscriber == subscribers.end()) {
+            return -1;
+        }
+
+        subscription = std::move(subscriber->subscription);
+        subscribers.erase(subscriber);
+        number_of_subscriptions--;
+
+        if (subscribers.empty()) {
+            streams.erase(it);
+        }
+    }
+
+    // Stopped out of the lock: the delivery thread may be
+    // waiting for the socket, and a publisher for room in the queue.
+    subscription->stop();
+    frames_sent = subscription->get_frames_sent();
+    frames_dropped = subscription->get_frames_dropped();
+    return 0;
+}
+
+void StreamManager::unsubscribe_all(SubscriberID id)
+{
+    std::vector<std::shared_ptr<Subscription>> subscriptions;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (auto it = streams.begin(); it != streams.end();) {
+            auto& subscribers = it->second;
+
+            for (auto subscriber = subscribers.begin(); subscriber != subscribers.end();) {
+                if (subscriber->id == id) {
+                    subscriptions.push_back(std::move(subscriber->subscription));
+                    subscriber = subscribers.erase(subscriber);
+                    number_of_subscriptions--;
+                } else {
+                    ++subscriber;
+                }
+            }
+
+            it = subscribers.empty() ? streams.erase(it) : std::next(it);
+        }
+    }
+
+    for (auto& subscription : subscriptions) {
+        subscription->stop();
+    }
+}
+
+bool StreamManager::has_subscribers(uint32_t stream)
+{
+    if (number_of_subscriptions == 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    return streams.find(stream) != streams.end();
+}
+
+void StreamManager::publish(uint32_t stream, const StreamFrame& frame)
+{
+    // Pushed out of the lock: with the BLOCK policy
+    // the publisher waits for the subscribers.
+    std::vector<std::shared_ptr<Subscription>> subscriptions;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = streams.find(stream);
+
+        if (it == streams.end()) {
+            return;
+        }
+
+        for (const auto& subscriber : it->second) {
+            subscriptions.push_back(subscriber.subscription);
+        }
+    }
+
+    for (auto& subscription : subscriptions) {
+        subscription->push(frame);
+    }
+}
+
+} // namespace koheron
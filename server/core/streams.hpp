@@ -0,0 +1,201 @@
+/// Server-push streams
+///
+/// The drivers publish frames from their acquisition threads
+/// (see ContextBase::publish). A frame is serialized as the response
+/// to one of the driver operations, so the clients decode it like
+/// the response to that operation (e.g. the frames of the FFT
+/// read_psd stream are spectra).
+///
+/// A session subscribes to the stream of an operation with the
+/// KServer subscribe operation. Each new frame is then pushed to the
+/// session without the client having to poll.
+///
+/// Each subscription has a bounded queue of frames, sent by its
+/// own delivery thread. When the queue is full, the policy chosen
+/// by the client applies:
+/// - DROP_OLDEST: the oldest queued frame is dropped (the client gets the latest data)
+/// - DROP_NEWEST: the new frame is dropped
+/// - BLOCK: the publisher waits for room in the queue, up to
+///          config::stream_block_timeout_ms, then drops the new frame.
+///
+/// Stream frame:
+/// |  RESERVED = 2     | class_id | func_id |      payload size     | payload
+/// |  0 |  1 |  2 |  3 |  4 |  5  |  6 |  7 |  8 |  9 | 10 | 11 | 12 ...
+///
+/// The payload is the response payload of the operation.
+/// The size allows the clients to queue the frames received
+/// while waiting for a response.
+///
+/// The streams can also be sent over UDP (see udp_channel.hpp).
+///
+/// (c) Koheron
+
+#ifndef __KOHERON_STREAMS_HPP__
+#define __KOHERON_STREAMS_HPP__
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <tuple>
+#include <utility>
+#include <chrono>
+
+#include "server_definitions.hpp"
+#include "config.hpp"
+#include "serializer_deserializer.hpp"
+
+namespace koheron {
+
+class SessionAbstract;
+
+/// Backpressure policy of a subscription
+enum StreamPolicy : uint32_t {
+    DROP_OLDEST = 0,
+    DROP_NEWEST = 1,
+    BLOCK = 2,
+    stream_policy_num
+};
+
+/// Value of the reserved header field of the stream frames
+constexpr uint32_t STREAM_FRAME = 2;
+
+/// Stream id of an operation
+constexpr uint32_t stream_id(uint16_t class_id, uint16_t func_id) {
+    return (uint32_t(class_id) << 16) + func_id;
+}
+
+/// Serialized frame, shared by the queues of all the subscribers
+struct StreamFrameData
+{
+    std::vector<unsigned char> bytes;  ///< Stream frame (header and payload)
+    uint64_t timestamp;                ///< Publication time (ns since the epoch)
+};
+
+using StreamFrame = std::shared_ptr<const StreamFrameData>;
+
+/// Serialize a frame of the stream of operation (class_id, func_id)
+template<uint16_t class_id, uint16_t func_id, typename... Args>
+StreamFrame make_stream_frame(Args&&... args)
+{
+    std::vector<unsigned char> response;
+    DynamicSerializer<1024> serializer;
+    serializer.build_command<class_id, func_id>(response, std::forward<Args>(args)...);
+
+    constexpr size_t header_size = 8;
+    const uint32_t payload_size = response.size() - header_size;
+    const auto header_fields = std::make_tuple(STREAM_FRAME, class_id, func_id, payload_size);
+    const auto header = serialize(header_fields);
+
+    auto frame = std::make_shared<StreamFrameData>();
+    frame->timestamp = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::system_clock::now().time_since_epoch()).count());
+    frame->bytes.reserve(header.size() + response.size() - header_size);
+    frame->bytes.insert(frame->bytes.end(), header.begin(), header.end());
+    frame->bytes.insert(frame->bytes.end(), response.begin() + header_size, response.end());
+    return frame;
+}
+
+/// Destination of the frames of a subscription
+class StreamSink
+{
+  public:
+    virtual ~StreamSink() = default;
+
+    /// Called by the delivery thread.
+    /// Returns 0 or less once the frames can't be delivered anymore.
+    virtual int deliver(const StreamFrame& frame) = 0;
+};
+
+/// Subscribers: sessions (the session ID) or UDP clients (see udp_channel.hpp)
+using SubscriberID = uint64_t;
+
+class Subscription
+{
+  public:
+    Subscription(std::unique_ptr<StreamSink> sink_, StreamPolicy policy_, size_t queue_length_)
+    : sink(std::move(sink_))
+    , policy(policy_)
+    , queue_length(queue_length_)
+    {}
+
+    ~Subscription() {stop();}
+
+    /// Start the delivery thread
+    void start();
+
+    /// Stop the delivery. The queued frames are discarded.
+    void stop();
+
+    /// Queue a frame, applying the backpressure policy if the queue is full
+    void push(const StreamFrame& frame);
+
+    uint64_t get_frames_sent() const {return frames_sent;}
+    uint64_t get_frames_dropped() const {return frames_dropped;}
+
+  private:
+    std::unique_ptr<StreamSink> sink;
+    const StreamPolicy policy;
+    const size_t queue_length;
+
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<StreamFrame> queue;
+    bool closed = false;  ///< Stopped, or the session can't be written anymore
+    std::thread thread;
+
+    std::atomic<uint64_t> frames_sent{0};
+    std::atomic<uint64_t> frames_dropped{0};
+
+    void delivery_thread();
+};
+
+class StreamManager
+{
+  public:
+    /// Subscribe the session to a stream.
+    /// Returns -1 if the session is already subscribed to it.
+    int subscribe(SessionAbstract& session, SessionID sid, uint32_t stream,
+                  StreamPolicy policy, size_t queue_length);
+
+    /// Subscribe a sink to a stream.
+    /// Returns -1 if the subscriber is already subscribed to it.
+    int subscribe(SubscriberID id, uint32_t stream, StreamPolicy policy,
+                  size_t queue_length, std::unique_ptr<StreamSink> sink);
+
+    /// Returns -1 if the subscriber is not subscribed to the stream.
+    /// Once it returns, no more frame of the stream is sent to the subscriber.
+    int unsubscribe(SubscriberID id, uint32_t stream, uint64_t& frames_sent, uint64_t& frames_dropped);
+
+    /// Remove all the subscriptions of a subscriber
+    void unsubscribe_all(SubscriberID id);
+
+    /// Fast check for the publishers, to skip the serialization of unsubscribed frames
+    bool has_subscribers(uint32_t stream);
+
+    /// Queue the frame for all the subscribers of the stream
+    void publish(uint32_t stream, const StreamFrame& frame);
+
+    size_t get_number_of_subscriptions() const {return number_of_subscriptions;}
+
+  private:
+    struct Subscriber
+    {
+        SubscriberID id;
+        std::shared_ptr<Subscription> subscription;
+    };
+
+    std::mutex mutex;
+    std::map<uint32_t, std::vector<Subscriber>> streams;
+    std::atomic<size_t> number_of_subscriptions{0};
+};
+
+} // namespace koheron
+
+#endif // __KOHERON_STREAMS_HPP__
@@ -4,6 +4,7 @@
 #define __STRING_UTILS_HPP__
 
 #include <cstring>
+#include <stdexcept>
 #include <string>
 #include <array>
 #include <syslog.h>
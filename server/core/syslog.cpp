@@ -0,0 +1,114 @@
+/// Implementation of syslog.hpp
+///
+/// (c) Koheron
+
+#include "syslog.hpp"
+
+#include <chrono>
+
+namespace koheron {
+
+// Ring of the thread, released with the thread
+struct ThreadLogRing
+{
+    const SysLog *owner = nullptr;
+    std::shared_ptr<LogRing> ring;
+
+    ~ThreadLogRing() {
+        if (ring != nullptr) {
+            ring->orphaned.store(true, std::memory_order_release);
+        }
+    }
+};
+
+static thread_local ThreadLogRing thread_log_ring;
+
+LogRing* SysLog::thread_ring()
+{
+    auto& local = thread_log_ring;
+
+    if (local.owner != this) {
+        if (local.ring != nullptr) {
+            local.ring->orphaned.store(true, std::memory_order_release);
+        }
+
+        local.ring = std::make_shared<LogRing>();
+        local.owner = this;
+
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        rings.push_back(local.ring);
+    }
+
+    return local.ring.get();
+}
+
+void SysLog::drain_loop()
+{
+    while (drain_running.load()) {
+        drain();
+        std::this_thread::sleep_for(std::chrono::milliseconds(config::log::drain_period_ms));
+    }
+}
+
+void SysLog::drain()
+{
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        drained_rings = rings;
+    }
+
+    for (auto& ring : drained_rings) {
+        uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+        const uint32_t head = ring->head.load(std::memory_order_acquire);
+
+        for (; tail != head; tail++) {
+            const auto& record = ring->records[tail % config::log::ring_records];
+            record.format(*this, record);
+        }
+
+        ring->tail.store(tail, std::memory_order_release);
+
+        const uint64_t dropped = ring->dropped.load(std::memory_order_relaxed);
+
+        if (dropped != ring->dropped_reported) {
+            const auto n = dropped - ring->dropped_reported;
+            ring->dropped_reported = dropped;
+            number_of_dropped += n;
+            write<WARNING>("SysLog: %llu messages dropped\n", static_cast<unsigned long long>(n));
+        }
+    }
+
+    drained_rings.clear();
+
+    // Release the rings of the exited threads once empty
+    std::lock_guard<std::mutex> lock(rings_mutex);
+
+    for (auto it = rings.begin(); it != rings.end();) {
+        auto& ring = *it;
+
+        if (ring->orphaned.load(std::memory_order_acquire) &&
+            ring->head.load(std::memory_order_acquire) == ring->tail.load(std::memory_order_relaxed)) {
+            it = rings.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void SysLog::stop_drain()
+{
+    buffered = false;
+
+    if (!drain_running.exchange(false)) {
+        return;
+    }
+
+    if (drain_thread.joinable()) {
+        drain_thread.join();
+    }
+
+    // The messages logged until now
+    drain();
+}
+
+} // namespace koheron
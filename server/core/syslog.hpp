@@ -1,5 +1,16 @@
 /// Server system log
 ///
+/// With config::log::async, print() doesn't format the message: it copies
+/// the format string pointer and the raw arguments in a record of the
+/// ring of the calling thread, and returns. A background thread drains the
+/// rings, formats the records and writes them to stderr/stdout and to the
+/// system log (journald reads it on systemd systems).
+/// A full ring drops the record, the drops are reported by the drain thread.
+/// PANIC and CRITICAL messages are written immediately, as are all the
+/// messages with config::log::verbose (which traces every command).
+/// The messages are recorded only once the server is started: the
+/// startup errors are written before the server exits.
+///
 /// (c) Koheron
 
 #ifndef __KOHERON_SYSLOG_HPP__
@@ -7,10 +18,16 @@
 
 #include "config.hpp"
 
+#include <array>
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <cstring>
+#include <thread>
 #include <tuple>
+#include <type_traits>
+#include <vector>
 
 #include <syslog.h>
 
@@ -43,17 +60,69 @@ static constexpr auto log_array = koheron::make_array(
 template<int severity>
 constexpr str_const severity_msg = std::get<1>(std::get<severity>(log_array));
 
+struct SysLog;
+
+/// Size of a log record (format string, formatting function and arguments)
+constexpr size_t log_record_size = 256;
+
+struct LogRecord
+{
+    void (*format)(SysLog&, const LogRecord&);
+    const char *message;
+    uint32_t args_size;
+    unsigned char args[log_record_size - 2 * sizeof(void*) - sizeof(uint32_t)];
+};
+
+/// Single producer (the logging thread) single consumer (the drain thread) ring
+struct LogRing
+{
+    std::array<LogRecord, config::log::ring_records> records;
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+    std::atomic<uint64_t> dropped{0};
+    uint64_t dropped_reported = 0;    // Drain thread only
+    std::atomic<bool> orphaned{false}; // Thread exited
+};
+
 struct SysLog
 {
+    /// The message must be a string literal (only its address is recorded).
+    /// String arguments are copied (truncated to the size of the record).
     template<int severity, typename... Args>
     void print(const char *msg, Args&&... args);
 
+    /// Number of records dropped because the ring of the thread was full
+    uint64_t get_number_of_dropped() const {
+        return number_of_dropped.load();
+    }
+
+    /// Write the next messages from the calling threads (e.g. on a crash)
+    void write_immediately() {
+        buffered = false;
+    }
+
+    /// Record the next messages in the rings (once the server is started)
+    void start_buffering() {
+        buffered = async;
+    }
+
+    ~SysLog() {
+        stop_drain();
+    }
+
   private:
+    static constexpr bool async = config::log::async && !config::log::verbose;
+
     SysLog() {
         if (config::log::syslog) {
             setlogmask(LOG_UPTO(LOG_NOTICE));
             openlog("koheron-server", LOG_CONS | LOG_PID | LOG_NDELAY, LOG_USER);
         }
+
+        if (async) {
+            drain_running = true;
+            drain_thread = std::thread{&SysLog::drain_loop, this};
+        }
     }
 
     // This cannot be done in the destructor
@@ -62,10 +131,124 @@ struct SysLog
     void close() {
         if (config::log::syslog) {
             print<INFO>("Close syslog ...\n");
+        }
+
+        // The last messages are written before the server exits
+        stop_drain();
+
+        if (config::log::syslog) {
             closelog();
         }
     }
 
+    std::atomic<bool> buffered{false};      // Messages recorded in the rings
+    std::atomic<bool> drain_running{false};
+    std::thread drain_thread;
+    std::atomic<uint64_t> number_of_dropped{0};
+
+    std::mutex rings_mutex;
+    std::vector<std::shared_ptr<LogRing>> rings;
+    std::vector<std::shared_ptr<LogRing>> drained_rings; // Drain thread only
+
+    LogRing* thread_ring();
+    void drain_loop();
+    void drain();
+    void stop_drain();
+
+    // Nothing is written for the debug messages unless verbose
+    template<int severity>
+    static constexpr bool is_written = severity <= WARNING ? config::log::use_stderr || config::log::syslog
+                                     : severity == INFO    ? config::log::verbose || config::log::syslog
+                                                           : config::log::verbose;
+
+    template<int severity, typename... Args>
+    void write(const char *msg, Args... args) {
+        print_msg<severity>(msg, args...);
+        call_syslog<severity>(msg, args...);
+    }
+
+    // Record arguments: strings are copied with their terminating null character,
+    // the other arguments are copied as is.
+
+    template<typename T>
+    static constexpr bool is_string = std::is_same_v<T, const char*> || std::is_same_v<T, char*>;
+
+    template<typename T>
+    using record_arg_t = std::conditional_t<is_string<T>, const char*, T>;
+
+    template<typename T>
+    static void encode(LogRecord& record, T arg) {
+        if constexpr (is_string<T>) {
+            if (arg == nullptr) {
+                arg = "(null)";
+            }
+
+            const size_t room = sizeof(record.args) - record.args_size;
+            const size_t len = room > 0 ? strnlen(arg, room - 1) : 0;
+
+            if (room > 0) {
+                std::memcpy(record.args + record.args_size, arg, len);
+                record.args[record.args_size + len] = '\0';
+                record.args_size += uint32_t(len + 1);
+            }
+        } else {
+            static_assert(std::is_trivially_copyable_v<T>, "Invalid log argument type");
+            std::memcpy(record.args + record.args_size, &arg, sizeof(T));
+            record.args_size += uint32_t(sizeof(T));
+        }
+    }
+
+    template<typename T>
+    static T decode(const LogRecord& record, size_t& offset) {
+        if constexpr (is_string<T>) {
+            if (offset >= record.args_size) {
+                return "";
+            }
+
+            const char *str = reinterpret_cast<const char*>(record.args + offset);
+            offset += strlen(str) + 1;
+            return str;
+        } else {
+            T arg;
+            std::memcpy(&arg, record.args + offset, sizeof(T));
+            offset += sizeof(T);
+            return arg;
+        }
+    }
+
+    template<int severity, typename... Args>
+    static void format_record(SysLog& log, const LogRecord& record) {
+        [[maybe_unused]] size_t offset = 0;
+
+        // Braced initialization evaluates the arguments in order
+        std::tuple<Args...> args{decode<Args>(record, offset)...};
+
+        std::apply([&](auto... values) {
+            log.write<severity>(record.message, values...);
+        }, args);
+    }
+
+    template<int severity, typename... Args>
+    void push_record(const char *msg, Args... args) {
+        static_assert((0 + ... + (is_string<Args> ? 1 : sizeof(Args))) <= sizeof(LogRecord::args),
+                      "Too many log arguments");
+
+        auto ring = thread_ring();
+        const uint32_t head = ring->head.load(std::memory_order_relaxed);
+
+        if (head - ring->tail.load(std::memory_order_acquire) >= config::log::ring_records) {
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        auto& record = ring->records[head % config::log::ring_records];
+        record.format = &format_record<severity, Args...>;
+        record.message = msg;
+        record.args_size = 0;
+        (encode<Args>(record, args), ...);
+        ring->head.store(head + 1, std::memory_order_release);
+    }
+
     // High severity (Panic, ..., Warning) => stderr
     template<int severity, typename... Args>
     std::enable_if_t< severity <= WARNING && config::log::use_stderr, void >
@@ -117,8 +300,14 @@ template<int severity, typename... Args>
 void SysLog::print(const char *msg, Args&&... args)
 {
     static_assert(severity <= syslog_severity_num, "Invalid logging level");
-    print_msg<severity>(msg, std::forward<Args>(args)...);
-    call_syslog<severity>(msg, std::forward<Args>(args)...);
+
+    if constexpr (is_written<severity>) {
+        if (async && severity > CRITICAL && buffered.load(std::memory_order_relaxed)) {
+            push_record<severity, record_arg_t<std::decay_t<Args>>...>(msg, args...);
+        } else {
+            write<severity>(msg, args...);
+        }
+    }
 }
 
 } // namespace koheron
@@ -0,0 +1,253 @@
+/// Implementation of trace.hpp
+///
+/// (c) Koheron
+
+#include "trace.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace koheron {
+namespace trace {
+
+struct TraceEvent
+{
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t> begin_ns{0};
+    std::atomic<uint64_t> end_ns{0};
+    std::atomic<uint32_t> arg{0};
+};
+
+// Written by its thread only. The dump reads it concurrently:
+// the events overwritten while they are read are discarded.
+struct TraceRing
+{
+    TraceRing()
+    : tid(static_cast<int>(syscall(SYS_gettid)))
+    {
+        pthread_getname_np(pthread_self(), thread_name, sizeof(thread_name));
+    }
+
+    std::array<TraceEvent, config::trace::ring_events> events;
+    std::atomic<uint64_t> head{0}; // Number of events recorded
+    std::atomic<bool> exited{false};
+    const int tid;
+    char thread_name[16] = "";
+};
+
+class TraceRegistry
+{
+  public:
+    void add(const std::shared_ptr<TraceRing>& ring) {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t n_exited = 0;
+
+        for (auto& r : rings) {
+            n_exited += r->exited.load(std::memory_order_acquire);
+        }
+
+        // Release the oldest rings of the exited threads
+        for (auto it = rings.begin(); it != rings.end() && n_exited > config::trace::exited_rings;) {
+            if ((*it)->exited.load(std::memory_order_acquire)) {
+                it = rings.erase(it);
+                n_exited--;
+            } else {
+                ++it;
+            }
+        }
+
+        rings.push_back(ring);
+    }
+
+    std::vector<std::shared_ptr<TraceRing>> get_rings() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return rings;
+    }
+
+  private:
+    std::mutex mutex;
+    std::vector<std::shared_ptr<TraceRing>> rings;
+};
+
+// Never destroyed: the detached acquisition threads may trace until the exit
+static TraceRegistry& registry()
+{
+    static auto *trace_registry = new TraceRegistry();
+    return *trace_registry;
+}
+
+// Ring of the thread, kept by the registry after the thread exits
+struct ThreadTraceRing
+{
+    std::shared_ptr<TraceRing> ring;
+
+    ~ThreadTraceRing() {
+        if (ring != nullptr) {
+            ring->exited.store(true, std::memory_order_release);
+        }
+    }
+};
+
+static thread_local ThreadTraceRing thread_trace_ring;
+
+static TraceRing& thread_ring()
+{
+    auto& local = thread_trace_ring;
+
+    if (local.ring == nullptr) {
+        local.ring = std::make_shared<TraceRing>();
+        registry().add(local.ring);
+    }
+
+    return *local.ring;
+}
+
+void record(const char *name, uint64_t begin_ns, uint64_t end_ns, uint32_t arg)
+{
+    if constexpr (!config::trace::enabled) {
+        return;
+    }
+
+    auto& ring = thread_ring();
+    const uint64_t index = ring.head.load(std::memory_order_relaxed);
+
+    // A dump reading the slot sees the head of the event overwritten from here
+    std::atomic_thread_fence(std::memory_order_release);
+
+    auto& event = ring.events[index % config::trace::ring_events];
+    event.name.store(name, std::memory_order_relaxed);
+    event.begin_ns.store(begin_ns, std::memory_order_relaxed);
+    event.end_ns.store(end_ns, std::memory_order_relaxed);
+    event.arg.store(arg, std::memory_order_relaxed);
+    ring.head.store(index + 1, std::memory_order_release);
+}
+
+// Time in us with a ns resolution
+static void append_us(std::string& json, uint64_t ns)
+{
+    char buffer[32];
+    const int len = std::snprintf(buffer, sizeof(buffer), "%llu.%03llu",
+                                  static_cast<unsigned long long>(ns / 1000),
+                                  static_cast<unsigned long long>(ns % 1000));
+    json.append(buffer, static_cast<size_t>(len));
+}
+
+static void append_string(std::string& json, const char *str)
+{
+    json += '"';
+
+    for (; *str != '\0'; str++) {
+        if (*str == '"' || *str == '\\') {
+            json += '\\';
+        }
+
+        if (static_cast<unsigned char>(*str) >= 0x20) {
+            json += *str;
+        }
+    }
+
+    json += '"';
+}
+
+std::string dump(uint32_t seconds)
+{
+    struct Event {
+        const char *name;
+        uint64_t begin_ns;
+        uint64_t end_ns;
+        uint32_t arg;
+    };
+
+    const uint64_t now = clock_ns();
+    const uint64_t window_ns = uint64_t(seconds) * 1000000000;
+    const uint64_t since_ns = now > window_ns ? now - window_ns : 0;
+    const auto pid = std::to_string(getpid());
+
+    std::string json = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    std::vector<Event> events;
+    bool first = true;
+
+    for (auto& ring : registry().get_rings()) {
+        const uint64_t head = ring->head.load(std::memory_order_acquire);
+        const uint64_t begin = head > config::trace::ring_events ? head - config::trace::ring_events : 0;
+        events.clear();
+
+        for (uint64_t i = begin; i < head; i++) {
+            const auto& event = ring->events[i % config::trace::ring_events];
+            events.push_back({event.name.load(std::memory_order_relaxed),
+                              event.begin_ns.load(std::memory_order_relaxed),
+                              event.end_ns.load(std::memory_order_relaxed),
+                              event.arg.load(std::memory_order_relaxed)});
+        }
+
+        // Events overwritten by the thread while they were read
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t head_after = ring->head.load(std::memory_order_relaxed);
+        const uint64_t valid = head_after >= config::trace::ring_events
+                               ? head_after - config::trace::ring_events + 1 : 0;
+
+        const auto tid = std::to_string(ring->tid);
+
+        if (!first) {
+            json += ',';
+        }
+
+        first = false;
+        json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + pid + ",\"tid\":" + tid + ",\"args\":{\"name\":";
+        append_string(json, ring->thread_name[0] != '\0' ? ring->thread_name : "thread");
+        json += "}}";
+
+        for (uint64_t i = std::max(begin, valid); i < head; i++) {
+            const auto& event = events[i - begin];
+
+            if (event.end_ns < since_ns || event.name == nullptr) {
+                continue;
+            }
+
+            json += ",{\"name\":";
+            append_string(json, event.name);
+            json += ",\"ph\":\"X\",\"pid\":" + pid + ",\"tid\":" + tid + ",\"ts\":";
+            append_us(json, event.begin_ns);
+            json += ",\"dur\":";
+            append_us(json, event.end_ns > event.begin_ns ? event.end_ns - event.begin_ns : 0);
+
+            if (event.arg != 0) {
+                json += ",\"args\":{\"arg\":" + std::to_string(event.arg) + "}";
+            }
+
+            json += '}';
+        }
+    }
+
+    json += "]}";
+    return json;
+}
+
+int dump_to_file(const char *path, uint32_t seconds)
+{
+    const auto json = dump(seconds);
+    FILE *file = std::fopen(path, "w");
+
+    if (file == nullptr) {
+        return -1;
+    }
+
+    const bool written = std::fwrite(json.data(), 1, json.size(), file) == json.size();
+
+    if (std::fclose(file) != 0 || !written) {
+        return -1;
+    }
+
+    return 0;
+}
+
+} // namespace trace
+} // namespace koheron
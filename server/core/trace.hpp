@@ -0,0 +1,80 @@
+/// Trace events of the server activity
+///
+/// KOHERON_TRACE_SCOPE(name) records the duration of the enclosing scope
+/// in a ring of the calling thread (the last config::trace::ring_events
+/// events of each thread are kept). The name must be a string literal
+/// (or any string that lives as long as the server).
+///
+/// The events of the last seconds are dumped as Chrome trace-event JSON
+/// (KServer get_trace or SIGUSR1), which can be opened in Perfetto
+/// (https://ui.perfetto.dev) or chrome://tracing.
+///
+/// (c) Koheron
+
+#ifndef __KOHERON_TRACE_HPP__
+#define __KOHERON_TRACE_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "config.hpp"
+
+namespace koheron {
+namespace trace {
+
+inline uint64_t clock_ns()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/// Record an event of the calling thread.
+/// arg is displayed with the event (e.g. a session ID).
+void record(const char *name, uint64_t begin_ns, uint64_t end_ns, uint32_t arg = 0);
+
+/// Chrome trace-event JSON of the events ending in the last seconds
+std::string dump(uint32_t seconds);
+
+/// Write the dump in a file
+int dump_to_file(const char *path, uint32_t seconds);
+
+class Scope
+{
+  public:
+    explicit Scope(const char *name_, uint32_t arg_ = 0)
+    : name(name_)
+    , arg(arg_)
+    {
+        if constexpr (config::trace::enabled) {
+            begin_ns = clock_ns();
+        }
+    }
+
+    ~Scope() {
+        if constexpr (config::trace::enabled) {
+            record(name, begin_ns, clock_ns(), arg);
+        }
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+  private:
+    const char *name;
+    uint32_t arg;
+    uint64_t begin_ns = 0;
+};
+
+} // namespace trace
+} // namespace koheron
+
+#define KOHERON_TRACE_CONCAT_(a, b) a##b
+#define KOHERON_TRACE_CONCAT(a, b) KOHERON_TRACE_CONCAT_(a, b)
+
+/// Trace the enclosing scope: KOHERON_TRACE_SCOPE("name") or KOHERON_TRACE_SCOPE("name", arg)
+#define KOHERON_TRACE_SCOPE(...) \
+    koheron::trace::Scope KOHERON_TRACE_CONCAT(koheron_trace_scope_, __LINE__)(__VA_ARGS__)
+
+#endif // __KOHERON_TRACE_HPP__
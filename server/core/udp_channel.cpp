@@ -0,0 +1,329 @@
+/// Implementation of udp_channel.hpp
+///
+/// (c) Koheron
+
+#include "udp_channel.hpp"
+#include "server.hpp"
+#include "sha1.h"
+
+#include <array>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+#include <random>
+
+extern "C" {
+  #include <unistd.h>
+  #include <poll.h>
+  #include <sys/socket.h>
+  #include <sys/uio.h>
+  #include <arpa/inet.h>
+}
+
+namespace koheron {
+
+// Size of the stream frame header (see streams.hpp)
+constexpr size_t stream_frame_header_size = 12;
+
+constexpr size_t udp_header_size = 28;
+constexpr size_t udp_control_size = 16;
+
+// Period of the subscriptions expiration check
+constexpr int udp_control_poll_ms = 200;
+
+static_assert(config::udp_datagram_size > udp_header_size, "udp_datagram_size too small");
+
+// The subscriber ID of a UDP client is made of its address and port:
+// a client subscribing again renews its subscription.
+// Bit 48 is set so that it doesn't collide with the session IDs.
+static SubscriberID udp_subscriber_id(const struct sockaddr_in& addr)
+{
+    return (SubscriberID(1) << 48)
+         + (SubscriberID(ntohl(addr.sin_addr.s_addr)) << 16)
+         + ntohs(addr.sin_port);
+}
+
+// Frames sent to a UDP client
+class UdpSink : public StreamSink
+{
+  public:
+    UdpSink(int udp_fd_, const struct sockaddr_in& addr_)
+    : udp_fd(udp_fd_)
+    , addr(addr_)
+    {}
+
+    int deliver(const StreamFrame& frame) override;
+
+  private:
+    int udp_fd;
+    struct sockaddr_in addr;
+    uint32_t sequence = 0;
+    uint32_t frame_count = 0;
+};
+
+int UdpSink::deliver(const StreamFrame& frame)
+{
+    constexpr size_t max_data_size = config::udp_datagram_size - udp_header_size;
+
+    const unsigned char *payload = frame->bytes.data() + stream_frame_header_size;
+    const size_t payload_size = frame->bytes.size() - stream_frame_header_size;
+    const size_t n_fragments = std::max(size_t(1), (payload_size + max_data_size - 1) / max_data_size);
+
+    if (n_fragments > UINT16_MAX) {
+        return 1; // Frame too large: dropped
+    }
+
+    std::array<unsigned char, udp_header_size> header;
+    append<uint32_t>(header.data(), UDP_DATAGRAM);
+    std::memcpy(header.data() + 4, frame->bytes.data() + 4, 4); // class_id and func_id
+    append<uint32_t>(header.data() + 12, frame_count);
+    append<uint16_t>(header.data() + 18, static_cast<uint16_t>(n_fragments));
+    append<uint64_t>(header.data() + 20, frame->timestamp);
+
+    struct iovec iov[2];
+    iov[0].iov_base = header.data();
+    iov[0].iov_len = header.size();
+
+    struct msghdr msg{};
+    msg.msg_name = &addr;
+    msg.msg_namelen = sizeof(addr);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+
+    for (size_t fragment = 0; fragment < n_fragments; fragment++) {
+        const size_t offset = fragment * max_data_size;
+        append<uint32_t>(header.data() + 8, sequence);
+        append<uint16_t>(header.data() + 16, static_cast<uint16_t>(fragment));
+        iov[1].iov_base = const_cast<unsigned char*>(payload + offset);
+        iov[1].iov_len = std::min(max_data_size, payload_size - offset);
+
+        if (sendmsg(udp_fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+            // The socket buffer is full: the rest of the frame is dropped.
+            // The sequence still counts the dropped datagrams.
+            sequence += static_cast<uint32_t>(n_fragments - fragment);
+            break;
+        }
+
+        sequence++;
+    }
+
+    frame_count++;
+    return 1;
+}
+
+//----------------------------------------------------------------------------
+// Channel
+//----------------------------------------------------------------------------
+
+UdpChannel::UdpChannel(Server *server_)
+: server(server_)
+{
+    std::random_device rng;
+
+    for (auto& c : cookie_secret) {
+        c = static_cast<unsigned char>(rng());
+    }
+}
+
+int UdpChannel::init()
+{
+    udp_fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (udp_fd < 0) {
+        server->syslog.print<ERROR>("Can't open UDP socket\n");
+        return -1;
+    }
+
+    struct sockaddr_in servaddr{};
+    servaddr.sin_family = AF_INET;
+    servaddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    servaddr.sin_port = htons(config::udp_port);
+
+    if (bind(udp_fd, reinterpret_cast<struct sockaddr *>(&servaddr), sizeof(servaddr)) < 0) {
+        server->syslog.print<ERROR>("UDP binding error\n");
+        close(udp_fd);
+        udp_fd = -1;
+        return -1;
+    }
+
+    return 0;
+}
+
+int UdpChannel::start_worker()
+{
+    if (udp_fd >= 0) {
+        control_thread = std::thread{&UdpChannel::control_loop, this};
+    }
+
+    return 0;
+}
+
+void UdpChannel::shutdown()
+{
+    if (udp_fd < 0) {
+        return;
+    }
+
+    server->syslog.print<INFO>("Closing UDP channel ...\n");
+
+    // The control thread exits on exit_comm
+    if (control_thread.joinable()) {
+        control_thread.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t frames_sent, frames_dropped;
+
+        for (const auto& subscription : subscriptions) {
+            server->stream_manager.unsubscribe(subscription.first.first, subscription.first.second,
+                                               frames_sent, frames_dropped);
+        }
+
+        subscriptions.clear();
+    }
+
+    close(udp_fd);
+    udp_fd = -1;
+}
+
+// Cookie of a client address: SHA1 of the secret, the address and the period
+uint32_t UdpChannel::make_cookie(const struct sockaddr_in& addr, uint64_t period) const
+{
+    std::array<unsigned char, sizeof(cookie_secret) + 4 + 2 + 8> data;
+    std::memcpy(data.data(), cookie_secret.data(), cookie_secret.size());
+    std::memcpy(data.data() + 16, &addr.sin_addr.s_addr, 4);
+    std::memcpy(data.data() + 20, &addr.sin_port, 2);
+    append<uint64_t>(data.data() + 22, period);
+
+    std::array<unsigned char, 20> digest;
+    SHA1(data.data(), data.size(), digest.data());
+    return extract<uint32_t>(reinterpret_cast<const char *>(digest.data()));
+}
+
+uint64_t UdpChannel::cookie_period() const
+{
+    const auto now = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now().time_since_epoch());
+    return static_cast<uint64_t>(now.count()) / config::udp_cookie_lifetime_ms;
+}
+
+// The cookie of the previous period is still accepted
+bool UdpChannel::check_cookie(uint32_t cookie, const struct sockaddr_in& addr) const
+{
+    const auto period = cookie_period();
+    return cookie == make_cookie(addr, period) || cookie == make_cookie(addr, period - 1);
+}
+
+void UdpChannel::control_loop()
+{
+    std::array<unsigned char, udp_control_size> buffer;
+
+    while (!server->exit_comm.load()) {
+        struct pollfd pfd{};
+        pfd.fd = udp_fd;
+        pfd.events = POLLIN;
+
+        if (poll(&pfd, 1, udp_control_poll_ms) > 0) {
+            struct sockaddr_in addr{};
+            socklen_t addr_len = sizeof(addr);
+
+            const auto n = recvfrom(udp_fd, buffer.data(), buffer.size(), 0,
+                                    reinterpret_cast<struct sockaddr *>(&addr), &addr_len);
+
+            if (n == static_cast<ssize_t>(udp_control_size) && addr.sin_family == AF_INET) {
+                const auto data = reinterpret_cast<const char *>(buffer.data());
+                const auto command = extract<uint32_t>(data);
+                const auto stream = extract<uint32_t>(data + 4);
+                const auto cookie = extract<uint32_t>(data + 8);
+
+                // The answer has the size of the request
+                const uint32_t status = check_cookie(cookie, addr) ? execute_control(command, stream, addr)
+                                                                   : UDP_COOKIE;
+                append<uint32_t>(buffer.data() + 8, make_cookie(addr, cookie_period()));
+                append<uint32_t>(buffer.data() + 12, status);
+                sendto(udp_fd, buffer.data(), buffer.size(), MSG_DONTWAIT,
+                       reinterpret_cast<struct sockaddr *>(&addr), addr_len);
+            }
+        }
+
+        expire_subscriptions();
+    }
+}
+
+uint32_t UdpChannel::execute_control(uint32_t command, uint32_t stream, const struct sockaddr_in& addr)
+{
+    const auto driver = stream >> 16;
+    const auto id = udp_subscriber_id(addr);
+    const auto key = std::make_pair(id, stream);
+
+    if (driver < 2 || driver >= device_num) {
+        server->syslog.print<ERROR>("UdpChannel: invalid driver %u\n", driver);
+        return UDP_FAILED;
+    }
+
+    if ((stream & 0xFFFF) >= drivers_op_num[driver]) {
+        server->syslog.print<ERROR>("UdpChannel: invalid operation %u of driver %u\n", stream & 0xFFFF, driver);
+        return UDP_FAILED;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = subscriptions.find(key);
+
+    switch (command) {
+      case UDP_SUBSCRIBE: {
+        if (it != subscriptions.end()) {
+            it->second = clock::now(); // Renewal
+            return UDP_OK;
+        }
+
+        if (subscriptions.size() >= config::udp_max_subscriptions) {
+            server->syslog.print<WARNING>("UdpChannel: maximum number of subscriptions reached\n");
+            return UDP_FAILED;
+        }
+
+        // Only the latest frames are queued: the lag is bounded
+        if (server->stream_manager.subscribe(id, stream, DROP_OLDEST, config::udp_queue_length,
+                                             std::make_unique<UdpSink>(udp_fd, addr)) < 0) {
+            return UDP_FAILED;
+        }
+
+        subscriptions[key] = clock::now();
+        return UDP_OK;
+      }
+      case UDP_UNSUBSCRIBE: {
+        if (it == subscriptions.end()) {
+            return UDP_FAILED;
+        }
+
+        uint64_t frames_sent, frames_dropped;
+        server->stream_manager.unsubscribe(id, stream, frames_sent, frames_dropped);
+        subscriptions.erase(it);
+        return UDP_OK;
+      }
+      default:
+        server->syslog.print<ERROR>("UdpChannel: invalid command %u\n", command);
+        return UDP_FAILED;
+    }
+}
+
+void UdpChannel::expire_subscriptions()
+{
+    const auto now = clock::now();
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto it = subscriptions.begin(); it != subscriptions.end();) {
+        if (now - it->second > std::chrono::milliseconds(config::udp_subscription_timeout_ms)) {
+            uint64_t frames_sent, frames_dropped;
+            server->stream_manager.unsubscribe(it->first.first, it->first.second,
+                                               frames_sent, frames_dropped);
+            server->syslog.print<INFO>("UdpChannel: subscription expired (%llu frames sent, %llu dropped)\n",
+                                       static_cast<unsigned long long>(frames_sent),
+                                       static_cast<unsigned long long>(frames_dropped));
+            it = subscriptions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+} // namespace koheron
@@ -0,0 +1,122 @@
+/// UDP streaming channel
+///
+/// Sends the frames of the operation streams (see streams.hpp)
+/// to UDP clients. A frame is split in datagrams of at most
+/// config::udp_datagram_size bytes, so that it isn't fragmented by IP.
+///
+/// Control datagram:
+/// |      command      | class_id | func_id |       cookie      |       status      |
+/// |  0 |  1 |  2 |  3 |  4 |  5  |  6 |  7 |  8 |  9 | 10 | 11 | 12 | 13 | 14 | 15 |
+///
+/// command is UDP_SUBSCRIBE or UDP_UNSUBSCRIBE. The server answers with
+/// the same command and stream, the cookie of the client and the status.
+/// The cookie proves that the client receives the datagrams sent to its
+/// address: a client sends 0 first, and gets the UDP_COOKIE status with
+/// the cookie to send back. So the frames are never sent to a spoofed
+/// address, and the answers are not larger than the requests.
+/// The cookies change every config::udp_cookie_lifetime_ms.
+///
+/// A subscription is removed if the client doesn't subscribe
+/// again within config::udp_subscription_timeout_ms.
+///
+/// Data datagram:
+/// | RESERVED = 4 | class_id | func_id | sequence | frame | fragment | n_fragments | timestamp | data
+/// |   0 ... 3    |  4 | 5   |  6 | 7  | 8 ... 11 | 12..15|  16 | 17 |   18 | 19   | 20 ... 27 | 28 ...
+///
+/// The frame data is the response payload of the operation, split in n_fragments
+/// datagrams. The timestamp is the publication time of the frame (ns since the epoch).
+///
+/// The sequence number counts the datagrams of the subscription, including
+/// the ones dropped by the server when the socket buffer is full, so that
+/// the client accounts for all the losses from the gaps in the sequence.
+/// On congestion, the rest of the frame is dropped and the subscription
+/// queue only keeps the latest frames: the lag stays bounded.
+///
+/// (c) Koheron
+
+#ifndef __KOHERON_UDP_CHANNEL_HPP__
+#define __KOHERON_UDP_CHANNEL_HPP__
+
+#include <cstdint>
+#include <array>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <chrono>
+
+#include "streams.hpp"
+
+extern "C" {
+  #include <netinet/in.h>
+}
+
+namespace koheron {
+
+class Server;
+
+/// Value of the reserved header field of the UDP data datagrams
+constexpr uint32_t UDP_DATAGRAM = 4;
+
+/// Commands of the UDP control datagrams
+enum UdpCommand : uint32_t {
+    UDP_SUBSCRIBE = 1,
+    UDP_UNSUBSCRIBE = 2
+};
+
+/// Status of the UDP control answers
+enum UdpStatus : uint32_t {
+    UDP_FAILED = 0,
+    UDP_OK = 1,
+    UDP_COOKIE = 2  ///< Send the request again with the cookie of the answer
+};
+
+class UdpChannel
+{
+  public:
+    UdpChannel(Server *server_);
+
+    /// Open and bind the socket
+    int init();
+
+    /// Use a socket handed over by the previous server
+    int init(int handed_over_fd) {
+        udp_fd = handed_over_fd;
+        return 0;
+    }
+
+    int get_fd() const {
+        return udp_fd;
+    }
+
+    /// Start the control thread
+    int start_worker();
+
+    /// Stop the control thread and remove the subscriptions
+    void shutdown();
+
+  private:
+    Server *server;
+    int udp_fd = -1;
+    std::thread control_thread;
+
+    using clock = std::chrono::steady_clock;
+
+    /// Renewal time of the subscriptions (subscriber ID, stream)
+    std::mutex mutex;
+    std::map<std::pair<SubscriberID, uint32_t>, clock::time_point> subscriptions;
+
+    /// Random key of the cookies
+    std::array<unsigned char, 16> cookie_secret;
+
+    uint32_t make_cookie(const struct sockaddr_in& addr, uint64_t period) const;
+    bool check_cookie(uint32_t cookie, const struct sockaddr_in& addr) const;
+    uint64_t cookie_period() const;
+
+    void control_loop();
+    uint32_t execute_control(uint32_t command, uint32_t stream, const struct sockaddr_in& addr);
+    void expire_subscriptions();
+};
+
+} // namespace koheron
+
+#endif // __KOHERON_UDP_CHANNEL_HPP__
@@ -0,0 +1,622 @@
+/// Implementation of uring.hpp
+///
+/// (c) Koheron
+
+#include "uring.hpp"
+#include "config.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cerrno>
+#include <cstring>
+
+extern "C" {
+  #include <sys/mman.h>
+  #include <sys/socket.h>
+  #include <sys/uio.h>
+  #include <unistd.h>
+}
+
+namespace koheron {
+
+#if KOHERON_HAS_IO_URING
+
+static_assert((config::io_uring_recv_buffers & (config::io_uring_recv_buffers - 1)) == 0,
+              "The number of io_uring receive buffers must be a power of 2");
+
+// -----------------------------------------------
+// IoUring
+// -----------------------------------------------
+
+int IoUring::init(unsigned int entries)
+{
+    struct io_uring_params params{};
+    ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+
+    if (ring_fd < 0) {
+        return -1;
+    }
+
+    sq_entries = params.sq_entries;
+    sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+
+    if (single_mmap) {
+        sq_map_size = std::max(sq_map_size, cq_map_size);
+        cq_map_size = sq_map_size;
+    }
+
+    sq_ptr = mmap(nullptr, sq_map_size, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+
+    if (sq_ptr == MAP_FAILED) {
+        sq_ptr = nullptr;
+        release();
+        return -1;
+    }
+
+    if (single_mmap) {
+        cq_ptr = sq_ptr;
+    } else {
+        cq_ptr = mmap(nullptr, cq_map_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+
+        if (cq_ptr == MAP_FAILED) {
+            cq_ptr = nullptr;
+            release();
+            return -1;
+        }
+    }
+
+    sqes_map_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes_ptr = mmap(nullptr, sqes_map_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+
+    if (sqes_ptr == MAP_FAILED) {
+        release();
+        return -1;
+    }
+
+    sqes = static_cast<struct io_uring_sqe*>(sqes_ptr);
+
+    auto sq = static_cast<char*>(sq_ptr);
+    sq_head = reinterpret_cast<unsigned int*>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned int*>(sq + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned int*>(sq + params.sq_off.array);
+
+    auto cq = static_cast<char*>(cq_ptr);
+    cq_head = reinterpret_cast<unsigned int*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned int*>(cq + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned int*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    sqe_tail = *sq_tail;
+    return 0;
+}
+
+void IoUring::release()
+{
+    if (sqes != nullptr) {
+        munmap(sqes, sqes_map_size);
+        sqes = nullptr;
+    }
+
+    if (cq_ptr != nullptr && cq_ptr != sq_ptr) {
+        munmap(cq_ptr, cq_map_size);
+    }
+
+    cq_ptr = nullptr;
+
+    if (sq_ptr != nullptr) {
+        munmap(sq_ptr, sq_map_size);
+        sq_ptr = nullptr;
+    }
+
+    if (ring_fd >= 0) {
+        ::close(ring_fd);
+        ring_fd = -1;
+    }
+}
+
+struct io_uring_sqe* IoUring::get_sqe()
+{
+    const unsigned int head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+
+    if (sqe_tail - head >= sq_entries) {
+        return nullptr;
+    }
+
+    const unsigned int idx = sqe_tail & *sq_mask;
+    sq_array[idx] = idx;
+    sqe_tail++;
+
+    auto sqe = &sqes[idx];
+    std::memset(sqe, 0, sizeof(struct io_uring_sqe));
+    return sqe;
+}
+
+int IoUring::submit_and_wait(unsigned int wait_nr)
+{
+    __atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+
+    // Entries not yet consumed by the kernel
+    const unsigned int to_submit = sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    const unsigned int flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+
+    const auto ret = syscall(__NR_io_uring_enter, ring_fd, to_submit, wait_nr, flags, nullptr, 0);
+
+    // Interrupted while waiting: the caller checks
+    // the completion queue and waits again if needed.
+    if (ret < 0 && errno != EINTR) {
+        return -1;
+    }
+
+    return 0;
+}
+
+struct io_uring_cqe* IoUring::peek_cqe()
+{
+    const unsigned int head = *cq_head;
+
+    if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+        return nullptr;
+    }
+
+    return &cqes[head & *cq_mask];
+}
+
+void IoUring::cqe_seen()
+{
+    __atomic_store_n(cq_head, *cq_head + 1, __ATOMIC_RELEASE);
+}
+
+int IoUring::register_resource(unsigned int opcode, void *arg, unsigned int nr_args)
+{
+    return static_cast<int>(syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args));
+}
+
+// -----------------------------------------------
+// UringTransport
+// -----------------------------------------------
+
+int UringTransport::open(int comm_fd)
+{
+    if (ring.init(config::io_uring_queue_depth) < 0) {
+        return -1;
+    }
+
+    // Registered send buffer
+    send_buf.resize(config::io_uring_send_buffer_size);
+    struct iovec iov{send_buf.data(), send_buf.size()};
+
+    if (ring.register_resource(IORING_REGISTER_BUFFERS, &iov, 1) < 0) {
+        ring.release();
+        return -1;
+    }
+
+    // Ring of receive buffers provided to the kernel
+    buf_ring_size = config::io_uring_recv_buffers * sizeof(struct io_uring_buf);
+    void *buf_ring_ptr = mmap(nullptr, buf_ring_size, PROT_READ | PROT_WRITE,
+                              MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+
+    if (buf_ring_ptr == MAP_FAILED) {
+        ring.release();
+        return -1;
+    }
+
+    buf_ring = static_cast<struct io_uring_buf_ring*>(buf_ring_ptr);
+
+    struct io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uintptr_t>(buf_ring);
+    reg.ring_entries = config::io_uring_recv_buffers;
+    reg.bgid = 0;
+
+    if (ring.register_resource(IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        munmap(buf_ring, buf_ring_size);
+        buf_ring = nullptr;
+        ring.release();
+        return -1;
+    }
+
+    recv_bufs.resize(config::io_uring_recv_buffers * config::io_uring_recv_buffer_size);
+
+    for (unsigned int bid = 0; bid < config::io_uring_recv_buffers; bid++) {
+        provide_buffer(bid);
+    }
+
+    staging.reserve(recv_bufs.size());
+    held_buffers.reserve(config::io_uring_recv_buffers);
+    fd = comm_fd;
+    is_opened = true;
+    return 0;
+}
+
+void UringTransport::close()
+{
+    if (!is_opened) {
+        return;
+    }
+
+    flush();
+
+    // Cancel the pending receive before releasing its buffers
+    if (recv_armed && !has_error) {
+        auto sqe = ring.get_sqe();
+
+        if (sqe != nullptr) {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = RECV_TAG;
+
+            while (recv_armed && !has_error) {
+                wait_completions();
+            }
+        }
+    }
+
+    ring.release();
+    munmap(buf_ring, buf_ring_size);
+    buf_ring = nullptr;
+    is_opened = false;
+}
+
+void UringTransport::provide_buffer(unsigned int bid)
+{
+    // The entries are indexed from the ring start rather than through
+    // io_uring_buf_ring::bufs, whose flexible array declaration
+    // gets a wrong offset when compiled as C++.
+    const uint16_t tail = buf_ring->tail;
+    auto bufs = reinterpret_cast<struct io_uring_buf*>(buf_ring);
+    auto buf = &bufs[tail & (config::io_uring_recv_buffers - 1)];
+    buf->addr = reinterpret_cast<uintptr_t>(&recv_bufs[bid * config::io_uring_recv_buffer_size]);
+    buf->len = config::io_uring_recv_buffer_size;
+    buf->bid = static_cast<uint16_t>(bid);
+    __atomic_store_n(&buf_ring->tail, static_cast<uint16_t>(tail + 1), __ATOMIC_RELEASE);
+}
+
+// Once the session has read the staged bytes
+void UringTransport::provide_held_buffers()
+{
+    if (held_buffers.empty() || staging.size() - staging_pos > config::io_uring_max_staging_size) {
+        return;
+    }
+
+    for (auto bid : held_buffers) {
+        provide_buffer(bid);
+    }
+
+    held_buffers.clear();
+}
+
+int UringTransport::arm_recv()
+{
+    auto sqe = ring.get_sqe();
+
+    if (sqe == nullptr) {
+        return -1;
+    }
+
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+    sqe->user_data = RECV_TAG;
+
+    if (multishot) {
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+    } else {
+        sqe->len = config::io_uring_recv_buffer_size;
+    }
+
+    recv_armed = true;
+    return 0;
+}
+
+int UringTransport::prep_send_fixed(const unsigned char *data, size_t len)
+{
+    auto sqe = ring.get_sqe();
+
+    if (sqe == nullptr) {
+        return -1;
+    }
+
+    sqe->opcode = IORING_OP_WRITE_FIXED;
+    sqe->buf_index = 0;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uintptr_t>(data);
+    sqe->len = static_cast<uint32_t>(len);
+    sqe->user_data = SEND_TAG;
+
+    send_in_flight = true;
+    send_fixed = true;
+    send_addr = data;
+    send_remaining = len;
+    return 0;
+}
+
+int UringTransport::prep_sendmsg()
+{
+    auto sqe = ring.get_sqe();
+
+    if (sqe == nullptr) {
+        return -1;
+    }
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uintptr_t>(&send_msg);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = SEND_TAG;
+
+    send_in_flight = true;
+    send_fixed = false;
+    return 0;
+}
+
+int UringTransport::prep_pending_send()
+{
+    if (send_len > 0 && !send_in_flight) {
+        return prep_send_fixed(send_buf.data(), send_len);
+    }
+
+    return 0;
+}
+
+int UringTransport::wait_completions()
+{
+    if (ring.submit_and_wait(1) < 0) {
+        has_error = true;
+        return -1;
+    }
+
+    process_completions();
+    return has_error ? -1 : 0;
+}
+
+void UringTransport::process_completions()
+{
+    struct io_uring_cqe *cqe;
+
+    while ((cqe = ring.peek_cqe()) != nullptr) {
+        if (cqe->user_data == RECV_TAG) {
+            handle_recv(cqe);
+        } else if (cqe->user_data == SEND_TAG) {
+            handle_send(cqe);
+        }
+
+        ring.cqe_seen();
+    }
+}
+
+void UringTransport::handle_recv(const struct io_uring_cqe *cqe)
+{
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        recv_armed = false;
+    }
+
+    if (cqe->res > 0) {
+        const unsigned int bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        const auto data = &recv_bufs[bid * config::io_uring_recv_buffer_size];
+
+        // Free the consumed bytes (the commands pipelined while sending)
+        if (staging_pos > 0 && 2 * staging_pos >= staging.size()) {
+            staging.erase(staging.begin(), staging.begin() + static_cast<std::ptrdiff_t>(staging_pos));
+            staging_pos = 0;
+        }
+
+        staging.insert(staging.end(), data, data + cqe->res);
+
+        // Backpressure: the kernel runs out of buffers until the session reads
+        if (staging.size() - staging_pos > config::io_uring_max_staging_size) {
+            held_buffers.push_back(bid);
+        } else {
+            provide_buffer(bid);
+        }
+
+        return;
+    }
+
+    switch (-cqe->res) {
+      case 0:
+        connection_closed = true;
+        break;
+      case ENOBUFS:   // All buffers in use. Re-armed at next wait.
+      case EINTR:
+      case EAGAIN:
+      case ECANCELED:
+        break;
+      case EINVAL:
+        // Multishot receive not supported by the kernel
+        if (multishot) {
+            multishot = false;
+            break;
+        }
+        has_error = true;
+        break;
+      default:
+        has_error = true;
+    }
+}
+
+void UringTransport::handle_send(const struct io_uring_cqe *cqe)
+{
+    if (cqe->res < 0) {
+        if (cqe->res == -EINTR || cqe->res == -EAGAIN) {
+            send_fixed ? prep_send_fixed(send_addr, send_remaining) : prep_sendmsg();
+            return;
+        }
+
+        send_in_flight = false;
+        has_error = true;
+        return;
+    }
+
+    if (cqe->res == 0) {
+        send_in_flight = false;
+        connection_closed = true;
+        has_error = true;
+        return;
+    }
+
+    const auto bytes_send = static_cast<size_t>(cqe->res);
+
+    if (send_fixed) {
+        // Partial write
+        if (bytes_send < send_remaining) {
+            prep_send_fixed(send_addr + bytes_send, send_remaining - bytes_send);
+            return;
+        }
+
+        send_len = 0;
+    } else {
+        auto iov = send_msg.msg_iov;
+        size_t iovcnt = send_msg.msg_iovlen;
+        advance_iovecs(iov, iovcnt, bytes_send);
+
+        if (iovcnt > 0) {
+            send_msg.msg_iov = iov;
+            send_msg.msg_iovlen = iovcnt;
+            prep_sendmsg();
+            return;
+        }
+    }
+
+    send_in_flight = false;
+}
+
+int UringTransport::wait_send()
+{
+    while (send_in_flight) {
+        if (wait_completions() < 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int64_t UringTransport::recv(char *buffer, int64_t n_bytes)
+{
+    int64_t bytes_read = 0;
+
+    while (bytes_read < n_bytes) {
+        const auto available = staging.size() - staging_pos;
+
+        if (available > 0) {
+            const auto n = std::min(available, static_cast<size_t>(n_bytes - bytes_read));
+            std::memcpy(buffer + bytes_read, &staging[staging_pos], n);
+            staging_pos += n;
+            bytes_read += n;
+            provide_held_buffers();
+            continue;
+        }
+
+        staging.clear();
+        staging_pos = 0;
+        provide_held_buffers();
+
+        if (connection_closed) {
+            return 0;
+        }
+
+        if (has_error) {
+            return -1;
+        }
+
+        // The coalesced responses are submitted with the receive request
+        if (prep_pending_send() < 0) {
+            return -1;
+        }
+
+        if (!recv_armed && arm_recv() < 0) {
+            return -1;
+        }
+
+        if (wait_completions() < 0) {
+            return -1;
+        }
+    }
+
+    return bytes_read;
+}
+
+int64_t UringTransport::send(const unsigned char *data, size_t len)
+{
+    struct iovec iov{const_cast<unsigned char*>(data), len};
+    return send(&iov, 1);
+}
+
+int64_t UringTransport::send(struct iovec *iov, size_t iovcnt)
+{
+    size_t len = 0;
+
+    for (size_t i = 0; i < iovcnt; i++) {
+        len += iov[i].iov_len;
+    }
+
+    if (has_error || wait_send() < 0) {
+        return -1;
+    }
+
+    if (len > send_buf.size() - send_len && flush() < 0) {
+        return -1;
+    }
+
+    if (len <= send_buf.size() - send_len) {
+        for (size_t i = 0; i < iovcnt; i++) {
+            std::memcpy(&send_buf[send_len], iov[i].iov_base, iov[i].iov_len);
+            send_len += iov[i].iov_len;
+        }
+
+        return static_cast<int64_t>(len);
+    }
+
+    // Large payload sent from the caller memory
+    send_msg = {};
+    send_msg.msg_iov = iov;
+    send_msg.msg_iovlen = std::min(iovcnt, static_cast<size_t>(IOV_MAX));
+
+    while (iovcnt > 0) {
+        const size_t n_iov = send_msg.msg_iovlen;
+
+        if (prep_sendmsg() < 0 || wait_send() < 0) {
+            return -1;
+        }
+
+        // More than IOV_MAX buffers
+        iov += n_iov;
+        iovcnt -= n_iov;
+        send_msg.msg_iov = iov;
+        send_msg.msg_iovlen = std::min(iovcnt, static_cast<size_t>(IOV_MAX));
+    }
+
+    return static_cast<int64_t>(len);
+}
+
+int UringTransport::flush()
+{
+    if (has_error) {
+        return -1;
+    }
+
+    if (prep_pending_send() < 0) {
+        return -1;
+    }
+
+    return wait_send();
+}
+
+#else // KOHERON_HAS_IO_URING
+
+int UringTransport::open(int) {return -1;}
+void UringTransport::close() {}
+int64_t UringTransport::recv(char *, int64_t) {return -1;}
+int64_t UringTransport::send(const unsigned char *, size_t) {return -1;}
+int64_t UringTransport::send(struct iovec *, size_t) {return -1;}
+int UringTransport::flush() {return 0;}
+
+#endif // KOHERON_HAS_IO_URING
+
+} // namespace koheron
@@ -0,0 +1,187 @@
+/// io_uring transport for stream sockets
+///
+/// Used by the TCP and Unix sessions in place of the
+/// blocking read/write calls:
+/// - Data are received with a multishot receive into a ring of
+///   buffers provided to the kernel. A single submission then serves
+///   many commands. Kernels without multishot receive re-arm a
+///   single-shot receive on the same buffers.
+/// - Responses are copied into a registered send buffer and coalesced.
+///   They are submitted together with the next receive request,
+///   so that executing a command costs a single system call.
+///   Responses larger than the send buffer are sent with sendmsg
+///   directly from the caller memory.
+///
+/// The ring is set up with raw system calls. If the kernel
+/// (or the headers) doesn't provide the required features open()
+/// fails and the session must use the default read/write path.
+///
+/// (c) Koheron
+
+#ifndef __KOHERON_URING_HPP__
+#define __KOHERON_URING_HPP__
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "iovec.hpp"
+
+#if __has_include(<linux/io_uring.h>)
+extern "C" {
+  #include <linux/io_uring.h>
+  #include <sys/syscall.h>
+  #include <sys/socket.h>
+}
+#endif
+
+// Multishot receive and provided buffer rings are available since Linux 6.0
+#if defined(IORING_RECV_MULTISHOT) && defined(__NR_io_uring_setup)
+# define KOHERON_HAS_IO_URING 1
+#else
+# define KOHERON_HAS_IO_URING 0
+#endif
+
+namespace koheron {
+
+#if KOHERON_HAS_IO_URING
+
+/// Minimal io_uring instance
+class IoUring
+{
+  public:
+    IoUring() = default;
+    ~IoUring() {release();}
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    int init(unsigned int entries);
+    void release();
+
+    int fd() const {return ring_fd;}
+
+    /// Bytes of the mapped rings
+    size_t memory_size() const {return sq_map_size + cq_map_size + sqes_map_size;}
+
+    /// Get an empty submission entry. Returns nullptr if the queue is full.
+    struct io_uring_sqe* get_sqe();
+
+    /// Submit the prepared entries and wait for wait_nr completions
+    int submit_and_wait(unsigned int wait_nr);
+
+    /// Next available completion, nullptr if none
+    struct io_uring_cqe* peek_cqe();
+    void cqe_seen();
+
+    int register_resource(unsigned int opcode, void *arg, unsigned int nr_args);
+
+  private:
+    int ring_fd = -1;
+    unsigned int sq_entries = 0;
+    unsigned int sqe_tail = 0;   ///< Local tail of the prepared entries
+
+    void *sq_ptr = nullptr;
+    size_t sq_map_size = 0;
+    void *cq_ptr = nullptr;
+    size_t cq_map_size = 0;
+    struct io_uring_sqe *sqes = nullptr;
+    size_t sqes_map_size = 0;
+
+    unsigned int *sq_head = nullptr;
+    unsigned int *sq_tail = nullptr;
+    unsigned int *sq_mask = nullptr;
+    unsigned int *sq_array = nullptr;
+    unsigned int *cq_head = nullptr;
+    unsigned int *cq_tail = nullptr;
+    unsigned int *cq_mask = nullptr;
+    struct io_uring_cqe *cqes = nullptr;
+};
+
+#endif // KOHERON_HAS_IO_URING
+
+class UringTransport
+{
+  public:
+    UringTransport() = default;
+    ~UringTransport() {close();}
+
+    UringTransport(const UringTransport&) = delete;
+    UringTransport& operator=(const UringTransport&) = delete;
+
+    /// Set up the ring for the socket. Returns -1 if io_uring is unavailable.
+    int open(int comm_fd);
+    void close();
+
+    bool is_open() const {return is_opened;}
+
+    /// Bytes of the rings and of the receive and send buffers
+    size_t memory_size() const {
+#if KOHERON_HAS_IO_URING
+        return ring.memory_size() + buf_ring_size + recv_bufs.capacity()
+               + staging.capacity() + send_buf.capacity();
+#else
+        return 0;
+#endif
+    }
+
+    /// Receive exactly n_bytes.
+    /// Same return values than read: 0 if the connection is closed, -1 on error.
+    int64_t recv(char *buffer, int64_t n_bytes);
+
+    /// Send (or buffer) len bytes. Returns len on success, -1 on error.
+    int64_t send(const unsigned char *data, size_t len);
+
+    /// Send (or buffer) a list of buffers. The iovec list is modified.
+    int64_t send(struct iovec *iov, size_t iovcnt);
+
+    /// Send the coalesced responses and wait for completion
+    int flush();
+
+  private:
+    bool is_opened = false;
+
+#if KOHERON_HAS_IO_URING
+    enum Tag : uint64_t {RECV_TAG = 1, SEND_TAG = 2};
+
+    IoUring ring;
+    int fd = -1;
+    bool connection_closed = false;
+    bool has_error = false;
+
+    // Receive
+    struct io_uring_buf_ring *buf_ring = nullptr;
+    size_t buf_ring_size = 0;
+    std::vector<char> recv_bufs;
+    bool multishot = true;
+    bool recv_armed = false;
+    std::vector<char> staging;  ///< Received bytes not yet consumed
+    size_t staging_pos = 0;
+    std::vector<unsigned int> held_buffers;  ///< Not provided while staging is full
+
+    // Send
+    std::vector<unsigned char> send_buf;  ///< Registered buffer
+    size_t send_len = 0;
+    bool send_in_flight = false;
+    bool send_fixed = false;
+    const unsigned char *send_addr = nullptr;  ///< Fixed buffer write
+    size_t send_remaining = 0;
+    struct msghdr send_msg{};                  ///< Scatter-gather send
+
+    void provide_buffer(unsigned int bid);
+    void provide_held_buffers();
+    int arm_recv();
+    int prep_send_fixed(const unsigned char *data, size_t len);
+    int prep_sendmsg();
+    int prep_pending_send();
+    int wait_completions();
+    void process_completions();
+    void handle_recv(const struct io_uring_cqe *cqe);
+    void handle_send(const struct io_uring_cqe *cqe);
+    int wait_send();
+#endif
+};
+
+} // namespace koheron
+
+#endif // __KOHERON_URING_HPP__
@@ -10,39 +10,50 @@
 #include <sstream>
 #include <iostream>
 #include <cstdlib>
+#include <algorithm>
 
 extern "C" {
     #include <sys/socket.h> // socket definitions
     #include <arpa/inet.h>  // inet (3) funtions
     #include <sys/types.h>  // socket types
     #include <unistd.h>
+    #include <poll.h>
 }
 
 #include "base64.hpp"
 #include "sha1.h"
 #include "syslog.hpp"
+#include "reactor.hpp"
+#include "websocket_mask.hpp"
 
 namespace koheron {
 
-WebSocket::WebSocket(SysLog& syslog_)
+WebSocket::WebSocket(SysLog& syslog_, BufferPool& pool_)
 : syslog(syslog_),
+  pool(pool_),
   comm_fd(-1),
-  read_str_len(0),
+  reader(pool_, config::recv_buffer_size),
+  message_size(0),
+  message_received(false),
   connection_closed(false)
 {
-    bzero(read_str, WEBSOCK_READ_STR_LEN);
     bzero(sha_str, 21);
+    bzero(header_bytes, BIG_HEADER);
+    bzero(control_payload, SMALL_STREAM);
 }
 
 void WebSocket::set_id(int comm_fd_)
 {
     comm_fd = comm_fd_;
+    reader.set_fd(comm_fd);
 }
 
 int WebSocket::authenticate()
 {
-    if (read_http_packet() < 0)
-        return -1;
+    const int err = read_http_packet();
+
+    if (err != 0)
+        return err;
 
     static const std::string WSKeyIdentifier("Sec-WebSocket-Key: ");
     static const std::string WSProtocolIdentifier("Sec-WebSocket-Protocol: ");
@@ -85,44 +96,62 @@ int WebSocket::authenticate()
     return send_request(oss.str());
 }
 
+// Returns 0 once the request is received, -1 on error,
+// INCOMPLETE if the rest of the request is not yet received (reactor mode).
 int WebSocket::read_http_packet()
 {
-    reset_read_buff();
+    static const std::string delimiter("\r\n\r\n");
+    const int flags = config::session_model == config::SessionModel::REACTOR ? MSG_DONTWAIT : 0;
+
+    // The request can be received in several reads
+    while (true) {
+        if (reader.available() > 0) {
+            const char *data = reader.peek();
+            const char *end = data + reader.available();
+            const char *pos = std::search(data, end, delimiter.begin(), delimiter.end());
+
+            if (pos != end) {
+                const auto len = static_cast<size_t>(pos - data) + delimiter.size();
+                http_packet.assign(data, len);
+                reader.consume(len);
+                break;
+            }
 
-    int nb_bytes_rcvd = read(comm_fd, read_str, WEBSOCK_READ_STR_LEN);
+            if (reader.available() >= KOHERON_READ_STR_LEN) {
+                syslog.print<CRITICAL>("WebSocket: Read buffer overflow\n");
+                return -1;
+            }
+        }
 
-    // Check reception ...
-    if (nb_bytes_rcvd < 0) {
-        syslog.print<CRITICAL>("WebSocket: Read error\n");
-        return -1;
-    }
+        const auto nb_bytes_rcvd = reader.fill(flags);
 
-    if (nb_bytes_rcvd == KOHERON_READ_STR_LEN) {
-        syslog.print<CRITICAL>("WebSocket: Read buffer overflow\n");
-        return -1;
-    }
+        if (nb_bytes_rcvd == 0) { // Connection closed by client
+            connection_closed = true;
+            return -1;
+        }
 
-    if (nb_bytes_rcvd == 0) { // Connection closed by client
-        connection_closed = true;
-        return -1;
-    }
+        if (nb_bytes_rcvd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
 
-    http_packet = std::string(read_str);
-    std::size_t delim_pos = http_packet.find("\r\n\r\n");
+            if (flags != 0 && would_block(errno)) {
+                return INCOMPLETE;
+            }
 
-    if (delim_pos == std::string::npos) {
-        syslog.print<CRITICAL>("WebSocket: No HTML header found\n");
-        return -1;
+            syslog.print<CRITICAL>("WebSocket: Read error\n");
+            return -1;
+        }
     }
 
     syslog.print<DEBUG>("[R] HTTP header\n");
-    return nb_bytes_rcvd;
+    return 0;
 }
 
 int WebSocket::set_send_header(unsigned char *bits, int64_t data_len,
                                unsigned int format)
 {
-    memset(bits, 0, 10 + data_len);
+    memset(bits, 0, BIG_OFFSET);
 
     bits[0] = format;
     int mask_offset = 0;
@@ -153,9 +182,126 @@ int WebSocket::set_send_header(unsigned char *bits, int64_t data_len,
     return mask_offset;
 }
 
+int WebSocket::send(IovecBuffer& buffer, bool wait_drained)
+{
+    std::unique_lock<std::mutex> lock(send_mutex);
+
+    if (connection_closed)
+        return 0;
+
+    // The stream frames wait for the previous ones to be written
+    if (wait_drained && config::session_model == config::SessionModel::REACTOR
+        && output.wait_drained(lock) < 0) {
+        return -1;
+    }
+
+    const uint64_t size = buffer.size();
+    const uint64_t fragment_size = config::websocket_fragment_size > 0
+                                   ? config::websocket_fragment_size
+                                   : std::max(size, uint64_t(1));
+    const size_t n_frames = size > 0 ? (size + fragment_size - 1) / fragment_size : 1;
+
+    send_headers.resize(n_frames);
+    send_iov.clear();
+
+    // The header of each fragment is followed by the parts
+    // of the source buffers it contains.
+    size_t frame = 0;
+
+    auto add_frame_header = [&]() -> uint64_t {
+        const uint64_t len = std::min(fragment_size, size - frame * fragment_size);
+        const unsigned int fin = frame == n_frames - 1 ? (1 << 7) : 0;
+        const unsigned int opcode = frame == 0 ? BINARY_FRAME : CONTINUATION_FRAME;
+        auto& frame_header = send_headers[frame];
+        const auto header_len = set_send_header(frame_header.data(), static_cast<int64_t>(len), fin + opcode);
+        send_iov.push_back({frame_header.data(), static_cast<size_t>(header_len)});
+        return len;
+    };
+
+    uint64_t frame_remaining = add_frame_header();
+
+    for (auto iov : buffer.iovecs()) {
+        while (iov.iov_len > 0) {
+            if (frame_remaining == 0) {
+                frame++;
+                frame_remaining = add_frame_header();
+            }
+
+            const auto n = std::min<uint64_t>(iov.iov_len, frame_remaining);
+            send_iov.push_back({iov.iov_base, static_cast<size_t>(n)});
+            iov.iov_base = static_cast<char*>(iov.iov_base) + n;
+            iov.iov_len -= n;
+            frame_remaining -= n;
+        }
+    }
+
+    const auto bytes_send = send_iovecs(send_iov.data(), send_iov.size());
+
+    if (bytes_send == 0) {
+        connection_closed = true;
+        syslog.print<INFO>("WebSocket: Connection closed by client\n");
+        return 0;
+    }
+
+    if (bytes_send < 0) {
+        connection_closed = true;
+        syslog.print<ERROR>("WebSocket: Cannot send frame\n");
+        return -1;
+    }
+
+    syslog.print<DEBUG>("[S] %i bytes\n", bytes_send);
+    return static_cast<int>(bytes_send);
+}
+
+// Send a single frame (control frames)
+int WebSocket::send_frame(unsigned int format, const char *data, int64_t len)
+{
+    std::lock_guard<std::mutex> lock(send_mutex);
+
+    if (connection_closed)
+        return 0;
+
+    unsigned char frame_header[BIG_OFFSET];
+    const auto header_len = set_send_header(frame_header, len, format);
+
+    struct iovec iov[2];
+    iov[0].iov_base = frame_header;
+    iov[0].iov_len = static_cast<size_t>(header_len);
+    iov[1].iov_base = const_cast<char*>(data);
+    iov[1].iov_len = static_cast<size_t>(len);
+
+    if (send_iovecs(iov, len > 0 ? 2 : 1) <= 0) {
+        connection_closed = true;
+        syslog.print<ERROR>("WebSocket: Cannot send control frame\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+// Send a close frame with the status code, then stop reading the connection
+void WebSocket::close_connection(uint16_t status)
+{
+    const char code[2] = {static_cast<char>(status >> 8), static_cast<char>(status & 0xFF)};
+    send_frame((1 << 7) + CONNECTION_CLOSE, code, sizeof(code));
+    connection_closed = true;
+}
+
+// Blocking send, or queued without blocking in reactor mode.
+// Called with send_mutex locked.
+int64_t WebSocket::send_iovecs(struct iovec *iov, size_t iovcnt)
+{
+    if (config::session_model == config::SessionModel::REACTOR) {
+        return output.send(iov, iovcnt);
+    }
+
+    return writev_all(comm_fd, iov, iovcnt);
+}
+
 int WebSocket::exit()
 {
-    return send_request(send_buf, set_send_header(send_buf, 0, (1 << 7) + CONNECTION_CLOSE));
+    unsigned char frame[BIG_OFFSET];
+    return send_request(frame, set_send_header(frame, 0, (1 << 7) + CONNECTION_CLOSE));
 }
 
 int WebSocket::receive_cmd(Command& cmd)
@@ -167,98 +313,317 @@ int WebSocket::receive_cmd(Command& cmd)
 
     if (err < 0)
         return -1;
-    else if (err == 1) /* Connection closed by client*/
+    else if (err == 1 || err == INCOMPLETE) /* Connection closed by client or rest of the message not yet received */
         return 0;
 
+    if (!message_received) {
+        return 0;
+    }
+
     if (decode_raw_stream_cmd(cmd) < 0) {
         syslog.print<CRITICAL>("WebSocket: Cannot decode command stream\n");
         return -1;
     }
 
-    syslog.print<DEBUG>("[R] WebSocket: command of %u bytes\n", header.payload_size);
-    return header.payload_size;
+    syslog.print<DEBUG>("[R] WebSocket: command of %li bytes\n", message_size);
+    return static_cast<int>(message_size);
 }
 
 int WebSocket::decode_raw_stream_cmd(Command& cmd)
 {
-    if (read_str_len < header.header_size + 1)
+    if (payload.empty()) {
         return -1;
+    }
 
-    char *mask = read_str + header.mask_offset;
-    char *payload_ptr = read_str + header.mask_offset + 4;
+    char *data = payload.data();
 
-    for (int64_t i = 0; i < Command::HEADER_SIZE; ++i) {
-        cmd.header.data()[i] = (payload_ptr[i] ^ mask[i % 4]);
+    // Too small commands are rejected by the session
+    if (message_size < Command::HEADER_SIZE) {
+        cmd.payload.set(data, 0);
+        return 0;
     }
 
-    for (int64_t i = Command::HEADER_SIZE; i < header.payload_size; ++i) {
-        cmd.payload.data()[i - Command::HEADER_SIZE] = (payload_ptr[i] ^ mask[i % 4]);
-    }
+    std::memcpy(cmd.header.data(), data, Command::HEADER_SIZE);
 
+    // The arguments are deserialized in place from the payload buffer
+    cmd.payload.set(data + Command::HEADER_SIZE,
+                    static_cast<size_t>(message_size - Command::HEADER_SIZE));
     return 0;
 }
 
-int WebSocket::decode_raw_stream()
+// Read the frames up to the end of the next message.
+// The control frames received in between are handled.
+// Returns 0 on success, 1 if the connection is closed, -1 on error.
+// In reactor mode, returns INCOMPLETE once the bytes received are
+// consumed: the next call resumes the reception from there.
+int WebSocket::read_stream()
 {
-    if (read_str_len < header.header_size + 1)
-        return -1;
+    message_received = false;
+
+    while (true) {
+        if (!in_frame) {
+            if (!in_message) {
+                message_size = 0;
+
+                if (wait_message() < 0) {
+                    return -1;
+                }
+            }
+
+            // The header of a frame (and the payload of a control
+            // frame) is read again if only partially received
+            reader.mark();
+            int err = read_header();
+
+            if (err == 0 && check_opcode(header.opcode) < 0) {
+                return -1;
+            }
+
+            // Client frames must be masked (RFC 6455 section 5.1)
+            if (err == 0 && !header.masked) {
+                syslog.print<CRITICAL>("WebSocket: Unmasked client frame\n");
+                close_connection(CLOSE_PROTOCOL_ERROR);
+                return -1;
+            }
+
+            if (err == 0 && (header.opcode & 0x8)) {
+                // Control frames can be interleaved with the message fragments
+                err = read_control_frame();
 
-    char *mask = read_str + header.mask_offset;
-    payload = read_str + header.mask_offset + 4;
+                if (err == INCOMPLETE) {
+                    reader.rewind();
+                    return err;
+                }
+
+                reader.unmark();
+
+                if (err != 0) {
+                    return err;
+                }
+
+                continue;
+            }
+
+            if (err == INCOMPLETE) {
+                reader.rewind();
+                return err;
+            }
+
+            reader.unmark();
+
+            if (err < 0) {
+                syslog.print<CRITICAL>("WebSocket: Cannot read header\n");
+                return -1;
+            }
+
+            if (err == 1) {
+                // Connection closed
+                return err;
+            }
+
+            if (in_message != (header.opcode == CONTINUATION_FRAME)) {
+                syslog.print<CRITICAL>("WebSocket: Unexpected %s frame\n",
+                                       in_message ? "data" : "continuation");
+                return -1;
+            }
+
+            if (begin_data_frame() < 0) {
+                return -1;
+            }
+        }
+
+        const int err = read_frame_payload();
+
+        if (err != 0) {
+            return err;
+        }
+
+        in_frame = false;
+
+        if (header.fin) {
+            in_message = false;
+            message_received = true;
+            return 0;
+        }
+
+        in_message = true;
+    }
+}
 
-    for (int64_t i = 0; i < header.payload_size; ++i) {
-        payload[i] = (payload[i] ^ mask[i % 4]);
+// Start the reception of the payload of a data frame
+int WebSocket::begin_data_frame()
+{
+    if (header.payload_size > config::websocket_max_message_size - message_size) {
+        syslog.print<CRITICAL>("WebSocket: Message too large\n");
+        return -1;
     }
 
+    in_frame = true;
+    payload_remaining = header.payload_size;
     return 0;
 }
 
-int WebSocket::read_stream()
+// Make room in the message for the next bytes of the frame payload.
+// The buffer grows geometrically with the bytes received rather than
+// with the declared payload size, which the client could inflate.
+// The payload buffer is kept from one message to the next.
+void WebSocket::reserve_payload()
 {
-    reset_read_buff();
+    const auto size = static_cast<size_t>(message_size);
+
+    if (payload.size() > size) {
+        return;
+    }
+
+    const auto new_size = std::min(std::max(2 * payload.size(), payload_min_size),
+                                   size + static_cast<size_t>(payload_remaining));
+    auto new_payload = pool.acquire(new_size);
+
+    if (size > 0) {
+        std::memcpy(new_payload.data(), payload.data(), size);
+    }
+
+    payload = std::move(new_payload);
+}
+
+// Append the payload of the current data frame to the message.
+// Returns 0 once the frame is received, 1 if the connection is closed,
+// -1 on error, INCOMPLETE if the rest is not yet received (reactor mode).
+int WebSocket::read_frame_payload()
+{
+    const bool reactor = config::session_model == config::SessionModel::REACTOR;
+
+    while (payload_remaining > 0) {
+        reserve_payload();
+        char *data = payload.data() + message_size;
+        const auto len = std::min(static_cast<size_t>(payload_remaining),
+                                  payload.size() - static_cast<size_t>(message_size));
+        const auto n = reader.read(data, len, reactor ? MSG_DONTWAIT : 0);
+
+        if (n == 0) {
+            syslog.print<INFO>("WebSocket: Connection closed by client\n");
+            connection_closed = true;
+            return 1;
+        }
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            if (reactor && would_block(errno)) {
+                return INCOMPLETE;
+            }
 
-    int read_head_err = read_header();
+            syslog.print<CRITICAL>("WebSocket: Cannot read payload\n");
+            return -1;
+        }
+
+        // The mask is applied from the offset of the bytes in the frame
+        const auto offset = header.payload_size - payload_remaining;
+        const char *mask = header_bytes + header.mask_offset;
+        char rotated_mask[4];
+
+        for (int i = 0; i < 4; i++) {
+            rotated_mask[i] = mask[(offset + i) % 4];
+        }
+
+        unmask(data, static_cast<uint64_t>(n), rotated_mask);
+        message_size += n;
+        payload_remaining -= n;
+    }
 
-    if (read_head_err < 0) {
-        syslog.print<CRITICAL>("WebSocket: Cannot read header\n");
+    return 0;
+}
+
+int WebSocket::read_control_frame()
+{
+    if (!header.fin || header.payload_size > SMALL_STREAM) {
+        syslog.print<CRITICAL>("WebSocket: Invalid control frame\n");
         return -1;
     }
 
-    if (read_head_err == 1) {
-        // Connection closed
-        return read_head_err;
+    int err = read_n_bytes(control_payload, header.payload_size);
+
+    if (err != 0) {
+        return err;
     }
 
-    // Read payload
-    int err = read_n_bytes(header.payload_size, header.payload_size);
+    unmask(control_payload, static_cast<uint64_t>(header.payload_size), header_bytes + header.mask_offset);
 
-    if (err < 0) {
-        syslog.print<CRITICAL>("WebSocket: Cannot read payload\n");
+    switch (header.opcode) {
+      case PING:
+        syslog.print<DEBUG>("WebSocket: Ping\n");
+        return send_frame((1 << 7) + PONG, control_payload, header.payload_size);
+      case PONG:
+        syslog.print<DEBUG>("WebSocket: Pong\n");
+        return 0;
+      case CONNECTION_CLOSE:
+        syslog.print<INFO>("WebSocket: Connection close\n");
+        // Echo the status code
+        send_frame((1 << 7) + CONNECTION_CLOSE, control_payload, std::min(header.payload_size, int64_t(2)));
+        connection_closed = true;
+        return 1;
+      default:
         return -1;
     }
+}
+
+// Wait for the next message, pinging the client while it is idle.
+// Returns -1 if the client doesn't answer to the ping.
+int WebSocket::wait_message()
+{
+    // Reactor sessions are only read when data are available
+    if (config::websocket_ping_interval_ms <= 0 || reader.available() > 0
+        || config::session_model == config::SessionModel::REACTOR) {
+        return 0;
+    }
+
+    bool ping_sent = false;
+
+    while (true) {
+        struct pollfd pfd{};
+        pfd.fd = comm_fd;
+        pfd.events = POLLIN;
+
+        const int n = poll(&pfd, 1, config::websocket_ping_interval_ms);
+
+        if (n > 0) {
+            // Errors are reported by the next read
+            return 0;
+        }
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return -1;
+        }
 
-    return err;
+        if (ping_sent) {
+            syslog.print<INFO>("WebSocket: No answer to ping, closing the connection\n");
+            return -1;
+        }
+
+        if (send_frame((1 << 7) + PING, nullptr, 0) < 0) {
+            return -1;
+        }
+
+        ping_sent = true;
+    }
 }
 
 int WebSocket::check_opcode(unsigned int opcode)
 {
     switch (opcode) {
       case CONTINUATION_FRAME:
-        syslog.print<CRITICAL>("WebSocket: Continuation frame is not suported\n");
-        return -1;
       case TEXT_FRAME:
-        break;
       case BINARY_FRAME:
-        break;
       case CONNECTION_CLOSE:
-        syslog.print<INFO>("WebSocket: Connection close\n");
-        return 1;
       case PING:
-        syslog.print<CRITICAL>("WebSocket: Ping is not suported\n");
-        return -1;
       case PONG:
-        syslog.print<CRITICAL>("WebSocket: Pong is not suported\n");
-        return -1;
+        break;
       default:
         syslog.print<CRITICAL>("WebSocket: Invalid opcode %u\n", opcode);
         return -1;
@@ -269,55 +634,48 @@ int WebSocket::check_opcode(unsigned int opcode)
 
 int WebSocket::read_header()
 {
-    if (read_n_bytes(6,6) < 0)
-        return -1;
-
-    if (connection_closed)
-        return 0;
+    // Frame header: 2 bytes + 4 bytes of mask for small messages
+    int err = read_n_bytes(header_bytes, SMALL_HEADER);
 
-    header.fin = read_str[0] & 0x80;
+    if (err != 0) {
+        return err;
+    }
 
-    header.masked = read_str[1] & 0x80;
-    unsigned char stream_size = read_str[1] & 0x7F;
+    header.fin = header_bytes[0] & 0x80;
 
-    header.opcode = read_str[0] & 0x0F;
+    header.masked = header_bytes[1] & 0x80;
+    unsigned char stream_size = header_bytes[1] & 0x7F;
 
-    int opcode_err = check_opcode(header.opcode);
+    header.opcode = header_bytes[0] & 0x0F;
 
-    if (opcode_err < 0) {
-        return -1;
-    } else if (opcode_err == 1) {
-        connection_closed = true;
-        return opcode_err;
-    }
     if (stream_size <= SMALL_STREAM) {
         header.header_size = SMALL_HEADER;
         header.payload_size = stream_size;
         header.mask_offset = SMALL_OFFSET;
     }
     else if (stream_size == MEDIUM_STREAM) {
-        if (read_n_bytes(2, 2) < 0) {
-            return -1;
-        }
-        if (connection_closed) {
-            return 0;
+        err = read_n_bytes(&header_bytes[SMALL_HEADER], MEDIUM_HEADER - SMALL_HEADER);
+
+        if (err != 0) {
+            return err;
         }
+
         header.header_size = MEDIUM_HEADER;
         uint16_t s = 0;
-        memcpy(&s, reinterpret_cast<const char*>(&read_str[2]), 2);
+        memcpy(&s, &header_bytes[2], 2);
         header.payload_size = ntohs(s);
         header.mask_offset = MEDIUM_OFFSET;
     }
     else if (stream_size == BIG_STREAM) {
-        if (read_n_bytes(8, 8) < 0) {
-            return -1;
-        }
-        if (connection_closed) {
-            return 0;
+        err = read_n_bytes(&header_bytes[SMALL_HEADER], BIG_HEADER - SMALL_HEADER);
+
+        if (err != 0) {
+            return err;
         }
+
         header.header_size = BIG_HEADER;
         uint64_t l = 0;
-        memcpy(&l, reinterpret_cast<const char*>(&read_str[2]), 8);
+        memcpy(&l, &header_bytes[2], 8);
         header.payload_size = static_cast<int64_t>(be64toh(l));
         header.mask_offset = BIG_OFFSET;
     } else {
@@ -325,37 +683,28 @@ int WebSocket::read_header()
         return -1;
     }
 
-    if (header.payload_size > WEBSOCK_READ_STR_LEN - 56) {
-        syslog.print<CRITICAL>("WebSocket: Message too large\n");
+    if (header.payload_size < 0) {
+        syslog.print<CRITICAL>("WebSocket: Invalid payload size\n");
         return -1;
     }
 
     return 0;
 }
 
-int WebSocket::read_n_bytes(int64_t bytes, int64_t expected)
+// Returns 0 on success, 1 if the connection is closed, -1 on error,
+// INCOMPLETE if the bytes are not yet all received (reactor mode).
+int WebSocket::read_n_bytes(char *dst, int64_t bytes)
 {
-    int64_t remaining = bytes;
-    int64_t bytes_read = -1;
+    const bool reactor = config::session_model == config::SessionModel::REACTOR;
+    int64_t bytes_read = 0;
 
-    while (expected > 0) {
-        while ((remaining > 0) && ((bytes_read = read(comm_fd, &read_str[read_str_len], remaining)) > 0)) {
-
-            if (bytes_read > 0) {
-                read_str_len += bytes_read;
-                remaining -= bytes_read;
-                expected -= bytes_read;
-            }
-
-            if (bytes_read < 0) {
-                syslog.print<ERROR>("WebSocket: Cannot read data\n");
-                return -1;
-            }
-
-            if (expected < 0) {
-                expected = 0;
-            }
+    while (bytes > 0) {
+        bytes_read = reader.read(dst, static_cast<size_t>(bytes), reactor ? MSG_DONTWAIT : 0);
 
+        if (bytes_read > 0) {
+            dst += bytes_read;
+            bytes -= bytes_read;
+            continue;
         }
 
         if (bytes_read == 0) {
@@ -364,10 +713,16 @@ int WebSocket::read_n_bytes(int64_t bytes, int64_t expected)
             return 1;
         }
 
-        if (read_str_len == KOHERON_READ_STR_LEN) {
-            syslog.print<CRITICAL>("WebSocket: Read buffer overflow\n");
-            return -1;
+        if (errno == EINTR) {
+            continue;
         }
+
+        if (reactor && would_block(errno)) {
+            return INCOMPLETE;
+        }
+
+        syslog.print<ERROR>("WebSocket: Cannot read data\n");
+        return -1;
     }
 
     return 0;
@@ -380,41 +735,30 @@ int WebSocket::send_request(const std::string& request)
 
 int WebSocket::send_request(const unsigned char *bits, int64_t len)
 {
+    std::lock_guard<std::mutex> lock(send_mutex);
+
     if (connection_closed)
         return 0;
 
-    int bytes_send = 0;
-    int remaining = len;
-    int offset = 0;
+    struct iovec iov;
+    iov.iov_base = const_cast<unsigned char*>(bits);
+    iov.iov_len = static_cast<size_t>(len);
+    const auto bytes_send = send_iovecs(&iov, 1);
 
-    while ((remaining > 0) &&
-           (bytes_send = write(comm_fd, &bits[offset], static_cast<uint32_t>(remaining))) > 0) {
-        if (bytes_send > 0) {
-            offset += bytes_send;
-            remaining -= bytes_send;
-        }
-        else if (bytes_send == 0) {
-            connection_closed = true;
-            syslog.print<INFO>("WebSocket: Connection closed by client\n");
-            return 0;
-        }
+    if (bytes_send == 0) {
+        connection_closed = true;
+        syslog.print<INFO>("WebSocket: Connection closed by client\n");
+        return 0;
     }
 
     if (bytes_send < 0) {
         connection_closed = true;
-        syslog.print<ERROR>(
-                "WebSocket: Cannot send request. Error %i\n", bytes_send);
+        syslog.print<ERROR>("WebSocket: Cannot send request\n");
         return -1;
     }
 
-    syslog.print<DEBUG>("[S] %i bytes\n", bytes_send);
-    return bytes_send;
-}
-
-void WebSocket::reset_read_buff()
-{
-    std::memset(read_str, 0, read_str_len);
-    read_str_len = 0;
+    syslog.print<DEBUG>("[S] %li bytes\n", bytes_send);
+    return 0;
 }
 
 } // namespace koheron
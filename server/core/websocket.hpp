@@ -1,15 +1,32 @@
 /// Websocket protocol interface
 ///
+/// Fragmented messages are reassembled into a pooled buffer.
+/// Pings are answered, and idle clients are pinged
+/// (see config::websocket_ping_interval_ms).
+/// Large messages are sent as a sequence of fragments streamed
+/// from the source buffers.
+///
+/// In reactor mode, the reception is resumed where it stopped
+/// when the rest of the handshake or of a frame is received.
+///
 /// (c) Koheron
 
 #ifndef __WEBSOCKET_HPP__
 #define __WEBSOCKET_HPP__
 
 #include <string>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <mutex>
 
 #include "server_definitions.hpp"
 #include "config.hpp"
 #include "commands.hpp"
+#include "iovec.hpp"
+#include "recv_buffer.hpp"
+#include "buffer_pool.hpp"
+#include "reactor.hpp"
 
 namespace koheron {
 
@@ -18,35 +35,90 @@ struct SysLog;
 class WebSocket
 {
   public:
-    WebSocket(SysLog& syslog_);
+    WebSocket(SysLog& syslog_, BufferPool& pool_);
+
+    /// Returned in reactor mode when the rest of the
+    /// handshake or of the message is not yet received
+    static constexpr int INCOMPLETE = 2;
 
     void set_id(int comm_fd_);
     int authenticate();
     int receive_cmd(Command& cmd);
 
-    /// Send binary blob
-    template<class T> int send(const T *data, unsigned int len);
+    /// Send a scatter-gather message as binary frames without copying it.
+    /// Messages larger than config::websocket_fragment_size are fragmented.
+    /// Thread safe (the stream frames are sent by the delivery threads).
+    /// In reactor mode, wait_drained waits for the pending output to be
+    /// written first (delivery threads only).
+    int send(IovecBuffer& buffer, bool wait_drained = false);
+
+    int64_t payload_size() const {return message_size;}
 
-    char* get_payload_no_copy() {return payload;}
-    int64_t payload_size() const {return header.payload_size;}
+    /// False if the rest of the message is not yet received (reactor mode)
+    bool has_message() const {return message_received;}
 
     bool is_closed() const {return connection_closed;}
 
+    // Pending output (reactor mode, see PendingOutput)
+
+    void attach_output(int epoll_fd, int comm_fd_, uint64_t event_data) {
+        output.attach(epoll_fd, comm_fd_, event_data);
+    }
+
+    int drain_output() {
+        std::lock_guard<std::mutex> lock(send_mutex);
+        return output.drain();
+    }
+
+    void close_output() {
+        std::lock_guard<std::mutex> lock(send_mutex);
+        output.close();
+    }
+
+    bool output_pending() {
+        std::lock_guard<std::mutex> lock(send_mutex);
+        return !output.empty();
+    }
+
+    /// Bytes of the receive, payload and send buffers
+    size_t memory_size() {
+        std::lock_guard<std::mutex> lock(send_mutex);
+        return reader.memory_size() + payload.size() + output.memory_size()
+               + send_iov.capacity() * sizeof(struct iovec)
+               + send_headers.capacity() * sizeof(send_headers[0]);
+    }
+
+    /// Give the receive buffers back to the pool while the session is idle
+    void release_buffers() {
+        reader.release_if_empty();
+
+        if (!in_message && !in_frame) {
+            payload.release();
+        }
+    }
+
     int exit();
 
   private:
     SysLog& syslog;
+    BufferPool& pool;
 
     int comm_fd;
+    RecvBuffer reader;
 
     // Buffers
-    uint32_t read_str_len;
-    char read_str[WEBSOCK_READ_STR_LEN];
-    char *payload;
-    unsigned char sha_str[21];
-    unsigned char send_buf[WEBSOCK_SEND_BUF_LEN];
+    PoolBuffer payload; ///< Unmasked payload of the last message received
+    int64_t message_size;
+    bool message_received;
 
-    void reset_read_buff();
+    // Reception state, kept from one read to the next in reactor mode
+    bool in_message = false;      ///< Between the fragments of a message
+    bool in_frame = false;        ///< Payload of a data frame being received
+    int64_t payload_remaining = 0; ///< Bytes of the frame payload not yet received
+
+    unsigned char sha_str[21];
+    std::vector<struct iovec> send_iov;
+    std::vector<std::array<unsigned char, 10>> send_headers; ///< Fragment headers
 
     std::string http_packet;
 
@@ -60,7 +132,9 @@ class WebSocket
         unsigned char res[3];
     } header;
 
-    bool connection_closed;
+    std::atomic<bool> connection_closed;
+    std::mutex send_mutex;
+    PendingOutput output;
 
     enum OpCode {
         CONTINUATION_FRAME = 0x0,
@@ -89,14 +163,32 @@ class WebSocket
         BIG_OFFSET    = 10
     };
 
+    enum CloseStatus {
+        CLOSE_PROTOCOL_ERROR = 1002
+    };
+
+    /// First allocation of the payload buffer of a message
+    static constexpr size_t payload_min_size = 65536;
+
+    char header_bytes[BIG_HEADER]; ///< Raw header of the frame being received
+    char control_payload[SMALL_STREAM];
+
     // Internal functions
     int read_http_packet();
-    int decode_raw_stream();
     int decode_raw_stream_cmd(Command& cmd);
     int read_stream();
     int read_header();
     int check_opcode(unsigned int opcode);
-    int read_n_bytes(int64_t bytes, int64_t expected);
+    int begin_data_frame();
+    void reserve_payload();
+    int read_frame_payload();
+    int read_control_frame();
+    int wait_message();
+    int read_n_bytes(char *dst, int64_t bytes);
+
+    int send_frame(unsigned int format, const char *data, int64_t len);
+    void close_connection(uint16_t status);
+    int64_t send_iovecs(struct iovec *iov, size_t iovcnt);
 
     int set_send_header(unsigned char *bits, int64_t data_len,
                         unsigned int format);
@@ -104,22 +196,6 @@ class WebSocket
     int send_request(const unsigned char *bits, int64_t len);
 };
 
-template<class T>
-inline int WebSocket::send(const T *data, unsigned int len)
-{
-    if (connection_closed)
-        return 0;
-
-    auto char_data_len = len * sizeof(T) / sizeof(char);
-
-    if (char_data_len + 10 > WEBSOCK_SEND_BUF_LEN)
-        return -1;
-
-    auto mask_offset = set_send_header(send_buf, char_data_len, (1 << 7) + BINARY_FRAME);
-    memcpy(&send_buf[mask_offset], data, char_data_len);
-    return send_request(send_buf, static_cast<int64_t>(mask_offset) + static_cast<int64_t>(char_data_len));
-}
-
 } // namespace koheron
 
 #endif // __WEBSOCKET_HPP__
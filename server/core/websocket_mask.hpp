@@ -0,0 +1,75 @@
+/// WebSocket payload unmasking
+///
+/// Client frames are masked by XORing the payload with a 4-byte key.
+/// The payload is unmasked a word at a time (16 bytes with NEON),
+/// the bytes before the first aligned word and after the last
+/// one are unmasked one by one.
+///
+/// (c) Koheron
+
+#ifndef __KOHERON_WEBSOCKET_MASK_HPP__
+#define __KOHERON_WEBSOCKET_MASK_HPP__
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+# define KOHERON_HAS_NEON 1
+#endif
+
+namespace koheron {
+
+/// Reference implementation
+inline void unmask_bytes(char *data, uint64_t len, const char *mask)
+{
+    for (uint64_t i = 0; i < len; ++i) {
+        data[i] = static_cast<char>(data[i] ^ mask[i % 4]);
+    }
+}
+
+inline void unmask(char *data, uint64_t len, const char *mask)
+{
+    uint64_t i = 0;
+
+    // Bytes up to the first word aligned address
+    while (i < len && (reinterpret_cast<uintptr_t>(data + i) % sizeof(uint64_t)) != 0) {
+        data[i] = static_cast<char>(data[i] ^ mask[i % 4]);
+        i++;
+    }
+
+    // Mask rotated to start at the current byte.
+    // The word sizes are multiples of 4, so the rotation doesn't change.
+    unsigned char key[16];
+
+    for (unsigned int k = 0; k < sizeof(key); k++) {
+        key[k] = static_cast<unsigned char>(mask[(i + k) % 4]);
+    }
+
+#ifdef KOHERON_HAS_NEON
+    const uint8x16_t key128 = vld1q_u8(key);
+
+    for (; i + 16 <= len; i += 16) {
+        auto p = reinterpret_cast<uint8_t*>(data + i);
+        vst1q_u8(p, veorq_u8(vld1q_u8(p), key128));
+    }
+#endif
+
+    uint64_t key64;
+    std::memcpy(&key64, key, sizeof(key64));
+
+    for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        word ^= key64;
+        std::memcpy(data + i, &word, sizeof(word));
+    }
+
+    for (; i < len; ++i) {
+        data[i] = static_cast<char>(data[i] ^ mask[i % 4]);
+    }
+}
+
+} // namespace koheron
+
+#endif // __KOHERON_WEBSOCKET_MASK_HPP__
@@ -0,0 +1,228 @@
+/// Implementation of zerocopy.hpp
+///
+/// (c) Koheron
+
+#include "zerocopy.hpp"
+#include "config.hpp"
+#include "reactor.hpp"
+
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <algorithm>
+
+extern "C" {
+  #include <netinet/in.h>
+  #include <poll.h>
+  #include <sys/socket.h>
+  #include <linux/errqueue.h>
+}
+
+// MSG_ZEROCOPY is available since Linux 4.14
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+# define KOHERON_HAS_ZEROCOPY 1
+#else
+# define KOHERON_HAS_ZEROCOPY 0
+#endif
+
+namespace koheron {
+
+#if KOHERON_HAS_ZEROCOPY
+
+int ZeroCopySender::open(int comm_fd)
+{
+    const int one = 1;
+
+    // Fails on Unix sockets and on kernels without zero-copy support
+    if (setsockopt(comm_fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0) {
+        return -1;
+    }
+
+    fd = comm_fd;
+    return 0;
+}
+
+int64_t ZeroCopySender::send(struct iovec *iov, size_t iovcnt)
+{
+    int64_t bytes_send = 0;
+    int flags = MSG_NOSIGNAL | MSG_ZEROCOPY;
+
+    while (iovcnt > 0) {
+        struct msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = std::min(iovcnt, static_cast<size_t>(IOV_MAX));
+
+        const auto n = sendmsg(fd, &msg, flags);
+
+        if (n == 0) {
+            return 0;
+        }
+
+        if (n < 0) {
+            // The locked memory limit is reached (optmem_max or RLIMIT_MEMLOCK)
+            if (errno == ENOBUFS) {
+                if (n_completed != n_issued) {
+                    if (wait_completions(bytes_send) < 0) {
+                        return -1;
+                    }
+                } else {
+                    flags = MSG_NOSIGNAL; // Copy the rest
+                }
+
+                continue;
+            }
+
+            if (would_block(errno) && wait_writable() == 0) {
+                continue;
+            }
+
+            return -1;
+        }
+
+        if (flags & MSG_ZEROCOPY) {
+            n_issued++;
+        }
+
+        bytes_send += n;
+        advance_iovecs(iov, iovcnt, static_cast<size_t>(n));
+    }
+
+    if (wait_completions(bytes_send) < 0) {
+        return -1;
+    }
+
+    return bytes_send;
+}
+
+// Consume the notifications available on the error queue.
+// Each notification reports a range of completed sendmsg calls.
+int ZeroCopySender::read_completions()
+{
+    while (true) {
+        char control[128];
+        struct msghdr msg{};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            return would_block(errno) ? 0 : -1;
+        }
+
+        for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) &&
+                !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)) {
+                continue;
+            }
+
+            struct sock_extended_err serr;
+            std::memcpy(&serr, CMSG_DATA(cmsg), sizeof(serr));
+
+            if (serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr.ee_errno != 0) {
+                continue;
+            }
+
+            n_completed += serr.ee_data - serr.ee_info + 1;
+
+            if (serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                n_copied++;
+            }
+        }
+    }
+}
+
+// The peer must acknowledge the bytes sent: the timeout
+// grows with their number (slow links).
+int ZeroCopySender::wait_completions(int64_t bytes_send)
+{
+    struct pollfd pfd{};
+    pfd.fd = fd;
+    pfd.events = 0; // POLLERR is always reported
+    bool notified = false;
+
+    using clock = std::chrono::steady_clock;
+    const auto timeout_ms = config::tcp_zerocopy_timeout_ms
+                          + 1000 * bytes_send / config::tcp_zerocopy_min_rate;
+    const auto deadline = clock::now() + std::chrono::milliseconds(timeout_ms);
+
+    while (true) {
+        const auto n_prev = n_completed;
+
+        if (read_completions() < 0) {
+            return -1;
+        }
+
+        if (n_completed == n_issued) {
+            return 0;
+        }
+
+        // POLLERR without notification: socket error
+        if (notified && n_completed == n_prev) {
+            return -1;
+        }
+
+        const auto remaining_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                      deadline - clock::now()).count();
+        const int n = remaining_ms > 0 ? poll(&pfd, 1, static_cast<int>(std::min<int64_t>(remaining_ms, INT_MAX)))
+                                       : 0;
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (n <= 0 || (pfd.revents & POLLNVAL)) {
+            return -1;
+        }
+
+        notified = pfd.revents & POLLERR;
+
+        // Connection closed: the pages are released with the socket
+        if ((pfd.revents & POLLHUP) && !(pfd.revents & POLLERR)) {
+            return -1;
+        }
+    }
+}
+
+// Same as wait_socket(fd, POLLOUT) but the completion notifications
+// pending on the error queue (reported as POLLERR) are consumed.
+int ZeroCopySender::wait_writable()
+{
+    struct pollfd pfd{};
+    pfd.fd = fd;
+    pfd.events = POLLOUT;
+
+    while (true) {
+        const int n = poll(&pfd, 1, config::reactor_io_timeout_ms);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (n <= 0 || (pfd.revents & (POLLNVAL | POLLHUP))) {
+            return -1;
+        }
+
+        if (pfd.revents & POLLERR) {
+            const auto n_prev = n_completed;
+
+            if (read_completions() < 0 || n_completed == n_prev) {
+                return -1;
+            }
+        }
+
+        if (pfd.revents & POLLOUT) {
+            return 0;
+        }
+    }
+}
+
+#else // KOHERON_HAS_ZEROCOPY
+
+int ZeroCopySender::open(int) {return -1;}
+int64_t ZeroCopySender::send(struct iovec*, size_t) {return -1;}
+int ZeroCopySender::read_completions() {return -1;}
+int ZeroCopySender::wait_completions(int64_t) {return -1;}
+int ZeroCopySender::wait_writable() {return -1;}
+
+#endif // KOHERON_HAS_ZEROCOPY
+
+} // namespace koheron
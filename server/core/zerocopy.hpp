@@ -0,0 +1,57 @@
+/// Zero-copy TCP send
+///
+/// Large responses (typically multi-megabyte arrays in device memory)
+/// are sent with MSG_ZEROCOPY: the kernel pins the pages of the source
+/// buffer instead of copying them into the socket buffer.
+///
+/// The pages are released asynchronously, when the data have been
+/// acknowledged by the peer. The kernel reports it with notifications
+/// on the socket error queue. send() waits for the notifications of all
+/// its submissions before returning, so the caller (the driver holding
+/// its lock) can reuse or overwrite the buffer as soon as the
+/// response is sent. The wait is bounded by a timeout growing with
+/// the payload size (see config::tcp_zerocopy_min_rate).
+///
+/// (c) Koheron
+
+#ifndef __KOHERON_ZEROCOPY_HPP__
+#define __KOHERON_ZEROCOPY_HPP__
+
+#include <cstdint>
+#include <cstddef>
+
+#include "iovec.hpp"
+
+namespace koheron {
+
+class ZeroCopySender
+{
+  public:
+    /// Enable SO_ZEROCOPY on the socket.
+    /// Returns -1 if the socket doesn't support zero-copy.
+    int open(int comm_fd);
+
+    /// Zero-copy is disabled once the kernel reports that it had to copy
+    /// the data anyway (loopback, device without scatter-gather...).
+    /// Pinning the pages then costs more than a plain copy.
+    bool is_enabled() const {return fd >= 0 && n_copied == 0;}
+
+    /// Send a list of buffers and wait until the kernel released them.
+    /// The iovec list is modified.
+    /// Returns the number of bytes sent, 0 if the connection is closed, -1 on error.
+    int64_t send(struct iovec *iov, size_t iovcnt);
+
+  private:
+    int fd = -1;
+    uint32_t n_issued = 0;     ///< Number of zero-copy sendmsg calls
+    uint32_t n_completed = 0;  ///< Number of sendmsg calls reported as completed
+    uint32_t n_copied = 0;    ///< Number of sendmsg calls completed with a copy
+
+    int read_completions();
+    int wait_completions(int64_t bytes_send);
+    int wait_writable();
+};
+
+} // namespace koheron
+
+#endif // __KOHERON_ZEROCOPY_HPP__
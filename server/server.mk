@@ -60,9 +60,13 @@ SERVER_CCXXFLAGS += -Wuninitialized -Wshadow -Wzero-as-null-pointer-constant -Wm
 SERVER_CCXXFLAGS += -I$(TMP_SERVER_PATH) -I$(SERVER_PATH)/core -I$(SDK_PATH) -I. -I$(SERVER_PATH)/context -I$(SERVER_PATH)/drivers -I$(PROJECT_PATH)
 SERVER_CCXXFLAGS += -DKOHERON_VERSION=$(KOHERON_VERSION).$(shell git rev-parse --short HEAD)
 SERVER_CCXXFLAGS += -MMD -MP -O3 $(GCC_FLAGS)
+# Optional features (see config.hpp), e.g. SERVER_FLAGS=-DKOHERON_UDP_PORT=36100
+SERVER_FLAGS ?=
+SERVER_CCXXFLAGS += $(SERVER_FLAGS)
 # Arch flags obtain by running on the Zynq:
 # gcc -march=native -Q --help=target
-SERVER_CCXXFLAGS += -mcpu=cortex-a9 -mfpu=vfpv3-d16 -mvectorize-with-neon-quad -mfloat-abi=hard
+SERVER_ARCH_FLAGS := -mcpu=cortex-a9 -mfpu=vfpv3-d16 -mvectorize-with-neon-quad -mfloat-abi=hard
+SERVER_CCXXFLAGS += $(SERVER_ARCH_FLAGS)
 SERVER_CCXXFLAGS += -std=c++17 -pthread -lstdc++ -lstdc++fs -static-libstdc++
 
 PHONY: gcc_flags
@@ -85,6 +89,22 @@ $(SERVER): $(OBJ)
 server: $(SERVER_TEMPLATE_LIST) $(INTERFACE_DRIVERS_HPP) $(INTERFACE_DRIVERS_CPP) $(TMP_SERVER_PATH)/memory.hpp | $(KOHERON_SERVER_PATH)
 	$(MAKE) --jobs=$(N_CPUS) $(SERVER)
 
+# Host build
+###############################################################################
+# Server compiled for the host with simulated memory maps (anonymous shared
+# memory instead of /dev/mem), without FPGA configuration. Used to benchmark
+# the server without a board (see tests/load_generator.py):
+# make CONFIG=tests/config.yml host_server
+
+HOST_TMP := $(TMP)/host
+HOST_SERVER := $(HOST_TMP)/$(PROJECT_PATH)serverd
+HOST_SERVER_FLAGS ?=
+
+# The host build streams over UDP (tested by make host_tests)
+.PHONY: host_server
+host_server:
+	$(MAKE) TMP=$(HOST_TMP) SERVER_CCXX=g++ SERVER_ARCH_FLAGS="-march=native -DKOHERON_SIMULATED -DKOHERON_UDP_PORT=36100 $(HOST_SERVER_FLAGS)" server
+
 # Clean targets
 ###############################################################################
 
@@ -5,9 +5,11 @@
 #ifndef __DRIVERS_TABLE_HPP__
 #define __DRIVERS_TABLE_HPP__
 
+#include <cstdint>
 #include <array>
 #include <tuple>
 #include <memory>
+#include <utility>
 
 #include <string_utils.hpp>
 #include <meta_utils.hpp>
@@ -64,4 +66,59 @@ template<> constexpr driver_id driver_id_of<Server> = 1;
 template<driver_id driver>
 using device_t = std::remove_reference_t<decltype(*std::get<driver - 2>(std::declval<drivers_tuple_t>()))>;
 
+// Number of operations of each driver
+// (the Server operations are dispatched by the Server)
+constexpr std::array<uint16_t, device_num> drivers_op_num = {
+    0, 0,
+{%- for driver in drivers %}
+    {{ driver.operations|length }},
+{%- endfor %}
+};
+
+// Index of the first operation of each driver in the dispatch table
+// (see interface_drivers.hpp)
+constexpr std::array<std::size_t, device_num> op_offsets = {
+    0, 0,
+{%- for driver in drivers %}
+    {{ driver.op_offset }},
+{%- endfor %}
+};
+
+constexpr std::size_t operations_num = {{ drivers | map(attribute='operations') | map('length') | sum }};
+
+// Names of the operations in the dispatch table (trace events)
+constexpr std::array<const char*, operations_num> operations_names = {
+{%- for driver in drivers %}
+{%- for operation in driver.operations %}
+    "{{ driver.objects[0]['type'] }}::{{ operation['name'] }}",
+{%- endfor %}
+{%- endfor %}
+};
+
+// Driver dependencies as {driver, dependency} pairs
+// (drivers obtained with ctx.get<Driver>() in the driver sources).
+// A driver is started once its dependencies are started.
+constexpr std::array<std::pair<driver_id, driver_id>, {{ drivers | map(attribute='dependencies') | map('length') | sum }}> drivers_dependencies = {{ '{{' }}
+{%- for driver in drivers %}
+{%- for dependency in driver.dependencies %}
+    { {{ driver.id }}, {{ dependency }} },
+{%- endfor %}
+{%- endfor %}
+{{ '}}' }};
+
+// Operation ids of each driver
+//
+// Used by the drivers to publish the frames of their
+// streams (see ContextBase::publish).
+
+namespace op_id {
+{% for driver in drivers -%}
+namespace {{ driver.objects[0]['type'] }} {
+    {% for operation in driver.operations -%}
+    constexpr uint16_t {{ operation['name'] }} = {{ operation['id'] }};
+    {% endfor -%}
+}
+{% endfor -%}
+} // namespace op_id
+
 #endif // __DRIVERS_TABLE_HPP__
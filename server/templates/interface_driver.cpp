@@ -11,35 +11,27 @@
 
 namespace koheron {
 
+// GCC doesn't match the out-of-class member template definitions
+// with the class specialization when it is named with driver_id_of
+using Interface = Driver<driver_id_of<{{ driver.objects[0]["type"] }}>>;
+
 {% for operation in driver.operations -%}
 /////////////////////////////////////
 // {{ operation['name'] }}
 
-template<>
-int Driver<driver_id_of<{{ driver.objects[0]["type"] }}>>::
-        execute_operation<Driver<driver_id_of<{{ driver.objects[0]["type"] }}>>::{{ operation['tag'] }}>(Command& cmd)
+template<int socket_type>
+int Interface::execute_{{ operation['name'] }}(Command& cmd)
 {
     (void)cmd;
+    auto& session = *static_cast<Session<socket_type>*>(cmd.session);
+    (void)session;
     {{ operation | get_parser(driver) }}
     {{ operation | get_fragment(driver) }}
 }
 
-{% endfor %}
-
-int Driver<driver_id_of<{{ driver.objects[0]["type"] }}>>::execute(Command& cmd)
-{
-    std::lock_guard<std::mutex> lock(mutex);
+// The Unix sessions use the TCP implementation
+template int Interface::execute_{{ operation['name'] }}<TCP>(Command& cmd);
+template int Interface::execute_{{ operation['name'] }}<WEBSOCK>(Command& cmd);
 
-    switch(cmd.operation) {
-{% for operation in driver.operations -%}
-      case {{ operation['tag'] }}: {
-        return execute_operation<{{ operation['tag'] }}>(cmd);
-      }
 {% endfor %}
-      case {{ driver.tag | lower }}_op_num:
-      default:
-          return -1;
-    }
-}
-
 } // namespace koheron
@@ -9,6 +9,7 @@
 
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
 
 #include <driver.hpp>
 
@@ -22,9 +23,6 @@ template<>
 class Driver<driver_id_of<{{ driver.objects[0]["type"] }}>> : public DriverAbstract
 {
   public:
-    int execute(Command& cmd);
-    template<int op> int execute_operation(Command& cmd);
-
     Driver(Server *server_, {{ driver.objects[0]["type"] }}& {{ driver.objects[0]["name"] }}_)
     : DriverAbstract(driver_id_of<{{ driver.objects[0]["type"] }}>, server_)
     , {{ driver.objects[0]["name"] }}({{ driver.objects[0]["name"] }}_)
@@ -37,10 +35,15 @@ class Driver<driver_id_of<{{ driver.objects[0]["type"] }}>> : public DriverAbstr
         {{ driver.tag|lower }}_op_num
     };
 
-    std::mutex mutex;
+    std::shared_mutex mutex;
 
     {{ driver.objects[0]["type"] }}& {{ driver.objects[0]["name"] }};
 
+    // Operations (see the dispatch table in interface_drivers.hpp)
+{% for operation in driver.operations %}
+    template<int socket_type> int execute_{{ operation['name'] }}(Command& cmd);
+{%- endfor %}
+
 {% for operation in driver.operations -%}
 struct Argument_{{ operation['name'] }} {
 {%- macro print_param_line(arg) %}
@@ -49,7 +52,7 @@ struct Argument_{{ operation['name'] }} {
 {% for arg in operation["arguments"] -%}
     {{ arg["type"] }} {{ arg["name"]}};
 {% endfor -%}
-} args_{{ operation['name'] }};
+}{% if not operation['read_only'] %} args_{{ operation['name'] }}{% endif %};
 
 {% endfor -%}
 
@@ -2,6 +2,37 @@
 ///
 /// (c) Koheron
 
+#ifndef __INTERFACE_DRIVERS_HPP__
+#define __INTERFACE_DRIVERS_HPP__
+
+#include <array>
+
+#include <driver.hpp>
+#include <drivers_table.hpp>
+
 {% for driver in drivers -%}
 # include <{{ driver.interface_name + '.hpp' }}>
-{% endfor %}
\ No newline at end of file
+{% endfor %}
+namespace koheron {
+
+/// Operations dispatch table of the sessions of type socket_type
+///
+/// The operation op of a driver is at index op_offsets[driver] + op
+/// (see drivers_table.hpp). The Unix sessions use the TCP table.
+template<int socket_type>
+constexpr std::array<OperationEntry, operations_num> dispatch_table{};
+{% for socket_type in ['TCP', 'WEBSOCK'] %}
+template<>
+constexpr std::array<OperationEntry, operations_num> dispatch_table<{{ socket_type }}> = {
+{%- for driver in drivers %}
+{%- for operation in driver.operations %}
+    &execute_operation<Driver<driver_id_of<{{ driver.objects[0]['type'] }}>>,
+                       &Driver<driver_id_of<{{ driver.objects[0]['type'] }}>>::execute_{{ operation['name'] }}<{{ socket_type }}>,
+                       {{ 'true' if operation['read_only'] else 'false' }}>,
+{%- endfor %}
+{%- endfor %}
+};
+{% endfor %}
+} // namespace koheron
+
+#endif // __INTERFACE_DRIVERS_HPP__
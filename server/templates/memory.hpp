@@ -73,6 +73,15 @@ constexpr uint32_t {{ key }} = {{ config['parameters'][key] }};
 
 namespace zynq_clocks {
 
+// Settings applied by set_clocks (hashed with the bitstream)
+constexpr char settings[] = "
+{%- for clk in ['fclk0','fclk1','fclk2','fclk3'] -%}
+{% if clk in config['parameters'] -%}
+{{ clk }}={{ config['parameters'][clk] }};
+{%- endif -%}
+{% endfor -%}
+";
+
 inline void set_clocks(ZynqFclk& fclk) {
 
 {% for clk in ['fclk0','fclk1','fclk2','fclk3'] -%}
@@ -0,0 +1,192 @@
+/// Per-command overhead of the operations dispatch
+///
+/// Compares the former dispatch (recursive walk over the drivers, switch
+/// on the operation, session type resolved by SessionAbstract when sending)
+/// with the flat dispatch table (one indirect call per command, entries
+/// specialized per session type).
+///
+/// Build and run with: make dispatch_benchmark
+///
+/// (c) Koheron
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+constexpr size_t n_drivers = 8;
+constexpr size_t n_ops = 16;
+
+enum SessionType {TCP, WEBSOCK};
+
+struct Command
+{
+    size_t driver;
+    int32_t operation;
+    int session_type;
+};
+
+static volatile uint32_t sink;
+
+// Stands for the serialization and the write of the response
+template<int session_type>
+__attribute__((noinline)) int send(uint32_t value)
+{
+    sink = sink + value + session_type;
+    return 0;
+}
+
+//----------------------------------------------------------------------------
+// Former dispatch
+//----------------------------------------------------------------------------
+
+// SessionAbstract::send
+static int send_abstract(int session_type, uint32_t value)
+{
+    switch (session_type) {
+      case TCP:
+        return send<TCP>(value);
+      case WEBSOCK:
+        return send<WEBSOCK>(value);
+      default:
+        return -1;
+    }
+}
+
+template<size_t driver, int32_t op>
+int execute_operation(Command& cmd)
+{
+    return send_abstract(cmd.session_type, driver * n_ops + op);
+}
+
+// Driver<driver>::execute
+template<size_t driver>
+__attribute__((noinline)) int execute_switch(Command& cmd)
+{
+    switch (cmd.operation) {
+      case 0: return execute_operation<driver, 0>(cmd);
+      case 1: return execute_operation<driver, 1>(cmd);
+      case 2: return execute_operation<driver, 2>(cmd);
+      case 3: return execute_operation<driver, 3>(cmd);
+      case 4: return execute_operation<driver, 4>(cmd);
+      case 5: return execute_operation<driver, 5>(cmd);
+      case 6: return execute_operation<driver, 6>(cmd);
+      case 7: return execute_operation<driver, 7>(cmd);
+      case 8: return execute_operation<driver, 8>(cmd);
+      case 9: return execute_operation<driver, 9>(cmd);
+      case 10: return execute_operation<driver, 10>(cmd);
+      case 11: return execute_operation<driver, 11>(cmd);
+      case 12: return execute_operation<driver, 12>(cmd);
+      case 13: return execute_operation<driver, 13>(cmd);
+      case 14: return execute_operation<driver, 14>(cmd);
+      case 15: return execute_operation<driver, 15>(cmd);
+      default: return -1;
+    }
+}
+
+// DriverManager::execute_driver_implementation
+template<size_t dev0, size_t... drivers>
+int execute_driver(Command& cmd)
+{
+    if constexpr (sizeof...(drivers) == 0) {
+        return execute_switch<dev0>(cmd);
+    } else {
+        return cmd.driver == dev0 ? execute_switch<dev0>(cmd)
+                                  : execute_driver<drivers...>(cmd);
+    }
+}
+
+template<size_t... drivers>
+int execute_recursive_impl(Command& cmd, std::index_sequence<drivers...>)
+{
+    return execute_driver<drivers...>(cmd);
+}
+
+static int execute_recursive(Command& cmd)
+{
+    return execute_recursive_impl(cmd, std::make_index_sequence<n_drivers>());
+}
+
+//----------------------------------------------------------------------------
+// Dispatch table
+//----------------------------------------------------------------------------
+
+using OperationEntry = int (*)(Command&);
+
+template<size_t driver, int32_t op, int session_type>
+__attribute__((noinline)) int execute_entry(Command&)
+{
+    return send<session_type>(driver * n_ops + op);
+}
+
+template<int session_type, size_t... i>
+constexpr std::array<OperationEntry, sizeof...(i)> make_table(std::index_sequence<i...>)
+{
+    return {{&execute_entry<i / n_ops, i % n_ops, session_type>...}};
+}
+
+template<int session_type>
+constexpr auto dispatch_table = make_table<session_type>(std::make_index_sequence<n_drivers * n_ops>());
+
+static int execute_table(Command& cmd)
+{
+    if (cmd.operation < 0 || cmd.operation >= int32_t(n_ops)) {
+        return -1;
+    }
+
+    const size_t index = cmd.driver * n_ops + size_t(cmd.operation);
+
+    if (cmd.session_type == WEBSOCK) {
+        return dispatch_table<WEBSOCK>[index](cmd);
+    }
+
+    return dispatch_table<TCP>[index](cmd);
+}
+
+//----------------------------------------------------------------------------
+
+// Returns the time per command in ns
+template<typename Execute>
+static double run(Execute execute, std::vector<Command>& commands, size_t n_iterations)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < n_iterations; i++) {
+        for (auto& cmd : commands) {
+            execute(cmd);
+        }
+    }
+
+    const auto stop = std::chrono::steady_clock::now();
+    return 1E9 * std::chrono::duration<double>(stop - start).count() / (n_iterations * commands.size());
+}
+
+int main()
+{
+    constexpr size_t n_commands = 65536;
+    constexpr size_t n_iterations = 64;
+
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<size_t> driver_dist(0, n_drivers - 1);
+    std::uniform_int_distribution<int32_t> op_dist(0, n_ops - 1);
+
+    // Same operation repeated (e.g. a client polling a getter)
+    std::vector<Command> repeated(n_commands, Command{n_drivers - 1, 3, TCP});
+
+    // Random operations of random drivers from TCP and WebSocket sessions
+    std::vector<Command> mixed(n_commands);
+
+    for (auto& cmd : mixed) {
+        cmd = Command{driver_dist(gen), op_dist(gen), int(gen() % 2)};
+    }
+
+    std::printf("%12s %16s %16s\n", "commands", "former (ns)", "table (ns)");
+    std::printf("%12s %16.2f %16.2f\n", "repeated",
+                run(execute_recursive, repeated, n_iterations), run(execute_table, repeated, n_iterations));
+    std::printf("%12s %16.2f %16.2f\n", "mixed",
+                run(execute_recursive, mixed, n_iterations), run(execute_table, mixed, n_iterations));
+    return 0;
+}
@@ -0,0 +1,334 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+'''Load generator
+
+Replays a mix of commands from concurrent TCP, Unix socket and WebSocket
+clients, and reports the throughput and the latency percentiles.
+
+Each client runs in its own process and sends its next command once the
+previous response is received (closed loop). The commands are drawn from
+the mix with their weights:
+
+    python load_generator.py --host 127.0.0.1 --clients tcp=4,websocket=2 \\
+        --mix "4:Tests.get_tuple()" --mix "1:Tests.get_large_vector(1000)"
+
+The server closes the connections beyond its *_worker_connections (see
+config.hpp): these clients fail to connect.
+
+Run against the simulated host server with: make CONFIG=tests/config.yml host_load_test
+'''
+
+import argparse
+import ast
+import base64
+import hashlib
+import json
+import multiprocessing
+import os
+import random
+import re
+import socket
+import struct
+import sys
+import time
+import numpy as np
+
+sys.path = [".."] + sys.path
+from koheron import KoheronClient
+
+DEFAULT_MIX = [
+    "4:Tests.get_tuple()",
+    "2:Tests.set_string('Hello World')",
+    "2:Tests.get_large_vector(1000)",
+    "1:Tests.get_array()"
+]
+
+PERCENTILES = [50, 90, 99, 99.9]
+
+# --------------------------------------------
+# WebSocket transport
+# --------------------------------------------
+
+WS_MAGIC = '258EAFA5-E914-47DA-95CA-C5AB0DC85B11'
+
+WS_CONTINUATION = 0x0
+WS_BINARY = 0x2
+WS_CLOSE = 0x8
+WS_PING = 0x9
+WS_PONG = 0xA
+
+class WebSocket:
+    '''Client side of a WebSocket connection (RFC 6455).
+
+    Wraps a connected socket: send() sends a binary message and recv()
+    returns the bytes of the received messages, so that KoheronClient
+    can use it as a stream socket.
+    '''
+    def __init__(self, sock, host, port):
+        self.sock = sock
+        self.raw = b''
+        self.payload = b''
+
+        key = base64.b64encode(os.urandom(16)).decode()
+        request = ('GET / HTTP/1.1\r\n'
+                   'Host: {}:{}\r\n'
+                   'Upgrade: websocket\r\n'
+                   'Connection: Upgrade\r\n'
+                   'Sec-WebSocket-Key: {}\r\n'
+                   'Sec-WebSocket-Version: 13\r\n\r\n').format(host, port, key)
+        self.sock.sendall(request.encode())
+
+        while b'\r\n\r\n' not in self.raw:
+            self.raw += self.recv_socket()
+
+        header, self.raw = self.raw.split(b'\r\n\r\n', 1)
+        accept = base64.b64encode(hashlib.sha1((key + WS_MAGIC).encode()).digest())
+        if accept not in header:
+            raise ConnectionError('WebSocket handshake failed')
+
+    def recv_socket(self):
+        chunk = self.sock.recv(65536)
+        if not chunk:
+            raise ConnectionError('WebSocket: Socket connection broken')
+        return chunk
+
+    def recv_exact(self, n_bytes):
+        while len(self.raw) < n_bytes:
+            self.raw += self.recv_socket()
+        data, self.raw = self.raw[:n_bytes], self.raw[n_bytes:]
+        return data
+
+    def send_frame(self, opcode, data):
+        length = len(data)
+        if length < 126:
+            header = struct.pack('>BB', 0x80 | opcode, 0x80 | length)
+        elif length < 65536:
+            header = struct.pack('>BBH', 0x80 | opcode, 0x80 | 126, length)
+        else:
+            header = struct.pack('>BBQ', 0x80 | opcode, 0x80 | 127, length)
+        # Client frames are masked
+        mask = os.urandom(4)
+        masked = np.frombuffer(data, dtype='uint8') ^ np.resize(np.frombuffer(mask, dtype='uint8'), length)
+        self.sock.sendall(header + mask + masked.tobytes())
+
+    def recv_frame(self):
+        '''Receive a frame in the payload buffer (server frames are not masked).'''
+        b0, b1 = struct.unpack('>BB', self.recv_exact(2))
+        opcode = b0 & 0x0F
+        length = b1 & 0x7F
+        if length == 126:
+            length = struct.unpack('>H', self.recv_exact(2))[0]
+        elif length == 127:
+            length = struct.unpack('>Q', self.recv_exact(8))[0]
+        data = self.recv_exact(length)
+
+        if opcode in [WS_BINARY, WS_CONTINUATION]:
+            self.payload += data
+        elif opcode == WS_PING:
+            self.send_frame(WS_PONG, data)
+        elif opcode == WS_CLOSE:
+            raise ConnectionError('WebSocket: Connection closed by the server')
+
+    def send(self, data):
+        self.send_frame(WS_BINARY, data)
+        return len(data)
+
+    def recv(self, n_bytes):
+        while not self.payload:
+            self.recv_frame()
+        data, self.payload = self.payload[:n_bytes], self.payload[n_bytes:]
+        return data
+
+    def close(self):
+        self.sock.close()
+
+class WebSocketClient(KoheronClient):
+    def __init__(self, host, port=8080):
+        KoheronClient.__init__(self, host, port)
+
+    def check_version(self):
+        # Called once connected, before the first command
+        self.sock = WebSocket(self.sock, self.host, self.port)
+        KoheronClient.check_version(self)
+
+# --------------------------------------------
+# Clients
+# --------------------------------------------
+
+def connect_client(transport, args):
+    if transport == 'tcp':
+        return KoheronClient(args.host, args.port)
+    if transport == 'unix':
+        return KoheronClient(unixsock=args.unixsock)
+    if transport == 'websocket':
+        return WebSocketClient(args.host, args.websocket_port)
+    raise ValueError('Unknown transport "' + transport + '"')
+
+def parse_mix(specs):
+    '''Parse the commands mix: "WEIGHT:Driver.command(args)" (the weight is optional)'''
+    mix = []
+    for spec in specs:
+        match = re.match(r'^\s*(?:(\d+)\s*:)?\s*(\w+)\.(\w+)\((.*)\)\s*$', spec)
+        if match is None:
+            raise ValueError('Invalid command "' + spec + '" (expected WEIGHT:Driver.command(args))')
+        weight, device, command, args = match.groups()
+        args = ast.literal_eval('(' + args + ',)') if args.strip() else ()
+        mix.append((int(weight or 1), device, command, args))
+    return mix
+
+def run_client(transport, index, args, mix, barrier, results):
+    '''Closed loop of one client. Puts (transport, {command: latencies in ns}, error) in results.'''
+    latencies = {}
+    error = None
+
+    # The blocking socket calls of the client fail after the timeout
+    socket.setdefaulttimeout(args.timeout)
+
+    try:
+        client = connect_client(transport, args)
+        calls = []
+        for weight, device, command, cmd_args in mix:
+            device_id, cmd_id, cmd_args_types = client.get_ids(device, command)
+            ret_type = client.cmds_ret_types_list[device_id][command]
+            calls.append(('{}.{}'.format(device, command), device_id, cmd_id, cmd_args_types, cmd_args, ret_type))
+            latencies[calls[-1][0]] = []
+        weights = [call[0] for call in mix]
+    except Exception as e:
+        barrier.wait()
+        results.put((transport, latencies, 'Failed to connect: {}'.format(e)))
+        return
+
+    rng = random.Random(args.seed + index)
+    barrier.wait()
+    start = time.perf_counter_ns() + int(args.warmup * 1E9)
+    stop = start + int(args.duration * 1E9)
+
+    try:
+        while True:
+            name, device_id, cmd_id, cmd_args_types, cmd_args, ret_type = rng.choices(calls, weights)[0]
+            t0 = time.perf_counter_ns()
+            if t0 >= stop:
+                break
+            client.send_command(device_id, cmd_id, cmd_args_types, *cmd_args)
+            client.recv_ret_type(ret_type)
+            t1 = time.perf_counter_ns()
+            if t0 >= start:
+                latencies[name].append(t1 - t0)
+    except Exception as e:
+        error = str(e)
+
+    results.put((transport, latencies, error))
+
+# --------------------------------------------
+# Report
+# --------------------------------------------
+
+def summary(latencies_ns, duration):
+    lat = np.sort(np.array(latencies_ns, dtype='int64')) / 1E3
+    result = {'requests': len(lat), 'throughput': len(lat) / duration}
+    for p in PERCENTILES:
+        result['p{}'.format(p)] = float(np.percentile(lat, p)) if len(lat) else 0.0
+    result['max'] = float(lat[-1]) if len(lat) else 0.0
+    return result
+
+def report(clients, results, duration):
+    '''Summaries per transport and per command (latencies in us)'''
+    rows = {}
+    total = []
+
+    for transport in clients:
+        by_command = {}
+        for transport_, latencies, _ in results:
+            if transport_ != transport:
+                continue
+            for name, lat in latencies.items():
+                by_command.setdefault(name, []).extend(lat)
+        all_lat = [l for lat in by_command.values() for l in lat]
+        total.extend(all_lat)
+        rows[transport] = {'clients': clients[transport], 'all': summary(all_lat, duration)}
+        for name in sorted(by_command):
+            rows[transport][name] = summary(by_command[name], duration)
+
+    rows['total'] = {'clients': sum(clients.values()), 'all': summary(total, duration)}
+    return rows
+
+def print_report(rows):
+    columns = ['p{}'.format(p) for p in PERCENTILES] + ['max']
+    print('{:<14} {:<28} {:>10} {:>10}'.format('transport', 'command', 'requests', 'req/s')
+          + ''.join(' {:>10}'.format(c + ' (us)' if c == 'max' else c) for c in columns))
+    for transport, commands in rows.items():
+        for name, s in commands.items():
+            if name == 'clients':
+                continue
+            label = '{} x{}'.format(transport, commands['clients'])
+            print('{:<14} {:<28} {:>10} {:>10.0f}'.format(label, name, s['requests'], s['throughput'])
+                  + ''.join(' {:>10.1f}'.format(s[c]) for c in columns))
+
+# --------------------------------------------
+# Main
+# --------------------------------------------
+
+def parse_clients(spec):
+    '''Number of clients per transport: "tcp=4,unix=2,websocket=2"'''
+    clients = {}
+    for item in spec.split(','):
+        transport, _, n = item.partition('=')
+        transport = transport.strip()
+        if transport not in ['tcp', 'unix', 'websocket']:
+            raise argparse.ArgumentTypeError('Unknown transport "' + transport + '"')
+        clients[transport] = int(n or 1)
+    return clients
+
+def main():
+    parser = argparse.ArgumentParser(description='Koheron server load generator')
+    parser.add_argument('--host', default=os.getenv('HOST', '127.0.0.1'))
+    parser.add_argument('--port', type=int, default=36000)
+    parser.add_argument('--websocket-port', type=int, default=8080)
+    parser.add_argument('--unixsock', default=os.getenv('UNIXSOCK', '/var/run/koheron-server.sock'))
+    parser.add_argument('--clients', type=parse_clients, default='tcp=2,unix=2,websocket=2',
+                        help='number of clients per transport (default: tcp=2,unix=2,websocket=2)')
+    parser.add_argument('--mix', action='append',
+                        help='command replayed, as WEIGHT:Driver.command(args) (repeat for each command)')
+    parser.add_argument('--duration', type=float, default=10, help='measurement time in seconds')
+    parser.add_argument('--warmup', type=float, default=1, help='time before the measurement in seconds')
+    parser.add_argument('--timeout', type=float, default=10, help='socket timeout in seconds')
+    parser.add_argument('--seed', type=int, default=0)
+    parser.add_argument('--json', help='write the report in this file')
+    args = parser.parse_args()
+
+    mix = parse_mix(args.mix or DEFAULT_MIX)
+    clients = {t: n for t, n in args.clients.items() if n > 0}
+    n_clients = sum(clients.values())
+
+    barrier = multiprocessing.Barrier(n_clients)
+    results = multiprocessing.Queue()
+    processes = []
+
+    for transport, n in clients.items():
+        for _ in range(n):
+            process = multiprocessing.Process(target=run_client,
+                                              args=(transport, len(processes), args, mix, barrier, results))
+            process.start()
+            processes.append(process)
+
+    results = [results.get() for _ in processes]
+
+    for process in processes:
+        process.join()
+
+    errors = [(transport, error) for transport, _, error in results if error is not None]
+    for transport, error in errors:
+        print('{} client error: {}'.format(transport, error), file=sys.stderr)
+
+    rows = report(clients, results, args.duration)
+    print_report(rows)
+
+    if args.json is not None:
+        with open(args.json, 'w') as f:
+            json.dump(rows, f, indent=2)
+
+    return 1 if errors else 0
+
+if __name__ == '__main__':
+    sys.exit(main())
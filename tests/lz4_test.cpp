@@ -0,0 +1,130 @@
+/// Round trip of the responses compression
+///
+/// Compresses with the server LZ4 compressor (and shuffle filter)
+/// and decompresses with the client of koheron-client.hpp, for
+/// payloads from a few bytes to several LZ4 windows (64 kB).
+///
+/// Build and run with: make CONFIG=tests/config.yml lz4_test
+///
+/// (c) Koheron
+
+#include "compression.hpp"
+#include "koheron-client.hpp"
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::mt19937 rng(42);
+
+std::vector<unsigned char> random_bytes(size_t len)
+{
+    std::vector<unsigned char> data(len);
+
+    for (auto& c : data) {
+        c = static_cast<unsigned char>(rng());
+    }
+
+    return data;
+}
+
+// Random blocks repeated at the given distance
+std::vector<unsigned char> repeated_blocks(size_t len, size_t distance)
+{
+    auto data = random_bytes(len);
+
+    for (size_t i = distance; i < len; i++) {
+        data[i] = data[i - distance];
+    }
+
+    return data;
+}
+
+std::vector<unsigned char> ramp(size_t n_elements)
+{
+    std::vector<unsigned char> data(n_elements * sizeof(uint32_t));
+
+    for (size_t i = 0; i < n_elements; i++) {
+        const auto value = static_cast<uint32_t>(i);
+        std::memcpy(data.data() + i * sizeof(uint32_t), &value, sizeof(value));
+    }
+
+    return data;
+}
+
+unsigned int n_failures = 0;
+
+void check(bool ok, const std::string& name, size_t len, const char *what)
+{
+    if (!ok) {
+        std::printf("FAILED: %s (%zu bytes): %s\n", name.c_str(), len, what);
+        n_failures++;
+    }
+}
+
+void round_trip(const std::string& name, const std::vector<unsigned char>& data, size_t element_size = 1)
+{
+    const size_t len = data.size();
+    std::vector<uint32_t> hash_table(koheron::lz4_hash_table_size);
+    std::vector<unsigned char> input = data;
+
+    if (element_size > 1) {
+        koheron::shuffle(data.data(), len, element_size, input.data());
+    }
+
+    std::vector<unsigned char> compressed(koheron::lz4_compress_bound(len));
+    const size_t compressed_size = koheron::lz4_compress(input.data(), len, compressed.data(), hash_table.data());
+    check(compressed_size <= compressed.size(), name, len, "compressed size above the bound");
+
+    std::vector<unsigned char> output(len);
+    const bool ok = serdes::lz4_decompress(compressed.data(), compressed_size, output.data(), len);
+    check(ok, name, len, "invalid compressed block");
+
+    if (element_size > 1) {
+        std::vector<unsigned char> unshuffled(len);
+        serdes::unshuffle(output.data(), len, element_size, unshuffled.data());
+        output = unshuffled;
+    }
+
+    check(output == data, name, len, "decompressed data differ");
+
+    // A truncated block is rejected
+    if (compressed_size > 1) {
+        check(!serdes::lz4_decompress(compressed.data(), compressed_size - 1, output.data(), len),
+              name, len, "truncated block accepted");
+    }
+}
+
+} // namespace
+
+int main()
+{
+    for (size_t len = 0; len <= 64; len++) {
+        round_trip("random", random_bytes(len));
+        round_trip("zeros", std::vector<unsigned char>(len, 0));
+    }
+
+    round_trip("random", random_bytes(300000));
+    round_trip("zeros", std::vector<unsigned char>(1048576, 0));
+
+    // Matches at the maximum distance and beyond the 64 kB window
+    round_trip("repeated 1 kB", repeated_blocks(1048576, 1024));
+    round_trip("repeated 65535 B", repeated_blocks(1048576, 65535));
+    round_trip("repeated 65536 B", repeated_blocks(1048576, 65536));
+    round_trip("repeated 100 kB", repeated_blocks(1048576, 100000));
+
+    round_trip("ramp", ramp(262144));
+    round_trip("shuffled ramp", ramp(262144), sizeof(uint32_t));
+    round_trip("shuffled ramp with trailing bytes", random_bytes(262147), sizeof(uint32_t));
+
+    if (n_failures > 0) {
+        std::printf("%u failures\n", n_failures);
+        return 1;
+    }
+
+    std::printf("OK\n");
+    return 0;
+}
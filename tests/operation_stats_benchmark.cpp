@@ -0,0 +1,109 @@
+/// Overhead of the operation statistics
+///
+/// Times a trivial operation (shared lock of the driver, call, send)
+/// without statistics and with the recording done by DriverManager::execute
+/// (operation_stats.hpp), on 1 and 4 threads executing operations
+/// of the same driver.
+///
+/// Build and run with: make operation_stats_benchmark
+///
+/// (c) Koheron
+
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#include "operation_stats.hpp"
+
+using namespace koheron;
+
+constexpr size_t n_operations = 64;
+constexpr size_t n_iterations = 4000000;
+
+static std::shared_mutex driver_mutex;
+static volatile uint32_t sink;
+
+// Stands for the serialization and the write of the response
+__attribute__((noinline)) static int send(uint32_t value)
+{
+    sink = value;
+    return 8;
+}
+
+__attribute__((noinline)) static int execute_operation(uint32_t value)
+{
+    std::shared_lock<std::shared_mutex> lock(driver_mutex);
+    return send(value);
+}
+
+__attribute__((noinline)) static int execute_operation_stats(uint32_t value)
+{
+    std::shared_lock<std::shared_mutex> lock(driver_mutex, std::try_to_lock);
+
+    if (!lock.owns_lock()) {
+        const auto start = stats_clock_ns();
+        lock.lock();
+        operation_timing.locked(stats_clock_ns() - start);
+    }
+
+    const auto start = stats_clock_ns();
+    const int bytes_send = send(value);
+    operation_timing.sent(stats_clock_ns() - start, bytes_send);
+    return bytes_send;
+}
+
+static int execute(uint32_t value, OperationStats&)
+{
+    return execute_operation(value);
+}
+
+static int execute_stats(uint32_t value, OperationStats& stats)
+{
+    const auto outer = operation_timing.begin();
+    const auto start = stats_clock_ns();
+    const int ret = execute_operation_stats(value);
+    stats.record(value % n_operations, TCP, stats_clock_ns() - start);
+    operation_timing.end(outer);
+    return ret;
+}
+
+// Returns the time per operation in ns (all the threads)
+template<typename Execute>
+static double run(Execute execute, size_t n_threads)
+{
+    OperationStats stats(n_operations);
+    std::vector<std::thread> threads;
+    const auto start = std::chrono::steady_clock::now();
+
+    for (size_t t = 0; t < n_threads; t++) {
+        threads.emplace_back([&] {
+            for (uint32_t i = 0; i < n_iterations; i++) {
+                execute(i, stats);
+            }
+        });
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    const auto stop = std::chrono::steady_clock::now();
+    return 1E9 * std::chrono::duration<double>(stop - start).count() / (n_iterations * n_threads);
+}
+
+int main()
+{
+    std::printf("%8s %16s %16s %16s\n", "threads", "no stats (ns)", "stats (ns)", "overhead (ns)");
+
+    for (size_t n_threads : {1, 4}) {
+        const double ns = run(execute, n_threads);
+        const double stats_ns = run(execute_stats, n_threads);
+        std::printf("%8zu %16.2f %16.2f %16.2f\n", n_threads, ns, stats_ns, stats_ns - ns);
+    }
+
+    return 0;
+}
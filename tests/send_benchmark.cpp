@@ -0,0 +1,149 @@
+/// Throughput benchmark of the response serialization
+///
+/// Compares the copy of the responses into a contiguous buffer
+/// with the scatter-gather serialization (IovecBuffer) sent with sendmsg.
+/// The responses are sent on loopback to a thread draining the socket.
+///
+/// Build and run with: make send_benchmark
+///
+/// (c) Koheron
+
+#include "serializer_deserializer.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+extern "C" {
+  #include <arpa/inet.h>
+  #include <netinet/in.h>
+  #include <sys/socket.h>
+  #include <unistd.h>
+}
+
+using namespace koheron;
+
+static int send_all(int fd, struct iovec *iov, size_t iovcnt)
+{
+    while (iovcnt > 0) {
+        struct msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+        const auto n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+
+        if (n <= 0) {
+            return -1;
+        }
+
+        advance_iovecs(iov, iovcnt, static_cast<size_t>(n));
+    }
+
+    return 0;
+}
+
+static void drain(int fd)
+{
+    std::vector<char> buffer(1 << 20);
+
+    while (read(fd, buffer.data(), buffer.size()) > 0) {}
+}
+
+static int connect_loopback(int *server_fd)
+{
+    const int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+
+    if (bind(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), addr_len) < 0 ||
+        listen(listen_fd, 1) < 0 ||
+        getsockname(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), &addr_len) < 0) {
+        close(listen_fd);
+        return -1;
+    }
+
+    const int client_fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (connect(client_fd, reinterpret_cast<struct sockaddr*>(&addr), addr_len) < 0) {
+        close(client_fd);
+        close(listen_fd);
+        return -1;
+    }
+
+    *server_fd = accept(listen_fd, nullptr, nullptr);
+    close(listen_fd);
+    return client_fd;
+}
+
+// Returns the throughput in MB/s
+template<typename Buffer>
+static double run(const std::vector<float>& data, size_t n_responses)
+{
+    int fd;
+    const int reader_fd = connect_loopback(&fd);
+
+    if (reader_fd < 0) {
+        return -1;
+    }
+
+    std::thread reader(drain, reader_fd);
+
+    DynamicSerializer<1024> serializer;
+    Buffer buffer;
+    size_t n_bytes = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < n_responses; i++) {
+        serializer.build_command<1, 1>(buffer, data);
+        struct iovec iov;
+        struct iovec *iovecs;
+        size_t iovcnt;
+
+        if constexpr (std::is_same<Buffer, IovecBuffer>::value) {
+            iovecs = buffer.iovecs().data();
+            iovcnt = buffer.iovecs().size();
+        } else {
+            iov.iov_base = buffer.data();
+            iov.iov_len = buffer.size();
+            iovecs = &iov;
+            iovcnt = 1;
+        }
+
+        n_bytes += buffer.size();
+
+        if (send_all(fd, iovecs, iovcnt) < 0) {
+            break;
+        }
+    }
+
+    const auto stop = std::chrono::steady_clock::now();
+
+    shutdown(fd, SHUT_RDWR);
+    close(fd);
+    reader.join();
+    close(reader_fd);
+
+    return 1E-6 * n_bytes / std::chrono::duration<double>(stop - start).count();
+}
+
+int main()
+{
+    const std::vector<size_t> payload_sizes{1024, 16384, 65536, 1048576, 8388608};
+
+    std::printf("%12s %14s %14s\n", "payload (B)", "copy (MB/s)", "iovec (MB/s)");
+
+    for (auto size : payload_sizes) {
+        const std::vector<float> data(size / sizeof(float), 1.0F);
+        const size_t n_responses = std::max(size_t(16), (size_t(1) << 30) / size);
+
+        const double copy_throughput = run<std::vector<unsigned char>>(data, n_responses);
+        const double iovec_throughput = run<IovecBuffer>(data, n_responses);
+
+        std::printf("%12zu %14.1f %14.1f\n", size, copy_throughput, iovec_throughput);
+    }
+
+    return 0;
+}
@@ -0,0 +1,175 @@
+/// Contention between the connection churn and the sessions lookups
+///
+/// Compares the former sessions table (std::map and reusable IDs
+/// guarded by a mutex) with the slab (slab.hpp). Churn threads open
+/// and close sessions in a loop (short-lived scripting clients) while
+/// lookup threads keep looking up long-lived sessions.
+///
+/// Build and run with: make session_table_benchmark
+///
+/// (c) Koheron
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "slab.hpp"
+
+constexpr size_t n_live_sessions = 16;
+constexpr size_t n_churn_threads = 2;
+constexpr size_t n_lookup_threads = 2;
+constexpr int duration_ms = 500;
+
+struct SessionAbstract
+{
+    virtual ~SessionAbstract() {}
+    uint64_t key = 0;
+};
+
+struct Session : public SessionAbstract
+{
+    unsigned char buffer[1024];
+};
+
+//----------------------------------------------------------------------------
+// Former sessions table
+//----------------------------------------------------------------------------
+
+class MapTable
+{
+  public:
+    int create() {
+        std::lock_guard<std::mutex> lock(mutex);
+        int id;
+
+        if (reusable_ids.empty()) {
+            id = number_of_sessions;
+        } else {
+            id = reusable_ids.back();
+            reusable_ids.pop_back();
+        }
+
+        pool.emplace(id, std::make_unique<Session>());
+        number_of_sessions++;
+        return id;
+    }
+
+    SessionAbstract* get(int id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return pool.at(id).get();
+    }
+
+    void erase(int id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        pool.erase(id);
+        reusable_ids.push_back(id);
+        number_of_sessions--;
+    }
+
+  private:
+    std::map<int, std::unique_ptr<SessionAbstract>> pool;
+    std::vector<int> reusable_ids;
+    int number_of_sessions = 0;
+    std::mutex mutex;
+};
+
+//----------------------------------------------------------------------------
+// Slab
+//----------------------------------------------------------------------------
+
+class SlabTable
+{
+  public:
+    SlabTable()
+    : slab(512, sizeof(Session), alignof(Session))
+    {}
+
+    int create() {
+        const int id = slab.allocate();
+        slab.publish(id, new (slab.get_storage(id)) Session());
+        return id;
+    }
+
+    SessionAbstract* get(int id) {
+        return slab.get(id);
+    }
+
+    void erase(int id) {
+        slab.retire(id)->~SessionAbstract();
+        slab.release(id);
+    }
+
+  private:
+    koheron::Slab<SessionAbstract> slab;
+};
+
+//----------------------------------------------------------------------------
+
+template<typename Table>
+static void run(const char *name)
+{
+    Table table;
+    std::vector<int> live_ids;
+
+    for (size_t i = 0; i < n_live_sessions; i++) {
+        live_ids.push_back(table.create());
+    }
+
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> n_lookups{0};
+    std::atomic<uint64_t> n_churns{0};
+    std::atomic<uint64_t> checksum{0};
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < n_lookup_threads; i++) {
+        threads.emplace_back([&] {
+            uint64_t n = 0;
+            uint64_t sum = 0;
+
+            while (!stop.load(std::memory_order_relaxed)) {
+                sum += table.get(live_ids[n % n_live_sessions])->key;
+                n++;
+            }
+
+            n_lookups += n;
+            checksum += sum;
+        });
+    }
+
+    for (size_t i = 0; i < n_churn_threads; i++) {
+        threads.emplace_back([&] {
+            uint64_t n = 0;
+
+            while (!stop.load(std::memory_order_relaxed)) {
+                table.erase(table.create());
+                n++;
+            }
+
+            n_churns += n;
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(duration_ms));
+    stop = true;
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    const double seconds = duration_ms / 1000.0;
+    std::printf("%8s %16.2f %16.2f\n", name, n_lookups / seconds / 1E6, n_churns / seconds / 1E6);
+}
+
+int main()
+{
+    std::printf("%8s %16s %16s\n", "table", "lookups (M/s)", "churn (M/s)");
+    run<MapTable>("map");
+    run<SlabTable>("slab");
+    return 0;
+}
@@ -14,10 +14,12 @@
 class Tests
 {
   public:
-    Tests(Context&)
-    : vector(0)
+    Tests(Context& ctx_)
+    : ctx(ctx_)
+    , vector(0)
     {}
 
+    /// @read_only
     bool set_scalars(uint32_t a, int32_t b, float c, bool d, double e, uint16_t f) {
         return a == 429496729
           && b == -2048
@@ -27,6 +29,7 @@ class Tests
           && f == 42;
     }
 
+    /// @read_only
     bool set_array(uint32_t u, float f, const std::array<uint32_t, 8192>& arr, double d, int32_t i) {
         if (u != 4223453) return false;
         if (std::fabs(f - 3.14159265358F) > std::numeric_limits<float>::epsilon()) return false;
@@ -78,31 +81,85 @@ class Tests
         return vector_u;
     }
 
+    const std::vector<uint32_t>& get_large_vector(uint32_t length) {
+        vector_u.resize(length);
+
+        for (size_t i=0; i<vector_u.size(); i++) {
+            vector_u[i] = i;
+        }
+
+        return vector_u;
+    }
+
+    /// @read_only
+    bool set_vector(const std::vector<uint32_t>& vec) {
+        for (size_t j=0; j<vec.size(); j++) {
+            if (vec[j] != j) return false;
+        }
+
+        return vec.size() == 8192;
+    }
+
+    /// @read_only
     bool set_string(const std::string& str) {
         return str == "Hello World";
     }
 
+    /// @read_only
     std::string get_string() {
         return "Hello World";
     }
 
+    /// @read_only
     const std::string& get_const_string() {
         return const_string;
     }
 
+    /// @read_only
     std::string get_json() {
         return "{\"date\":\"20/07/2016\",\"machine\":\"PC-3\",\"time\":\"18:16:13\",\"user\":\"thomas\",\"version\":\"0691eed\"}";
     }
 
+    /// @read_only
     auto get_tuple() {
         return std::make_tuple(501762438, 507.3858, 926547.6468507200, true);
     }
 
+    // Server-push streams
+
+    const auto& get_stream_frame() {
+        return stream_frame;
+    }
+
+    // Publish n_frames frames of the get_stream_frame stream.
+    // All the elements of frame i are equal to i.
+    void publish_stream(uint32_t n_frames) {
+        for (uint32_t i=0; i<n_frames; i++) {
+            stream_frame.fill(i);
+            ctx.publish<Tests, op_id::Tests::get_stream_frame>(stream_frame);
+        }
+    }
+
+    // Frames split in several UDP datagrams
+    const auto& get_large_stream_frame() {
+        return large_stream_frame;
+    }
+
+    void publish_large_stream(uint32_t n_frames) {
+        for (uint32_t i=0; i<n_frames; i++) {
+            large_stream_frame.fill(i);
+            ctx.publish<Tests, op_id::Tests::get_large_stream_frame>(large_stream_frame);
+        }
+    }
+
   private:
+    Context& ctx;
     std::vector<float> vector;
     std::vector<uint32_t> vector_u;
     std::array<uint32_t, 8192> array;
     std::string string;
+    std::array<uint32_t, 16> stream_frame{};
+    std::array<uint32_t, 4096> large_stream_frame{};
 
     std::string const_string = "Hello World const";
 };
@@ -6,6 +6,23 @@ PHONY: tests_py
 tests_py: run
 	HOST=$(HOST) pytest -v $(TESTS_PATH)/tests.py
 
+# Same against the host build of the server (runs on the host):
+# make CONFIG=tests/config.yml host_tests
+PHONY: host_tests
+host_tests: host_server
+	$(HOST_SERVER) & pid=$$!; trap "kill $$pid" EXIT; sleep 1; \
+	HOST=127.0.0.1 UNIXSOCK=/tmp/koheron-server.sock LOCAL_SERVER=1 UDP_STREAMING=1 PYTHONPATH=$(PYTHON_PATH) $(PYTHON) -m pytest -v $(TESTS_PATH)/tests.py
+
+# Same with the reactor sessions model (see config::session_model)
+PHONY: host_tests_reactor
+host_tests_reactor:
+	$(MAKE) HOST_TMP=$(TMP)/host-reactor HOST_SERVER_FLAGS=-DKOHERON_REACTOR host_tests
+
+# Same with the io_uring transport (see config::io_uring_transport)
+PHONY: host_tests_io_uring
+host_tests_io_uring:
+	$(MAKE) HOST_TMP=$(TMP)/host-io-uring HOST_SERVER_FLAGS=-DKOHERON_IO_URING host_tests
+
 # TODO fix ugly hack
 $(TMP)/koheron_with_exports.ts: $(WEB_PATH)/koheron.ts
 	rm -f $@
@@ -17,3 +34,89 @@ $(TESTS_PATH)/tests.js: $(TESTS_PATH)/tests.ts $(TMP)/koheron_with_exports.ts
 PHONY: test_js
 tests_js: run $(TESTS_PATH)/tests.js
 	HOST=$(HOST) nodeunit $(TESTS_PATH)/tests.js
+
+# Compare the read/write and io_uring session transports on loopback (runs on the host)
+$(TMP)/transport_benchmark: $(TESTS_PATH)/transport_benchmark.cpp $(SERVER_PATH)/core/uring.cpp $(SERVER_PATH)/core/uring.hpp
+	g++ -O3 -std=c++17 -pthread -I$(SERVER_PATH)/core $(filter %.cpp,$^) -o $@
+
+PHONY: transport_benchmark
+transport_benchmark: $(TMP)/transport_benchmark
+	$<
+
+# Compare copied and scatter-gather responses serialization (runs on the host)
+$(TMP)/send_benchmark: $(TESTS_PATH)/send_benchmark.cpp $(SERVER_PATH)/core/serializer_deserializer.hpp $(SERVER_PATH)/core/iovec.hpp
+	g++ -O3 -std=c++17 -pthread -I$(SERVER_PATH)/core $< -o $@
+
+PHONY: send_benchmark
+send_benchmark: $(TMP)/send_benchmark
+	$<
+
+# Check the WebSocket payload unmasking against the byte-wise reference (runs on the host)
+$(TMP)/unmask_test: $(TESTS_PATH)/unmask_test.cpp $(SERVER_PATH)/core/websocket_mask.hpp
+	g++ -O3 -std=c++17 -I$(SERVER_PATH)/core $< -o $@
+
+PHONY: unmask_test
+unmask_test: $(TMP)/unmask_test
+	$<
+
+# Round trip of the responses compression through the C++ client decompressor (runs on the host).
+# The client header includes the operations generated by the host server build.
+$(TMP)/lz4_test: $(TESTS_PATH)/lz4_test.cpp $(SERVER_PATH)/core/compression.cpp $(SERVER_PATH)/core/buffer_pool.cpp $(SERVER_PATH)/client/koheron-client.hpp | host_server
+	g++ -O3 -std=c++17 -pthread -I$(SDK_PATH) -I. -I$(SERVER_PATH)/context -I$(SERVER_PATH)/core -I$(SERVER_PATH)/client \
+	    -I$(HOST_TMP)/$(PROJECT_PATH)server $(filter %.cpp,$^) -o $@
+
+PHONY: lz4_test
+lz4_test: $(TMP)/lz4_test
+	$<
+
+# Compare the byte-wise and word WebSocket payload unmasking (runs on the host)
+$(TMP)/unmask_benchmark: $(TESTS_PATH)/unmask_benchmark.cpp $(SERVER_PATH)/core/websocket_mask.hpp
+	g++ -O3 -std=c++17 -I$(SERVER_PATH)/core $< -o $@
+
+PHONY: unmask_benchmark
+unmask_benchmark: $(TMP)/unmask_benchmark
+	$<
+
+# Compare the former recursive command dispatch with the dispatch table (runs on the host)
+$(TMP)/dispatch_benchmark: $(TESTS_PATH)/dispatch_benchmark.cpp
+	g++ -O3 -std=c++17 $< -o $@
+
+PHONY: dispatch_benchmark
+dispatch_benchmark: $(TMP)/dispatch_benchmark
+	$<
+
+# Compare the former sessions table with the sessions slab under connection churn (runs on the host)
+$(TMP)/session_table_benchmark: $(TESTS_PATH)/session_table_benchmark.cpp $(SERVER_PATH)/core/slab.hpp
+	g++ -O3 -std=c++17 -pthread -I$(SERVER_PATH)/core $< -o $@
+
+PHONY: session_table_benchmark
+session_table_benchmark: $(TMP)/session_table_benchmark
+	$<
+
+# Overhead of the recording of the operations latency statistics (runs on the host)
+$(TMP)/operation_stats_benchmark: $(TESTS_PATH)/operation_stats_benchmark.cpp $(SERVER_PATH)/core/operation_stats.cpp $(SERVER_PATH)/core/operation_stats.hpp
+	g++ -O3 -std=c++17 -pthread -I$(SERVER_PATH)/core $(filter %.cpp,$^) -o $@
+
+PHONY: operation_stats_benchmark
+operation_stats_benchmark: $(TMP)/operation_stats_benchmark
+	$<
+
+# Cost of the trace events (runs on the host)
+$(TMP)/trace_benchmark: $(TESTS_PATH)/trace_benchmark.cpp $(SERVER_PATH)/core/trace.cpp $(SERVER_PATH)/core/trace.hpp
+	g++ -O3 -std=c++17 -pthread -I$(SERVER_PATH)/core $(filter %.cpp,$^) -o $@
+
+PHONY: trace_benchmark
+trace_benchmark: $(TMP)/trace_benchmark
+	$<
+
+# Replay a mix of commands from concurrent TCP and WebSocket clients (see load_generator.py)
+PHONY: load_test
+load_test: run
+	PYTHONPATH=$(PYTHON_PATH) $(PYTHON) $(TESTS_PATH)/load_generator.py --host $(HOST) --clients tcp=2,websocket=2 $(LOAD_ARGS)
+
+# Same with the Unix socket clients, against the host build of the server (runs on the host):
+# make CONFIG=tests/config.yml host_load_test
+PHONY: host_load_test
+host_load_test: host_server
+	$(HOST_SERVER) & pid=$$!; trap "kill $$pid" EXIT; sleep 1; \
+	PYTHONPATH=$(PYTHON_PATH) $(PYTHON) $(TESTS_PATH)/load_generator.py --host 127.0.0.1 --unixsock /tmp/koheron-server.sock $(LOAD_ARGS)
@@ -7,9 +7,16 @@ import pytest
 import struct
 import numpy as np
 import re
+import threading
+import time
+import socket
+import base64
+import hashlib
 
 sys.path = [".."] + sys.path
-from koheron import connect, command, __version__
+from koheron import connect, command, __version__, KoheronClient, UdpStream
+from koheron.koheron import STREAM_DROP_OLDEST, STREAM_BLOCK, make_command
+from koheron.koheron import UDP_PORT, UDP_SUBSCRIBE, UDP_CONTROL_FMT, UDP_CONTROL_SIZE, UDP_COOKIE
 
 class Tests:
     def __init__(self, client):
@@ -19,6 +26,14 @@ class Tests:
     def get_server_version(self):
         return self.client.recv_string()
 
+    @command(classname='KServer', funcname='get_memory_report')
+    def get_memory_report(self):
+        return self.client.recv_json()
+
+    @command(classname='KServer', funcname='get_startup_report')
+    def get_startup_report(self):
+        return self.client.recv_json()
+
     @command()
     def set_scalars(self, a, b, c, d, e, f):
         return self.client.recv_bool()
@@ -43,6 +58,14 @@ class Tests:
     def get_const_auto_vector(self):
         return self.client.recv_vector(dtype='uint32')
 
+    @command()
+    def get_large_vector(self, length):
+        return self.client.recv_vector(dtype='uint32')
+
+    @command()
+    def set_vector(self, vec):
+        return self.client.recv_bool()
+
     @command()
     def set_string(self, str):
         return self.client.recv_bool()
@@ -63,10 +86,26 @@ class Tests:
     def get_tuple(self):
         return self.client.recv_tuple('Idd?')
 
+    @command()
+    def publish_stream(self, n_frames):
+        pass
+
+    @command()
+    def publish_large_stream(self, n_frames):
+        pass
+
 # Unit Tests
 host = os.getenv('HOST', '192.168.1.100')
+unixsock = os.getenv('UNIXSOCK', '/var/run/koheron-server.sock')
 
-client = connect(host, name='test')
+# The server is built with UDP streaming (see config::udp_port)
+udp_streaming = os.getenv('UDP_STREAMING') == '1'
+
+# The host build of the server (make host_tests) runs without the instrument manager
+if os.getenv('LOCAL_SERVER'):
+    client = KoheronClient(host)
+else:
+    client = connect(host, name='test')
 tests = Tests(client)
 
 def test_get_server_version():
@@ -83,6 +122,23 @@ def test_set_array():
     arr = np.arange(8192, dtype='uint32')
     assert tests.set_array(4223453, np.pi, arr, 2.654798454646, -56789)
 
+def test_concurrent_read_only():
+    # set_array and set_scalars are read-only operations: several
+    # sessions execute them at once, each with its own arguments.
+    results = []
+    def run():
+        session = Tests(KoheronClient(host))
+        arr = np.arange(8192, dtype='uint32')
+        for _ in range(50):
+            results.append(session.set_array(4223453, np.pi, arr, 2.654798454646, -56789))
+            results.append(session.set_scalars(429496729, -2048, np.pi, True, np.exp(1), 42))
+    threads = [threading.Thread(target=run) for _ in range(4)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    assert len(results) == 400 and all(results)
+
 def test_get_array():
     array = tests.get_array()
     assert len(array) == 8192
@@ -107,6 +163,12 @@ def test_get_const_auto_vector():
     for i in range(len(array)):
         assert array[i] == 42 * i
 
+def test_get_large_vector():
+    length = 1 << 20
+    array = tests.get_large_vector(length)
+    assert len(array) == length
+    assert np.array_equal(array, np.arange(length, dtype='uint32'))
+
 def test_set_string():
     assert tests.set_string('Hello World')
 
@@ -129,4 +191,309 @@ def test_get_tuple():
     assert tup[0] == 501762438
     assert abs(tup[1] - 507.3858) < 5E-6
     assert abs(tup[2] - 926547.6468507200) < 1E-14
-    assert tup[3]
\ No newline at end of file
+    assert tup[3]
+
+def test_pipeline():
+    calls = [('Tests', 'get_string'), ('Tests', 'get_const_vector'),
+             ('Tests', 'get_large_vector', 1000), ('Tests', 'get_tuple')] * 50
+    responses = client.pipeline(calls)
+    assert len(responses) == len(calls)
+    for i in range(0, len(responses), 4):
+        assert responses[i] == 'Hello World'
+        assert np.array_equal(responses[i + 1], np.arange(42, dtype='uint32') ** 2)
+        assert np.array_equal(responses[i + 2], np.arange(1000, dtype='uint32'))
+        assert responses[i + 3][0] == 501762438
+
+def test_large_pipeline():
+    # The commands (5 MB) and the responses (20 MB) exceed the socket buffers
+    calls = [('Tests', 'set_string', 'x' * 100000), ('Tests', 'get_large_vector', 100000)] * 50
+    responses = client.pipeline(calls)
+    assert len(responses) == len(calls)
+    for i in range(0, len(responses), 2):
+        assert not responses[i]
+        assert np.array_equal(responses[i + 1], np.arange(100000, dtype='uint32'))
+
+def test_batch():
+    calls = [('Tests', 'set_string', 'Hello World'), ('Tests', 'get_string'),
+             ('Tests', 'get_large_vector', 5000), ('KServer', 'get_version'), ('Tests', 'get_tuple')]
+    responses = client.batch(calls)
+    assert responses[0]
+    assert responses[1] == 'Hello World'
+    assert np.array_equal(responses[2], np.arange(5000, dtype='uint32'))
+    assert responses[3] == tests.get_server_version()
+    assert responses[4][0] == 501762438
+
+def test_batch_failed_command():
+    # A failed command has an entry without response: the stream stays in sync
+    device_id, cmd_id, cmd_args = client.get_ids('KServer', 'batch')
+    tests_id, get_string_id, _ = client.get_ids('Tests', 'get_string')
+    cmd = make_command(device_id, cmd_id, cmd_args, 5)
+    cmd += make_command(tests_id, get_string_id, [])
+    cmd += make_command(tests_id, 999, [])
+    cmd += make_command(999, 0, [])
+    cmd += make_command(0xFFFF, 0xFFFF, [])
+    cmd += make_command(tests_id, get_string_id, [])
+    client.sock.sendall(cmd)
+    payload = client.recv_dynamic_payload()
+    statuses = []
+    while payload:
+        status, length = struct.unpack('>iI', payload[:8])
+        statuses.append(status)
+        payload = payload[8 + length:]
+    assert statuses == [0, -1, -1, -1, 0]
+    assert tests.get_tuple()[0] == 501762438
+
+@pytest.mark.parametrize('command_name, args, splits', [
+    ('set_array', (4223453, np.pi, np.arange(8192, dtype='uint32'), 2.654798454646, -56789), [3, 0.5]),
+    # Split inside the length prefix of the vector and of the string (after the 12-byte header)
+    ('set_vector', (np.arange(8192, dtype='uint32'),), [14, 0.5]),
+    ('set_string', ('Hello World',), [14])
+])
+def test_partial_command(command_name, args, splits):
+    # A client stopping in the middle of a command doesn't hold up the other sessions
+    slow = KoheronClient(host)
+    device_id, cmd_id, cmd_args = slow.get_ids('Tests', command_name)
+    cmd = make_command(device_id, cmd_id, cmd_args, *args)
+    bounds = [0] + [s if isinstance(s, int) else int(len(cmd) * s) for s in splits] + [len(cmd)]
+    for start, end in zip(bounds[:-1], bounds[1:]):
+        slow.sock.sendall(cmd[start:end])
+        t0 = time.time()
+        assert tests.get_tuple()[0] == 501762438
+        assert time.time() - t0 < 1
+    assert slow.recv_ret_type(slow.cmds_ret_types_list[device_id][command_name])
+
+def websocket_upgrade(split=False):
+    '''Open a WebSocket connection. Returns the socket and the bytes received after the handshake.'''
+    sock = socket.create_connection((host, 8080), timeout=5)
+    key = base64.b64encode(os.urandom(16)).decode()
+    request = ('GET / HTTP/1.1\r\nHost: {}:8080\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n'
+               'Sec-WebSocket-Key: {}\r\nSec-WebSocket-Version: 13\r\n\r\n').format(host, key).encode()
+    if split:
+        sock.sendall(request[:20])
+        time.sleep(0.2)
+        request = request[20:]
+    sock.sendall(request)
+    response = b''
+    while b'\r\n\r\n' not in response:
+        chunk = sock.recv(4096)
+        assert chunk
+        response += chunk
+    assert response.startswith(b'HTTP/1.1 101')
+    accept = base64.b64encode(hashlib.sha1((key + '258EAFA5-E914-47DA-95CA-C5AB0DC85B11').encode()).digest())
+    assert accept in response
+    return sock, response.split(b'\r\n\r\n', 1)[1]
+
+def websocket_recv_frame(sock, data):
+    '''Receive a small unmasked server frame'''
+    while len(data) < 2 or len(data) < 2 + (data[1] & 0x7F):
+        chunk = sock.recv(4096)
+        assert chunk
+        data += chunk
+    return data
+
+def test_websocket_split_upgrade():
+    # The upgrade request and the frames are received in several reads
+    sock, data = websocket_upgrade(split=True)
+
+    # Masked binary frame with the get_server_version command
+    device_id, cmd_id, _ = client.get_ids('KServer', 'get_version')
+    cmd = bytes(make_command(device_id, cmd_id))
+    mask = os.urandom(4)
+    frame = struct.pack('>BB', 0x82, 0x80 | len(cmd)) + mask + bytes(b ^ mask[i % 4] for i, b in enumerate(cmd))
+    sock.sendall(frame[:4])
+    time.sleep(0.2)
+    sock.sendall(frame[4:])
+    data = websocket_recv_frame(sock, data)
+    assert data[0] == 0x82
+    assert tests.get_server_version().encode() in data
+    sock.close()
+
+def test_websocket_fragmented_message():
+    # set_array (32 kB) sent in masked fragments
+    sock, data = websocket_upgrade()
+    device_id, cmd_id, cmd_args = client.get_ids('Tests', 'set_array')
+    cmd = bytes(make_command(device_id, cmd_id, cmd_args, 4223453, np.pi, np.arange(8192, dtype='uint32'), 2.654798454646, -56789))
+    fragments = [cmd[i:i + 5000] for i in range(0, len(cmd), 5000)]
+    for i, fragment in enumerate(fragments):
+        opcode = 0x2 if i == 0 else 0x0
+        fin = 0x80 if i == len(fragments) - 1 else 0
+        mask = os.urandom(4)
+        masked = (np.frombuffer(fragment, dtype='uint8') ^ np.resize(np.frombuffer(mask, dtype='uint8'), len(fragment))).tobytes()
+        sock.sendall(struct.pack('>BBH', fin | opcode, 0x80 | 126, len(fragment)) + mask + masked)
+    data = websocket_recv_frame(sock, data)
+    assert data[0] == 0x82
+    assert data[-1] == 1
+    sock.close()
+
+def test_websocket_unmasked_frame():
+    # The server closes the connection with a protocol error (1002)
+    sock, data = websocket_upgrade()
+    device_id, cmd_id, _ = client.get_ids('KServer', 'get_version')
+    cmd = bytes(make_command(device_id, cmd_id))
+    sock.sendall(struct.pack('>BB', 0x82, len(cmd)) + cmd)
+    data = websocket_recv_frame(sock, data)
+    assert data[0] == 0x88
+    assert struct.unpack('>H', data[2:4])[0] == 1002
+    sock.close()
+
+def test_websocket_declared_size():
+    # The payload buffer grows with the bytes received, not with the declared size
+    sock, _ = websocket_upgrade()
+    bytes_in_use = tests.get_memory_report()['bytes_in_use']
+    sock.sendall(struct.pack('>BBQ', 0x82, 0x80 | 127, 16 * 1024 * 1024) + os.urandom(4) + b'0' * 1000)
+    time.sleep(0.2)
+    assert tests.get_memory_report()['bytes_in_use'] - bytes_in_use < 1024 * 1024
+    sock.close()
+
+def test_get_memory_report():
+    report = tests.get_memory_report()
+    assert report['number_of_sessions'] >= 1
+    assert report['bytes_in_use'] <= report['peak_bytes_in_use']
+    assert report['number_of_allocations'] <= report['number_of_acquires']
+    # Commands no longer embed a payload buffer
+    assert report['sizeof_command'] < 1024
+    # The session owns its buffers on top of the object
+    assert report['session_bytes'] > report['sizeof_tcp_session']
+    assert report['log_records_dropped'] == 0
+
+def test_get_startup_report():
+    report = tests.get_startup_report()
+    if report['threads'] > 0:
+        # All the drivers are started with the server
+        assert sorted(driver['name'] for driver in report['drivers']) == ['Common', 'Tests']
+        for driver in report['drivers']:
+            assert driver['start_us'] + driver['duration_us'] <= report['duration_us']
+
+def test_get_stats():
+    for i in range(10):
+        tests.get_large_vector(1000)
+    stats = client.get_stats()
+    assert stats['requests']['tcp'] + stats['requests']['websocket'] + stats['requests']['unix'] > 0
+    operation = next(op for op in stats['operations'] if op['name'] == 'get_large_vector')
+    assert operation['driver_name'] == 'Tests'
+    assert operation['requests'] >= 10
+    assert operation['bytes_sent'] >= 10 * 4000
+    for latency in ['lock_ns', 'exec_ns', 'send_ns']:
+        percentiles = [operation[latency][p] for p in ['p50', 'p90', 'p99', 'p999', 'max']]
+        assert percentiles == sorted(percentiles)
+
+def test_get_trace():
+    for i in range(10):
+        tests.get_large_vector(1000)
+    trace = client.get_trace(10)
+    events = [event for event in trace['traceEvents'] if event['ph'] == 'X']
+    names = set(event['name'] for event in events)
+    assert 'Tests::get_large_vector' in names
+    assert 'send' in names
+    assert all(event['dur'] >= 0 for event in events)
+
+def test_get_trace_slow_client():
+    # A client not reading its trace dumps doesn't hold up the Server operations
+    slow = KoheronClient(host)
+    device_id, cmd_id, cmd_args = slow.get_ids('KServer', 'get_trace')
+    slow.sock.sendall(bytes(make_command(device_id, cmd_id, cmd_args, 10)) * 200)
+    time.sleep(0.5)
+    # The connection runs Server operations (get_version, get_cmds)
+    socket.setdefaulttimeout(1)
+    try:
+        other = KoheronClient(host)
+        assert Tests(other).get_memory_report()['number_of_sessions'] >= 2
+    finally:
+        socket.setdefaulttimeout(None)
+        slow.sock.close()
+
+def test_compression():
+    assert client.enable_compression()
+    length = 1 << 20
+    array = tests.get_large_vector(length)
+    assert np.array_equal(array, np.arange(length, dtype='uint32'))
+    assert tests.get_string() == 'Hello World'
+    responses = client.pipeline([('Tests', 'get_large_vector', length), ('Tests', 'get_tuple')])
+    assert np.array_equal(responses[0], np.arange(length, dtype='uint32'))
+    assert responses[1][0] == 501762438
+
+def test_stream_block():
+    n_frames = 100
+    assert client.subscribe('Tests', 'get_stream_frame', STREAM_BLOCK, 4)
+    tests.publish_stream(n_frames)
+    for i in range(n_frames):
+        frame = client.recv_frame('Tests', 'get_stream_frame')
+        assert np.array_equal(frame, np.full(16, i, dtype='uint32'))
+    assert client.unsubscribe('Tests', 'get_stream_frame') == (n_frames, 0)
+
+def test_subscribe_invalid_operation():
+    # No stream for an operation that doesn't exist
+    device_id, _, _ = client.get_ids('Tests', 'get_stream_frame')
+    kserver_id, subscribe_id, cmd_args = client.get_ids('KServer', 'subscribe')
+    for driver, operation in [(device_id, 999), (device_id, 0xFFFF), (999, 0)]:
+        client.send_command(kserver_id, subscribe_id, cmd_args, driver, operation, STREAM_BLOCK, 4)
+        assert not client.recv(fmt='?')
+    assert tests.get_memory_report()['number_of_subscriptions'] == 0
+
+def test_stream_drop_oldest():
+    n_frames = 1000
+    assert client.subscribe('Tests', 'get_stream_frame', STREAM_DROP_OLDEST, 1)
+    tests.publish_stream(n_frames)
+    # The last frame is never dropped
+    n_received = 0
+    frame = None
+    while frame is None or frame[0] != n_frames - 1:
+        frame = client.recv_frame('Tests', 'get_stream_frame')
+        n_received += 1
+    sent, dropped = client.unsubscribe('Tests', 'get_stream_frame')
+    assert sent == n_received
+    assert sent + dropped == n_frames
+
+def test_stream_interleaved_responses():
+    assert client.subscribe('Tests', 'get_stream_frame', STREAM_BLOCK, 16)
+    tests.publish_stream(10)
+    assert tests.get_string() == 'Hello World'
+    for i in range(10):
+        assert client.recv_frame('Tests', 'get_stream_frame')[0] == i
+    assert client.unsubscribe('Tests', 'get_stream_frame') == (10, 0)
+    assert tests.get_memory_report()['number_of_subscriptions'] == 0
+
+@pytest.mark.skipif(not udp_streaming, reason='Requires UDP streaming')
+def test_udp_stream():
+    n_frames = 10
+    stream = UdpStream(client, 'Tests', 'get_large_stream_frame')
+    tests.publish_large_stream(n_frames)
+    # Only the latest frames are queued, the last one is always sent
+    last = -1
+    while last != n_frames - 1:
+        timestamp, frame = stream.recv_frame()
+        assert timestamp > 0
+        assert frame[0] > last
+        assert np.array_equal(frame, np.full(4096, frame[0], dtype='uint32'))
+        last = frame[0]
+    assert stream.datagrams_lost == 0
+    assert stream.frames_dropped == 0
+    stream.close()
+    assert tests.get_memory_report()['number_of_subscriptions'] == 0
+
+@pytest.mark.skipif(not udp_streaming, reason='Requires UDP streaming')
+def test_udp_subscribe_without_cookie():
+    device_id, cmd_id, _ = client.get_ids('Tests', 'get_large_stream_frame')
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.connect((client.host or '127.0.0.1', UDP_PORT))
+    sock.settimeout(1.0)
+    sock.send(struct.pack(UDP_CONTROL_FMT, UDP_SUBSCRIBE, device_id, cmd_id, 0, 0))
+    # The answer has the size of the request, and no subscription is made
+    data = sock.recv(65536)
+    assert len(data) == UDP_CONTROL_SIZE
+    assert struct.unpack(UDP_CONTROL_FMT, data)[4] == UDP_COOKIE
+    assert tests.get_memory_report()['number_of_subscriptions'] == 0
+    sock.close()
+
+@pytest.mark.skipif(not os.path.exists(unixsock), reason='Requires a local server')
+def test_shared_memory():
+    local = KoheronClient(unixsock=unixsock)
+    assert local.open_shared_memory()
+    local_tests = Tests(local)
+    length = 1 << 20
+    # Several times the ring size
+    for i in range(10):
+        array = local_tests.get_large_vector(length)
+        assert np.array_equal(array, np.arange(length, dtype='uint32'))
+        assert local_tests.set_array(4223453, np.pi, np.arange(8192, dtype='uint32'), 2.654798454646, -56789)
+    assert local_tests.get_string() == 'Hello World'
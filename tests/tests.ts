@@ -76,6 +76,10 @@ class Tests {
     getTuple(cb) {
         this.client.readTuple(Command(this.id, this.cmds.get_tuple), 'Idd?', cb);
     }
+
+    getLargeVector(length, cb) {
+        this.client.readUint32Vector(Command(this.id, this.cmds.get_large_vector, length), cb);
+    }
 }
 
 // // Unit tests
@@ -277,3 +281,37 @@ export function getTuple(assert) {
         });
     });
 }
+
+// Compressed responses: the server LZ4 compressor and the client decompressor
+// (the responses above config::compression_min_size = 64 kB are compressed)
+
+let checkLargeVectorCompressed = function(assert, length) {
+    let client = new Client(HOST, 1, true);
+    assert.doesNotThrow( () => {
+        client.init( () => {
+            let tests = new Tests(client);
+            tests.getLargeVector(length, (array) => {
+                assert.equals(array.length, length);
+                let is_ok = true;
+                for (let i = 0; i < array.length; i++) {
+                    if (array[i] !== i) {
+                        is_ok = false;
+                        break;
+                    }
+                }
+                assert.ok(is_ok);
+                client.exit();
+                assert.done();
+            });
+        });
+    });
+};
+
+export function getLargeVectorCompressed(assert) {
+    checkLargeVectorCompressed(assert, 20000);
+}
+
+export function getVeryLargeVectorCompressed(assert) {
+    // 1 MB: the matches span many 64 kB LZ4 windows
+    checkLargeVectorCompressed(assert, 262144);
+}
@@ -0,0 +1,89 @@
+/// Cost of the trace events
+///
+/// Times an empty scope with and without KOHERON_TRACE_SCOPE on
+/// 1 and 4 threads, while a thread dumps the trace every 100 ms,
+/// then the time to dump the full rings.
+///
+/// Build and run with: make trace_benchmark
+///
+/// (c) Koheron
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "trace.hpp"
+
+using namespace koheron;
+
+constexpr size_t n_iterations = 4000000;
+
+static thread_local volatile uint32_t sink;
+
+__attribute__((noinline)) static void operation(uint32_t value)
+{
+    sink = value;
+}
+
+__attribute__((noinline)) static void operation_traced(uint32_t value)
+{
+    KOHERON_TRACE_SCOPE("operation", value);
+    sink = value;
+}
+
+// Returns the time per operation in ns (all the threads)
+template<typename Operation>
+static double run(Operation op, size_t n_threads)
+{
+    std::atomic<bool> stop{false};
+    size_t dump_size = 0;
+
+    std::thread dump_thread([&] {
+        while (!stop.load()) {
+            dump_size += trace::dump(1).size();
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    });
+
+    std::vector<std::thread> threads;
+    const auto start = std::chrono::steady_clock::now();
+
+    for (size_t t = 0; t < n_threads; t++) {
+        threads.emplace_back([&] {
+            for (uint32_t i = 0; i < n_iterations; i++) {
+                op(i);
+            }
+        });
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    const auto stop_time = std::chrono::steady_clock::now();
+    stop = true;
+    dump_thread.join();
+    return 1E9 * std::chrono::duration<double>(stop_time - start).count() / (n_iterations * n_threads);
+}
+
+int main()
+{
+    std::printf("%8s %16s %16s %16s\n", "threads", "no trace (ns)", "trace (ns)", "overhead (ns)");
+
+    for (size_t n_threads : {1, 4}) {
+        const double ns = run(operation, n_threads);
+        const double trace_ns = run(operation_traced, n_threads);
+        std::printf("%8zu %16.2f %16.2f %16.2f\n", n_threads, ns, trace_ns, trace_ns - ns);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto json = trace::dump(3600);
+    const auto stop = std::chrono::steady_clock::now();
+
+    std::printf("Dump of %zu kB in %.2f ms\n", json.size() / 1024,
+                1E3 * std::chrono::duration<double>(stop - start).count());
+    return 0;
+}
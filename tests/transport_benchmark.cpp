@@ -0,0 +1,207 @@
+/// Benchmark of the session transports on loopback
+///
+/// A server thread answers fixed-size requests with a payload
+/// of a given size, either with the blocking read/write calls
+/// or with the io_uring transport (server/core/uring.cpp).
+///
+/// Build and run with: make transport_benchmark
+///
+/// (c) Koheron
+
+#include "uring.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+extern "C" {
+  #include <arpa/inet.h>
+  #include <netinet/in.h>
+  #include <netinet/tcp.h>
+  #include <signal.h>
+  #include <sys/socket.h>
+  #include <unistd.h>
+}
+
+using namespace koheron;
+
+constexpr size_t request_size = 8;
+
+static int read_all(int fd, char *buffer, size_t len)
+{
+    size_t bytes_read = 0;
+
+    while (bytes_read < len) {
+        const auto n = read(fd, buffer + bytes_read, len - bytes_read);
+
+        if (n <= 0) {
+            return -1;
+        }
+
+        bytes_read += n;
+    }
+
+    return 0;
+}
+
+static int write_all(int fd, const unsigned char *data, size_t len)
+{
+    size_t bytes_send = 0;
+
+    while (bytes_send < len) {
+        const auto n = write(fd, data + bytes_send, len - bytes_send);
+
+        if (n <= 0) {
+            return -1;
+        }
+
+        bytes_send += n;
+    }
+
+    return 0;
+}
+
+static void serve(int fd, size_t response_size, bool use_uring)
+{
+    std::vector<unsigned char> response(response_size, 42);
+    char request[request_size];
+    UringTransport uring;
+
+    if (use_uring && uring.open(fd) < 0) {
+        return;
+    }
+
+    while (true) {
+        if (use_uring) {
+            if (uring.recv(request, request_size) <= 0 ||
+                uring.send(response.data(), response.size()) < 0) {
+                break;
+            }
+        } else {
+            if (read_all(fd, request, request_size) < 0 ||
+                write_all(fd, response.data(), response.size()) < 0) {
+                break;
+            }
+        }
+    }
+
+    uring.close();
+    close(fd);
+}
+
+static int connect_loopback(int listen_fd, int *server_fd)
+{
+    struct sockaddr_in addr{};
+    socklen_t addr_len = sizeof(addr);
+
+    if (getsockname(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), &addr_len) < 0) {
+        return -1;
+    }
+
+    const int client_fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (connect(client_fd, reinterpret_cast<struct sockaddr*>(&addr), addr_len) < 0) {
+        close(client_fd);
+        return -1;
+    }
+
+    *server_fd = accept(listen_fd, nullptr, nullptr);
+
+    int one = 1;
+    setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setsockopt(*server_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return client_fd;
+}
+
+// Requests are sent by groups of pipeline_depth before reading the responses
+static double run(int listen_fd, size_t response_size, size_t pipeline_depth,
+                  size_t n_requests, bool use_uring)
+{
+    int server_fd;
+    const int client_fd = connect_loopback(listen_fd, &server_fd);
+
+    if (client_fd < 0) {
+        return -1;
+    }
+
+    std::thread server_thread(serve, server_fd, response_size, use_uring);
+
+    std::vector<unsigned char> requests(request_size * pipeline_depth, 0);
+    std::vector<char> response(response_size);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < n_requests; i += pipeline_depth) {
+        if (write_all(client_fd, requests.data(), requests.size()) < 0) {
+            break;
+        }
+
+        for (size_t j = 0; j < pipeline_depth; j++) {
+            if (read_all(client_fd, response.data(), response.size()) < 0) {
+                break;
+            }
+        }
+    }
+
+    const auto stop = std::chrono::steady_clock::now();
+
+    shutdown(client_fd, SHUT_RDWR);
+    close(client_fd);
+    server_thread.join();
+
+    return std::chrono::duration<double>(stop - start).count();
+}
+
+int main()
+{
+    signal(SIGPIPE, SIG_IGN);
+
+    const int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+
+    if (bind(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        listen(listen_fd, 1) < 0) {
+        std::perror("listen");
+        return 1;
+    }
+
+    {
+        // Check io_uring availability
+        UringTransport uring;
+        const int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+        if (uring.open(fd) < 0) {
+            std::printf("io_uring transport not available\n");
+            return 0;
+        }
+
+        uring.close();
+        close(fd);
+    }
+
+    const std::vector<size_t> response_sizes{16, 4096, 65536, 1048576};
+    const std::vector<size_t> pipeline_depths{1, 8};
+
+    std::printf("%10s %6s %16s %16s %10s %10s\n",
+                "size (B)", "depth", "read/write (/s)", "io_uring (/s)", "MB/s", "MB/s");
+
+    for (auto depth : pipeline_depths) {
+        for (auto size : response_sizes) {
+            const size_t n_requests = std::max(size_t(64), size_t(1 << 28) / (size + 4096)) / depth * depth;
+            const double t_rw = run(listen_fd, size, depth, n_requests, false);
+            const double t_uring = run(listen_fd, size, depth, n_requests, true);
+
+            std::printf("%10zu %6zu %16.0f %16.0f %10.1f %10.1f\n", size, depth,
+                        n_requests / t_rw, n_requests / t_uring,
+                        1E-6 * n_requests * size / t_rw, 1E-6 * n_requests * size / t_uring);
+        }
+    }
+
+    close(listen_fd);
+    return 0;
+}
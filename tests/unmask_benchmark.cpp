@@ -0,0 +1,63 @@
+/// Throughput benchmark of the WebSocket payload unmasking
+///
+/// Compares the byte-wise unmasking with the word (and NEON) version.
+///
+/// Build and run with: make unmask_benchmark
+///
+/// (c) Koheron
+
+#include "websocket_mask.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using namespace koheron;
+
+// Returns the throughput in MB/s
+template<typename Unmask>
+static double run(Unmask unmask_func, std::vector<char>& data, size_t n_iterations)
+{
+    const char mask[4] = {0x12, 0x34, 0x56, 0x78};
+
+    // Unaligned payload, as in a received frame
+    char *payload = data.data() + 1;
+    const size_t len = data.size() - 1;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < n_iterations; i++) {
+        unmask_func(payload, len, mask);
+    }
+
+    const auto stop = std::chrono::steady_clock::now();
+
+    // Prevent the compiler from discarding the loop
+    volatile char sink = payload[len / 2];
+    (void)sink;
+
+    return 1E-6 * len * n_iterations / std::chrono::duration<double>(stop - start).count();
+}
+
+int main()
+{
+    const std::vector<size_t> payload_sizes{64, 1024, 16384, 262144, 4194304};
+
+#ifdef KOHERON_HAS_NEON
+    std::printf("NEON enabled\n");
+#endif
+
+    std::printf("%12s %14s %14s\n", "payload (B)", "bytes (MB/s)", "words (MB/s)");
+
+    for (auto size : payload_sizes) {
+        std::vector<char> data(size + 1, 1);
+        const size_t n_iterations = std::max(size_t(16), (size_t(1) << 30) / size);
+
+        const double bytes_throughput = run(unmask_bytes, data, n_iterations);
+        const double words_throughput = run(unmask, data, n_iterations);
+
+        std::printf("%12zu %14.1f %14.1f\n", size, bytes_throughput, words_throughput);
+    }
+
+    return 0;
+}
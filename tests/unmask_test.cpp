@@ -0,0 +1,54 @@
+/// Unit test of the WebSocket payload unmasking
+///
+/// Compares unmask() with the byte-wise reference for all the
+/// alignments and lengths around the word sizes.
+///
+/// Build and run with: make unmask_test
+///
+/// (c) Koheron
+
+#include "websocket_mask.hpp"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace koheron;
+
+int main()
+{
+    std::mt19937 rng(42);
+    std::vector<char> data(1024 + 64);
+    std::vector<char> reference(data.size());
+    char mask[4];
+    unsigned int n_failures = 0;
+
+    for (size_t offset = 0; offset < 32; offset++) {
+        for (size_t len = 0; len <= 1024; len++) {
+            for (auto& c : mask) {
+                c = static_cast<char>(rng());
+            }
+
+            for (auto& c : data) {
+                c = static_cast<char>(rng());
+            }
+
+            reference = data;
+            unmask_bytes(reference.data() + offset, len, mask);
+            unmask(data.data() + offset, len, mask);
+
+            if (data != reference) {
+                std::printf("FAILED: offset = %zu, length = %zu\n", offset, len);
+                n_failures++;
+            }
+        }
+    }
+
+    if (n_failures > 0) {
+        std::printf("%u failures\n", n_failures);
+        return 1;
+    }
+
+    std::printf("OK\n");
+    return 0;
+}
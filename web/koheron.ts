@@ -57,7 +57,9 @@ class WebSocketPool {
     private socketCounter: number;
     private exiting: boolean;
 
-    constructor(private poolSize: number, private url: string, private onOpenCallback: any) {
+    // openCommand is sent on each new socket before it joins the pool
+    constructor(private poolSize: number, private url: string, private onOpenCallback: any,
+                private openCommand?: CmdMessage) {
         this.poolSize = poolSize;
         this.url = url;
 
@@ -74,18 +76,28 @@ class WebSocketPool {
             websocket.onopen = evt => {
                 return this.waitForConnection(websocket, 100, () => {
                     console.assert(websocket.readyState === 1, 'Websocket not ready');
-                    this.freeSockets.push(this.socketCounter);
-                    if (this.socketCounter === 0) { onOpenCallback(); }
-                    websocket.ID = this.socketCounter;
-                    websocket.onclose = evt => {
-                        setTimeout(function(){ location.reload(); }, 1000);
-                    };
-                    websocket.onerror = evt => {
-                        console.error(`error: ${evt.data}\n`);
-                        return websocket.close();
+
+                    let addSocket = () => {
+                        this.freeSockets.push(this.socketCounter);
+                        if (this.socketCounter === 0) { onOpenCallback(); }
+                        websocket.ID = this.socketCounter;
+                        websocket.onclose = evt => {
+                            setTimeout(function(){ location.reload(); }, 1000);
+                        };
+                        websocket.onerror = evt => {
+                            console.error(`error: ${evt.data}\n`);
+                            return websocket.close();
+                        };
+
+                        return this.socketCounter++;
                     };
 
-                    return this.socketCounter++;
+                    if (this.openCommand == null) {
+                        return addSocket();
+                    }
+
+                    websocket.onmessage = evt => addSocket();
+                    websocket.send(this.openCommand.data);
                 }
                 );
             };
@@ -308,6 +320,96 @@ let isStdTuple = type => type.split('<')[0].trim() === 'std::tuple';
 
 let getStdVectorType = type => type.split('<')[1].split('>')[0].trim();
 
+// === Compressed responses ===
+
+const COMPRESSION_LZ4 = 1;
+const COMPRESSION_SHUFFLE = 2;
+const COMPRESSED_RESPONSE = 1;
+
+// Decompress a LZ4 block of dstSize bytes
+let lz4Decompress = function(src: Uint8Array, dstSize: number): Uint8Array {
+    let dst = new Uint8Array(dstSize);
+    let ip = 0;
+    let op = 0;
+
+    let readLength = function(length: number): number {
+        if (length === 15) {
+            let b;
+            do {
+                b = src[ip++];
+                length += b;
+            } while (b === 255);
+        }
+        return length;
+    };
+
+    while (ip < src.length) {
+        let token = src[ip++];
+        let literalsLen = readLength(token >> 4);
+        dst.set(src.subarray(ip, ip + literalsLen), op);
+        ip += literalsLen;
+        op += literalsLen;
+
+        if (ip >= src.length) {
+            break; // Last literals
+        }
+
+        let offset = src[ip] | (src[ip + 1] << 8);
+        ip += 2;
+        let matchLen = readLength(token & 0x0F) + 4;
+
+        if (offset === 0 || offset > op || op + matchLen > dstSize) {
+            throw new Error('Invalid compressed response');
+        }
+
+        // The match can overlap its output
+        for (let i = 0; i < matchLen; i++) {
+            dst[op] = dst[op - offset];
+            op++;
+        }
+    }
+
+    if (op !== dstSize) {
+        throw new Error('Invalid compressed response');
+    }
+
+    return dst;
+};
+
+let unshuffle = function(src: Uint8Array, elementSize: number): Uint8Array {
+    let dst = new Uint8Array(src.length);
+    let nElements = Math.floor(src.length / elementSize);
+
+    for (let j = 0; j < elementSize; j++) {
+        for (let i = 0; i < nElements; i++) {
+            dst[i * elementSize + j] = src[j * nElements + i];
+        }
+    }
+
+    let nShuffled = nElements * elementSize;
+    dst.set(src.subarray(nShuffled), nShuffled);
+    return dst;
+};
+
+// Rebuild the original response from a compressed one
+let decompressResponse = function(data: ArrayBuffer): ArrayBuffer {
+    let dv = new DataView(data);
+    let size = dv.getUint32(8);
+    let compressedSize = dv.getUint32(12);
+    let elementSize = dv.getUint32(16);
+
+    let payload = lz4Decompress(new Uint8Array(data, 20, compressedSize), size);
+
+    if (elementSize > 1) {
+        payload = unshuffle(payload, elementSize);
+    }
+
+    let response = new Uint8Array(8 + size);
+    response.set(new Uint8Array(data, 4, 4), 4); // class_id and func_id
+    response.set(payload, 8);
+    return response.buffer;
+};
+
 function Command(devId: number, cmd: ICommand, ...params: any[]): CmdMessage {
     let buffer = [];
     appendUint32(buffer, 0); // RESERVED
@@ -393,7 +495,8 @@ class Client {
     private driversList: Array<Driver>;
     private websockpool: WebSocketPool;
 
-    constructor(private IP: string, private websockPoolSize: number) {
+    // Large responses are compressed by the server if compression is true
+    constructor(private IP: string, private websockPoolSize: number, private compression?: boolean) {
         if (websockPoolSize == null) { websockPoolSize = 5; }
         this.websockPoolSize = websockPoolSize;
         this.url = `ws://${IP}:8080`;
@@ -401,9 +504,16 @@ class Client {
     }
 
     init(callback) {
+        let openCommand = null;
+
+        if (this.compression) {
+            openCommand = Command(1, <ICommand>{'id': 4, 'args': [{'name': 'flags', 'type': 'uint32_t'}]},
+                                  COMPRESSION_LZ4 | COMPRESSION_SHUFFLE);
+        }
+
         return this.websockpool = new WebSocketPool(this.websockPoolSize, this.url, (function() {
             return this.loadCmds(callback);
-        }.bind(this)));
+        }.bind(this)), openCommand);
     }
 
     exit() {
@@ -448,6 +558,11 @@ class Client {
     getPayload(mode, evt) {
         let buffer, dvBuff, i, len;
         let dv = new DataView(evt.data);
+
+        if (dv.getUint32(0) === COMPRESSED_RESPONSE) {
+            dv = new DataView(decompressResponse(evt.data));
+        }
+
         let reserved = dv.getUint32(0);
         let classId = dv.getUint16(4);
         let funcId = dv.getUint16(6);